@@ -0,0 +1,69 @@
+//-----------------------------------------------------------------------------
+// AssetLoader.h
+//
+// Loads a model and its texture in the background. File reading, import and
+// image decode run on a worker pool; the finished assets are handed back to
+// the render thread through a lock-free queue for the GL uploads. Textures
+// go through a TextureManager, so one already resident is not decoded again.
+// Several textures are packed into a TextureArray, one per material.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ImportOptions.h"
+#include "LoadProgress.h"
+#include "TextureOptions.h"
+#include "MpscQueue.h"
+#include "ThreadPool.h"
+
+class Mesh;
+class Texture2D;
+class TextureArray;
+class TextureManager;
+
+class AssetLoader
+{
+public:
+	explicit AssetLoader(TextureManager &textures);
+	~AssetLoader();
+	AssetLoader(const AssetLoader &rhs) = delete;
+	AssetLoader &operator=(const AssetLoader &rhs) = delete;
+
+	// Starts loading a model and its textures: one texture for the whole
+	// model, or several for its materials in order (material i uses texture
+	// i modulo their count). A load already in flight is cancelled.
+	void load(const std::string &modelPath, const std::vector<std::string> &texturePaths, const ImportOptions &options = ImportOptions(),
+			  const TextureOptions &textureOptions = TextureOptions());
+	void cancel();
+
+	bool isLoading() const { return mCurrent != nullptr; }
+
+	// The texture on show is a preview; its full resolution follows
+	bool isRefiningTexture() const { return mPreviewing != nullptr; }
+	float progress() const;
+	const char *stage() const;
+
+	// Render thread only, once per frame. Uploads finished loads and, when
+	// the current one is ready, swaps it into mesh and texture or
+	// materials (the other is null), deletes the previous mesh and
+	// materials and releases the previous texture to the manager. A large
+	// JPEG texture may arrive as a preview first and be swapped for its full
+	// resolution on a later frame; one decoding in parallel is uploaded a
+	// band of rows at a time meanwhile. Returns true on the frames that swap.
+	bool update(Mesh *&mesh, Texture2D *&texture, TextureArray *&materials);
+
+private:
+	struct Request;
+
+	void finishJob(const std::shared_ptr<Request> &request);
+	void discard(Request &request);
+
+	// Declared before the pool so it outlives the workers that push to it
+	TextureManager &mTextures;
+	MpscQueue<std::shared_ptr<Request>> mFinished;
+	ThreadPool mPool;
+	std::shared_ptr<Request> mCurrent;
+	std::shared_ptr<Request> mPreviewing; // swapped in with its preview, full texture decoding
+};
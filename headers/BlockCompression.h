@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// BlockCompression.h
+//
+// BCn block compressed texture formats and a CPU encoder for the ones that
+// are cheap to encode well. Every format stores 4x4 texel blocks; they cut
+// RGBA8 memory and upload bandwidth by 8x (BC1, BC4) or 4x (the rest).
+// Free of GL headers: Texture2D maps the formats to GL enums.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "MipChain.h"
+
+enum class BlockFormat : uint8_t
+{
+	BC1, // RGB, 1-bit alpha; 8 bytes per block
+	BC2, // RGB, explicit 4-bit alpha
+	BC3, // RGB, interpolated alpha
+	BC4, // one channel (red)
+	BC5, // two channels (red, green), e.g. normal maps
+	BC7	 // RGBA, high quality
+};
+
+const char *blockFormatName(BlockFormat format);
+
+// Bytes of one 4x4 block, 8 or 16
+unsigned int blockBytes(BlockFormat format);
+
+// Bytes of a width x height level, partial blocks rounded up
+size_t compressedSize(BlockFormat format, int width, int height);
+
+namespace BlockCompression
+{
+	// BC1, BC3, BC4 and BC5 can be encoded; BC2 and BC7 are load only
+	bool canEncode(BlockFormat format);
+
+	// True if any texel of an RGBA8 level is not fully opaque
+	bool hasAlpha(const MipLevel &level);
+
+	// Encodes an RGBA8 level into compressedSize(format, ...) bytes at out,
+	// rows of blocks on all cores. Colour endpoints are fitted along the
+	// principal axis of each block and refined by least squares. BC4 takes
+	// the red channel and BC5 red and green.
+	void encode(const MipLevel &level, BlockFormat format, unsigned char *out);
+}
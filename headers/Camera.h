@@ -26,6 +26,7 @@ public:
 	const glm::vec3 &getRight() const;
 	const glm::vec3 &getUp() const;
 
+	const glm::vec3 &getPosition() const { return mPosition; }
 	float getFOV() const { return mFOV; }
 	void setFOV(float fov) { mFOV = fov; } // in degrees
 
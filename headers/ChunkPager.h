@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// ChunkPager.h
+//
+// Out-of-core rendering of a mesh octree (.mvoct). Chunks are read from disk
+// on worker threads and uploaded on the render thread as the camera needs
+// them, nearest visible first, under separate CPU and GPU memory budgets.
+// Whatever does not fit is evicted least recently used first.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef __APPLE__
+#include <glad/glad.h>
+#else
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+#include "glm/glm.hpp"
+#include "MeshOctree.h"
+#include "Meshlets.h"
+#include "MpscQueue.h"
+#include "ThreadPool.h"
+
+class ShaderProgram;
+
+class ChunkPager
+{
+public:
+	ChunkPager();
+	~ChunkPager();
+	ChunkPager(const ChunkPager &rhs) = delete;
+	ChunkPager &operator=(const ChunkPager &rhs) = delete;
+
+	bool open(const std::string &path);
+
+	// Bytes of chunk data the pager may keep in memory and on the GPU
+	void setBudget(uint64_t cpuBytes, uint64_t gpuBytes);
+
+	// Render thread, once per frame before draw(). Picks the chunks the
+	// camera needs, requests missing ones, uploads arrivals and evicts.
+	// Without a view every chunk is wanted.
+	void update(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView);
+
+	// Draws the wanted chunks that are resident. Sets the vertex decode
+	// uniforms of shader, which must be in use.
+	void draw(ShaderProgram &shader);
+
+	// Drops every resident chunk, e.g. to benchmark from a cold cache
+	void flush();
+
+	// Paging counters since the last resetStats()
+	struct Stats
+	{
+		uint64_t lookups;		// visible chunks over all frames
+		uint64_t hits;			// ... that were on the GPU
+		uint64_t reads;			// chunks read from disk
+		uint64_t evictions;		// chunks dropped from the CPU or GPU
+		uint64_t stalledFrames; // frames with visible chunks missing
+		double stallMs;			// time spent in those frames
+		double latencyMs;		// total time visible chunks waited to become resident
+		uint64_t arrivals;		// chunks that waited
+		double pagingMs;		// render thread time spent in update()
+		uint64_t frames;
+	};
+	const Stats &getStats() const { return mStats; }
+	void resetStats();
+
+	// State of the last update()
+	struct Residency
+	{
+		size_t chunks;
+		size_t visibleChunks;
+		size_t drawnChunks;
+		size_t gpuChunks;
+		size_t cpuChunks;
+		uint64_t cpuBytes;
+		uint64_t gpuBytes;
+		uint64_t cpuBudget;
+		uint64_t gpuBudget;
+		size_t triangles;		// drawn
+		size_t visibleTriangles;
+		size_t totalTriangles;
+	};
+	const Residency &getResidency() const { return mResidency; }
+
+	const MeshOctree::Reader &getOctree() const { return mReader; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct ChunkState
+	{
+		std::shared_ptr<std::vector<unsigned char>> data; // CPU copy
+		bool reading = false;
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		GLuint ebo = 0;
+		uint64_t lastUsed = 0;	 // frame
+		Clock::time_point missingSince;
+		bool missing = false;	 // wanted and visible but not on the GPU
+	};
+
+	struct ReadResult
+	{
+		size_t chunk;
+		uint64_t generation;
+		std::shared_ptr<std::vector<unsigned char>> data;
+	};
+
+	void selectChunks(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView);
+	void requestReads();
+	void receiveReads();
+	void uploadChunks(Clock::time_point start);
+	bool makeCpuRoom(uint64_t bytes);
+	bool makeGpuRoom(uint64_t bytes);
+	void releaseGpu(ChunkState &state);
+	uint64_t chunkBytes(size_t chunk) const;
+
+	MeshOctree::Reader mReader;
+	std::vector<ChunkState> mStates;
+	std::vector<size_t> mWanted;  // this frame, in priority order
+	size_t mVisibleCount;		  // the first mVisibleCount of mWanted are visible
+	uint64_t mFrame;
+	uint64_t mGeneration;		  // bumped by flush() to drop reads in flight
+	size_t mReadsInFlight;
+	uint64_t mCpuBudget;
+	uint64_t mGpuBudget;
+	uint64_t mCpuBytes;			  // copies in memory plus reads in flight
+	uint64_t mGpuBytes;
+	Clock::time_point mLastUpdate;
+	bool mHasLastUpdate;
+	Stats mStats;
+	Residency mResidency;
+
+	// Declared last so the workers are joined before the queue goes away
+	MpscQueue<ReadResult> mReadResults;
+	ThreadPool mPool;
+};
@@ -0,0 +1,38 @@
+//-----------------------------------------------------------------------------
+// CompressedTexture.h
+//
+// Reads block compressed textures from DDS and KTX2 files and writes DDS.
+// The file is memory mapped and the levels point straight at its blocks,
+// which go to glCompressedTexSubImage2D unchanged.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include "MipChain.h"
+
+namespace CompressedTexture
+{
+	struct Image
+	{
+		MappedFile file;
+		BlockFormat format = BlockFormat::BC1;
+		bool srgb = false;			  // the file marks the colours as sRGB encoded
+		std::vector<MipLevel> levels; // level 0 first; pixels are the level's blocks
+	};
+
+	// True for the extensions load() reads (.dds, .ktx2)
+	bool isCompressedFile(const std::string &path);
+
+	// Maps a 2D texture in one of the BlockFormat formats: DDS with a DXTn,
+	// ATIn/BCnU or DX10 header, or KTX2 without supercompression. Cube maps,
+	// arrays, volumes and uncompressed files are rejected.
+	bool load(const std::string &path, Image &image);
+
+	// Writes levels (blocks, level 0 first) as a DDS file with a legacy
+	// header (DXT1, DXT3, DXT5, ATI1, ATI2), or a DX10 header for BC7 and
+	// for colour formats marked srgb (ignored for BC4 and BC5)
+	bool writeDds(const std::string &path, BlockFormat format, const std::vector<MipLevel> &levels, bool srgb = false);
+}
@@ -0,0 +1,24 @@
+//-----------------------------------------------------------------------------
+// DecodedRows.h
+//
+// How the parallel decoders report progress: which rows of the RGBA8 result
+// are final while the rest of the image still decodes, so they can go to
+// the GPU early
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+
+struct DecodedRows
+{
+	// Once the size is known, before any rows: the RGBA8 result the rows are
+	// decoded into and the components the image will report
+	std::function<void(const unsigned char *pixels, int width, int height, int components)> started;
+
+	// rowCount rows from firstRow are final. Called from any decoding thread,
+	// in any order, never twice for a row.
+	std::function<void(int firstRow, int rowCount)> decoded;
+
+	// The decode failed after started(); called before the pixels are freed
+	std::function<void()> abandoned;
+};
@@ -0,0 +1,105 @@
+//-----------------------------------------------------------------------------
+// GltfScene.h
+//
+// Native glTF 2.0 (.gltf and .glb) path. glTF buffers are already laid out
+// for the GPU, so they are memory mapped and handed to glBufferData as they
+// are, and every primitive's attributes are pointed at their accessors with
+// the file's own strides and offsets. Nothing is converted or re-interleaved.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include <vector>
+#ifdef __APPLE__
+#include <glad/glad.h>
+#else
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+#include "glm/glm.hpp"
+#include "MappedFile.h"
+#include "Meshlets.h"
+
+class ShaderProgram;
+
+class GltfScene
+{
+public:
+	GltfScene();
+	~GltfScene();
+	GltfScene(const GltfScene &rhs) = delete;
+	GltfScene &operator=(const GltfScene &rhs) = delete;
+
+	// CPU side: parses the JSON and maps the binary buffers. Makes no GL
+	// calls. Returns false for files this path does not handle (sparse
+	// accessors, missing buffers, no triangle primitives); those can still
+	// go through Assimp.
+	bool load(const std::string &path);
+
+	// GL side: one buffer object per glTF buffer, filled straight from the
+	// mapping, and one vertex array per primitive. Releases the mappings.
+	void upload();
+
+	// Draws every primitive with model * its node transform. Primitives
+	// outside frustum (model space, may be null) are skipped. Sets the
+	// vertex decode uniforms to identity and restores "model" afterwards.
+	void draw(ShaderProgram &shader, const glm::mat4 &model, const Meshlets::Frustum *frustum);
+
+	// What the last draw() submitted
+	struct Stats
+	{
+		size_t triangles;
+		size_t totalTriangles;
+		size_t primitives;
+		size_t totalPrimitives;
+	};
+	const Stats &getStats() const { return mStats; }
+
+	size_t getVertexCount() const { return mVertexCount; }
+	size_t getTriangleCount() const { return mTriangleCount; }
+	size_t getPrimitiveCount() const { return mPrimitives.size(); }
+
+private:
+	struct Buffer
+	{
+		MappedFile file;					// external .bin, or unused
+		std::vector<unsigned char> decoded; // data: URI
+		const unsigned char *data = nullptr;
+		size_t size = 0;
+		size_t uploadBegin = 0; // bytes the primitives use
+		size_t uploadEnd = 0;
+		GLuint vbo = 0;
+	};
+
+	struct Attribute
+	{
+		int buffer = -1; // -1 if the primitive lacks the attribute
+		size_t offset = 0;
+		GLint components = 0;
+		GLenum type = GL_FLOAT;
+		bool normalized = false;
+		GLsizei stride = 0;
+	};
+
+	struct Primitive
+	{
+		Attribute position;
+		Attribute texCoord;
+		int indexBuffer = -1; // -1 for non-indexed primitives
+		size_t indexOffset = 0;
+		GLenum indexType = GL_UNSIGNED_INT;
+		GLsizei count = 0; // indices, or vertices without them
+		glm::mat4 transform = glm::mat4(1.0f);
+		glm::vec3 boundsMin = glm::vec3(0.0f); // model space
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		bool hasBounds = false;
+		GLuint vao = 0;
+	};
+
+	MappedFile mFile; // the .gltf or .glb itself
+	std::vector<Buffer> mBuffers;
+	std::vector<Primitive> mPrimitives;
+	size_t mVertexCount;
+	size_t mTriangleCount;
+	Stats mStats;
+};
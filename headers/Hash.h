@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+// Hash.h
+//
+// Fast non-cryptographic 64-bit hashing used for cache keys and content
+// fingerprints
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// Final avalanche step (from MurmurHash3's fmix64)
+//-----------------------------------------------------------------------------
+inline uint64_t hashMix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+//-----------------------------------------------------------------------------
+// Combines two hashes into one, order dependent
+//-----------------------------------------------------------------------------
+inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+	return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+//-----------------------------------------------------------------------------
+// Hashes a block of memory. Four independent lanes keep the multiplier
+// pipeline busy so this runs at several GB/s per core.
+//-----------------------------------------------------------------------------
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0)
+{
+	const uint64_t PRIME1 = 0x9e3779b185ebca87ULL;
+	const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+
+	const unsigned char *p = static_cast<const unsigned char *>(data);
+	const unsigned char *end = p + size;
+
+	uint64_t lanes[4] = {seed + PRIME1, seed + PRIME2, seed, seed - PRIME1};
+	while (end - p >= 32)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t word;
+			std::memcpy(&word, p + i * 8, 8);
+			lanes[i] += word * PRIME2;
+			lanes[i] = (lanes[i] << 31) | (lanes[i] >> 33);
+			lanes[i] *= PRIME1;
+		}
+		p += 32;
+	}
+
+	uint64_t h = static_cast<uint64_t>(size);
+	for (int i = 0; i < 4; i++)
+		h = hashCombine(h, lanes[i]);
+
+	while (end - p >= 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, p, 8);
+		h = hashCombine(h, word);
+		p += 8;
+	}
+
+	uint64_t tail = 0;
+	std::memcpy(&tail, p, static_cast<size_t>(end - p));
+	return hashCombine(h, tail);
+}
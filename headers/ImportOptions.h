@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// ImportOptions.h
+//
+// Switches for the optional stages of the mesh import pipeline. The options
+// are part of the mesh cache key, so changing them re-imports the model.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include "Hash.h"
+#include "VertexFormat.h"
+
+struct ImportOptions
+{
+	// Merge duplicate vertices (OBJ corners, STL facets, Assimp output).
+	// weldEpsilon > 0 also merges vertices whose attributes fall into the
+	// same grid cell of that size; 0 merges bit-identical vertices only.
+	bool weldVertices = true;
+	float weldEpsilon = 0.0f;
+
+	// Reorder triangles for the post-transform vertex cache and overdraw,
+	// then vertices for fetch locality. Disable for the fastest import.
+	bool optimizeVertexCache = true;
+
+	// GPU vertex layout. Quantized formats roughly halve vertex memory and
+	// fetch bandwidth; check the precision report before using them.
+	VertexFormat vertexFormat;
+
+	// Generate simplified levels of detail, picked per frame by screen error
+	bool generateLods = true;
+
+	// Number vertices coarsest LOD first, so a streamed upload can draw the
+	// coarse levels while the rest of the vertex buffer is still on its way.
+	// Costs a little vertex fetch locality at full detail.
+	bool progressive = true;
+
+	// Partition the model into an on-disk octree (next to its mesh cache
+	// entry) and page chunks in as the camera needs them, for models that
+	// do not fit memory. Later loads only read the octree.
+	bool outOfCore = false;
+
+	uint64_t hash() const
+	{
+		uint64_t h = 0;
+		h = hashCombine(h, weldVertices ? 1 : 0);
+		h = hashCombine(h, hashBytes(&weldEpsilon, sizeof(weldEpsilon)));
+		h = hashCombine(h, optimizeVertexCache ? 1 : 0);
+		h = hashCombine(h, static_cast<uint64_t>(vertexFormat.position));
+		h = hashCombine(h, static_cast<uint64_t>(vertexFormat.texCoord));
+		h = hashCombine(h, generateLods ? 1 : 0);
+		h = hashCombine(h, progressive ? 1 : 0);
+		h = hashCombine(h, outOfCore ? 1 : 0);
+		return h;
+	}
+};
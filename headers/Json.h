@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// Json.h
+//
+// Small read-only JSON document model, enough for glTF headers
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	JsonValue() : mType(Type::Null), mBool(false), mNumber(0.0) {}
+
+	// Parses a whole document. On failure returns false and describes the
+	// problem and its byte offset in error.
+	static bool parse(const char *text, size_t length, JsonValue &value, std::string &error);
+
+	Type type() const { return mType; }
+	bool isNull() const { return mType == Type::Null; }
+	bool isNumber() const { return mType == Type::Number; }
+	bool isString() const { return mType == Type::String; }
+	bool isArray() const { return mType == Type::Array; }
+	bool isObject() const { return mType == Type::Object; }
+
+	bool asBool(bool fallback = false) const { return mType == Type::Bool ? mBool : fallback; }
+	double asNumber(double fallback = 0.0) const { return mType == Type::Number ? mNumber : fallback; }
+	const std::string &asString() const { return mString; }
+
+	// Array elements; 0 for anything else
+	size_t size() const { return mArray.size(); }
+	const JsonValue &operator[](size_t index) const { return mArray[index]; }
+
+	// Object member, or nullptr if absent (or this is not an object)
+	const JsonValue *find(const char *key) const;
+
+	// Number member, or fallback if absent
+	double number(const char *key, double fallback = 0.0) const;
+
+private:
+	friend class JsonParser;
+
+	Type mType;
+	bool mBool;
+	double mNumber;
+	std::string mString;
+	std::vector<JsonValue> mArray;
+	std::vector<std::pair<std::string, JsonValue>> mObject;
+};
@@ -0,0 +1,26 @@
+//-----------------------------------------------------------------------------
+// LoadProgress.h
+//
+// Progress and cancellation shared between a background load and the UI
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+
+struct LoadProgress
+{
+	// Written by the loader; stage always points at a string literal
+	std::atomic<float> fraction{0.0f};
+	std::atomic<const char *> stage{"Queued"};
+
+	// Written by the UI, polled by the loader
+	std::atomic<bool> cancelled{false};
+
+	void report(const char *stageName, float stageFraction)
+	{
+		stage = stageName;
+		fraction = stageFraction;
+	}
+
+	bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// MappedFile.h
+//
+// Read-only memory mapped file
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile &rhs) = delete;
+	MappedFile &operator=(const MappedFile &rhs) = delete;
+	MappedFile(MappedFile &&rhs) noexcept;
+	MappedFile &operator=(MappedFile &&rhs) noexcept;
+
+	// Maps the whole file read-only. Returns false if it cannot be opened.
+	bool open(const std::string &fileName);
+	void close();
+
+	bool isOpen() const { return mData != nullptr; }
+	const unsigned char *data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	const unsigned char *mData;
+	size_t mSize;
+#ifdef _WIN32
+	void *mFileHandle;
+	void *mMappingHandle;
+#endif
+};
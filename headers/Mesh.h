@@ -6,6 +6,8 @@
 //-----------------------------------------------------------------------------
 #pragma once
 
+#include <limits>
+#include <memory>
 #include <vector>
 #include <string>
 #ifdef __APPLE__
@@ -15,12 +17,21 @@
 #include "GL/glew.h" // Important - this header must come before glfw3 header
 #endif
 #include "glm/glm.hpp"
+#include "ImportOptions.h"
+#include "LoadProgress.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "Meshlets.h"
 
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec2 texCoords;
-};
+class ChunkPager;
+class GltfScene;
+class PointCloud;
+class ShaderProgram;
+class TextureArray;
+
+// Points vertex attributes 0 (position) and 1 (texture coordinates) of the
+// bound vertex array at the bound GL_ARRAY_BUFFER, laid out in format
+void setVertexAttributes(const VertexFormat &format);
 
 class Mesh
 {
@@ -28,16 +39,136 @@ public:
 	Mesh();
 	~Mesh();
 
-	void loadModel(const std::string &filename);
-	void draw();
+	// Synchronous load: import() followed by upload()
+	void loadModel(const std::string &filename, const ImportOptions &options = ImportOptions());
+
+	// CPU side of loading. Makes no GL calls, so it may run on a worker thread.
+	bool import(const std::string &filename, LoadProgress *progress = nullptr, const ImportOptions &options = ImportOptions());
+
+	// GL side of loading. Must run on the thread that owns the GL context.
+	// Creates the buffers and streams data into them for up to budgetMs,
+	// coarsest level of detail first; streamUpload() continues from there.
+	// Levels are drawn as soon as they are complete.
+	void upload(double budgetMs = std::numeric_limits<double>::infinity());
+
+	// Render thread, once per frame. Returns true once everything is resident.
+	bool streamUpload(double budgetMs);
+	float getUploadProgress() const;
+
+	// Sets the per-range vertex decode uniforms of shader, which must be in use
+	void draw(ShaderProgram &shader);
+
+	// Draws what the last draw() chose again, e.g. with another shader into
+	// another target. Pages nothing, selects no levels or points and leaves
+	// getDrawStats() as draw() left it.
+	void redraw(ShaderProgram &shader);
+
+	// Camera draw() culls meshlets against. Until one is set nothing is culled.
+	void setView(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection);
+	void setClusterCulling(bool frustum, bool backface);
+	void setLodSelection(float fovY, int viewportHeight, float maxPixelError);
+
+	// Layers draw() selects per material; without them every material uses
+	// the texture bound by the caller. Not owned.
+	void setMaterialTextures(TextureArray *textures) { mMaterialTextures = textures; }
+
+	// What the last draw() submitted
+	struct DrawStats
+	{
+		size_t triangles;
+		size_t totalTriangles;
+		size_t meshlets;
+		size_t totalMeshlets;
+		size_t drawRanges;
+		unsigned int coarsestLod;
+		size_t points; // point clouds only
+		size_t totalPoints;
+	};
+	const DrawStats &getDrawStats() const;
+
+	size_t getSubMeshCount() const;
+	const SubMesh &getSubMesh(size_t index) const;
+	void setSubMeshVisible(size_t index, bool visible);
+
+	// Set for out-of-core models (.mvoct files or ImportOptions::outOfCore)
+	ChunkPager *getPager() const { return mPager.get(); }
+
+	// Set for point sets (PLY files without faces)
+	PointCloud *getPointCloud() const { return mPointCloud.get(); }
+
+	const VertexFormat &getVertexFormat() const;
+	const VertexFormatReport &getVertexFormatReport() const;
 
 private:
-	void initBuffers();
-	void processFaceVertex(const std::string &faceData, std::vector<unsigned int> &vertexIndices, std::vector<unsigned int> &uvIndices);
+	bool loadWithAssimp(const std::string &filename, LoadProgress *progress);
+	bool openOctree(const std::string &path);
+	void drawPaged(ShaderProgram &shader);
+	void drawGltf(ShaderProgram &shader);
+	void drawPointCloud(ShaderProgram &shader);
+	void initBuffers(size_t vertexBufferSize, size_t indexBufferSize);
+	void logIndexSummary() const;
+	void logVertexFormat() const;
+	void logLodChain(size_t lod0Count, double elapsedMs) const;
+	void selectLods();
+	void drawSubMeshes(ShaderProgram &shader, DrawStats &stats);
+	void appendDrawRanges(const SubMesh &subMesh, DrawStats &stats);
+	void planUpload();
 
 	bool mLoaded;
-	std::vector<Vertex> mVertices;
-	std::vector<GLuint> mIndices;
+	bool mImported;
+	MeshCache::Entry mCached;
+	MeshData mData;
+	VertexFormat mVertexFormat;
+	VertexFormatReport mVertexReport;
+
+	// Draw ranges of the shared buffers and the scratch arrays draw() batches them in
+	std::vector<SubMesh> mSubMeshes;
+	std::vector<unsigned char> mSubMeshVisible;
+	std::vector<GLsizei> mDrawCounts;
+	std::vector<void *> mDrawOffsets;
+	std::vector<GLint> mDrawBaseVertices;
+
+	// Meshlet culling state
+	std::vector<Meshlet> mMeshlets;
+	bool mHasView;
+	bool mFrustumCulling;
+	bool mBackfaceCulling;
+	Meshlets::Frustum mFrustum;
+	glm::mat4 mModel;
+	glm::vec3 mCameraPosition; // model space
+
+	// Level of detail selection, one entry per sub-mesh group
+	float mFovY;
+	int mViewportHeight;
+	float mMaxPixelError;
+	std::vector<unsigned int> mSelectedLod;
+	DrawStats mStats;
+	TextureArray *mMaterialTextures;
+
+	// Streamed upload: byte spans of the buffers in upload order. The last
+	// span of a level makes that level of its group drawable.
+	struct UploadSpan
+	{
+		GLenum target;
+		size_t begin;
+		size_t end;
+		unsigned int group;
+		unsigned int lod;
+		bool completesLevel;
+	};
+	std::vector<UploadSpan> mUploadSpans;
+	size_t mUploadSpan;
+	size_t mUploadOffset; // within mUploadSpans[mUploadSpan]
+	size_t mUploadedBytes;
+	size_t mUploadTotalBytes;
+	const unsigned char *mUploadVertices;
+	const unsigned char *mUploadIndices;
+	std::vector<unsigned int> mResidentLod; // finest complete level per group
+
+	std::unique_ptr<ChunkPager> mPager;
+	std::unique_ptr<GltfScene> mGltf; // native glTF path, see GltfScene
+	std::unique_ptr<PointCloud> mPointCloud;
+
 	GLuint mVAO;
 	GLuint mVBO;
 	GLuint mEBO;
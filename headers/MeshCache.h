@@ -0,0 +1,60 @@
+//-----------------------------------------------------------------------------
+// MeshCache.h
+//
+// On-disk binary cache (.mvmesh) of imported meshes. A cache file holds the
+// packed vertex buffer, the packed index buffer, the sub-mesh and meshlet tables
+// behind a small header so a hit can be memory mapped and handed to
+// glBufferData without any copies.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+#include "MeshData.h"
+
+namespace MeshCache
+{
+	// A mapped cache hit. The pointers stay valid while the entry is alive.
+	struct Entry
+	{
+		MappedFile file;
+		const unsigned char *vertexBuffer = nullptr;
+		const unsigned char *indexBuffer = nullptr;
+		const SubMesh *subMeshes = nullptr;
+		const Meshlet *meshlets = nullptr;
+		size_t vertexCount = 0;
+		size_t vertexBufferSize = 0; // bytes
+		size_t indexCount = 0;
+		size_t indexBufferSize = 0; // bytes
+		size_t subMeshCount = 0;
+		size_t meshletCount = 0;
+		VertexFormat vertexFormat;
+		VertexFormatReport vertexReport = {};
+	};
+
+	// Where cache files live and how much disk they may use in total, mesh
+	// entries and derived files (.mvtex, .mvoct) together. Least recently
+	// used files are evicted once the budget is exceeded.
+	void setDirectory(const std::string &directory);
+	void setDiskBudget(uint64_t bytes);
+
+	// Maps the cache entry for sourcePath if one exists and still matches
+	// the source file (size, modification time and content hash) and was
+	// imported with the same options (ImportOptions::hash()).
+	bool load(const std::string &sourcePath, uint64_t optionsHash, Entry &entry);
+
+	// Path of a file derived from sourcePath that lives in the cache
+	// directory next to its entry, e.g. a mesh octree. Its writer calls
+	// trim() afterwards and touch() on every hit.
+	std::string derivedPath(const std::string &sourcePath, const char *extension);
+
+	// Deletes least recently used cache files until the budget holds
+	void trim();
+
+	// Marks a cache file as just used, for the LRU order of trim()
+	void touch(const std::string &cachePath);
+
+	// Writes a cache entry for sourcePath, then trims the cache to budget
+	bool store(const std::string &sourcePath, uint64_t optionsHash, const MeshData &mesh, const VertexFormatReport &vertexReport);
+}
@@ -0,0 +1,97 @@
+//-----------------------------------------------------------------------------
+// MeshData.h
+//
+// CPU side result of a model import: one shared vertex/index buffer plus the
+// table of sub-meshes drawn as ranges of it. Free of GL headers so importers
+// and the mesh cache can use it without a context.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "Vertex.h"
+#include "VertexFormat.h"
+
+//--------------------------------------------------------------
+// A contiguous index range drawn with one material. Indices are
+// relative to baseVertex so they can be drawn with
+// glDrawElementsBaseVertex.
+//--------------------------------------------------------------
+struct SubMesh
+{
+	unsigned int indexOffset;	// first index in MeshData::indices
+	unsigned int indexCount;
+	unsigned int baseVertex;	// added to every index of the range
+	unsigned int vertexCount;	// vertices used, starting at baseVertex
+	unsigned int materialIndex;
+	unsigned int indexSize;		// bytes per index in the packed buffer, 2 or 4
+	uint64_t indexBufferOffset; // byte offset in MeshData::indexBuffer
+	glm::vec3 boundsMin;		// model space bounding box
+	glm::vec3 boundsMax;
+	glm::vec3 positionOffset;	// decoded = offset + scale * stored attribute,
+	glm::vec3 positionScale;	// see packVertices
+	glm::vec2 texCoordOffset;
+	glm::vec2 texCoordScale;
+	unsigned int meshletOffset; // first entry in MeshData::meshlets
+	unsigned int meshletCount;
+	unsigned int group;			// the imported sub-mesh this range draws,
+	unsigned int lod;			// at this level of detail (0 = full)
+	float lodError;				// model space error of the level, see MeshSimplifier
+};
+
+//--------------------------------------------------------------
+// A small run of consecutive triangles of one sub-mesh, culled
+// as a unit. See Meshlets.h.
+//--------------------------------------------------------------
+struct Meshlet
+{
+	unsigned int indexOffset; // relative to the sub-mesh's indexOffset
+	unsigned int indexCount;
+	glm::vec3 center;		  // model space bounding sphere
+	float radius;
+	glm::vec3 coneAxis;		  // average facing of the triangles
+	float coneCutoff;		  // sine of the cone's half angle, > 1 if it cannot be culled
+};
+
+struct MeshData
+{
+	std::vector<Vertex> vertices;			 // float, used by the import stages
+	std::vector<unsigned int> indices;		 // 32-bit, used by the import stages
+	std::vector<unsigned char> vertexBuffer; // packed GPU vertex buffer, see packVertices
+	std::vector<unsigned char> indexBuffer;	 // packed GPU index buffer, see packIndices
+	std::vector<SubMesh> subMeshes;
+	std::vector<Meshlet> meshlets;
+	VertexFormat vertexFormat;
+
+	void clear()
+	{
+		vertices.clear();
+		indices.clear();
+		vertexBuffer.clear();
+		indexBuffer.clear();
+		subMeshes.clear();
+		meshlets.clear();
+		vertexFormat = VertexFormat();
+	}
+};
+
+// Recomputes the bounding box of every sub-mesh from the vertices it indexes,
+// or from its whole vertex range if it has no indices (a point set)
+void computeSubMeshBounds(MeshData &mesh);
+
+// Builds vertexBuffer from vertices in the given format and sets the decode
+// scale and offset of every sub-mesh (identity for float attributes).
+// Quantized attributes are stored relative to the range of the sub-mesh's
+// own vertices; LOD entries reuse their LOD 0 entry's. Reports the precision
+// lost. Must run before packIndices, while the LOD 0 vertex ranges are still
+// disjoint and the entries still in import order.
+void packVertices(MeshData &mesh, const VertexFormat &format, VertexFormatReport &report);
+
+// Builds indexBuffer from indices, choosing the narrowest index type for
+// every sub-mesh. Sub-meshes whose indices span at most 65536 vertices are
+// rebased through their base vertex and stored as 16-bit. Larger ones are
+// split into 16-bit pieces when their index order is local enough, and only
+// stay 32-bit otherwise. Must be the last stage that changes the sub-mesh
+// ranges.
+void packIndices(MeshData &mesh);
@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------------
+// MeshOctree.h
+//
+// On-disk octree of mesh chunks (.mvoct) for models too big to keep in
+// memory. The build step partitions an imported mesh spatially and writes
+// every leaf as self-contained packed vertex and index buffers, so the
+// viewer can page single chunks in and out (see ChunkPager).
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "MeshData.h"
+
+namespace MeshOctree
+{
+	// Leaves are split until they hold at most this many triangles. Chunks
+	// therefore always fit 16-bit indices.
+	const unsigned int MAX_CHUNK_TRIANGLES = 16384;
+	const unsigned int MAX_DEPTH = 16;
+
+	const uint32_t INVALID_NODE = 0xFFFFFFFFu;
+
+	struct Node
+	{
+		glm::vec3 boundsMin; // of the triangles below the node
+		glm::vec3 boundsMax;
+		uint32_t children[8]; // INVALID_NODE where empty
+		uint32_t firstChunk;  // leaves only
+		uint32_t chunkCount;
+	};
+
+	// The triangles of one leaf and one imported sub-mesh. subMesh describes
+	// the chunk's own buffers: baseVertex and indexBufferOffset are 0.
+	struct Chunk
+	{
+		uint64_t fileOffset; // vertex buffer, then index buffer
+		uint64_t vertexBufferSize;
+		uint64_t indexBufferSize;
+		SubMesh subMesh;
+	};
+
+	// Stamp of the source file an octree was built from (size and time)
+	uint64_t sourceStamp(const std::string &sourcePath);
+
+	// Offline build step. Writes the LOD 0 sub-meshes of mesh, which must
+	// still have its float vertices and 32-bit indices, to path in format.
+	bool build(const MeshData &mesh, const VertexFormat &format, uint64_t sourceStamp, uint64_t optionsHash, const std::string &path);
+
+	// An opened octree file. Only the node and chunk tables are read up
+	// front; readChunk() may be called from any thread.
+	class Reader
+	{
+	public:
+		bool open(const std::string &path);
+
+		const std::string &getPath() const { return mPath; }
+		const std::vector<Node> &getNodes() const { return mNodes; } // root first
+		const std::vector<Chunk> &getChunks() const { return mChunks; }
+		const VertexFormat &getVertexFormat() const { return mVertexFormat; }
+		uint64_t getSourceStamp() const { return mSourceStamp; }
+		uint64_t getOptionsHash() const { return mOptionsHash; }
+
+		// Reads the vertex buffer followed by the index buffer of a chunk
+		bool readChunk(size_t index, std::vector<unsigned char> &data) const;
+
+	private:
+		std::string mPath;
+		std::vector<Node> mNodes;
+		std::vector<Chunk> mChunks;
+		VertexFormat mVertexFormat;
+		uint64_t mSourceStamp = 0;
+		uint64_t mOptionsHash = 0;
+	};
+}
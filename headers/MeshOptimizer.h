@@ -0,0 +1,30 @@
+//-----------------------------------------------------------------------------
+// MeshOptimizer.h
+//
+// Import-time reordering of triangles and vertices for GPU efficiency
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "MeshData.h"
+
+namespace MeshOptimizer
+{
+	// Size of the post-transform cache the optimizer targets and simulates
+	const unsigned int CACHE_SIZE = 16;
+
+	// Average cache miss ratio (transformed vertices per triangle) of the
+	// whole mesh through a simulated FIFO cache of CACHE_SIZE entries
+	float computeACMR(const MeshData &mesh);
+
+	// Runs on every sub-mesh in parallel:
+	//   1. Tipsify (Sander et al. 2007) orders triangles for cache locality
+	//   2. the result is cut into clusters at cache flushes, and clusters are
+	//      sorted so outward facing ones draw first to reduce overdraw
+	//   3. vertices are renumbered in first-use order for fetch locality
+	// Must run before packIndices.
+	void optimize(MeshData &mesh);
+
+	// Tipsify alone on one index range, for triangles built after optimize()
+	// (e.g. LODs) that must keep the current vertex order
+	void optimizeTriangleOrder(unsigned int *indices, unsigned int indexCount, unsigned int vertexCount);
+}
@@ -0,0 +1,34 @@
+//-----------------------------------------------------------------------------
+// MeshSimplifier.h
+//
+// Level of detail generation by quadric error metric edge collapse
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "MeshData.h"
+
+namespace MeshSimplifier
+{
+	// Coarsest level generated, counting the full resolution one as LOD 0
+	const unsigned int MAX_LOD = 5;
+
+	// Levels stop once a sub-mesh is down to this many triangles
+	const unsigned int MIN_LOD_TRIANGLES = 256;
+
+	// Appends a chain of LODs for every LOD 0 sub-mesh. Each level halves
+	// the triangle count of the previous one by collapsing edges onto one of
+	// their vertices (Garland & Heckbert quadrics), so every level indexes
+	// the sub-mesh's original vertices and no vertex data is added. UV seam
+	// and open border vertices never move. The new entries share group and
+	// vertex range with their LOD 0 entry, which packVertices later copies
+	// its decode constants from, and record their geometric error in model
+	// units. Runs before orderVerticesByLod and packVertices, one sub-mesh
+	// per task.
+	void buildLods(MeshData &mesh);
+
+	// Renumbers the vertices of every group in first-use order of its
+	// coarsest level, then the next finer one, down to LOD 0, so each level
+	// only uses a prefix of the group's vertex range. Lets an upload stream
+	// coarse to fine. Runs after buildLods, before packVertices.
+	void orderVerticesByLod(MeshData &mesh);
+}
@@ -0,0 +1,37 @@
+//-----------------------------------------------------------------------------
+// Meshlets.h
+//
+// Cuts sub-meshes into small triangle clusters and culls them against the
+// camera, so close-ups of huge models only submit what is on screen
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "glm/glm.hpp"
+#include "MeshData.h"
+
+namespace Meshlets
+{
+	// Cluster size limits, the usual sweet spot for culling granularity
+	const unsigned int MAX_VERTICES = 64;
+	const unsigned int MAX_TRIANGLES = 124;
+
+	// Builds MeshData::meshlets from runs of consecutive triangles, so every
+	// meshlet is a contiguous index range of its sub-mesh. Runs on all cores
+	// and must run after packIndices, on the final sub-mesh table.
+	void build(MeshData &mesh);
+
+	// The six planes of a view frustum (xyz = unit normal pointing inside)
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+	};
+
+	// Frustum in the space modelViewProjection maps from
+	Frustum extractFrustum(const glm::mat4 &modelViewProjection);
+
+	bool isSphereVisible(const Frustum &frustum, const glm::vec3 &center, float radius);
+
+	// True if every triangle of the meshlet faces away from cameraPosition,
+	// which must be in the same space as the meshlet
+	bool isBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPosition);
+}
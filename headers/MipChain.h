@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// MipChain.h
+//
+// CPU mip map generation for RGBA8 textures, so the GL thread never runs
+// glGenerateMipmap. Free of GL headers: decoding, filtering and the texture
+// cache all run on worker threads.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter : uint8_t
+{
+	Box,   // average of the texels each level texel covers; fastest
+	Kaiser // Kaiser windowed sinc over 4 texels per side; sharper distant textures
+};
+
+// One level of an RGBA8 image, rows tightly packed
+struct MipLevel
+{
+	int width;
+	int height;
+	const unsigned char *pixels;
+};
+
+namespace MipChain
+{
+	// Number of levels of a full chain down to 1x1, base level included
+	unsigned int levelCount(int width, int height);
+
+	// Appends levels 1 and up of base (down to 1x1) to levels, which must
+	// hold base as its only entry, with their pixels in storage. Each level
+	// is filtered from the one before on all cores with SIMD.
+	// gammaCorrect filters the colour channels as sRGB decoded to linear
+	// light; alpha is always linear and colours are weighted by it, so fully
+	// transparent texels do not bleed into their neighbours. Textures repeat,
+	// so the Kaiser filter wraps around the edges.
+	void build(MipFilter filter, bool gammaCorrect, std::vector<unsigned char> &storage, std::vector<MipLevel> &levels);
+}
@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+// MpscQueue.h
+//
+// Lock-free multi-producer single-consumer queue (Dmitry Vyukov's intrusive
+// node design). Workers push, the render thread pops; neither side ever
+// blocks on the other.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+		: mHead(new Node()), mTail(mHead.load(std::memory_order_relaxed))
+	{
+	}
+
+	~MpscQueue()
+	{
+		T discarded;
+		while (pop(discarded))
+		{
+		}
+		delete mTail;
+	}
+
+	MpscQueue(const MpscQueue &rhs) = delete;
+	MpscQueue &operator=(const MpscQueue &rhs) = delete;
+
+	// Safe to call from any thread
+	void push(T value)
+	{
+		Node *node = new Node();
+		node->value = std::move(value);
+		Node *previous = mHead.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// Consumer thread only. Returns false if the queue is empty (or the
+	// most recent push has not been linked in yet).
+	bool pop(T &value)
+	{
+		Node *tail = mTail;
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+
+		value = std::move(next->value);
+		mTail = next;
+		delete tail;
+		return true;
+	}
+
+private:
+	struct Node
+	{
+		std::atomic<Node *> next{nullptr};
+		T value{};
+	};
+
+	std::atomic<Node *> mHead;
+	Node *mTail;
+};
@@ -0,0 +1,22 @@
+//-----------------------------------------------------------------------------
+// ObjLoader.h
+//
+// Native Wavefront OBJ reader used instead of Assimp for .obj files
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include "LoadProgress.h"
+#include "MeshData.h"
+
+namespace ObjLoader
+{
+	// Parses an OBJ file on all cores and writes straight into the final
+	// vertex and index arrays. The output matches what the Assimp path
+	// produces with aiProcess_Triangulate | aiProcess_FlipUVs: one vertex per
+	// face corner, polygons fan-triangulated and the V coordinate flipped.
+	// Every o/g/usemtl statement starts a new sub-mesh.
+	// Returns false (leaving mesh empty) if the file cannot be parsed or the
+	// load was cancelled through progress.
+	bool load(const std::string &filename, MeshData &mesh, LoadProgress *progress = nullptr);
+}
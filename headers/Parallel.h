@@ -0,0 +1,59 @@
+//-----------------------------------------------------------------------------
+// Parallel.h
+//
+// Minimal fork/join helper used by the import pipeline to spread independent
+// work items over all hardware threads.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Number of worker threads to use for CPU bound import work
+//-----------------------------------------------------------------------------
+inline unsigned int workerThreadCount()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+}
+
+//-----------------------------------------------------------------------------
+// Calls fn(i) for every i in [0, count) using all hardware threads.
+// Items are handed out dynamically so uneven work sizes still balance out.
+// Blocks until every item has been processed.
+//-----------------------------------------------------------------------------
+template <typename Fn>
+void parallelFor(size_t count, Fn fn)
+{
+	if (count == 0)
+		return;
+
+	size_t threadCount = std::min<size_t>(workerThreadCount(), count);
+	if (threadCount == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			fn(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t t = 1; t < threadCount; t++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread &thread : threads)
+		thread.join();
+}
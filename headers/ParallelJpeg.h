@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// ParallelJpeg.h
+//
+// JPEG decoding stb_image does not offer, for large textures.
+//
+// Multi-core decoding of large baseline JPEGs that carry restart markers, as
+// photogrammetry and GIS tools write them. At a restart marker that starts
+// a row of MCUs the entropy coder starts over, so the image splits there
+// into horizontal stripes. Each stripe is rewritten as a JPEG of its own
+// (the same tables, the height of the stripe) and decoded by stb_image on a
+// worker of its own, straight into its rows of the result.
+//
+// Previews at 1/8 scale from the DC coefficients alone: the mean of every
+// 8x8 block, with no inverse DCT or upsampling. A progressive JPEG only
+// needs its first scan for that.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include "DecodedRows.h"
+
+namespace ParallelJpeg
+{
+	// Decodes fileName to RGBA8 in stripes across all cores. Returns nullptr,
+	// without a message, if the file is not a JPEG that can be split (not
+	// baseline, no restart markers at row starts, too small to be worth it);
+	// the caller then decodes it with stbi_load. components is what the file
+	// holds, as stbi_load reports it. The pixels come from malloc, so
+	// stbi_image_free() releases them. rows, if given, hears of every stripe
+	// as it is finished.
+	unsigned char *decode(const std::string &fileName, int &width, int &height, int &components, const DecodedRows *rows = nullptr);
+
+	// Decodes fileName to RGBA8 at 1/8 of its size, rounded up. Returns
+	// nullptr, without a message, for files that are not baseline or
+	// progressive Huffman coded JPEGs of one or three components, and for
+	// images small enough to decode in full right away. Allocation and
+	// components as for decode().
+	unsigned char *decodePreview(const std::string &fileName, int &width, int &height, int &components);
+}
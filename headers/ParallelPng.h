@@ -0,0 +1,27 @@
+//-----------------------------------------------------------------------------
+// ParallelPng.h
+//
+// Pipelined decoding of large PNGs. A deflate stream only decodes from its
+// start, so one thread inflates the image data while a second unfilters
+// the scanlines it has produced so far and converts them to RGBA8. The
+// inflater writes into a buffer of the whole filtered image, so the 32 KB
+// window it reads back from never moves and no data is copied between the
+// two stages; the unfilter stage keeps just the previous row.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include "DecodedRows.h"
+
+namespace ParallelPng
+{
+	// Decodes fileName to RGBA8 with inflate and unfilter on two cores.
+	// Returns nullptr, without a message, if the file is not a PNG the
+	// pipeline reads (8 bits per channel, not interlaced) or too small to be
+	// worth it; the caller then decodes it with stbi_load. components is
+	// what the file holds: 1 gray, 2 gray and alpha, 3 RGB, 4 RGBA, with
+	// palette and tRNS transparency counted as alpha. The pixels come from
+	// malloc, so stbi_image_free() releases them. rows, if given, hears of
+	// the scanlines as they are unfiltered, a few megabytes at a time.
+	unsigned char *decode(const std::string &fileName, int &width, int &height, int &components, const DecodedRows *rows = nullptr);
+}
@@ -0,0 +1,24 @@
+//-----------------------------------------------------------------------------
+// PlyLoader.h
+//
+// Native binary PLY reader used instead of Assimp for .ply files
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include "LoadProgress.h"
+#include "MeshData.h"
+
+namespace PlyLoader
+{
+	// Maps a binary (little or big endian) PLY file and decodes its vertex
+	// and face elements on all cores into one sub-mesh. Positions come from
+	// x/y/z and texture coordinates from u/v, s/t or texture_u/texture_v,
+	// with V flipped as Assimp's aiProcess_FlipUVs does; every other property
+	// is skipped. Polygons are fan-triangulated. A file without faces is a
+	// point set: mesh gets the vertices, a sub-mesh with indexCount 0 and no
+	// indices.
+	// Returns false (leaving mesh empty) for ASCII or malformed files, which
+	// can still go through Assimp, or if the load was cancelled.
+	bool load(const std::string &filename, MeshData &mesh, LoadProgress *progress = nullptr);
+}
@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+// PointCloud.h
+//
+// Level of detail rendering of large point sets. At load time the points
+// are sorted into an octree whose inner nodes hold a spatially even subset
+// of the points below them (one point per cell of a grid over the node), so
+// every node on its own is a coarser version of its subtree. Each frame the
+// tree is walked from the camera outward, refining nodes until a point
+// budget is spent, and the chosen nodes are uploaded to their own buffers
+// under a GPU memory budget.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#ifdef __APPLE__
+#include <glad/glad.h>
+#else
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+#include "glm/glm.hpp"
+#include "MeshData.h"
+#include "Meshlets.h"
+#include "VertexFormat.h"
+
+class ShaderProgram;
+
+class PointCloud
+{
+public:
+	// Cells per axis of the sampling grid of an inner node
+	static const unsigned int SAMPLE_GRID = 128;
+
+	// Nodes with fewer points are not split
+	static const size_t MAX_LEAF_POINTS = 32 * 1024;
+	static const unsigned int MAX_DEPTH = 20;
+	static const uint32_t INVALID_NODE = 0xFFFFFFFFu;
+
+	PointCloud();
+	~PointCloud();
+	PointCloud(const PointCloud &rhs) = delete;
+	PointCloud &operator=(const PointCloud &rhs) = delete;
+
+	// CPU side, no GL calls. Builds the octree from the vertices of a point
+	// set (see PlyLoader) and packs every node in format, each with its own
+	// decode range. Leaves mesh empty.
+	void build(MeshData &mesh, const VertexFormat &format, VertexFormatReport &report);
+
+	// Points drawn per frame at most, and bytes of node buffers kept on the GPU
+	void setBudget(size_t points, uint64_t gpuBytes);
+
+	// Scales the screen size of the points; 0 draws them one pixel wide
+	void setPointSize(float scale);
+
+	// Render thread, once per frame before draw(). Chooses the nodes to
+	// draw, nearest first, uploads missing ones for a few milliseconds and
+	// evicts the least recently used. fovY is in radians. Without a view the
+	// coarsest levels are drawn up to the budget.
+	void update(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView, float fovY, int viewportHeight);
+
+	// Draws the chosen nodes that are resident, as often as needed (e.g. for
+	// another pass); update() counts them. Sets the vertex decode and point
+	// size uniforms of shader, which must be in use.
+	void draw(ShaderProgram &shader);
+
+	// State of the last update() and draw()
+	struct Stats
+	{
+		size_t points; // drawn
+		size_t totalPoints;
+		size_t pointBudget;
+		size_t nodes;
+		size_t selectedNodes;
+		size_t drawnNodes;
+		size_t gpuNodes;
+		uint64_t gpuBytes;
+		uint64_t gpuBudget;
+	};
+	const Stats &getStats() const { return mStats; }
+
+	size_t getPointCount() const { return mPointCount; }
+	size_t getNodeCount() const { return mNodes.size(); }
+
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin; // a cube
+		float size;
+		float spacing;		 // distance between the node's points, about size / SAMPLE_GRID
+		unsigned int depth;
+		uint32_t children[8];
+		SubMesh points;		 // vertex range in mVertexBuffer and its decode
+
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		uint64_t lastUsed = 0; // frame
+	};
+
+	void uploadNodes();
+	bool makeGpuRoom(uint64_t bytes);
+	void releaseGpu(Node &node);
+	uint64_t nodeBytes(const Node &node) const;
+
+	std::vector<Node> mNodes;
+	std::vector<unsigned char> mVertexBuffer; // every node's points, packed
+	VertexFormat mVertexFormat;
+	size_t mPointCount;
+
+	std::vector<uint32_t> mSelected; // this frame, nearest first
+	size_t mPointBudget;
+	uint64_t mGpuBudget;
+	uint64_t mGpuBytes;
+	float mPointSize;
+	float mPointScale; // pixels per unit at distance 1, times mPointSize
+	uint64_t mFrame;
+	Stats mStats;
+};
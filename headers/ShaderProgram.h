@@ -36,10 +36,12 @@ public:
 
 	GLuint getProgram() const;
 
+	void setUniform(const GLchar *name, GLfloat f);
 	void setUniform(const GLchar *name, const glm::vec2 &v);
 	void setUniform(const GLchar *name, const glm::vec3 &v);
 	void setUniform(const GLchar *name, const glm::vec4 &v);
 	void setUniform(const GLchar *name, const glm::mat4 &m);
+	void setUniformSampler(const GLchar *name, GLint texUnit);
 
 	// We are going to speed up looking for uniforms by keeping their locations in a map
 	GLint getUniformLocation(const GLchar *name);
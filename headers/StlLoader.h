@@ -0,0 +1,22 @@
+//-----------------------------------------------------------------------------
+// StlLoader.h
+//
+// Native binary STL reader used instead of Assimp for .stl files
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include "LoadProgress.h"
+#include "MeshData.h"
+
+namespace StlLoader
+{
+	// Maps a binary STL file and turns its unindexed triangles into one
+	// indexed sub-mesh on all cores, merging corners with bit-identical
+	// positions (+0 and -0 compare equal) while reading. Vertices are
+	// numbered in the order the triangles first use them. Facet normals and
+	// attribute bytes are ignored and texture coordinates are zero.
+	// Returns false (leaving mesh empty) for ASCII or truncated files, which
+	// can still go through Assimp, or if the load was cancelled.
+	bool load(const std::string &filename, MeshData &mesh, LoadProgress *progress = nullptr);
+}
@@ -12,22 +12,197 @@
 #define GLEW_STATIC
 #include "GL/glew.h" // Important - this header must come before glfw3 header
 #endif
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
+#include "CompressedTexture.h"
+#include "MipChain.h"
+#include "TextureCache.h"
+#include "TextureOptions.h"
 using std::string;
 
 class Texture2D
 {
 public:
+	// Pixel buffers the upload stages through, each reused once its fence
+	// signals
+	static const unsigned int STAGING_BUFFERS = 3;
+
 	Texture2D();
 	virtual ~Texture2D();
 	Texture2D(const Texture2D &rhs) = delete;
 	Texture2D &operator=(const Texture2D &rhs) = delete;
 
-	bool loadTexture(const string &fileName, bool generateMipMaps = true);
+	// Synchronous load: decode() followed by a complete upload()
+	bool loadTexture(const string &fileName, const TextureOptions &options = TextureOptions());
+
+	// Decodes the image into CPU memory and builds its mip chain there, or
+	// maps both from the texture cache. DDS and KTX2 files are mapped and
+	// uploaded block compressed with the levels they contain. Makes no GL
+	// calls, so it may run on a worker thread.
+	bool decode(const string &fileName, const TextureOptions &options = TextureOptions());
+
+	// Render thread, once per frame while decode() runs on a worker. Images
+	// the parallel decoders take go to the GPU a band of rows at a time as
+	// they finish, for up to budgetMs, so the upload overlaps the decode;
+	// upload() then only adds the rows still missing and the mip levels.
+	// Does nothing for other images.
+	void uploadDecodedRows(double budgetMs);
+
+	// Like decode(), at a fraction of the size for a texture to show while
+	// the full image decodes: 1/8 scale for large JPEGs. Returns false if the
+	// file has no preview or decode() is quick anyway; nothing is printed.
+	bool decodePreview(const string &fileName, const TextureOptions &options = TextureOptions());
+
+	// Creates the GL texture and streams the levels into it for up to
+	// budgetMs, coarsest first; streamUpload() continues from there. Until
+	// level 0 arrives the texture samples its finest complete level, so a
+	// blurred version shows right away. Must run on the thread that owns the
+	// GL context.
+	bool upload(double budgetMs = std::numeric_limits<double>::infinity());
+
+	// Render thread, once per frame. Returns true once every level down to
+	// the target level is resident; then the CPU copy has been freed, unless
+	// the texture streams.
+	bool streamUpload(double budgetMs);
+	float getUploadProgress() const;
+
+	int getWidth() const;
+	int getHeight() const;
+
+	// From decode() until the upload finishes, for the texture's lifetime if
+	// it streams: the levels in CPU memory, level 0 first, getChannels() bytes
+	// per texel or (isCompressed()) blocks
+	const std::vector<MipLevel> &getDecodedLevels() const { return mLevels; }
+	bool isCompressed() const { return mIsCompressed; }
+	int getChannels() const { return mChannels; }
+	// After upload(): the texture is stored in an sRGB format, so it samples
+	// linear values. DDS and KTX2 files say so themselves, other images
+	// follow TextureOptions::srgb; neither without setSrgbOutput().
+	bool isSrgb() const { return mSrgb; }
+	string getFormatName() const;
+
+	// GL storage of the texture: every allocated level, in its format, and
+	// what the same levels take as RGBA8. Drivers may pad RGB8 to four bytes
+	// per texel; the upload and the cache still move three.
+	uint64_t getGpuBytes() const { return mGpuBytes; }
+	uint64_t getRgbaBytes() const { return mRgbaBytes; }
+	int getLevelCount() const { return mLevelCount; }
+
+	// Textures whose levels stay mapped after the upload (from a DDS or KTX2
+	// file or the texture cache) stream: only the levels from the target
+	// level down are resident, and finer ones come and go as the target moves
+	bool isStreamable() const { return mStreamable; }
+	int getTargetLevel() const { return mTargetLevel; }
+	// Finest level the texture samples, getLevelCount() before any arrived
+	int getResidentLevel() const { return mResidentLevel; }
+	// GL storage of levels from level down; getGpuBytes() if not streamable
+	uint64_t getGpuBytesFrom(int level) const;
+
+	// Render thread. A coarser target frees the finer levels at once; a finer
+	// one streams them in through streamUpload(), coarsest first. Ignored
+	// unless isStreamable().
+	void setTargetLevel(int level);
+
+	// Order of the last bind() among all textures, 0 if never bound
+	uint64_t getLastBind() const { return mLastBind; }
+
+	// Render thread, after the upload finished. Replaces the texture with
+	// one holding levels 1 and up, halving its size and freeing about three
+	// quarters of its memory. Returns false if only one level is left, and
+	// for textures that stream (setTargetLevel() instead).
+	bool dropTopLevel();
+
+	// Render thread. Clamped to maxAnisotropy().
+	void setAnisotropy(float anisotropy);
+	static float maxAnisotropy();
+
+	// Render thread. GL_MAX_TEXTURE_SIZE; upload() rejects larger textures.
+	static int maxTextureSize();
+
+	// Whether the default framebuffer can encode sRGB output. Without it
+	// upload() stores every texture in a linear format, which samples the
+	// encoded values as they are.
+	static void setSrgbOutput(bool enabled) { sSrgbOutput = enabled; }
+
 	void bind(GLuint texUnit = 0);
 	void unbind(GLuint texUnit = 0);
 
 private:
+	void buildLevels(int components);
+	void packChannels();
+	void selectFormat(int channels);
+	void initSampling(int levelCount, int channels);
+	bool createRowTexture();
+	void deleteRowTexture();
+	void allocateStorage(int levelCount, int width, int height);
+	void allocateLevel(int level, bool allocate);
+	void updateGpuBytes();
+	void createStaging(size_t rowSize);
+	size_t levelSize(int width, int height) const;
+	void stageRows(GLint mipLevel, int width, int firstRow, int rows, GLenum format, const unsigned char *source, size_t size);
+	void releaseUpload();
+	void releaseDecoded();
+	void releasePixels();
 
 	GLuint mTexture;
+	unsigned char *mPixels;
+	int mWidth;
+	int mHeight;
+	TextureOptions mOptions;
+
+	// Until the upload finishes: the levels, in mPixels (level 0) and
+	// mMipPixels, repacked to mChannels in mPackedPixels, all in mCached, or
+	// as blocks in mCompressed
+	std::vector<unsigned char> mMipPixels;
+	std::vector<unsigned char> mPackedPixels;
+	TextureCache::Entry mCached;
+	CompressedTexture::Image mCompressed;
+	bool mIsCompressed;
+	BlockFormat mBlockFormat;
+	std::vector<MipLevel> mLevels;
+	int mChannels; // bytes per texel of the uncompressed levels
+	GLenum mInternalFormat;
+	GLenum mFormat; // pixel format of the uncompressed levels
+	bool mSrgb;		// mInternalFormat is sRGB encoded
+	int mLevelCount;
+	bool mStreamable;
+	int mTargetLevel;
+	int mResidentLevel;
+	int mAllocatedLevel; // finest level with GL storage
+	uint64_t mGpuBytes;
+	uint64_t mRgbaBytes;
+	uint64_t mLastBind;
+	static uint64_t sBindCount;
+	static bool sSrgbOutput;
+
+	GLuint mStaging[STAGING_BUFFERS];
+	GLsync mStagingFences[STAGING_BUFFERS];
+	size_t mStagingSize;
+	unsigned int mNextStaging;
+	int mUploadLevel; // next level to upload, counting down to the target level; -1 when done
+	int mUploadRow;
+	uint64_t mUploadedBytes;
+	uint64_t mUploadTotalBytes;
+
+	// What the parallel decoders report while decode() runs: the RGBA8 image
+	// they decode into and its finished bands of rows, until decode() closes
+	// the stream before it changes or frees those pixels
+	struct RowStream
+	{
+		std::mutex mutex;
+		const unsigned char *pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int channels = 0;						// storedChannels() of the image
+		std::vector<std::pair<int, int>> bands; // first row and count, not yet uploaded
+		bool closed = false;
+		bool complete = false; // decode() kept the image the rows came from
+	};
+	RowStream mRowStream;
+	std::vector<bool> mStreamedRows; // level 0 rows uploadDecodedRows() sent; empty without them
 };
@@ -0,0 +1,90 @@
+//-----------------------------------------------------------------------------
+// TextureArray.h
+//
+// The textures of a multi-material model packed into GL_TEXTURE_2D_ARRAY
+// layers, so every material is a layer index (and for atlased textures a
+// UV rect) instead of a texture bind. Images of the largest size become
+// layers of their own; smaller ones are packed into atlas pages of that
+// size, which are more layers of the same array. Only images that fit
+// neither get a further array, one per size.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef __APPLE__
+#include <glad/glad.h>
+#else
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+#include "glm/glm.hpp"
+#include "MipChain.h"
+#include "TextureOptions.h"
+
+class ShaderProgram;
+class Texture2D;
+
+class TextureArray
+{
+public:
+	// Where a material's texture ended up
+	struct Layer
+	{
+		unsigned int array; // which GL array texture
+		float layer;
+		glm::vec4 atlasRect; // UV offset (xy) and scale (zw) of an atlas tile; zero scale for a whole layer
+	};
+
+	TextureArray();
+	~TextureArray();
+	TextureArray(const TextureArray &rhs) = delete;
+	TextureArray &operator=(const TextureArray &rhs) = delete;
+
+	// Decodes the images (through the texture cache, with their mip chains)
+	// and packs them, material i taking files[i]. Block compressed files
+	// cannot be mixed into RGBA8 layers and are rejected. Makes no GL calls,
+	// so it may run on a worker thread.
+	bool decode(const std::vector<std::string> &files, const TextureOptions &options = TextureOptions());
+
+	// Creates the array textures and uploads every layer, then frees the
+	// CPU copies. Render thread.
+	bool upload();
+
+	// Render thread, with shader in use. Binds the array holding material
+	// (modulo the material count) to texUnit unless it already is, and sets
+	// the materialLayer and materialAtlasRect uniforms.
+	void apply(ShaderProgram &shader, unsigned int material, GLuint texUnit = 1);
+	void unbind(GLuint texUnit = 1);
+
+	void setAnisotropy(float anisotropy);
+
+	size_t getMaterialCount() const { return mLayers.size(); }
+	const Layer &getLayer(size_t material) const { return mLayers[material]; }
+	size_t getArrayCount() const { return mArrays.size(); }
+	size_t getAtlasedCount() const { return mAtlasedCount; }
+	uint64_t getGpuBytes() const { return mGpuBytes; }
+	bool isSrgb() const { return mOptions.srgb; }
+
+private:
+	struct Array
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<std::vector<MipLevel>> layers; // CPU levels of every layer until the upload
+		GLuint texture = 0;
+	};
+
+	void packAtlas(const std::vector<size_t> &images, Array &array);
+
+	TextureOptions mOptions;
+	std::vector<std::unique_ptr<Texture2D>> mSources; // decoded images until the upload
+	std::vector<std::vector<unsigned char>> mPages;	  // atlas page pixels and mips until the upload
+	std::vector<Array> mArrays;
+	std::vector<Layer> mLayers;
+	size_t mAtlasedCount;
+	uint64_t mGpuBytes;
+	unsigned int mBoundArray; // mArrays index + 1 of the last apply(), 0 for none
+};
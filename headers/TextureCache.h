@@ -0,0 +1,35 @@
+//-----------------------------------------------------------------------------
+// TextureCache.h
+//
+// On-disk cache (.mvtex) of decoded textures with their mip chains, next to
+// the mesh cache entries (see MeshCache::derivedPath). A hit is memory
+// mapped and streamed to GL as is, skipping both the image decode and the
+// mip filtering.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MipChain.h"
+
+namespace TextureCache
+{
+	// A mapped cache hit. The level pixels stay valid while the entry is alive.
+	struct Entry
+	{
+		MappedFile file;
+		std::vector<MipLevel> levels; // level 0 first
+		int channels = 4;			  // bytes per texel of the levels, 1 to 4
+	};
+
+	// Maps the entry for sourcePath if it matches the source file's size and
+	// modification time and was built with the same options
+	// (TextureOptions::hash()).
+	bool load(const std::string &sourcePath, uint64_t optionsHash, Entry &entry);
+
+	// Writes the entry for sourcePath: every level, level 0 first, with
+	// channels bytes per texel
+	bool store(const std::string &sourcePath, uint64_t optionsHash, const std::vector<MipLevel> &levels, int channels);
+}
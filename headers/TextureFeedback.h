@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// TextureFeedback.h
+//
+// Which mip levels of a texture the screen actually samples. Every few
+// frames the mesh is drawn again into a small render target, at 1/8 of the
+// viewport, with a shader that writes the mip level each pixel selects, the
+// way GL selects it: from the UV derivatives, shortened by anisotropic
+// filtering. The target is read back through pixel buffers a frame or two
+// later, without a stall, and its finest level is what the texture needs
+// resident (see TextureManager::setWantedLevel()).
+//
+// The level is written for a 1x1 texture, so one read back serves a texture
+// of any size; a texture of 2^n texels needs n levels more.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#ifdef __APPLE__
+#include <glad/glad.h>
+#else
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+#include "glm/glm.hpp"
+#include "ShaderProgram.h"
+
+class Mesh;
+
+class TextureFeedback
+{
+public:
+	// Read backs that may be in flight at once
+	static const unsigned int READBACKS = 2;
+
+	TextureFeedback();
+	~TextureFeedback();
+	TextureFeedback(const TextureFeedback &rhs) = delete;
+	TextureFeedback &operator=(const TextureFeedback &rhs) = delete;
+
+	// Render thread, with the GL context current
+	bool init(const char *vsFilename, const char *fsFilename);
+
+	// Render thread, once per frame, after the scene's mesh.draw(). Collects
+	// finished read backs and, every few frames, redraws what that draw chose
+	// into the feedback target and queues its read back. Leaves
+	// the default framebuffer bound with a viewportWidth x viewportHeight
+	// viewport; the feedback program may be left in use.
+	void update(Mesh &mesh, const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+				int viewportWidth, int viewportHeight, float anisotropy);
+
+	// Finest mip level a textureWidth x textureHeight texture was sampled at
+	// in the last read back: its coarsest level if nothing was visible, 0
+	// before the first read back
+	int getNeededLevel(int textureWidth, int textureHeight) const;
+
+private:
+	void resize(int width, int height);
+	void collect();
+	void release();
+
+	ShaderProgram mShader;
+	GLuint mFramebuffer;
+	GLuint mColor; // R8: the level for a 1x1 texture, in 1/16ths offset by -16
+	GLuint mDepth;
+	int mWidth;
+	int mHeight;
+
+	GLuint mReadbacks[READBACKS];
+	GLsync mReadbackFences[READBACKS];
+	int mReadbackSizes[READBACKS];
+	unsigned int mNextReadback;
+	unsigned int mFrame;
+	float mFinestLevel; // for a 1x1 texture, so at most 0; -16 (finest) until read back
+};
@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// TextureManager.h
+//
+// Owns every Texture2D the viewer creates. Textures are shared by content
+// (file bytes and mip options), so loading the same image again reuses the
+// resident copy, and stay resident after their last user lets go until the
+// GPU memory budget needs the space. Over budget, unreferenced textures are
+// evicted least recently bound first; if the textures in use alone exceed
+// it, they lose their top mip levels instead.
+//
+// Textures that stream (Texture2D::isStreamable()) keep only the levels the
+// screen needs, as setWantedLevel() reports them, and the budget is fitted
+// to those: finer levels come in as the camera closes in and go again, a
+// while after it backs off or when textures bound more recently need the
+// space.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TextureOptions.h"
+
+class Texture2D;
+
+class TextureManager
+{
+public:
+	TextureManager();
+	~TextureManager();
+	TextureManager(const TextureManager &rhs) = delete;
+	TextureManager &operator=(const TextureManager &rhs) = delete;
+
+	// Any thread. Key of a texture file's content loaded with options, or 0
+	// if the file cannot be read. Reads the whole file.
+	static uint64_t contentKey(const std::string &path, const TextureOptions &options);
+
+	// Any thread. Returns the texture stored under key with a reference
+	// added, or nullptr. A referenced texture is never evicted.
+	Texture2D *acquire(uint64_t key);
+
+	// Render thread. Takes ownership of a texture (normally uploading) and
+	// returns it with one reference. If a texture with the same key arrived
+	// first, texture is deleted and that one is returned instead.
+	Texture2D *add(uint64_t key, Texture2D *texture);
+
+	// Render thread. Drops a reference taken by acquire() or add(); nullptr
+	// is ignored.
+	void release(Texture2D *texture);
+
+	// Bytes of GL texture storage the textures may keep
+	void setBudget(uint64_t bytes);
+
+	// Render thread. The finest mip level of texture the screen samples
+	// (e.g. from TextureFeedback), 0 until set. Unknown textures are ignored.
+	void setWantedLevel(Texture2D *texture, int level);
+
+	// Render thread, once per frame. Sets the target level of the streaming
+	// textures and evicts and coarsens textures until those targets fit the
+	// budget, then streams texture uploads for up to uploadBudgetMs in all.
+	// Textures that cannot stream drop top levels if still over budget.
+	void update(double uploadBudgetMs);
+
+	// Render thread, while the GL context is alive. Deletes every texture,
+	// referenced or not.
+	void clear();
+
+	struct Residency
+	{
+		size_t textures;
+		size_t referenced;
+		uint64_t gpuBytes;
+		uint64_t rgbaBytes; // the same levels as RGBA8
+		uint64_t budget;
+		uint64_t evictions;		// textures deleted for the budget
+		uint64_t droppedLevels; // top levels dropped from textures in use
+		uint64_t reuses;		// loads served by a resident texture
+		size_t streaming;		// textures that stream their levels
+		uint64_t streamedOut;	// bytes of their levels not resident
+		int heldBackLevels;		// levels the budget keeps them above what is wanted
+	};
+	Residency getResidency() const;
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		std::unique_ptr<Texture2D> texture;
+		int references;
+		int wantedLevel;
+		int level;		   // wanted level after the hysteresis
+		int coarserFrames; // frames the wanted level has been coarser than level
+		int heldBack;	   // levels the budget added on top of level
+	};
+
+	uint64_t gpuBytes() const;
+	uint64_t targetBytes(const Entry &entry) const;
+
+	// Guards mEntries and the counters; acquire() runs on loader threads
+	mutable std::mutex mMutex;
+	std::vector<Entry> mEntries; // a handful of textures: linear search
+	uint64_t mBudget;
+	uint64_t mEvictions;
+	uint64_t mDroppedLevels;
+	uint64_t mReuses;
+};
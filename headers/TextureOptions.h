@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+// TextureOptions.h
+//
+// How a texture's mip chain is built and sampled. The mip options are part
+// of the texture cache key; anisotropy is sampler state and can change at
+// any time (Texture2D::setAnisotropy).
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include "Hash.h"
+#include "MipChain.h"
+
+struct TextureOptions
+{
+	// Build the mip chain on the CPU and sample it trilinearly. Without it
+	// minified textures alias.
+	bool generateMipMaps = true;
+	MipFilter mipFilter = MipFilter::Kaiser;
+
+	// Filter colours in linear light rather than on the sRGB values, which
+	// keeps distant textures from darkening
+	bool gammaCorrectMips = true;
+
+	// Keep only the channels the image has: grayscale as R8 (RG8 with
+	// alpha), RGB without alpha. Texture arrays need RGBA8 and turn this off.
+	bool compactChannels = true;
+
+	// The colours are sRGB encoded: stored in sRGB formats so filtering and
+	// shading see linear values. The framebuffer must then encode the
+	// output (GL_FRAMEBUFFER_SRGB).
+	bool srgb = false;
+
+	// Keep decoded textures in the cache directory, see TextureCache
+	bool cache = true;
+
+	// Show a 1/8 scale preview of a large JPEG while the full image decodes
+	// (Texture2D::decodePreview). Does not change the decoded texture.
+	bool preview = true;
+
+	// Maximum anisotropy, clamped to what the driver supports; 1 disables it
+	float anisotropy = 8.0f;
+
+	uint64_t hash() const
+	{
+		uint64_t h = 0;
+		h = hashCombine(h, generateMipMaps ? 1 : 0);
+		h = hashCombine(h, static_cast<uint64_t>(mipFilter));
+		h = hashCombine(h, gammaCorrectMips ? 1 : 0);
+		h = hashCombine(h, compactChannels ? 1 : 0);
+		h = hashCombine(h, srgb ? 1 : 0);
+		return h;
+	}
+};
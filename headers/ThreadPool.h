@@ -0,0 +1,34 @@
+//-----------------------------------------------------------------------------
+// ThreadPool.h
+//
+// Fixed size pool of worker threads for background loading
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &rhs) = delete;
+	ThreadPool &operator=(const ThreadPool &rhs) = delete;
+
+	// Queues a job; jobs run in submission order as workers become free
+	void submit(std::function<void()> job);
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mWakeUp;
+	bool mStopping;
+};
@@ -0,0 +1,15 @@
+//-----------------------------------------------------------------------------
+// Vertex.h
+//
+// Interleaved vertex layout shared by the mesh loaders and the GL upload code.
+// Kept free of any GL headers so the importers can be used without a context.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "glm/glm.hpp"
+
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec2 texCoords;
+};
@@ -0,0 +1,74 @@
+//-----------------------------------------------------------------------------
+// VertexFormat.h
+//
+// Compact GPU vertex layouts. Import stages work on float Vertex data;
+// packVertices (MeshData.h) encodes it into one of these formats for upload.
+// Free of GL headers: Mesh maps the layout to glVertexAttribPointer calls.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+
+// Quantized formats are stored relative to each sub-mesh's range and read
+// by the GPU as normalized [0, 1] values. SubMesh holds the scale and offset
+// the vertex shader applies to decode them.
+enum class PositionFormat : uint8_t
+{
+	Float32, // 12 bytes
+	Unorm16	 // 8 bytes (3 components + padding), relative to the sub-mesh bounds
+};
+
+enum class TexCoordFormat : uint8_t
+{
+	Float32, // 8 bytes
+	Half16,	 // 4 bytes, absolute
+	Unorm16	 // 4 bytes, relative to the sub-mesh's texture coordinate range
+};
+
+struct VertexFormat
+{
+	PositionFormat position = PositionFormat::Float32;
+	TexCoordFormat texCoord = TexCoordFormat::Float32;
+};
+
+enum class AttributeType : uint8_t
+{
+	Float,
+	HalfFloat,
+	UnsignedShort
+};
+
+struct VertexAttributeLayout
+{
+	unsigned int components;
+	AttributeType type;
+	bool normalized;
+	unsigned int offset; // bytes from the start of the vertex
+};
+
+// Attribute locations: 0 = position, 1 = texture coordinates
+const unsigned int VERTEX_ATTRIBUTE_COUNT = 2;
+
+struct VertexLayout
+{
+	unsigned int stride;
+	VertexAttributeLayout attributes[VERTEX_ATTRIBUTE_COUNT];
+};
+
+VertexLayout vertexLayout(const VertexFormat &format);
+
+const char *positionFormatName(PositionFormat format);
+const char *texCoordFormatName(TexCoordFormat format);
+
+// Precision lost by packVertices, measured against the float source after
+// decoding exactly the way the GPU does
+struct VertexFormatReport
+{
+	uint32_t stride;			  // bytes per packed vertex
+	uint32_t sourceStride;		  // bytes per float Vertex
+	float maxPositionError;		  // model units
+	float rmsPositionError;
+	float relativePositionError; // maxPositionError / mesh bounds diagonal
+	float maxTexCoordError;		  // texture coordinate units
+	float rmsTexCoordError;
+};
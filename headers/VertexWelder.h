@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// VertexWelder.h
+//
+// Parallel vertex deduplication for imported meshes
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+namespace VertexWelder
+{
+	// Merges identical vertices within each sub-mesh and rewrites the
+	// indices to match. With epsilon == 0 vertices must be bit-identical
+	// (+0 and -0 compare equal). With epsilon > 0 every attribute is snapped
+	// to a grid of that spacing and vertices in the same cell are merged,
+	// keeping the first one's values. Vertices no sub-mesh owns are dropped.
+	// Runs hash-partitioned on all cores and must run before packIndices.
+	// Returns the number of vertices removed.
+	size_t weld(MeshData &mesh, float epsilon = 0.0f);
+}
@@ -11,7 +11,25 @@ out vec4 frag_color;
 
 uniform sampler2D texSampler1;
 
+// Material textures (see TextureArray.h): the layer of the current material,
+// or -1 to sample texSampler1, and for atlased textures the UV offset (xy)
+// and scale (zw) of its tile. Zero scale means the texture fills the layer.
+uniform sampler2DArray materialTextures;
+uniform float materialLayer;
+uniform vec4 materialAtlasRect;
+
 void main()
 {
-	frag_color = texture(texSampler1, TexCoord);
+	if (materialLayer < 0.0f)
+		frag_color = texture(texSampler1, TexCoord);
+	else if (materialAtlasRect.z == 0.0f)
+		frag_color = texture(materialTextures, vec3(TexCoord, materialLayer));
+	else
+	{
+		// The tile repeats within its rect. Gradients of the unwrapped
+		// coordinates keep the mip level steady across the wrap.
+		vec2 uv = materialAtlasRect.xy + fract(TexCoord) * materialAtlasRect.zw;
+		frag_color = textureGrad(materialTextures, vec3(uv, materialLayer),
+								 dFdx(TexCoord) * materialAtlasRect.zw, dFdy(TexCoord) * materialAtlasRect.zw);
+	}
 }
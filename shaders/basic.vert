@@ -6,7 +6,7 @@
 //-----------------------------------------------------------------------------
 #version 330 core
 
-layout (location = 0) in vec3 pos;  // in local coords
+layout (location = 0) in vec3 pos;  // in local coords, or normalized if quantized
 layout (location = 1) in vec2 texCoord;
 
 out vec2 TexCoord;
@@ -15,8 +15,21 @@ uniform mat4 model;			// model matrix
 uniform mat4 view;			// view matrix
 uniform mat4 projection;	// projection matrix
 
+// Per draw range vertex decode (see VertexFormat.h); identity for float data
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 texCoordOffset;
+uniform vec2 texCoordScale;
+
+// Point clouds (see PointCloud.h): pixels per unit at distance 1, and the
+// spacing of the points being drawn. pointScale is 0 for triangles.
+uniform float pointScale;
+uniform float pointSpacing;
+
 void main()
 {
-	gl_Position = projection * view * model * vec4(pos, 1.0f);
-	TexCoord = texCoord;
+	vec4 viewPos = view * model * vec4(positionOffset + positionScale * pos, 1.0f);
+	gl_Position = projection * viewPos;
+	gl_PointSize = clamp(pointScale * pointSpacing / max(-viewPos.z, 1e-3f), 1.0f, 64.0f);
+	TexCoord = texCoordOffset + texCoordScale * texCoord;
 }
\ No newline at end of file
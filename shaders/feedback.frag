@@ -0,0 +1,26 @@
+//-----------------------------------------------------------------------------
+// feedback.frag
+//
+// Mip level selection for TextureFeedback: the level of a 1x1 texture each
+// pixel samples, stored as level / 16 + 1 in an R8 target
+//-----------------------------------------------------------------------------
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 frag_color;
+
+uniform float levelBias;		// log2 of the target's scale, e.g. -3 at 1/8
+uniform float maxAnisotropy;	// of the sampler, 1 without anisotropic filtering
+
+void main()
+{
+	// The longer axis of the pixel footprint sets the level; anisotropic
+	// filtering takes up to maxAnisotropy samples along it instead
+	vec2 dx = dFdx(TexCoord);
+	vec2 dy = dFdy(TexCoord);
+	float major = max(max(dot(dx, dx), dot(dy, dy)), 1e-20f);
+	float minor = max(min(dot(dx, dx), dot(dy, dy)), 1e-20f);
+	float anisotropy = min(sqrt(major / minor), maxAnisotropy);
+	float level = 0.5f * log2(major) - log2(anisotropy) + levelBias;
+	frag_color = vec4(clamp(level / 16.0f + 1.0f, 0.0f, 1.0f), 0.0f, 0.0f, 1.0f);
+}
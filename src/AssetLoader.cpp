@@ -0,0 +1,283 @@
+//-----------------------------------------------------------------------------
+// AssetLoader.cpp
+//
+// Loads a model and its texture in the background
+//-----------------------------------------------------------------------------
+#include "AssetLoader.h"
+#include "Hash.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "Texture2D.h"
+#include "TextureArray.h"
+#include "TextureManager.h"
+#include <iostream>
+
+namespace
+{
+    // Model import and texture decode run side by side
+    constexpr unsigned int LOADER_THREADS = 2;
+
+    // Upload time of the frame a model arrives; the rest streams over the
+    // following frames through Mesh::streamUpload and Texture2D::streamUpload
+    constexpr double FIRST_UPLOAD_BUDGET_MS = 4.0;
+
+    // Upload time per frame for the rows of a texture that is still decoding
+    constexpr double DECODED_ROWS_BUDGET_MS = 2.0;
+
+    // Mixed into a texture's key for its preview in the texture manager
+    constexpr uint64_t PREVIEW_KEY_SALT = 0x70726576696577ull;
+}
+
+struct AssetLoader::Request
+{
+    Mesh *mesh = nullptr;
+    Texture2D *texture = nullptr;
+    uint64_t textureKey = 0;
+    bool textureShared = false; // texture is referenced from the manager, not owned
+    Texture2D *preview = nullptr; // shown in place of texture until its decode is done
+    std::atomic<Texture2D *> decoding{nullptr}; // texture while its decode runs, for its early rows
+    std::atomic<bool> textureDone{false};
+    TextureArray *materials = nullptr;
+    LoadProgress meshProgress;
+    LoadProgress textureProgress;
+    bool meshOk = false;
+    bool textureOk = false;
+    std::atomic<int> pendingJobs{2};
+};
+
+AssetLoader::AssetLoader(TextureManager &textures)
+    : mTextures(textures), mPool(std::min(LOADER_THREADS, workerThreadCount()))
+{
+}
+
+//-----------------------------------------------------------------------------
+// Cancels any load in flight and lets the pool destructor wait for the
+// workers. Assets still queued are not deleted: by the time this runs at
+// shutdown the GL context is already gone.
+//-----------------------------------------------------------------------------
+AssetLoader::~AssetLoader()
+{
+    cancel();
+}
+
+void AssetLoader::load(const std::string &modelPath, const std::vector<std::string> &texturePaths, const ImportOptions &options,
+                       const TextureOptions &textureOptions)
+{
+    cancel();
+
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->mesh = new Mesh();
+    mCurrent = request;
+
+    mPool.submit([this, request, modelPath, options]()
+                 {
+                     request->meshOk = request->mesh->import(modelPath, &request->meshProgress, options);
+                     request->meshProgress.report("Done", 1.0f);
+                     finishJob(request); });
+
+    mPool.submit([this, request, texturePaths, textureOptions]()
+                 {
+                     bool previewed = false;
+                     if (!request->textureProgress.isCancelled() && texturePaths.size() > 1)
+                     {
+                         request->textureProgress.report("Packing textures", 0.0f);
+                         request->materials = new TextureArray();
+                         request->textureOk = request->materials->decode(texturePaths, textureOptions);
+                     }
+                     else if (!request->textureProgress.isCancelled() && !texturePaths.empty())
+                     {
+                         const std::string &texturePath = texturePaths[0];
+                         request->textureKey = TextureManager::contentKey(texturePath, textureOptions);
+                         request->texture = mTextures.acquire(request->textureKey);
+                         request->textureShared = request->texture != nullptr;
+                         if (request->textureShared)
+                             request->textureOk = true;
+                         else
+                         {
+                             // A preview completes the texture job as far as
+                             // showing the model goes; the full texture
+                             // follows through the queue on its own
+                             request->textureProgress.report("Decoding texture", 0.0f); // and building its mip chain
+                             request->texture = new Texture2D();
+                             if (textureOptions.preview)
+                             {
+                                 request->preview = new Texture2D();
+                                 previewed = request->preview->decodePreview(texturePath, textureOptions);
+                                 if (previewed)
+                                     finishJob(request);
+                                 else
+                                 {
+                                     delete request->preview;
+                                     request->preview = nullptr;
+                                 }
+                             }
+                             request->decoding = request->texture;
+                             request->textureOk = request->texture->decode(texturePath, textureOptions);
+                         }
+                     }
+                     request->textureProgress.report("Done", 1.0f);
+                     request->textureDone = true;
+                     if (previewed)
+                         mFinished.push(request);
+                     else
+                         finishJob(request); });
+}
+
+void AssetLoader::cancel()
+{
+    // The model on show keeps its preview
+    if (mPreviewing)
+    {
+        mPreviewing->textureProgress.cancelled = true;
+        mPreviewing.reset();
+    }
+    if (!mCurrent)
+        return;
+
+    mCurrent->meshProgress.cancelled = true;
+    mCurrent->textureProgress.cancelled = true;
+    mCurrent.reset();
+}
+
+float AssetLoader::progress() const
+{
+    if (!mCurrent)
+        return 0.0f;
+    return 0.5f * (mCurrent->meshProgress.fraction + mCurrent->textureProgress.fraction);
+}
+
+const char *AssetLoader::stage() const
+{
+    if (!mCurrent)
+        return "";
+    return mCurrent->meshProgress.stage;
+}
+
+//-----------------------------------------------------------------------------
+// Worker side: the last job of a request hands it to the render thread
+//-----------------------------------------------------------------------------
+void AssetLoader::finishJob(const std::shared_ptr<Request> &request)
+{
+    if (--request->pendingJobs == 0)
+        mFinished.push(request);
+}
+
+bool AssetLoader::update(Mesh *&mesh, Texture2D *&texture, TextureArray *&materials)
+{
+    bool swapped = false;
+
+    // Rows of a texture still decoding go up as they are ready, so little is
+    // left to upload when it arrives
+    for (Request *loading : {mCurrent.get(), mPreviewing.get()})
+    {
+        Texture2D *decoding = loading != nullptr && !loading->textureDone ? loading->decoding.load() : nullptr;
+        if (decoding != nullptr)
+            decoding->uploadDecodedRows(DECODED_ROWS_BUDGET_MS);
+    }
+
+    std::shared_ptr<Request> request;
+    while (mFinished.pop(request))
+    {
+        // The full texture of the model on show replaces its preview
+        if (request == mPreviewing)
+        {
+            mPreviewing.reset();
+            if (!request->textureOk)
+            {
+                std::cerr << "Background texture decode failed, keeping its preview" << std::endl;
+                discard(*request);
+                continue;
+            }
+            request->texture->upload(FIRST_UPLOAD_BUDGET_MS);
+            Texture2D *full = mTextures.add(request->textureKey, request->texture);
+            mTextures.release(texture);
+            texture = full;
+            request->texture = nullptr;
+            swapped = true;
+            continue;
+        }
+
+        // A request that arrived with its preview is queued again once the
+        // texture job is done; until then the job still uses it
+        if (request != mCurrent)
+        {
+            if (request->textureDone)
+                discard(*request); // cancelled or superseded
+            continue;
+        }
+        // The full texture overtook the model, whose job queues it again
+        if (request->pendingJobs > 0)
+            continue;
+        mCurrent.reset();
+
+        const bool textureDone = request->textureDone;
+        if (!request->meshOk || (textureDone && !request->textureOk))
+        {
+            std::cerr << "Background load failed, keeping the current model" << std::endl;
+            if (textureDone)
+                discard(*request);
+            continue;
+        }
+
+        if (request->materials && !request->materials->upload())
+        {
+            std::cerr << "Background load failed, keeping the current model" << std::endl;
+            discard(*request);
+            continue;
+        }
+
+        request->mesh->upload(FIRST_UPLOAD_BUDGET_MS);
+        Texture2D *shown = request->texture;
+        if (request->materials)
+            request->mesh->setMaterialTextures(request->materials);
+        else if (!textureDone)
+        {
+            // The preview is shared under a key of its own, so it is released
+            // like any texture when the full one arrives
+            request->preview->upload(FIRST_UPLOAD_BUDGET_MS);
+            shown = mTextures.add(hashCombine(request->textureKey, PREVIEW_KEY_SALT), request->preview);
+            request->preview = nullptr;
+            mPreviewing = request;
+        }
+        else if (!request->textureShared)
+        {
+            request->texture->upload(FIRST_UPLOAD_BUDGET_MS);
+            shown = mTextures.add(request->textureKey, request->texture);
+        }
+        delete request->preview;
+        request->preview = nullptr;
+
+        delete mesh;
+        mTextures.release(texture);
+        delete materials;
+        mesh = request->mesh;
+        texture = shown;
+        materials = request->materials;
+        request->mesh = nullptr;
+        if (mPreviewing != request)
+            request->texture = nullptr; // else still decoding
+        request->materials = nullptr;
+        swapped = true;
+    }
+
+    return swapped;
+}
+
+//-----------------------------------------------------------------------------
+// Frees a request's assets. Runs on the render thread because the
+// destructors release GL objects.
+//-----------------------------------------------------------------------------
+void AssetLoader::discard(Request &request)
+{
+    delete request.mesh;
+    if (request.textureShared)
+        mTextures.release(request.texture);
+    else
+        delete request.texture;
+    delete request.preview;
+    delete request.materials;
+    request.materials = nullptr;
+    request.mesh = nullptr;
+    request.texture = nullptr;
+    request.preview = nullptr;
+}
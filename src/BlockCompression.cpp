@@ -0,0 +1,355 @@
+//-----------------------------------------------------------------------------
+// BlockCompression.cpp
+//
+// BCn formats and the CPU block encoder
+//-----------------------------------------------------------------------------
+#include "BlockCompression.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Power iterations for the principal axis of a block's colours
+    const int AXIS_ITERATIONS = 8;
+
+    // Block rows encoded per task
+    const int BLOCK_ROWS_PER_TASK = 4;
+
+    struct Colour
+    {
+        float r, g, b;
+    };
+
+    inline float distanceSquared(const Colour &a, const Colour &b)
+    {
+        float dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+
+    //-------------------------------------------------------------------------
+    // RGB565 packing, rounding to the nearest representable colour
+    //-------------------------------------------------------------------------
+    uint16_t packRgb565(const Colour &c)
+    {
+        int r = std::min(31, std::max(0, static_cast<int>(c.r * 31.0f / 255.0f + 0.5f)));
+        int g = std::min(63, std::max(0, static_cast<int>(c.g * 63.0f / 255.0f + 0.5f)));
+        int b = std::min(31, std::max(0, static_cast<int>(c.b * 31.0f / 255.0f + 0.5f)));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    Colour unpackRgb565(uint16_t c)
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        return {static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)), static_cast<float>((b << 3) | (b >> 2))};
+    }
+
+    //-------------------------------------------------------------------------
+    // Indices of colours against the four colour palette of endpoints
+    // (c0 > c1 as 16-bit values) and the squared error
+    //-------------------------------------------------------------------------
+    float chooseColourIndices(const Colour *colours, uint16_t c0, uint16_t c1, uint32_t &indices)
+    {
+        Colour a = unpackRgb565(c0), b = unpackRgb565(c1);
+        Colour palette[4] = {a, b,
+                             {(2 * a.r + b.r) / 3, (2 * a.g + b.g) / 3, (2 * a.b + b.b) / 3},
+                             {(a.r + 2 * b.r) / 3, (a.g + 2 * b.g) / 3, (a.b + 2 * b.b) / 3}};
+        float error = 0.0f;
+        indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestDistance = distanceSquared(colours[i], palette[0]);
+            for (int p = 1; p < 4; p++)
+            {
+                float distance = distanceSquared(colours[i], palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+            error += bestDistance;
+        }
+        return error;
+    }
+
+    //-------------------------------------------------------------------------
+    // Quantizes float endpoints, orders them for four colour mode and picks
+    // the indices. Returns the squared error.
+    //-------------------------------------------------------------------------
+    float fitEndpoints(const Colour *colours, const Colour &high, const Colour &low, uint16_t &c0, uint16_t &c1, uint32_t &indices)
+    {
+        c0 = packRgb565(high);
+        c1 = packRgb565(low);
+        if (c0 < c1)
+            std::swap(c0, c1);
+        if (c0 == c1)
+        {
+            // One colour: c0 > c1 is impossible, and index 0 is c0 in either mode
+            indices = 0;
+            float error = 0.0f;
+            Colour c = unpackRgb565(c0);
+            for (int i = 0; i < 16; i++)
+                error += distanceSquared(colours[i], c);
+            return error;
+        }
+        return chooseColourIndices(colours, c0, c1, indices);
+    }
+
+    //-------------------------------------------------------------------------
+    // Endpoints that minimize the squared error for fixed indices
+    //-------------------------------------------------------------------------
+    bool leastSquaresEndpoints(const Colour *colours, uint32_t indices, Colour &high, Colour &low)
+    {
+        static const float WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        Colour ax = {0, 0, 0}, bx = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            float w = WEIGHTS[(indices >> (2 * i)) & 3];
+            float v = 1.0f - w;
+            aa += w * w;
+            bb += v * v;
+            ab += w * v;
+            ax.r += w * colours[i].r;
+            ax.g += w * colours[i].g;
+            ax.b += w * colours[i].b;
+            bx.r += v * colours[i].r;
+            bx.g += v * colours[i].g;
+            bx.b += v * colours[i].b;
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return false;
+        float inverse = 1.0f / determinant;
+        high = {(ax.r * bb - bx.r * ab) * inverse, (ax.g * bb - bx.g * ab) * inverse, (ax.b * bb - bx.b * ab) * inverse};
+        low = {(bx.r * aa - ax.r * ab) * inverse, (bx.g * aa - ax.g * ab) * inverse, (bx.b * aa - ax.b * ab) * inverse};
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // A BC1 colour block in four colour mode (also the colour half of BC3)
+    //-------------------------------------------------------------------------
+    void encodeColourBlock(const unsigned char *texels, unsigned char *out)
+    {
+        Colour colours[16];
+        Colour mean = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            colours[i] = {static_cast<float>(texels[4 * i]), static_cast<float>(texels[4 * i + 1]), static_cast<float>(texels[4 * i + 2])};
+            mean.r += colours[i].r / 16.0f;
+            mean.g += colours[i].g / 16.0f;
+            mean.b += colours[i].b / 16.0f;
+        }
+
+        float covariance[6] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = colours[i].r - mean.r, g = colours[i].g - mean.g, b = colours[i].b - mean.b;
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        Colour axis = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < AXIS_ITERATIONS; iteration++)
+        {
+            Colour next = {covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                           covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                           covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b};
+            float length = std::max({std::fabs(next.r), std::fabs(next.g), std::fabs(next.b)});
+            if (length < 1e-6f)
+                break;
+            axis = {next.r / length, next.g / length, next.b / length};
+        }
+
+        // Extremes along the axis, pulled in slightly as the palette's
+        // outer entries are rarely the best fit
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = (colours[i].r - mean.r) * axis.r + (colours[i].g - mean.g) * axis.g + (colours[i].b - mean.b) * axis.b;
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        float inset = (maxProjection - minProjection) / 16.0f;
+        minProjection += inset;
+        maxProjection -= inset;
+        float axisLengthSquared = axis.r * axis.r + axis.g * axis.g + axis.b * axis.b;
+        if (axisLengthSquared > 0.0f)
+        {
+            minProjection /= axisLengthSquared;
+            maxProjection /= axisLengthSquared;
+        }
+        Colour high = {mean.r + axis.r * maxProjection, mean.g + axis.g * maxProjection, mean.b + axis.b * maxProjection};
+        Colour low = {mean.r + axis.r * minProjection, mean.g + axis.g * minProjection, mean.b + axis.b * minProjection};
+
+        uint16_t c0, c1;
+        uint32_t indices;
+        float error = fitEndpoints(colours, high, low, c0, c1, indices);
+
+        // One least squares refinement of the endpoints for these indices
+        if (c0 != c1 && leastSquaresEndpoints(colours, indices, high, low))
+        {
+            uint16_t refined0, refined1;
+            uint32_t refinedIndices;
+            if (fitEndpoints(colours, high, low, refined0, refined1, refinedIndices) < error)
+            {
+                c0 = refined0;
+                c1 = refined1;
+                indices = refinedIndices;
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(c0 & 0xFF);
+        out[1] = static_cast<unsigned char>(c0 >> 8);
+        out[2] = static_cast<unsigned char>(c1 & 0xFF);
+        out[3] = static_cast<unsigned char>(c1 >> 8);
+        std::memcpy(out + 4, &indices, 4); // little endian, like the rest of the file formats
+    }
+
+    //-------------------------------------------------------------------------
+    // A BC4 block of one channel in eight value mode
+    //-------------------------------------------------------------------------
+    void encodeChannelBlock(const unsigned char *texels, int channel, unsigned char *out)
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, static_cast<int>(texels[4 * i + channel]));
+            high = std::max(high, static_cast<int>(texels[4 * i + channel]));
+        }
+
+        out[0] = static_cast<unsigned char>(high);
+        out[1] = static_cast<unsigned char>(low);
+        uint64_t indices = 0;
+        if (high > low)
+        {
+            int palette[8] = {high, low};
+            for (int p = 2; p < 8; p++)
+                palette[p] = ((8 - p) * high + (p - 1) * low + 3) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int value = texels[4 * i + channel];
+                int best = 0;
+                for (int p = 1; p < 8; p++)
+                {
+                    if (std::abs(palette[p] - value) < std::abs(palette[best] - value))
+                        best = p;
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+        }
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = static_cast<unsigned char>(indices >> (8 * b));
+    }
+
+    //-------------------------------------------------------------------------
+    // The 4x4 texels of block (bx, by), edge texels repeated past the level
+    //-------------------------------------------------------------------------
+    void gatherBlock(const MipLevel &level, int bx, int by, unsigned char *texels)
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            int sy = std::min(by * 4 + y, level.height - 1);
+            for (int x = 0; x < 4; x++)
+            {
+                int sx = std::min(bx * 4 + x, level.width - 1);
+                std::memcpy(texels + 4 * (4 * y + x), level.pixels + (static_cast<size_t>(sy) * level.width + sx) * 4, 4);
+            }
+        }
+    }
+}
+
+const char *blockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return "BC1";
+    case BlockFormat::BC2:
+        return "BC2";
+    case BlockFormat::BC3:
+        return "BC3";
+    case BlockFormat::BC4:
+        return "BC4";
+    case BlockFormat::BC5:
+        return "BC5";
+    case BlockFormat::BC7:
+        return "BC7";
+    }
+    return "unknown";
+}
+
+unsigned int blockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+bool BlockCompression::canEncode(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC3 || format == BlockFormat::BC4 || format == BlockFormat::BC5;
+}
+
+bool BlockCompression::hasAlpha(const MipLevel &level)
+{
+    size_t count = static_cast<size_t>(level.width) * level.height;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (level.pixels[4 * i + 3] != 255)
+            return true;
+    }
+    return false;
+}
+
+void BlockCompression::encode(const MipLevel &level, BlockFormat format, unsigned char *out)
+{
+    const int blocksWide = (level.width + 3) / 4;
+    const int blocksHigh = (level.height + 3) / 4;
+    const unsigned int bytes = blockBytes(format);
+
+    size_t taskCount = static_cast<size_t>((blocksHigh + BLOCK_ROWS_PER_TASK - 1) / BLOCK_ROWS_PER_TASK);
+    parallelFor(taskCount, [&](size_t task)
+                {
+                    int rowEnd = std::min(blocksHigh, static_cast<int>(task + 1) * BLOCK_ROWS_PER_TASK);
+                    for (int by = static_cast<int>(task) * BLOCK_ROWS_PER_TASK; by < rowEnd; by++)
+                    {
+                        for (int bx = 0; bx < blocksWide; bx++)
+                        {
+                            unsigned char texels[64];
+                            gatherBlock(level, bx, by, texels);
+                            unsigned char *block = out + (static_cast<size_t>(by) * blocksWide + bx) * bytes;
+                            switch (format)
+                            {
+                            case BlockFormat::BC1:
+                                encodeColourBlock(texels, block);
+                                break;
+                            case BlockFormat::BC3:
+                                encodeChannelBlock(texels, 3, block);
+                                encodeColourBlock(texels, block + 8);
+                                break;
+                            case BlockFormat::BC4:
+                                encodeChannelBlock(texels, 0, block);
+                                break;
+                            case BlockFormat::BC5:
+                                encodeChannelBlock(texels, 0, block);
+                                encodeChannelBlock(texels, 1, block + 8);
+                                break;
+                            default:
+                                std::memset(block, 0, bytes);
+                                break;
+                            }
+                        }
+                    } });
+}
@@ -0,0 +1,425 @@
+//-----------------------------------------------------------------------------
+// ChunkPager.cpp
+//
+// Out-of-core rendering of a mesh octree
+//-----------------------------------------------------------------------------
+#include "ChunkPager.h"
+#include "Mesh.h"
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    constexpr unsigned int PAGER_THREADS = 2;
+
+    // Reads queued at once. Few enough that the queue follows the camera.
+    constexpr size_t MAX_READS_IN_FLIGHT = 8;
+
+    // Render thread time per frame for GPU uploads; at least one chunk
+    // goes per frame
+    constexpr double UPLOAD_BUDGET_MS = 2.0;
+
+    // Chunks outside the frustum but this close to the camera, as a
+    // fraction of the model's diagonal, are prefetched after the visible ones
+    constexpr float PREFETCH_DISTANCE = 0.1f;
+
+    constexpr uint64_t DEFAULT_CPU_BUDGET = 1024ull * 1024 * 1024;
+    constexpr uint64_t DEFAULT_GPU_BUDGET = 512ull * 1024 * 1024;
+
+    double millisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+}
+
+ChunkPager::ChunkPager()
+    : mVisibleCount(0), mFrame(0), mGeneration(0), mReadsInFlight(0), mCpuBudget(DEFAULT_CPU_BUDGET),
+      mGpuBudget(DEFAULT_GPU_BUDGET), mCpuBytes(0), mGpuBytes(0), mHasLastUpdate(false), mStats(), mResidency(),
+      mPool(PAGER_THREADS)
+{
+}
+
+ChunkPager::~ChunkPager()
+{
+    for (ChunkState &state : mStates)
+        releaseGpu(state);
+}
+
+bool ChunkPager::open(const std::string &path)
+{
+    if (!mReader.open(path))
+        return false;
+
+    mStates.assign(mReader.getChunks().size(), ChunkState());
+    mResidency = Residency();
+    mResidency.chunks = mStates.size();
+    for (const MeshOctree::Chunk &chunk : mReader.getChunks())
+        mResidency.totalTriangles += chunk.subMesh.indexCount / 3;
+    std::cout << "Mesh octree: " << mReader.getNodes().size() << " nodes, " << mStates.size() << " chunks, paging from '"
+              << path << "'" << std::endl;
+    return true;
+}
+
+void ChunkPager::setBudget(uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    mCpuBudget = cpuBytes;
+    mGpuBudget = gpuBytes;
+}
+
+void ChunkPager::resetStats()
+{
+    mStats = Stats();
+    for (ChunkState &state : mStates)
+        state.missing = false;
+}
+
+//-----------------------------------------------------------------------------
+// Releases every chunk. Reads still in flight are dropped when they arrive.
+//-----------------------------------------------------------------------------
+void ChunkPager::flush()
+{
+    for (ChunkState &state : mStates)
+    {
+        releaseGpu(state);
+        state.data.reset();
+        state.reading = false;
+        state.missing = false;
+    }
+    mCpuBytes = 0;
+    mGpuBytes = 0;
+    mGeneration++;
+}
+
+void ChunkPager::update(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView)
+{
+    if (mStates.empty())
+        return;
+
+    Clock::time_point start = Clock::now();
+    double frameMs = mHasLastUpdate ? millisecondsBetween(mLastUpdate, start) : 0.0;
+    mLastUpdate = start;
+    mHasLastUpdate = true;
+    mFrame++;
+
+    receiveReads();
+    selectChunks(frustum, cameraPosition, hasView);
+    uploadChunks(start);
+    requestReads();
+
+    // What this frame can draw, and the holes it has to live with
+    Clock::time_point now = Clock::now();
+    const std::vector<MeshOctree::Chunk> &chunks = mReader.getChunks();
+    mResidency.visibleChunks = mVisibleCount;
+    mResidency.drawnChunks = 0;
+    mResidency.triangles = 0;
+    mResidency.visibleTriangles = 0;
+    bool stalled = false;
+    for (size_t i = 0; i < mVisibleCount; i++)
+    {
+        ChunkState &state = mStates[mWanted[i]];
+        size_t triangles = chunks[mWanted[i]].subMesh.indexCount / 3;
+        mResidency.visibleTriangles += triangles;
+        mStats.lookups++;
+        if (state.vao != 0)
+        {
+            mStats.hits++;
+            mResidency.drawnChunks++;
+            mResidency.triangles += triangles;
+            continue;
+        }
+
+        stalled = true;
+        if (!state.missing)
+        {
+            state.missing = true;
+            state.missingSince = now;
+        }
+    }
+    if (stalled)
+    {
+        mStats.stalledFrames++;
+        mStats.stallMs += frameMs;
+    }
+
+    mResidency.gpuChunks = 0;
+    mResidency.cpuChunks = 0;
+    for (const ChunkState &state : mStates)
+    {
+        mResidency.gpuChunks += state.vao != 0 ? 1 : 0;
+        mResidency.cpuChunks += state.data ? 1 : 0;
+    }
+    mResidency.cpuBytes = mCpuBytes;
+    mResidency.gpuBytes = mGpuBytes;
+    mResidency.cpuBudget = mCpuBudget;
+    mResidency.gpuBudget = mGpuBudget;
+
+    mStats.frames++;
+    mStats.pagingMs += millisecondsBetween(start, Clock::now());
+}
+
+//-----------------------------------------------------------------------------
+// Walks the octree: chunks in the frustum nearest first, then the ones just
+// outside it close to the camera. Marks all of them used this frame.
+//-----------------------------------------------------------------------------
+void ChunkPager::selectChunks(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView)
+{
+    const std::vector<MeshOctree::Node> &nodes = mReader.getNodes();
+    const std::vector<MeshOctree::Chunk> &chunks = mReader.getChunks();
+    float prefetchDistance = PREFETCH_DISTANCE * glm::length(nodes[0].boundsMax - nodes[0].boundsMin);
+
+    struct Candidate
+    {
+        float distance;
+        size_t chunk;
+    };
+    std::vector<Candidate> visible, nearby;
+
+    auto classify = [&](const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float &distance)
+    {
+        glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+        float radius = 0.5f * glm::length(boundsMax - boundsMin);
+        distance = std::max(glm::length(center - cameraPosition) - radius, 0.0f);
+        if (!hasView || Meshlets::isSphereVisible(frustum, center, radius))
+            return 2;
+        return distance <= prefetchDistance ? 1 : 0;
+    };
+
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        const MeshOctree::Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        float distance;
+        if (classify(node.boundsMin, node.boundsMax, distance) == 0)
+            continue;
+
+        for (uint32_t child : node.children)
+        {
+            if (child != MeshOctree::INVALID_NODE)
+                stack.push_back(child);
+        }
+
+        for (uint32_t c = node.firstChunk; c < node.firstChunk + node.chunkCount; c++)
+        {
+            const SubMesh &subMesh = chunks[c].subMesh;
+            int visibility = classify(subMesh.boundsMin, subMesh.boundsMax, distance);
+            if (visibility == 2)
+                visible.push_back({distance, c});
+            else if (visibility == 1)
+                nearby.push_back({distance, c});
+        }
+    }
+
+    auto nearer = [](const Candidate &a, const Candidate &b)
+    { return a.distance < b.distance; };
+    std::sort(visible.begin(), visible.end(), nearer);
+    std::sort(nearby.begin(), nearby.end(), nearer);
+
+    mWanted.clear();
+    for (const Candidate &candidate : visible)
+        mWanted.push_back(candidate.chunk);
+    for (const Candidate &candidate : nearby)
+        mWanted.push_back(candidate.chunk);
+    mVisibleCount = visible.size();
+
+    for (size_t chunk : mWanted)
+        mStates[chunk].lastUsed = mFrame;
+}
+
+//-----------------------------------------------------------------------------
+// Queues disk reads for wanted chunks that are neither on the GPU nor in
+// memory, in priority order, as far as the CPU budget allows
+//-----------------------------------------------------------------------------
+void ChunkPager::requestReads()
+{
+    for (size_t chunk : mWanted)
+    {
+        if (mReadsInFlight >= MAX_READS_IN_FLIGHT)
+            break;
+
+        ChunkState &state = mStates[chunk];
+        if (state.vao != 0 || state.data || state.reading)
+            continue;
+
+        uint64_t bytes = chunkBytes(chunk);
+        if (!makeCpuRoom(bytes))
+            break;
+
+        mCpuBytes += bytes;
+        state.reading = true;
+        mReadsInFlight++;
+        uint64_t generation = mGeneration;
+        mPool.submit([this, chunk, generation]()
+                     {
+                         ReadResult result;
+                         result.chunk = chunk;
+                         result.generation = generation;
+                         result.data = std::make_shared<std::vector<unsigned char>>();
+                         if (!mReader.readChunk(chunk, *result.data))
+                             result.data.reset();
+                         mReadResults.push(std::move(result)); });
+    }
+}
+
+void ChunkPager::receiveReads()
+{
+    ReadResult result;
+    while (mReadResults.pop(result))
+    {
+        mReadsInFlight--;
+        if (result.generation != mGeneration)
+            continue; // flushed while reading
+
+        ChunkState &state = mStates[result.chunk];
+        state.reading = false;
+        if (!result.data)
+        {
+            mCpuBytes -= chunkBytes(result.chunk);
+            std::cerr << "Mesh octree: unable to read chunk " << result.chunk << std::endl;
+            continue;
+        }
+        state.data = std::move(result.data);
+        mStats.reads++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Moves wanted chunks that are in memory onto the GPU, in priority order.
+// The memory copy stays (budget permitting) so a chunk evicted from the GPU
+// comes back without touching the disk.
+//-----------------------------------------------------------------------------
+void ChunkPager::uploadChunks(Clock::time_point start)
+{
+    const std::vector<MeshOctree::Chunk> &chunks = mReader.getChunks();
+    bool uploaded = false;
+    for (size_t chunk : mWanted)
+    {
+        ChunkState &state = mStates[chunk];
+        if (state.vao != 0 || !state.data)
+            continue;
+        if (uploaded && millisecondsBetween(start, Clock::now()) >= UPLOAD_BUDGET_MS)
+            break;
+
+        uint64_t bytes = chunkBytes(chunk);
+        if (!makeGpuRoom(bytes))
+            break;
+
+        const MeshOctree::Chunk &record = chunks[chunk];
+        glGenVertexArrays(1, &state.vao);
+        glGenBuffers(1, &state.vbo);
+        glGenBuffers(1, &state.ebo);
+        glBindVertexArray(state.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, state.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(record.vertexBufferSize), state.data->data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(record.indexBufferSize),
+                     state.data->data() + record.vertexBufferSize, GL_STATIC_DRAW);
+        setVertexAttributes(mReader.getVertexFormat());
+        glBindVertexArray(0);
+
+        mGpuBytes += bytes;
+        uploaded = true;
+        if (state.missing)
+        {
+            state.missing = false;
+            mStats.latencyMs += millisecondsBetween(state.missingSince, Clock::now());
+            mStats.arrivals++;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Evicts memory copies not used this frame, least recently used first, until
+// bytes more fit the CPU budget. Returns false if they cannot.
+//-----------------------------------------------------------------------------
+bool ChunkPager::makeCpuRoom(uint64_t bytes)
+{
+    if (mCpuBytes + bytes <= mCpuBudget)
+        return true;
+
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < mStates.size(); i++)
+    {
+        if (mStates[i].data && mStates[i].lastUsed < mFrame)
+            candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+              { return mStates[a].lastUsed < mStates[b].lastUsed; });
+
+    for (size_t i : candidates)
+    {
+        if (mCpuBytes + bytes <= mCpuBudget)
+            break;
+        mStates[i].data.reset();
+        mCpuBytes -= chunkBytes(i);
+        mStats.evictions++;
+    }
+    return mCpuBytes + bytes <= mCpuBudget;
+}
+
+//-----------------------------------------------------------------------------
+// Same for the GPU budget and the chunk buffers
+//-----------------------------------------------------------------------------
+bool ChunkPager::makeGpuRoom(uint64_t bytes)
+{
+    if (mGpuBytes + bytes <= mGpuBudget)
+        return true;
+
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < mStates.size(); i++)
+    {
+        if (mStates[i].vao != 0 && mStates[i].lastUsed < mFrame)
+            candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+              { return mStates[a].lastUsed < mStates[b].lastUsed; });
+
+    for (size_t i : candidates)
+    {
+        if (mGpuBytes + bytes <= mGpuBudget)
+            break;
+        releaseGpu(mStates[i]);
+        mGpuBytes -= chunkBytes(i);
+        mStats.evictions++;
+    }
+    return mGpuBytes + bytes <= mGpuBudget;
+}
+
+void ChunkPager::releaseGpu(ChunkState &state)
+{
+    if (state.vao == 0)
+        return;
+    glDeleteVertexArrays(1, &state.vao);
+    glDeleteBuffers(1, &state.vbo);
+    glDeleteBuffers(1, &state.ebo);
+    state.vao = state.vbo = state.ebo = 0;
+}
+
+uint64_t ChunkPager::chunkBytes(size_t chunk) const
+{
+    const MeshOctree::Chunk &record = mReader.getChunks()[chunk];
+    return record.vertexBufferSize + record.indexBufferSize;
+}
+
+void ChunkPager::draw(ShaderProgram &shader)
+{
+    const std::vector<MeshOctree::Chunk> &chunks = mReader.getChunks();
+    for (size_t i = 0; i < mVisibleCount; i++)
+    {
+        const ChunkState &state = mStates[mWanted[i]];
+        if (state.vao == 0)
+            continue;
+
+        const SubMesh &subMesh = chunks[mWanted[i]].subMesh;
+        shader.setUniform("positionOffset", subMesh.positionOffset);
+        shader.setUniform("positionScale", subMesh.positionScale);
+        shader.setUniform("texCoordOffset", subMesh.texCoordOffset);
+        shader.setUniform("texCoordScale", subMesh.texCoordScale);
+
+        glBindVertexArray(state.vao);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(subMesh.indexCount), subMesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, nullptr);
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,427 @@
+//-----------------------------------------------------------------------------
+// CompressedTexture.cpp
+//
+// DDS and KTX2 containers of BCn textures
+//-----------------------------------------------------------------------------
+#include "CompressedTexture.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    // Largest side accepted from a file header; Texture2D::upload() checks
+    // the texture against the driver's GL_MAX_TEXTURE_SIZE
+    const uint32_t MAX_DIMENSION = 65536;
+
+    //-------------------------------------------------------------------------
+    // DDS
+    //-------------------------------------------------------------------------
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDSD_CAPS = 0x1;
+    const uint32_t DDSD_HEIGHT = 0x2;
+    const uint32_t DDSD_WIDTH = 0x4;
+    const uint32_t DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDSD_DEPTH = 0x800000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS_COMPLEX = 0x8;
+    const uint32_t DDSCAPS_TEXTURE = 0x1000;
+    const uint32_t DDSCAPS_MIPMAP = 0x400000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_VOLUME = 0x200000;
+    const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+    const uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct DdsHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat pixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDx10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    constexpr uint32_t fourCC(char a, char b, char c, char d)
+    {
+        return static_cast<uint32_t>(static_cast<unsigned char>(a)) | (static_cast<uint32_t>(static_cast<unsigned char>(b)) << 8) |
+               (static_cast<uint32_t>(static_cast<unsigned char>(c)) << 16) | (static_cast<uint32_t>(static_cast<unsigned char>(d)) << 24);
+    }
+
+    bool formatFromFourCC(uint32_t code, BlockFormat &format)
+    {
+        if (code == fourCC('D', 'X', 'T', '1'))
+            format = BlockFormat::BC1;
+        else if (code == fourCC('D', 'X', 'T', '3'))
+            format = BlockFormat::BC2;
+        else if (code == fourCC('D', 'X', 'T', '5'))
+            format = BlockFormat::BC3;
+        else if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U'))
+            format = BlockFormat::BC4;
+        else if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U'))
+            format = BlockFormat::BC5;
+        else
+            return false;
+        return true;
+    }
+
+    bool formatFromDxgi(uint32_t dxgiFormat, BlockFormat &format, bool &srgb)
+    {
+        srgb = false;
+        switch (dxgiFormat)
+        {
+        case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+            srgb = true;
+            // fall through
+        case 71: // DXGI_FORMAT_BC1_UNORM
+            format = BlockFormat::BC1;
+            return true;
+        case 75:
+            srgb = true;
+            // fall through
+        case 74:
+            format = BlockFormat::BC2;
+            return true;
+        case 78:
+            srgb = true;
+            // fall through
+        case 77:
+            format = BlockFormat::BC3;
+            return true;
+        case 80: // DXGI_FORMAT_BC4_UNORM
+            format = BlockFormat::BC4;
+            return true;
+        case 83: // DXGI_FORMAT_BC5_UNORM
+            format = BlockFormat::BC5;
+            return true;
+        case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+            srgb = true;
+            // fall through
+        case 98:
+            format = BlockFormat::BC7;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // KTX2
+    //-------------------------------------------------------------------------
+    const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Ktx2Header
+    {
+        unsigned char identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct Ktx2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    bool formatFromVk(uint32_t vkFormat, BlockFormat &format, bool &srgb)
+    {
+        // VK_FORMAT_BC1_RGB_UNORM_BLOCK (131) to VK_FORMAT_BC7_SRGB_BLOCK (146);
+        // odd values are UNORM, even ones SRGB (SNORM for BC4 and BC5)
+        if (vkFormat < 131 || vkFormat > 146 || vkFormat == 143 || vkFormat == 144)
+            return false;
+        if (vkFormat == 140 || vkFormat == 142)
+            return false; // signed BC4/BC5
+        srgb = vkFormat % 2 == 0;
+        if (vkFormat <= 134)
+            format = BlockFormat::BC1;
+        else if (vkFormat <= 136)
+            format = BlockFormat::BC2;
+        else if (vkFormat <= 138)
+            format = BlockFormat::BC3;
+        else if (vkFormat == 139)
+            format = BlockFormat::BC4;
+        else if (vkFormat == 141)
+            format = BlockFormat::BC5;
+        else
+            format = BlockFormat::BC7;
+        return true;
+    }
+
+    std::string lowerExtension(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+            return std::string();
+        std::string extension = path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    bool loadDds(const std::string &path, CompressedTexture::Image &image)
+    {
+        const MappedFile &file = image.file;
+        uint32_t magic;
+        DdsHeader header;
+        if (file.size() < sizeof(magic) + sizeof(header))
+            return false;
+        std::memcpy(&magic, file.data(), sizeof(magic));
+        std::memcpy(&header, file.data() + sizeof(magic), sizeof(header));
+        if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat))
+            return false;
+        if ((header.flags & DDSD_DEPTH) || (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)))
+        {
+            std::cerr << "DDS: '" << path << "' is not a 2D texture" << std::endl;
+            return false;
+        }
+        if (!(header.pixelFormat.flags & DDPF_FOURCC))
+        {
+            std::cerr << "DDS: '" << path << "' is not block compressed" << std::endl;
+            return false;
+        }
+
+        size_t offset = sizeof(magic) + sizeof(header);
+        if (header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0'))
+        {
+            DdsHeaderDx10 dx10;
+            if (file.size() < offset + sizeof(dx10))
+                return false;
+            std::memcpy(&dx10, file.data() + offset, sizeof(dx10));
+            offset += sizeof(dx10);
+            if (dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10.arraySize > 1 || (dx10.miscFlag & DDS_MISC_TEXTURECUBE))
+            {
+                std::cerr << "DDS: '" << path << "' is not a 2D texture" << std::endl;
+                return false;
+            }
+            if (!formatFromDxgi(dx10.dxgiFormat, image.format, image.srgb))
+            {
+                std::cerr << "DDS: unsupported DXGI format " << dx10.dxgiFormat << " in '" << path << "'" << std::endl;
+                return false;
+            }
+        }
+        else if (!formatFromFourCC(header.pixelFormat.fourCC, image.format))
+        {
+            std::cerr << "DDS: unsupported format in '" << path << "'" << std::endl;
+            return false;
+        }
+
+        if (header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION)
+        {
+            std::cerr << "DDS: '" << path << "' has an invalid size of " << header.width << "x" << header.height << std::endl;
+            return false;
+        }
+        uint32_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max(1u, header.mipMapCount) : 1u;
+        levelCount = std::min(levelCount, MipChain::levelCount(static_cast<int>(header.width), static_cast<int>(header.height)));
+        int width = static_cast<int>(header.width), height = static_cast<int>(header.height);
+        for (uint32_t i = 0; i < levelCount; i++)
+        {
+            size_t size = compressedSize(image.format, width, height);
+            if (offset + size > file.size())
+                break; // keep the complete levels
+            image.levels.push_back({width, height, file.data() + offset});
+            offset += size;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        if (image.levels.empty())
+        {
+            std::cerr << "DDS: '" << path << "' is truncated" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool loadKtx2(const std::string &path, CompressedTexture::Image &image)
+    {
+        const MappedFile &file = image.file;
+        Ktx2Header header;
+        if (file.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+            return false;
+        if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+        {
+            std::cerr << "KTX2: '" << path << "' is not a 2D texture" << std::endl;
+            return false;
+        }
+        if (header.supercompressionScheme != 0)
+        {
+            std::cerr << "KTX2: '" << path << "' is supercompressed (Basis/zstd), which is not supported" << std::endl;
+            return false;
+        }
+        if (!formatFromVk(header.vkFormat, image.format, image.srgb))
+        {
+            std::cerr << "KTX2: unsupported format " << header.vkFormat << " in '" << path << "'" << std::endl;
+            return false;
+        }
+        if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelWidth > MAX_DIMENSION || header.pixelHeight > MAX_DIMENSION)
+        {
+            std::cerr << "KTX2: '" << path << "' has an invalid size of " << header.pixelWidth << "x" << header.pixelHeight << std::endl;
+            return false;
+        }
+
+        // levelCount 0 asks the loader to generate mips; we only use level 0
+        uint32_t levelCount = std::max(1u, header.levelCount);
+        if (file.size() < sizeof(header) + levelCount * sizeof(Ktx2Level))
+            return false;
+
+        int width = static_cast<int>(header.pixelWidth), height = static_cast<int>(header.pixelHeight);
+        for (uint32_t i = 0; i < levelCount; i++)
+        {
+            Ktx2Level level;
+            std::memcpy(&level, file.data() + sizeof(header) + i * sizeof(Ktx2Level), sizeof(level));
+            if (level.byteOffset + level.byteLength > file.size() || level.byteLength < compressedSize(image.format, width, height))
+            {
+                std::cerr << "KTX2: level " << i << " of '" << path << "' is truncated" << std::endl;
+                break;
+            }
+            image.levels.push_back({width, height, file.data() + level.byteOffset});
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return !image.levels.empty();
+    }
+}
+
+bool CompressedTexture::isCompressedFile(const std::string &path)
+{
+    std::string extension = lowerExtension(path);
+    return extension == ".dds" || extension == ".ktx2";
+}
+
+bool CompressedTexture::load(const std::string &path, Image &image)
+{
+    image.levels.clear();
+    if (!image.file.open(path))
+    {
+        std::cerr << "Error loading texture '" << path << "'" << std::endl;
+        return false;
+    }
+
+    bool loaded = lowerExtension(path) == ".ktx2" ? loadKtx2(path, image) : loadDds(path, image);
+    if (!loaded)
+    {
+        std::cerr << "Error loading texture '" << path << "'" << std::endl;
+        image.levels.clear();
+        image.file.close();
+    }
+    return loaded;
+}
+
+bool CompressedTexture::writeDds(const std::string &path, BlockFormat format, const std::vector<MipLevel> &levels, bool srgb)
+{
+    if (levels.empty())
+        return false;
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    header.width = static_cast<uint32_t>(levels[0].width);
+    header.height = static_cast<uint32_t>(levels[0].height);
+    header.pitchOrLinearSize = static_cast<uint32_t>(compressedSize(format, levels[0].width, levels[0].height));
+    header.caps = DDSCAPS_TEXTURE;
+    if (levels.size() > 1)
+    {
+        header.flags |= DDSD_MIPMAPCOUNT;
+        header.mipMapCount = static_cast<uint32_t>(levels.size());
+        header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+    header.pixelFormat.size = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+
+    // The legacy FourCCs have no sRGB variant; sRGB colour formats and BC7
+    // need the DX10 header
+    DdsHeaderDx10 dx10 = {};
+    dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    dx10.arraySize = 1;
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '1');
+        dx10.dxgiFormat = 72; // DXGI_FORMAT_BC1_UNORM_SRGB
+        break;
+    case BlockFormat::BC2:
+        header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '3');
+        dx10.dxgiFormat = 75;
+        break;
+    case BlockFormat::BC3:
+        header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '5');
+        dx10.dxgiFormat = 78;
+        break;
+    case BlockFormat::BC4:
+        header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '1');
+        srgb = false;
+        break;
+    case BlockFormat::BC5:
+        header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '2');
+        srgb = false;
+        break;
+    case BlockFormat::BC7:
+        dx10.dxgiFormat = srgb ? 99 : 98; // DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC7_UNORM
+        break;
+    }
+    const bool writeDx10 = srgb || format == BlockFormat::BC7;
+    if (writeDx10)
+        header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "DDS: unable to write '" << path << "'" << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (writeDx10)
+        out.write(reinterpret_cast<const char *>(&dx10), sizeof(dx10));
+    for (const MipLevel &level : levels)
+        out.write(reinterpret_cast<const char *>(level.pixels), static_cast<std::streamsize>(compressedSize(format, level.width, level.height)));
+    return static_cast<bool>(out);
+}
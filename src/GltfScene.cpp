@@ -0,0 +1,537 @@
+//-----------------------------------------------------------------------------
+// GltfScene.cpp
+//
+// Native glTF 2.0 (.gltf and .glb) path
+//-----------------------------------------------------------------------------
+#include "GltfScene.h"
+#include "Json.h"
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+namespace
+{
+    const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+    const int GLTF_MODE_TRIANGLES = 4;
+
+    // Node hierarchies deeper than this are treated as cyclic
+    const int MAX_NODE_DEPTH = 64;
+
+    uint32_t readU32(const unsigned char *data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    //-------------------------------------------------------------------------
+    // glTF component types use the GL enum values, so they map one to one
+    //-------------------------------------------------------------------------
+    size_t componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    int componentCount(const std::string &type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4")
+            return 4;
+        return 0;
+    }
+
+    bool decodeBase64(const char *text, size_t length, std::vector<unsigned char> &out)
+    {
+        auto value = [](char c) -> int
+        {
+            if (c >= 'A' && c <= 'Z')
+                return c - 'A';
+            if (c >= 'a' && c <= 'z')
+                return c - 'a' + 26;
+            if (c >= '0' && c <= '9')
+                return c - '0' + 52;
+            if (c == '+')
+                return 62;
+            if (c == '/')
+                return 63;
+            return -1;
+        };
+
+        out.clear();
+        out.reserve(length / 4 * 3);
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (size_t i = 0; i < length && text[i] != '='; i++)
+        {
+            int v = value(text[i]);
+            if (v < 0)
+                return false;
+            bits = (bits << 6) | static_cast<uint32_t>(v);
+            bitCount += 6;
+            if (bitCount >= 8)
+            {
+                bitCount -= 8;
+                out.push_back(static_cast<unsigned char>(bits >> bitCount));
+            }
+        }
+        return true;
+    }
+
+    glm::mat4 nodeTransform(const JsonValue &node)
+    {
+        const JsonValue *matrix = node.find("matrix");
+        if (matrix && matrix->size() == 16)
+        {
+            float values[16];
+            for (int i = 0; i < 16; i++)
+                values[i] = static_cast<float>((*matrix)[i].asNumber());
+            return glm::make_mat4(values); // column-major, like glTF
+        }
+
+        glm::mat4 transform(1.0f);
+        const JsonValue *translation = node.find("translation");
+        if (translation && translation->size() == 3)
+            transform = glm::translate(transform, glm::vec3((*translation)[0].asNumber(), (*translation)[1].asNumber(), (*translation)[2].asNumber()));
+        const JsonValue *rotation = node.find("rotation");
+        if (rotation && rotation->size() == 4)
+        {
+            glm::quat q(static_cast<float>((*rotation)[3].asNumber()), static_cast<float>((*rotation)[0].asNumber()),
+                        static_cast<float>((*rotation)[1].asNumber()), static_cast<float>((*rotation)[2].asNumber()));
+            transform *= glm::mat4_cast(q);
+        }
+        const JsonValue *scale = node.find("scale");
+        if (scale && scale->size() == 3)
+            transform = glm::scale(transform, glm::vec3((*scale)[0].asNumber(), (*scale)[1].asNumber(), (*scale)[2].asNumber()));
+        return transform;
+    }
+
+    std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+}
+
+GltfScene::GltfScene()
+    : mVertexCount(0), mTriangleCount(0), mStats()
+{
+}
+
+GltfScene::~GltfScene()
+{
+    for (Primitive &primitive : mPrimitives)
+        glDeleteVertexArrays(1, &primitive.vao);
+    for (Buffer &buffer : mBuffers)
+        glDeleteBuffers(1, &buffer.vbo);
+}
+
+//-----------------------------------------------------------------------------
+// Resolves every triangle primitive of every node instance to buffer
+// offsets. Only the JSON is parsed; the binary data is never touched.
+//-----------------------------------------------------------------------------
+bool GltfScene::load(const std::string &path)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (!mFile.open(path))
+        return false;
+
+    // A .glb holds the JSON and the first buffer as chunks of one file
+    const char *json = reinterpret_cast<const char *>(mFile.data());
+    size_t jsonLength = mFile.size();
+    const unsigned char *glbBuffer = nullptr;
+    size_t glbBufferSize = 0;
+    if (mFile.size() >= 12 && readU32(mFile.data()) == GLB_MAGIC)
+    {
+        if (readU32(mFile.data() + 4) != 2)
+        {
+            std::cerr << "glTF: '" << path << "' is not glTF 2.0" << std::endl;
+            return false;
+        }
+
+        size_t length = std::min<size_t>(readU32(mFile.data() + 8), mFile.size());
+        json = nullptr;
+        for (size_t offset = 12; offset + 8 <= length;)
+        {
+            size_t chunkLength = readU32(mFile.data() + offset);
+            uint32_t chunkType = readU32(mFile.data() + offset + 4);
+            const unsigned char *chunk = mFile.data() + offset + 8;
+            if (chunkLength > length - offset - 8)
+                break;
+            if (chunkType == GLB_CHUNK_JSON && json == nullptr)
+            {
+                json = reinterpret_cast<const char *>(chunk);
+                jsonLength = chunkLength;
+            }
+            else if (chunkType == GLB_CHUNK_BIN && glbBuffer == nullptr)
+            {
+                glbBuffer = chunk;
+                glbBufferSize = chunkLength;
+            }
+            offset += 8 + ((chunkLength + 3) & ~size_t(3));
+        }
+        if (json == nullptr)
+        {
+            std::cerr << "glTF: '" << path << "' has no JSON chunk" << std::endl;
+            return false;
+        }
+    }
+
+    JsonValue document;
+    std::string error;
+    if (!JsonValue::parse(json, jsonLength, document, error))
+    {
+        std::cerr << "glTF: '" << path << "': " << error << std::endl;
+        return false;
+    }
+
+    static const JsonValue EMPTY;
+    auto array = [&](const char *key) -> const JsonValue &
+    {
+        const JsonValue *value = document.find(key);
+        return value && value->isArray() ? *value : EMPTY;
+    };
+    const JsonValue &buffers = array("buffers");
+    const JsonValue &bufferViews = array("bufferViews");
+    const JsonValue &accessors = array("accessors");
+    const JsonValue &meshes = array("meshes");
+    const JsonValue &nodes = array("nodes");
+
+    // Buffers: the GLB chunk, an external file or an embedded data: URI
+    std::string directory = directoryOf(path);
+    mBuffers.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        Buffer &buffer = mBuffers[i];
+        const JsonValue *uri = buffers[i].find("uri");
+        size_t byteLength = static_cast<size_t>(buffers[i].number("byteLength"));
+        if (!uri)
+        {
+            if (i != 0 || glbBuffer == nullptr)
+                return false;
+            buffer.data = glbBuffer;
+            buffer.size = std::min(byteLength, glbBufferSize);
+        }
+        else if (uri->asString().compare(0, 5, "data:") == 0)
+        {
+            size_t comma = uri->asString().find(";base64,");
+            if (comma == std::string::npos ||
+                !decodeBase64(uri->asString().data() + comma + 8, uri->asString().size() - comma - 8, buffer.decoded))
+                return false;
+            buffer.data = buffer.decoded.data();
+            buffer.size = std::min(byteLength, buffer.decoded.size());
+        }
+        else
+        {
+            if (!buffer.file.open(directory + uri->asString()))
+            {
+                std::cerr << "glTF: unable to open buffer '" << uri->asString() << "'" << std::endl;
+                return false;
+            }
+            buffer.data = buffer.file.data();
+            buffer.size = std::min(byteLength, buffer.file.size());
+        }
+        buffer.uploadBegin = buffer.size;
+    }
+
+    // Resolves an accessor to a buffer range, validating it against the
+    // buffer view and the buffer
+    auto resolve = [&](const JsonValue *index, Attribute &attribute, size_t &count) -> bool
+    {
+        if (!index || !index->isNumber() || index->asNumber() < 0 || index->asNumber() >= accessors.size())
+            return false;
+        const JsonValue &accessor = accessors[static_cast<size_t>(index->asNumber())];
+        const JsonValue *viewIndex = accessor.find("bufferView");
+        if (accessor.find("sparse") || !viewIndex || viewIndex->asNumber() < 0 || viewIndex->asNumber() >= bufferViews.size())
+            return false; // zero-filled and sparse accessors need a CPU copy
+
+        const JsonValue &view = bufferViews[static_cast<size_t>(viewIndex->asNumber())];
+        size_t bufferIndex = static_cast<size_t>(view.number("buffer", -1));
+        if (bufferIndex >= mBuffers.size())
+            return false;
+
+        int componentType = static_cast<int>(accessor.number("componentType"));
+        const JsonValue *type = accessor.find("type");
+        size_t elementSize = componentSize(componentType) * (type ? componentCount(type->asString()) : 0);
+        count = static_cast<size_t>(accessor.number("count"));
+        if (elementSize == 0 || count == 0)
+            return false;
+
+        size_t viewOffset = static_cast<size_t>(view.number("byteOffset"));
+        size_t viewLength = static_cast<size_t>(view.number("byteLength"));
+        size_t stride = static_cast<size_t>(view.number("byteStride", static_cast<double>(elementSize)));
+        size_t offset = static_cast<size_t>(accessor.number("byteOffset"));
+        if (stride < elementSize || offset + stride * (count - 1) + elementSize > viewLength ||
+            viewOffset + viewLength > mBuffers[bufferIndex].size)
+            return false;
+
+        attribute.buffer = static_cast<int>(bufferIndex);
+        attribute.offset = viewOffset + offset;
+        attribute.components = componentCount(type->asString());
+        attribute.type = static_cast<GLenum>(componentType);
+        attribute.normalized = accessor.find("normalized") && accessor.find("normalized")->asBool();
+        attribute.stride = static_cast<GLsizei>(stride);
+
+        Buffer &buffer = mBuffers[bufferIndex];
+        buffer.uploadBegin = std::min(buffer.uploadBegin, attribute.offset);
+        buffer.uploadEnd = std::max(buffer.uploadEnd, attribute.offset + stride * (count - 1) + elementSize);
+        return true;
+    };
+
+    // One primitive entry per mesh instance in the node hierarchy
+    auto addMesh = [&](size_t meshIndex, const glm::mat4 &transform) -> bool
+    {
+        const JsonValue *primitives = meshes[meshIndex].find("primitives");
+        for (size_t p = 0; primitives && p < primitives->size(); p++)
+        {
+            const JsonValue &source = (*primitives)[p];
+            if (source.number("mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+                continue;
+
+            const JsonValue *attributes = source.find("attributes");
+            if (!attributes)
+                return false;
+
+            Primitive primitive;
+            primitive.transform = transform;
+            size_t vertexCount = 0, texCoordCount = 0, indexCount = 0;
+            if (!resolve(attributes->find("POSITION"), primitive.position, vertexCount))
+                return false;
+            const JsonValue *texCoord = attributes->find("TEXCOORD_0");
+            if (texCoord && (!resolve(texCoord, primitive.texCoord, texCoordCount) || texCoordCount < vertexCount))
+                return false;
+
+            const JsonValue *indices = source.find("indices");
+            if (indices)
+            {
+                Attribute index;
+                if (!resolve(indices, index, indexCount) || index.components != 1 || index.stride != static_cast<GLsizei>(componentSize(static_cast<int>(index.type))) ||
+                    index.type == GL_FLOAT || index.type == GL_BYTE || index.type == GL_SHORT || index.offset % componentSize(static_cast<int>(index.type)) != 0)
+                    return false;
+                primitive.indexBuffer = index.buffer;
+                primitive.indexOffset = index.offset;
+                primitive.indexType = index.type;
+                primitive.count = static_cast<GLsizei>(indexCount);
+            }
+            else
+            {
+                primitive.count = static_cast<GLsizei>(vertexCount);
+            }
+
+            // POSITION must carry min/max; transform the box's corners
+            const JsonValue &accessor = accessors[static_cast<size_t>(attributes->find("POSITION")->asNumber())];
+            const JsonValue *min = accessor.find("min");
+            const JsonValue *max = accessor.find("max");
+            if (min && max && min->size() == 3 && max->size() == 3)
+            {
+                primitive.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+                primitive.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    glm::vec4 point((*((corner & 1) ? max : min))[0].asNumber(), (*((corner & 2) ? max : min))[1].asNumber(),
+                                    (*((corner & 4) ? max : min))[2].asNumber(), 1.0f);
+                    glm::vec3 transformed(transform * point);
+                    primitive.boundsMin = glm::min(primitive.boundsMin, transformed);
+                    primitive.boundsMax = glm::max(primitive.boundsMax, transformed);
+                }
+                primitive.hasBounds = true;
+            }
+
+            mVertexCount += vertexCount;
+            mTriangleCount += primitive.count / 3;
+            mPrimitives.push_back(primitive);
+        }
+        return true;
+    };
+
+    auto visit = [&](size_t root) -> bool
+    {
+        std::vector<std::pair<std::pair<size_t, int>, glm::mat4>> stack = {{{root, 0}, glm::mat4(1.0f)}};
+        while (!stack.empty())
+        {
+            size_t nodeIndex = stack.back().first.first;
+            int depth = stack.back().first.second;
+            glm::mat4 parent = stack.back().second;
+            stack.pop_back();
+            if (nodeIndex >= nodes.size() || depth > MAX_NODE_DEPTH)
+                return false;
+
+            const JsonValue &node = nodes[nodeIndex];
+            glm::mat4 transform = parent * nodeTransform(node);
+            const JsonValue *mesh = node.find("mesh");
+            if (mesh && (mesh->asNumber(-1) < 0 || mesh->asNumber() >= meshes.size() || !addMesh(static_cast<size_t>(mesh->asNumber()), transform)))
+                return false;
+
+            const JsonValue *children = node.find("children");
+            for (size_t c = 0; children && c < children->size(); c++)
+                stack.push_back({{static_cast<size_t>((*children)[c].asNumber(-1)), depth + 1}, transform});
+        }
+        return true;
+    };
+
+    // The default scene's roots; without scenes every mesh once, untransformed
+    const JsonValue &scenes = array("scenes");
+    size_t sceneIndex = static_cast<size_t>(document.number("scene", 0));
+    if (sceneIndex < scenes.size())
+    {
+        const JsonValue *roots = scenes[sceneIndex].find("nodes");
+        for (size_t r = 0; roots && r < roots->size(); r++)
+        {
+            if (!visit(static_cast<size_t>((*roots)[r].asNumber(-1))))
+                return false;
+        }
+    }
+    else
+    {
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            if (!addMesh(m, glm::mat4(1.0f)))
+                return false;
+        }
+    }
+
+    // Index ranges widen the upload range of their buffer too
+    for (const Primitive &primitive : mPrimitives)
+    {
+        if (primitive.indexBuffer < 0)
+            continue;
+        Buffer &buffer = mBuffers[primitive.indexBuffer];
+        size_t indexBytes = static_cast<size_t>(primitive.count) * componentSize(static_cast<int>(primitive.indexType));
+        buffer.uploadBegin = std::min(buffer.uploadBegin, primitive.indexOffset);
+        buffer.uploadEnd = std::max(buffer.uploadEnd, primitive.indexOffset + indexBytes);
+    }
+
+    if (mPrimitives.empty())
+        return false;
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Model has been loaded correctly (native glTF, " << mVertexCount << " vertices, " << mTriangleCount
+              << " triangles, " << mPrimitives.size() << " primitives, " << elapsedMs << " ms)" << std::endl;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads the used range of every buffer as it is and builds the vertex
+// arrays over it. Vertex and index data may share a buffer object.
+//-----------------------------------------------------------------------------
+void GltfScene::upload()
+{
+    auto startTime = std::chrono::steady_clock::now();
+    size_t uploadedBytes = 0;
+    for (Buffer &buffer : mBuffers)
+    {
+        if (buffer.uploadEnd <= buffer.uploadBegin)
+            continue;
+
+        // Keep the offsets' alignment within the uploaded range
+        buffer.uploadBegin &= ~size_t(15);
+        glGenBuffers(1, &buffer.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(buffer.uploadEnd - buffer.uploadBegin), buffer.data + buffer.uploadBegin, GL_STATIC_DRAW);
+        uploadedBytes += buffer.uploadEnd - buffer.uploadBegin;
+    }
+
+    auto bindAttribute = [this](GLuint location, const Attribute &attribute)
+    {
+        if (attribute.buffer < 0)
+        {
+            glDisableVertexAttribArray(location);
+            glVertexAttrib2f(location, 0.0f, 0.0f);
+            return;
+        }
+        const Buffer &buffer = mBuffers[attribute.buffer];
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+                              attribute.stride, (GLvoid *)(uintptr_t)(attribute.offset - buffer.uploadBegin));
+    };
+
+    for (Primitive &primitive : mPrimitives)
+    {
+        glGenVertexArrays(1, &primitive.vao);
+        glBindVertexArray(primitive.vao);
+        bindAttribute(0, primitive.position);
+        bindAttribute(1, primitive.texCoord);
+        if (primitive.indexBuffer >= 0)
+        {
+            const Buffer &buffer = mBuffers[primitive.indexBuffer];
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.vbo);
+            primitive.indexOffset -= buffer.uploadBegin;
+        }
+    }
+    glBindVertexArray(0);
+
+    // Everything lives in the buffer objects now
+    for (Buffer &buffer : mBuffers)
+    {
+        buffer.file.close();
+        buffer.decoded = std::vector<unsigned char>();
+        buffer.data = nullptr;
+    }
+    mFile.close();
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "glTF upload: " << uploadedBytes / 1024 << " KB in " << elapsedMs << " ms" << std::endl;
+}
+
+void GltfScene::draw(ShaderProgram &shader, const glm::mat4 &model, const Meshlets::Frustum *frustum)
+{
+    mStats = Stats();
+    mStats.totalPrimitives = mPrimitives.size();
+    mStats.totalTriangles = mTriangleCount;
+
+    shader.setUniform("positionOffset", glm::vec3(0.0f));
+    shader.setUniform("positionScale", glm::vec3(1.0f));
+    shader.setUniform("texCoordOffset", glm::vec2(0.0f));
+    shader.setUniform("texCoordScale", glm::vec2(1.0f));
+
+    for (const Primitive &primitive : mPrimitives)
+    {
+        if (frustum && primitive.hasBounds)
+        {
+            glm::vec3 center = 0.5f * (primitive.boundsMin + primitive.boundsMax);
+            float radius = 0.5f * glm::length(primitive.boundsMax - primitive.boundsMin);
+            if (!Meshlets::isSphereVisible(*frustum, center, radius))
+                continue;
+        }
+
+        shader.setUniform("model", model * primitive.transform);
+        glBindVertexArray(primitive.vao);
+        if (primitive.indexBuffer >= 0)
+            glDrawElements(GL_TRIANGLES, primitive.count, primitive.indexType, (GLvoid *)(uintptr_t)primitive.indexOffset);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, primitive.count);
+
+        mStats.primitives++;
+        mStats.triangles += primitive.count / 3;
+    }
+
+    glBindVertexArray(0);
+    shader.setUniform("model", model);
+}
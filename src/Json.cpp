@@ -0,0 +1,311 @@
+//-----------------------------------------------------------------------------
+// Json.cpp
+//
+// Small read-only JSON document model
+//-----------------------------------------------------------------------------
+#include "Json.h"
+#include <cstdlib>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// Recursive descent parser over a length-delimited buffer. Nesting is
+// limited so a hostile file cannot exhaust the stack.
+//-----------------------------------------------------------------------------
+class JsonParser
+{
+public:
+    JsonParser(const char *text, size_t length)
+        : mText(text), mEnd(text + length), mCursor(text)
+    {
+    }
+
+    bool parseDocument(JsonValue &value, std::string &error)
+    {
+        bool ok = parseValue(value, 0);
+        skipWhitespace();
+        if (ok && mCursor != mEnd)
+            ok = fail("trailing characters");
+
+        if (!ok)
+            error = mError + " at offset " + std::to_string(mCursor - mText);
+        return ok;
+    }
+
+private:
+    static const int MAX_DEPTH = 128;
+
+    bool fail(const char *message)
+    {
+        if (mError.empty())
+            mError = message;
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (mCursor < mEnd && (*mCursor == ' ' || *mCursor == '\t' || *mCursor == '\n' || *mCursor == '\r'))
+            mCursor++;
+    }
+
+    bool consume(const char *literal)
+    {
+        size_t length = std::strlen(literal);
+        if (static_cast<size_t>(mEnd - mCursor) < length || std::memcmp(mCursor, literal, length) != 0)
+            return false;
+        mCursor += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return fail("nesting too deep");
+
+        skipWhitespace();
+        if (mCursor == mEnd)
+            return fail("unexpected end");
+
+        switch (*mCursor)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.mType = JsonValue::Type::String;
+            return parseString(value.mString);
+        case 't':
+            value.mType = JsonValue::Type::Bool;
+            value.mBool = true;
+            return consume("true") || fail("invalid literal");
+        case 'f':
+            value.mType = JsonValue::Type::Bool;
+            value.mBool = false;
+            return consume("false") || fail("invalid literal");
+        case 'n':
+            value.mType = JsonValue::Type::Null;
+            return consume("null") || fail("invalid literal");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue &value, int depth)
+    {
+        value.mType = JsonValue::Type::Object;
+        mCursor++; // {
+        skipWhitespace();
+        if (mCursor < mEnd && *mCursor == '}')
+        {
+            mCursor++;
+            return true;
+        }
+
+        while (true)
+        {
+            skipWhitespace();
+            std::pair<std::string, JsonValue> member;
+            if (mCursor == mEnd || *mCursor != '"' || !parseString(member.first))
+                return fail("expected member name");
+
+            skipWhitespace();
+            if (mCursor == mEnd || *mCursor++ != ':')
+                return fail("expected ':'");
+            if (!parseValue(member.second, depth + 1))
+                return false;
+            value.mObject.push_back(std::move(member));
+
+            skipWhitespace();
+            if (mCursor == mEnd)
+                return fail("unexpected end");
+            char c = *mCursor++;
+            if (c == '}')
+                return true;
+            if (c != ',')
+                return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parseArray(JsonValue &value, int depth)
+    {
+        value.mType = JsonValue::Type::Array;
+        mCursor++; // [
+        skipWhitespace();
+        if (mCursor < mEnd && *mCursor == ']')
+        {
+            mCursor++;
+            return true;
+        }
+
+        while (true)
+        {
+            value.mArray.emplace_back();
+            if (!parseValue(value.mArray.back(), depth + 1))
+                return false;
+
+            skipWhitespace();
+            if (mCursor == mEnd)
+                return fail("unexpected end");
+            char c = *mCursor++;
+            if (c == ']')
+                return true;
+            if (c != ',')
+                return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parseNumber(JsonValue &value)
+    {
+        // strtod needs a terminated string; numbers are short
+        char buffer[64];
+        size_t length = 0;
+        while (mCursor + length < mEnd && length < sizeof(buffer) - 1 && std::strchr("+-0123456789.eE", mCursor[length]))
+            length++;
+        if (length == 0)
+            return fail("unexpected character");
+
+        std::memcpy(buffer, mCursor, length);
+        buffer[length] = '\0';
+        char *end = nullptr;
+        value.mType = JsonValue::Type::Number;
+        value.mNumber = std::strtod(buffer, &end);
+        if (end != buffer + length)
+            return fail("invalid number");
+        mCursor += length;
+        return true;
+    }
+
+    static void appendUtf8(std::string &out, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+            out += static_cast<char>(codePoint);
+        else if (codePoint < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (codePoint >> 18));
+            out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned int &value)
+    {
+        if (mEnd - mCursor < 4)
+            return false;
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *mCursor++;
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string &out)
+    {
+        mCursor++; // "
+        while (mCursor < mEnd)
+        {
+            char c = *mCursor++;
+            if (c == '"')
+                return true;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if (mCursor == mEnd)
+                break;
+            char escape = *mCursor++;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += escape;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                unsigned int codePoint;
+                if (!parseHex4(codePoint))
+                    return fail("invalid \\u escape");
+                if (codePoint >= 0xD800 && codePoint < 0xDC00)
+                {
+                    unsigned int low;
+                    if (!consume("\\u") || !parseHex4(low) || low < 0xDC00 || low >= 0xE000)
+                        return fail("invalid surrogate pair");
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    const char *mText;
+    const char *mEnd;
+    const char *mCursor;
+    std::string mError;
+};
+
+bool JsonValue::parse(const char *text, size_t length, JsonValue &value, std::string &error)
+{
+    value = JsonValue();
+    JsonParser parser(text, length);
+    return parser.parseDocument(value, error);
+}
+
+const JsonValue *JsonValue::find(const char *key) const
+{
+    for (const auto &member : mObject)
+    {
+        if (member.first == key)
+            return &member.second;
+    }
+    return nullptr;
+}
+
+double JsonValue::number(const char *key, double fallback) const
+{
+    const JsonValue *value = find(key);
+    return value ? value->asNumber(fallback) : fallback;
+}
@@ -0,0 +1,146 @@
+//-----------------------------------------------------------------------------
+// MappedFile.cpp
+//
+// Read-only memory mapped file
+//-----------------------------------------------------------------------------
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mData(nullptr), mSize(0)
+#ifdef _WIN32
+      ,
+      mFileHandle(nullptr), mMappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&rhs) noexcept
+    : MappedFile()
+{
+    *this = std::move(rhs);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        close();
+        std::swap(mData, rhs.mData);
+        std::swap(mSize, rhs.mSize);
+#ifdef _WIN32
+        std::swap(mFileHandle, rhs.mFileHandle);
+        std::swap(mMappingHandle, rhs.mMappingHandle);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &fileName)
+{
+    close();
+
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mData = static_cast<const unsigned char *>(view);
+    mSize = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData)
+        UnmapViewOfFile(mData);
+    if (mMappingHandle)
+        CloseHandle(mMappingHandle);
+    if (mFileHandle)
+        CloseHandle(mFileHandle);
+
+    mData = nullptr;
+    mSize = 0;
+    mFileHandle = nullptr;
+    mMappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (view == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const unsigned char *>(view);
+    mSize = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData)
+        munmap(const_cast<unsigned char *>(mData), mSize);
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+#endif
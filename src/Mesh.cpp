@@ -5,34 +5,550 @@
 // Basic Mesh class
 //-----------------------------------------------------------------------------
 #include "Mesh.h"
+#include "ShaderProgram.h"
+#include "ObjLoader.h"
+#include "StlLoader.h"
+#include "PlyLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "VertexWelder.h"
+#include "MeshSimplifier.h"
+#include "MeshOctree.h"
+#include "ChunkPager.h"
+#include "GltfScene.h"
+#include "PointCloud.h"
+#include "TextureArray.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/ProgressHandler.hpp>
 
 Mesh::Mesh()
-    : mLoaded(false), mVAO(0), mVBO(0), mEBO(0)
+    : mLoaded(false), mImported(false), mVertexReport(), mHasView(false), mFrustumCulling(true), mBackfaceCulling(false),
+      mFrustum(), mModel(1.0f), mCameraPosition(0.0f), mFovY(0.0f), mViewportHeight(0), mMaxPixelError(0.0f), mStats(),
+      mMaterialTextures(nullptr), mUploadSpan(0), mUploadOffset(0), mUploadedBytes(0), mUploadTotalBytes(0), mUploadVertices(nullptr), mUploadIndices(nullptr),
+      mVAO(0), mVBO(0), mEBO(0)
 {
 }
 
 Mesh::~Mesh()
 {
+    // A mesh that was only imported (e.g. by miraconvert) has no GL objects
+    // and may not even have a context to delete them from
+    if (mVAO == 0)
+        return;
     glDeleteVertexArrays(1, &mVAO);
     glDeleteBuffers(1, &mVBO);
     glDeleteBuffers(1, &mEBO);
 }
 
-void Mesh::loadModel(const std::string &path)
+namespace
+{
+    // Resident level of a group none of whose levels is complete yet
+    const unsigned int NOT_RESIDENT = std::numeric_limits<unsigned int>::max();
+
+    // Bytes per glBufferSubData call of a streamed upload
+    const size_t UPLOAD_CHUNK_SIZE = 1 << 20;
+
+    //-------------------------------------------------------------------------
+    // Returns the lower case extension of path including the dot, e.g. ".obj"
+    //-------------------------------------------------------------------------
+    std::string fileExtension(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+            return std::string();
+
+        std::string extension = path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    //-------------------------------------------------------------------------
+    // Forwards Assimp's progress to a LoadProgress and aborts on cancel
+    //-------------------------------------------------------------------------
+    class AssimpProgress : public Assimp::ProgressHandler
+    {
+    public:
+        explicit AssimpProgress(LoadProgress *progress)
+            : mProgress(progress)
+        {
+        }
+
+        bool Update(float percentage) override
+        {
+            if (percentage >= 0.0f)
+                mProgress->fraction = percentage;
+            return !mProgress->isCancelled();
+        }
+
+    private:
+        LoadProgress *mProgress;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Loads a model from disk and uploads it on the calling (GL) thread
+//-----------------------------------------------------------------------------
+void Mesh::loadModel(const std::string &path, const ImportOptions &options)
+{
+    if (import(path, nullptr, options))
+        upload();
+}
+
+//-----------------------------------------------------------------------------
+// Reads a model into CPU memory. A valid .mvmesh cache entry is only mapped.
+// Otherwise OBJ, binary STL and binary PLY files go through the native
+// multi-threaded readers; everything else (and any file they reject) is
+// imported through Assimp, and the result is optimized for the GPU and
+// written back to the cache. Point sets are sorted into a PointCloud
+// instead and are not cached.
+// glTF files are only mapped (see GltfScene), and octrees only opened.
+//-----------------------------------------------------------------------------
+bool Mesh::import(const std::string &path, LoadProgress *progress, const ImportOptions &options)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::string extension = fileExtension(path);
+    if (extension == ".mvoct")
+    {
+        if (!openOctree(path))
+        {
+            std::cerr << "Mesh octree: unable to open '" << path << "'" << std::endl;
+            return false;
+        }
+        mImported = true;
+        return true;
+    }
+
+    // glTF buffers are GPU-ready and go straight to GL. Out-of-core import
+    // needs the float vertices, so it takes the Assimp route.
+    if ((extension == ".gltf" || extension == ".glb") && !options.outOfCore)
+    {
+        if (progress)
+            progress->report("Reading glTF", 0.0f);
+
+        std::unique_ptr<GltfScene> gltf(new GltfScene());
+        if (gltf->load(path))
+        {
+            mGltf = std::move(gltf);
+            mImported = true;
+            return true;
+        }
+        std::cout << "Falling back to Assimp for '" << path << "'" << std::endl;
+    }
+
+    // An out-of-core model built before is paged from its octree right away
+    std::string octreePath;
+    uint64_t sourceStamp = 0;
+    if (options.outOfCore)
+    {
+        octreePath = MeshCache::derivedPath(path, ".mvoct");
+        sourceStamp = MeshOctree::sourceStamp(path);
+        if (!octreePath.empty() && openOctree(octreePath))
+        {
+            const MeshOctree::Reader &octree = mPager->getOctree();
+            if (octree.getSourceStamp() == sourceStamp && octree.getOptionsHash() == options.hash())
+            {
+                MeshCache::touch(octreePath);
+                mImported = true;
+                return true;
+            }
+            mPager.reset();
+        }
+    }
+
+    if (progress)
+        progress->report("Checking mesh cache", 0.0f);
+
+    if (MeshCache::load(path, options.hash(), mCached))
+    {
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "Model has been loaded correctly (mesh cache, " << mCached.vertexCount << " vertices, "
+                  << mCached.indexCount / 3 << " triangles, " << mCached.subMeshCount << " sub-meshes, "
+                  << elapsedMs << " ms)" << std::endl;
+        mVertexFormat = mCached.vertexFormat;
+        mVertexReport = mCached.vertexReport;
+        mImported = true;
+        return true;
+    }
+
+    const char *loaderName = "Assimp";
+    bool (*nativeLoader)(const std::string &, MeshData &, LoadProgress *) = nullptr;
+    if (extension == ".obj")
+    {
+        nativeLoader = ObjLoader::load;
+        loaderName = "native OBJ";
+    }
+    else if (extension == ".stl")
+    {
+        nativeLoader = StlLoader::load;
+        loaderName = "native STL";
+    }
+    else if (extension == ".ply")
+    {
+        nativeLoader = PlyLoader::load;
+        loaderName = "native PLY";
+    }
+
+    bool imported = false;
+    if (nativeLoader)
+    {
+        imported = nativeLoader(path, mData, progress);
+        if (!imported)
+        {
+            loaderName = "Assimp";
+            if (!(progress && progress->isCancelled()))
+                std::cout << "Falling back to Assimp for '" << path << "'" << std::endl;
+        }
+    }
+
+    if (progress && progress->isCancelled())
+        return false;
+
+    if (!imported && !loadWithAssimp(path, progress))
+        return false;
+
+    if (mData.indices.size() % 3 != 0)
+    {
+        std::cout << "Warning: Index count is not a multiple of 3!" << std::endl;
+    }
+
+    // Only the native PLY reader produces vertices without any indices
+    const bool pointSet = mData.indices.empty();
+    if (mData.vertices.empty() || mData.subMeshes.empty() || (pointSet && !imported))
+    {
+        std::cerr << "ERROR::MESH::NO_VERTICES_OR_INDICES" << std::endl;
+        return false;
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Model has been loaded correctly (" << loaderName << ", " << mData.vertices.size() << " vertices, "
+              << mData.indices.size() / 3 << " triangles, " << mData.subMeshes.size() << " sub-meshes, "
+              << elapsedMs << " ms)" << std::endl;
+
+    // Every imported sub-mesh starts as LOD 0 of its own group
+    for (size_t i = 0; i < mData.subMeshes.size(); i++)
+    {
+        mData.subMeshes[i].group = static_cast<unsigned int>(i);
+        mData.subMeshes[i].lod = 0;
+        mData.subMeshes[i].lodError = 0.0f;
+    }
+
+    // The triangle stages (and the mesh octree) do not apply to points
+    if (pointSet)
+    {
+        if (options.outOfCore)
+            std::cout << "Point sets are not paged; loading '" << path << "' in core" << std::endl;
+        if (progress)
+            progress->report("Building point octree", 1.0f);
+
+        auto octreeStart = std::chrono::steady_clock::now();
+        std::unique_ptr<PointCloud> pointCloud(new PointCloud());
+        pointCloud->build(mData, options.vertexFormat, mVertexReport);
+        mVertexFormat = options.vertexFormat;
+        double octreeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - octreeStart).count();
+        std::cout << "Point octree: " << pointCloud->getPointCount() << " points in " << pointCloud->getNodeCount()
+                  << " nodes (" << octreeMs << " ms)" << std::endl;
+
+        mPointCloud = std::move(pointCloud);
+        mImported = true;
+        return true;
+    }
+
+    if (options.weldVertices)
+    {
+        if (progress)
+            progress->report("Welding vertices", 1.0f);
+
+        auto weldStart = std::chrono::steady_clock::now();
+        size_t vertexCount = mData.vertices.size();
+        size_t removed = VertexWelder::weld(mData, std::max(0.0f, options.weldEpsilon));
+        double weldMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - weldStart).count();
+        std::cout << "Vertex weld: " << vertexCount << " -> " << vertexCount - removed << " vertices ("
+                  << weldMs << " ms)" << std::endl;
+    }
+
+    if (options.optimizeVertexCache)
+    {
+        if (progress)
+            progress->report("Optimizing mesh", 1.0f);
+
+        auto optimizeStart = std::chrono::steady_clock::now();
+        float acmrBefore = MeshOptimizer::computeACMR(mData);
+        MeshOptimizer::optimize(mData);
+        float acmrAfter = MeshOptimizer::computeACMR(mData);
+        double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimizeStart).count();
+        std::cout << "Vertex cache: ACMR " << acmrBefore << " -> " << acmrAfter << " (cache size "
+                  << MeshOptimizer::CACHE_SIZE << ", " << optimizeMs << " ms)" << std::endl;
+    }
+
+    if (options.outOfCore)
+    {
+        if (progress)
+            progress->report("Building octree", 1.0f);
+
+        auto octreeStart = std::chrono::steady_clock::now();
+        bool built = MeshOctree::build(mData, options.vertexFormat, sourceStamp, options.hash(), octreePath);
+        double octreeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - octreeStart).count();
+        mData.clear();
+        if (!built || !openOctree(octreePath))
+        {
+            std::cerr << "Mesh octree: unable to build '" << octreePath << "'" << std::endl;
+            return false;
+        }
+        std::cout << "Mesh octree: built in " << octreeMs << " ms" << std::endl;
+        MeshCache::trim(); // the pager has the octree open
+
+        mImported = true;
+        return true;
+    }
+
+    if (options.generateLods)
+    {
+        if (progress)
+            progress->report("Generating LODs", 1.0f);
+
+        auto lodStart = std::chrono::steady_clock::now();
+        size_t lod0Count = mData.subMeshes.size();
+        MeshSimplifier::buildLods(mData);
+        if (options.progressive)
+            MeshSimplifier::orderVerticesByLod(mData);
+        double lodMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lodStart).count();
+        logLodChain(lod0Count, lodMs);
+    }
+
+    if (progress)
+        progress->report("Packing vertices", 1.0f);
+    packVertices(mData, options.vertexFormat, mVertexReport);
+    mVertexFormat = options.vertexFormat;
+
+    if (progress)
+        progress->report("Packing indices", 1.0f);
+    packIndices(mData);
+
+    if (progress)
+        progress->report("Building meshlets", 1.0f);
+    Meshlets::build(mData);
+
+    if (progress)
+        progress->report("Writing mesh cache", 1.0f);
+    MeshCache::store(path, options.hash(), mData, mVertexReport);
+
+    mImported = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Creates the GL buffers for an imported model and starts streaming into
+// them. The CPU copy, or the mapped cache entry, is released as soon as its
+// contents are all in the buffers.
+//-----------------------------------------------------------------------------
+void Mesh::upload(double budgetMs)
+{
+    if (!mImported || mLoaded)
+        return;
+
+    if (mPager)
+    {
+        mLoaded = true; // chunks are uploaded as draw() needs them
+        return;
+    }
+    if (mGltf)
+    {
+        mGltf->upload();
+        mLoaded = true;
+        return;
+    }
+    if (mPointCloud)
+    {
+        logVertexFormat();
+        mLoaded = true; // nodes are uploaded as draw() needs them
+        return;
+    }
+
+    size_t vertexBufferSize, indexBufferSize;
+    if (mCached.file.isOpen())
+    {
+        mSubMeshes.assign(mCached.subMeshes, mCached.subMeshes + mCached.subMeshCount);
+        mMeshlets.assign(mCached.meshlets, mCached.meshlets + mCached.meshletCount);
+        mUploadVertices = mCached.vertexBuffer;
+        mUploadIndices = mCached.indexBuffer;
+        vertexBufferSize = mCached.vertexBufferSize;
+        indexBufferSize = mCached.indexBufferSize;
+    }
+    else
+    {
+        mSubMeshes = mData.subMeshes;
+        mMeshlets = mData.meshlets;
+        mUploadVertices = mData.vertexBuffer.data();
+        mUploadIndices = mData.indexBuffer.data();
+        vertexBufferSize = mData.vertexBuffer.size();
+        indexBufferSize = mData.indexBuffer.size();
+    }
+    initBuffers(vertexBufferSize, indexBufferSize);
+
+    logVertexFormat();
+    logIndexSummary();
+
+    mSubMeshVisible.assign(mSubMeshes.size(), 1);
+
+    unsigned int groupCount = 0;
+    for (const SubMesh &subMesh : mSubMeshes)
+        groupCount = std::max(groupCount, subMesh.group + 1);
+    mSelectedLod.assign(groupCount, 0);
+    mResidentLod.assign(groupCount, NOT_RESIDENT);
+    mLoaded = true;
+
+    planUpload();
+    streamUpload(budgetMs);
+}
+
+//-----------------------------------------------------------------------------
+// Orders the buffer data for a coarse to fine upload. Each (level, group)
+// step needs the level's index ranges and the part of the group's vertex
+// range it reaches that earlier steps did not upload. With the vertices
+// numbered by orderVerticesByLod those parts are short for coarse levels;
+// without it the first step of a group brings all of its vertices.
+//-----------------------------------------------------------------------------
+void Mesh::planUpload()
+{
+    const size_t stride = vertexLayout(mVertexFormat).stride;
+    const unsigned int groupCount = static_cast<unsigned int>(mResidentLod.size());
+
+    unsigned int maxLod = 0;
+    std::vector<size_t> uploadedEnd(groupCount, std::numeric_limits<size_t>::max()); // in vertices
+    for (const SubMesh &subMesh : mSubMeshes)
+    {
+        maxLod = std::max(maxLod, subMesh.lod);
+        uploadedEnd[subMesh.group] = std::min<size_t>(uploadedEnd[subMesh.group], subMesh.baseVertex);
+    }
+
+    mUploadSpans.clear();
+    mUploadSpan = 0;
+    mUploadOffset = 0;
+    mUploadedBytes = 0;
+    mUploadTotalBytes = 0;
+    for (unsigned int lod = maxLod + 1; lod-- > 0;)
+    {
+        for (unsigned int group = 0; group < groupCount; group++)
+        {
+            size_t first = mUploadSpans.size();
+            size_t vertexEnd = 0;
+            for (const SubMesh &subMesh : mSubMeshes)
+            {
+                if (subMesh.group != group || subMesh.lod != lod || subMesh.indexCount == 0)
+                    continue;
+                vertexEnd = std::max<size_t>(vertexEnd, static_cast<size_t>(subMesh.baseVertex) + subMesh.vertexCount);
+
+                size_t begin = subMesh.indexBufferOffset;
+                size_t end = begin + static_cast<size_t>(subMesh.indexCount) * subMesh.indexSize;
+                if (mUploadSpans.size() > first && mUploadSpans.back().end == begin)
+                    mUploadSpans.back().end = end;
+                else
+                    mUploadSpans.push_back({GL_ELEMENT_ARRAY_BUFFER, begin, end, group, lod, false});
+            }
+            if (mUploadSpans.size() == first)
+                continue;
+
+            if (vertexEnd > uploadedEnd[group])
+            {
+                mUploadSpans.insert(mUploadSpans.begin() + first,
+                                    {GL_ARRAY_BUFFER, uploadedEnd[group] * stride, vertexEnd * stride, group, lod, false});
+                uploadedEnd[group] = vertexEnd;
+            }
+            mUploadSpans.back().completesLevel = true;
+        }
+    }
+
+    for (const UploadSpan &span : mUploadSpans)
+        mUploadTotalBytes += span.end - span.begin;
+}
+
+//-----------------------------------------------------------------------------
+// Copies the next spans into the GL buffers in chunks until budgetMs is
+// spent. At least one chunk goes per call, so the upload always advances.
+// Releases the CPU copy (or the mapped cache file) once everything is in.
+//-----------------------------------------------------------------------------
+bool Mesh::streamUpload(double budgetMs)
+{
+    if (!mLoaded)
+        return false;
+    if (mPager || mGltf || mPointCloud || mUploadSpan >= mUploadSpans.size())
+        return true;
+
+    auto start = std::chrono::steady_clock::now();
+    glBindVertexArray(mVAO); // GL_ELEMENT_ARRAY_BUFFER binds to the VAO
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    do
+    {
+        const UploadSpan &span = mUploadSpans[mUploadSpan];
+        const unsigned char *source = span.target == GL_ARRAY_BUFFER ? mUploadVertices : mUploadIndices;
+        size_t offset = span.begin + mUploadOffset;
+        size_t size = std::min(UPLOAD_CHUNK_SIZE, span.end - offset);
+        glBufferSubData(span.target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), source + offset);
+        mUploadOffset += size;
+        mUploadedBytes += size;
+
+        if (span.begin + mUploadOffset == span.end)
+        {
+            if (span.completesLevel)
+                mResidentLod[span.group] = span.lod;
+            mUploadSpan++;
+            mUploadOffset = 0;
+        }
+    } while (mUploadSpan < mUploadSpans.size() &&
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs);
+    glBindVertexArray(0);
+
+    if (mUploadSpan < mUploadSpans.size())
+        return false;
+
+    mUploadSpans.clear();
+    mUploadVertices = nullptr;
+    mUploadIndices = nullptr;
+    mCached = MeshCache::Entry();
+    mData.clear();
+    return true;
+}
+
+float Mesh::getUploadProgress() const
+{
+    if (!mLoaded)
+        return 0.0f;
+    if (mUploadTotalBytes == 0)
+        return 1.0f;
+    return static_cast<float>(static_cast<double>(mUploadedBytes) / mUploadTotalBytes);
+}
+
+//-----------------------------------------------------------------------------
+// Imports any format Assimp understands into mData, one sub-mesh per aiMesh
+//-----------------------------------------------------------------------------
+bool Mesh::loadWithAssimp(const std::string &path, LoadProgress *progress)
 {
     Assimp::Importer importer;
+    if (progress)
+    {
+        progress->report("Importing with Assimp", 0.0f);
+        importer.SetProgressHandler(new AssimpProgress(progress)); // the importer takes ownership
+    }
+
     const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-        return;
+        return false;
     }
 
     std::cout << "Number of meshes: " << scene->mNumMeshes << std::endl;
@@ -40,14 +556,21 @@ void Mesh::loadModel(const std::string &path)
     {
         aiMesh *mesh = scene->mMeshes[i];
 
-        size_t vertexOffset = mVertices.size(); // Keep track of base vertex index
+        SubMesh subMesh = {};
+        subMesh.indexOffset = static_cast<unsigned int>(mData.indices.size());
+        subMesh.baseVertex = static_cast<unsigned int>(mData.vertices.size());
+        subMesh.vertexCount = mesh->mNumVertices;
+        subMesh.materialIndex = mesh->mMaterialIndex;
 
         std::cout << "Mesh[" << i << "] Vertices: " << mesh->mNumVertices
                   << " Faces: " << mesh->mNumFaces << std::endl;
 
+        mData.vertices.reserve(mData.vertices.size() + mesh->mNumVertices);
+        mData.indices.reserve(mData.indices.size() + mesh->mNumFaces * 3);
+
         for (unsigned int j = 0; j < mesh->mNumVertices; j++)
         {
-            Vertex aVertex;
+            Vertex aVertex = {};
 
             aiVector3D vertex = mesh->mVertices[j];
             aVertex.position = glm::vec3(vertex.x, vertex.y, vertex.z);
@@ -58,7 +581,7 @@ void Mesh::loadModel(const std::string &path)
                 aVertex.texCoords = glm::vec2(texCoord.x, texCoord.y);
             }
 
-            mVertices.push_back(aVertex);
+            mData.vertices.push_back(aVertex);
         }
 
         for (unsigned int j = 0; j < mesh->mNumFaces; j++)
@@ -72,38 +595,32 @@ void Mesh::loadModel(const std::string &path)
             }
             for (unsigned int k = 0; k < face.mNumIndices; k++)
             {
-                unsigned int index = face.mIndices[k] + vertexOffset;
-                if (index >= mVertices.size())
+                // Indices stay relative to the sub-mesh, drawn with its base vertex
+                unsigned int index = face.mIndices[k];
+                if (index >= mesh->mNumVertices)
                 {
                     std::cout << "Warning: Invalid index " << index << " at face " << j << std::endl;
                     continue;
                 }
-                mIndices.push_back(index);
+                mData.indices.push_back(index);
             }
         }
-    }
 
-    if (mIndices.size() % 3 != 0)
-    {
-        std::cout << "Warning: Index count is not a multiple of 3!" << std::endl;
+        subMesh.indexCount = static_cast<unsigned int>(mData.indices.size()) - subMesh.indexOffset;
+        if (subMesh.indexCount > 0)
+            mData.subMeshes.push_back(subMesh);
     }
 
-    if (mVertices.empty() || mIndices.empty())
-    {
-        std::cerr << "ERROR::MESH::NO_VERTICES_OR_INDICES" << std::endl;
-        return;
-    }
-
-    std::cout << "Model has been loaded correctly" << std::endl;
-    mLoaded = true;
-    initBuffers();
+    computeSubMeshBounds(mData);
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 // Create and initialize the vertex buffer and vertex array object
-// Must have valid, non-empty std::vector of Vertex objects.
+// Allocates the buffers uninitialized; streamUpload() fills them. The
+// attribute pointers follow the layout of mVertexFormat.
 //-----------------------------------------------------------------------------
-void Mesh::initBuffers()
+void Mesh::initBuffers(size_t vertexBufferSize, size_t indexBufferSize)
 {
     glGenVertexArrays(1, &mVAO);
     glGenBuffers(1, &mVBO);
@@ -111,34 +628,436 @@ void Mesh::initBuffers()
 
     glBindVertexArray(mVAO);
     glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, nullptr, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned int), &mIndices[0], GL_STATIC_DRAW);
-
-    // Vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)0);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, nullptr, GL_STATIC_DRAW);
 
-    // Vertex Texture Coords
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)(3 * sizeof(GLfloat)));
+    setVertexAttributes(mVertexFormat);
 
     // unbind to make sure other code does not change it somewhere else
     glBindVertexArray(0);
 }
 
-void Mesh::draw()
+void setVertexAttributes(const VertexFormat &format)
+{
+    // Vertex Positions (location 0) and Texture Coords (location 1)
+    VertexLayout layout = vertexLayout(format);
+    for (GLuint location = 0; location < VERTEX_ATTRIBUTE_COUNT; location++)
+    {
+        const VertexAttributeLayout &attribute = layout.attributes[location];
+        GLenum type = GL_FLOAT;
+        if (attribute.type == AttributeType::HalfFloat)
+            type = GL_HALF_FLOAT;
+        else if (attribute.type == AttributeType::UnsignedShort)
+            type = GL_UNSIGNED_SHORT;
+
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, static_cast<GLint>(attribute.components), type, attribute.normalized ? GL_TRUE : GL_FALSE,
+                              static_cast<GLsizei>(layout.stride), (GLvoid *)(uintptr_t)attribute.offset);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Opens an octree and pages from it instead of the shared buffers
+//-----------------------------------------------------------------------------
+bool Mesh::openOctree(const std::string &path)
+{
+    std::unique_ptr<ChunkPager> pager(new ChunkPager());
+    if (!pager->open(path))
+        return false;
+
+    mVertexFormat = pager->getOctree().getVertexFormat();
+    mPager = std::move(pager);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Reports how much index memory the per-range index widths saved
+//-----------------------------------------------------------------------------
+void Mesh::logIndexSummary() const
+{
+    size_t shortRanges = 0;
+    uint64_t indexCount = 0;
+    uint64_t packedBytes = 0;
+    for (const SubMesh &subMesh : mSubMeshes)
+    {
+        if (subMesh.indexSize == 2)
+            shortRanges++;
+        indexCount += subMesh.indexCount;
+        packedBytes += static_cast<uint64_t>(subMesh.indexCount) * subMesh.indexSize;
+    }
+
+    uint64_t fullBytes = indexCount * sizeof(GLuint);
+    std::cout << "Index buffer: " << shortRanges << " of " << mSubMeshes.size() << " draw ranges 16-bit, "
+              << packedBytes / 1024 << " KB instead of " << fullBytes / 1024 << " KB (saved "
+              << (fullBytes - packedBytes) / 1024 << " KB), " << mMeshlets.size() << " meshlets" << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Reports the triangles and error of every generated level of detail
+//-----------------------------------------------------------------------------
+void Mesh::logLodChain(size_t lod0Count, double elapsedMs) const
+{
+    std::vector<uint64_t> triangles(MeshSimplifier::MAX_LOD + 1, 0);
+    std::vector<float> errors(MeshSimplifier::MAX_LOD + 1, 0.0f);
+    for (const SubMesh &subMesh : mData.subMeshes)
+    {
+        triangles[subMesh.lod] += subMesh.indexCount / 3;
+        errors[subMesh.lod] = std::max(errors[subMesh.lod], subMesh.lodError);
+    }
+
+    std::cout << "LOD chain (" << mData.subMeshes.size() - lod0Count << " ranges, " << elapsedMs << " ms):";
+    for (unsigned int lod = 0; lod <= MeshSimplifier::MAX_LOD && triangles[lod] > 0; lod++)
+        std::cout << " LOD" << lod << " " << triangles[lod] << " triangles (error " << errors[lod] << ")";
+    std::cout << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Reports the vertex format, the memory it saved and the precision it cost
+//-----------------------------------------------------------------------------
+void Mesh::logVertexFormat() const
+{
+    const VertexFormatReport &report = mVertexReport;
+    std::cout << "Vertex format: positions " << positionFormatName(mVertexFormat.position) << ", texture coords "
+              << texCoordFormatName(mVertexFormat.texCoord) << ", " << report.stride << " bytes per vertex instead of "
+              << report.sourceStride << "; max position error " << report.maxPositionError << " ("
+              << report.relativePositionError * 100.0f << "% of the bounds), max texture coord error "
+              << report.maxTexCoordError << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Vertex layout of the uploaded buffers and the precision lost packing them
+//-----------------------------------------------------------------------------
+const VertexFormat &Mesh::getVertexFormat() const
+{
+    return mVertexFormat;
+}
+
+const VertexFormatReport &Mesh::getVertexFormatReport() const
+{
+    return mVertexReport;
+}
+
+//-----------------------------------------------------------------------------
+// Number of sub-meshes and their ranges, available once the mesh is uploaded
+//-----------------------------------------------------------------------------
+size_t Mesh::getSubMeshCount() const
+{
+    return mSubMeshes.size();
+}
+
+const SubMesh &Mesh::getSubMesh(size_t index) const
+{
+    return mSubMeshes[index];
+}
+
+//-----------------------------------------------------------------------------
+// Hidden sub-meshes are skipped by draw()
+//-----------------------------------------------------------------------------
+void Mesh::setSubMeshVisible(size_t index, bool visible)
+{
+    if (index < mSubMeshVisible.size())
+        mSubMeshVisible[index] = visible ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Meshlet culling. The frustum and camera position are taken into model
+// space once here so draw() tests meshlets without transforming them.
+//-----------------------------------------------------------------------------
+void Mesh::setView(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    glm::mat4 modelView = view * model;
+    mModel = model;
+    mFrustum = Meshlets::extractFrustum(projection * modelView);
+    mCameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    mHasView = true;
+}
+
+//-----------------------------------------------------------------------------
+// Back-face culling of meshlets is off by default: the viewer draws both
+// sides of every triangle, so it is only correct for closed models.
+//-----------------------------------------------------------------------------
+void Mesh::setClusterCulling(bool frustum, bool backface)
+{
+    mFrustumCulling = frustum;
+    mBackfaceCulling = backface;
+}
+
+const Mesh::DrawStats &Mesh::getDrawStats() const
+{
+    return mStats;
+}
+
+//-----------------------------------------------------------------------------
+// Screen space error budget for LOD selection. fovY is the vertical field of
+// view in radians; a level is used once its error, projected at the closest
+// point of the sub-mesh's bounds, stays under maxPixelError pixels.
+//-----------------------------------------------------------------------------
+void Mesh::setLodSelection(float fovY, int viewportHeight, float maxPixelError)
+{
+    mFovY = fovY;
+    mViewportHeight = viewportHeight;
+    mMaxPixelError = maxPixelError;
+}
+
+//-----------------------------------------------------------------------------
+// Picks the coarsest acceptable level of every sub-mesh group. Errors grow
+// with the level, so the coarsest passing level is also the last one. While
+// streaming, a group never goes finer than its resident level, and draws
+// nothing before its first level is in.
+//-----------------------------------------------------------------------------
+void Mesh::selectLods()
+{
+    std::fill(mSelectedLod.begin(), mSelectedLod.end(), 0);
+    if (mHasView && mViewportHeight > 0 && mMaxPixelError > 0.0f)
+    {
+        float pixelsPerUnit = mViewportHeight / (2.0f * std::tan(0.5f * mFovY)); // at distance 1
+        for (const SubMesh &subMesh : mSubMeshes)
+        {
+            if (subMesh.lod <= mSelectedLod[subMesh.group])
+                continue;
+
+            glm::vec3 center = 0.5f * (subMesh.boundsMin + subMesh.boundsMax);
+            float radius = 0.5f * glm::length(subMesh.boundsMax - subMesh.boundsMin);
+            float distance = std::max(glm::length(center - mCameraPosition) - radius, 1e-4f);
+            if (subMesh.lodError * pixelsPerUnit / distance <= mMaxPixelError)
+                mSelectedLod[subMesh.group] = subMesh.lod;
+        }
+    }
+
+    for (size_t group = 0; group < mSelectedLod.size(); group++)
+    {
+        mSelectedLod[group] = std::max(mSelectedLod[group], mResidentLod[group]);
+        if (mSelectedLod[group] != NOT_RESIDENT)
+            mStats.coarsestLod = std::max(mStats.coarsestLod, mSelectedLod[group]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Queues the surviving meshlets of a sub-mesh for the current multi-draw.
+// Runs of consecutive visible meshlets become one range.
+//-----------------------------------------------------------------------------
+void Mesh::appendDrawRanges(const SubMesh &subMesh, DrawStats &stats)
+{
+    auto appendRange = [&](unsigned int first, unsigned int count)
+    {
+        uint64_t offset = subMesh.indexBufferOffset + static_cast<uint64_t>(first) * subMesh.indexSize;
+        mDrawCounts.push_back(static_cast<GLsizei>(count));
+        mDrawOffsets.push_back(reinterpret_cast<void *>(static_cast<uintptr_t>(offset)));
+        mDrawBaseVertices.push_back(static_cast<GLint>(subMesh.baseVertex));
+        stats.triangles += count / 3;
+    };
+
+    bool culling = mHasView && (mFrustumCulling || mBackfaceCulling) && subMesh.meshletCount > 0;
+    if (!culling)
+    {
+        appendRange(0, subMesh.indexCount);
+        stats.meshlets += subMesh.meshletCount;
+        return;
+    }
+
+    // Whole sub-mesh outside the frustum
+    glm::vec3 center = 0.5f * (subMesh.boundsMin + subMesh.boundsMax);
+    float radius = 0.5f * glm::length(subMesh.boundsMax - subMesh.boundsMin);
+    if (mFrustumCulling && !Meshlets::isSphereVisible(mFrustum, center, radius))
+        return;
+
+    unsigned int runStart = 0;
+    unsigned int runCount = 0;
+    for (unsigned int m = subMesh.meshletOffset; m < subMesh.meshletOffset + subMesh.meshletCount; m++)
+    {
+        const Meshlet &meshlet = mMeshlets[m];
+        bool visible = (!mFrustumCulling || Meshlets::isSphereVisible(mFrustum, meshlet.center, meshlet.radius)) &&
+                       (!mBackfaceCulling || !Meshlets::isBackfacing(meshlet, mCameraPosition));
+        if (!visible)
+            continue;
+
+        stats.meshlets++;
+        if (runCount > 0 && runStart + runCount == meshlet.indexOffset)
+        {
+            runCount += meshlet.indexCount;
+            continue;
+        }
+        if (runCount > 0)
+            appendRange(runStart, runCount);
+        runStart = meshlet.indexOffset;
+        runCount = meshlet.indexCount;
+    }
+    if (runCount > 0)
+        appendRange(runStart, runCount);
+}
+
+//-----------------------------------------------------------------------------
+// Draws every visible sub-mesh as ranges of the shared buffers, at the level
+// of detail selectLods() picked and skipping culled meshlets. Consecutive
+// sub-meshes with the same material, index type and vertex decode are
+// batched into one multi-draw. With material textures a new material only
+// changes the layer uniforms, not the bound texture.
+//-----------------------------------------------------------------------------
+void Mesh::draw(ShaderProgram &shader)
 {
     if (!mLoaded)
         return;
-    if (mIndices.empty())
+    if (mPager)
+    {
+        drawPaged(shader);
+        return;
+    }
+    if (mGltf)
+    {
+        drawGltf(shader);
+        return;
+    }
+    if (mPointCloud)
+    {
+        drawPointCloud(shader);
+        return;
+    }
+    if (mSubMeshes.empty())
     {
         std::cerr << "No indices to render!" << std::endl;
         return;
     }
 
     glBindVertexArray(mVAO);
-    glDrawElements(GL_TRIANGLES, mIndices.size(), GL_UNSIGNED_INT, 0); // Use glDrawElements
+
+    mStats = DrawStats();
+    selectLods();
+    drawSubMeshes(shader, mStats);
+
     glBindVertexArray(0);
 }
+
+//-----------------------------------------------------------------------------
+// Draws again what the last draw() chose, for another pass of the same
+// frame: the pager, point cloud and level selection are left as they are
+//-----------------------------------------------------------------------------
+void Mesh::redraw(ShaderProgram &shader)
+{
+    if (!mLoaded)
+        return;
+    if (mPager)
+    {
+        mPager->draw(shader);
+        return;
+    }
+    if (mGltf)
+    {
+        mGltf->draw(shader, mModel, mHasView && mFrustumCulling ? &mFrustum : nullptr);
+        return;
+    }
+    if (mPointCloud)
+    {
+        mPointCloud->draw(shader);
+        return;
+    }
+    if (mSubMeshes.empty())
+        return;
+
+    glBindVertexArray(mVAO);
+    DrawStats stats = DrawStats();
+    drawSubMeshes(shader, stats);
+    glBindVertexArray(0);
+}
+
+//-----------------------------------------------------------------------------
+// The batches of draw() at the levels selectLods() picked, counted in stats
+//-----------------------------------------------------------------------------
+void Mesh::drawSubMeshes(ShaderProgram &shader, DrawStats &stats)
+{
+    size_t i = 0;
+    while (i < mSubMeshes.size())
+    {
+        const SubMesh &first = mSubMeshes[i];
+        GLenum indexType = first.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        auto sameBatch = [&first](const SubMesh &subMesh)
+        {
+            return subMesh.materialIndex == first.materialIndex && subMesh.indexSize == first.indexSize &&
+                   subMesh.positionOffset == first.positionOffset && subMesh.positionScale == first.positionScale &&
+                   subMesh.texCoordOffset == first.texCoordOffset && subMesh.texCoordScale == first.texCoordScale;
+        };
+
+        shader.setUniform("positionOffset", first.positionOffset);
+        shader.setUniform("positionScale", first.positionScale);
+        shader.setUniform("texCoordOffset", first.texCoordOffset);
+        shader.setUniform("texCoordScale", first.texCoordScale);
+        if (mMaterialTextures)
+            mMaterialTextures->apply(shader, first.materialIndex);
+
+        mDrawCounts.clear();
+        mDrawOffsets.clear();
+        mDrawBaseVertices.clear();
+        for (; i < mSubMeshes.size() && sameBatch(mSubMeshes[i]); i++)
+        {
+            const SubMesh &subMesh = mSubMeshes[i];
+            if (!mSubMeshVisible[i])
+                continue;
+
+            if (subMesh.lod == 0)
+            {
+                stats.totalTriangles += subMesh.indexCount / 3;
+                stats.totalMeshlets += subMesh.meshletCount;
+            }
+            if (subMesh.lod == mSelectedLod[subMesh.group])
+                appendDrawRanges(subMesh, stats);
+        }
+        stats.drawRanges += mDrawCounts.size();
+
+        if (mDrawCounts.size() == 1)
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, mDrawCounts[0], indexType, mDrawOffsets[0], mDrawBaseVertices[0]);
+        }
+        else if (!mDrawCounts.empty())
+        {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, mDrawCounts.data(), indexType, mDrawOffsets.data(),
+                                          static_cast<GLsizei>(mDrawCounts.size()), mDrawBaseVertices.data());
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Out-of-core draw: pages chunks for the current view, then draws the ones
+// already resident. The pager culls whole chunks against the frustum.
+//-----------------------------------------------------------------------------
+void Mesh::drawPaged(ShaderProgram &shader)
+{
+    mPager->update(mFrustum, mCameraPosition, mHasView);
+    mPager->draw(shader);
+
+    const ChunkPager::Residency &residency = mPager->getResidency();
+    mStats = DrawStats();
+    mStats.triangles = residency.triangles;
+    mStats.totalTriangles = residency.totalTriangles;
+    mStats.drawRanges = residency.drawnChunks;
+}
+
+//-----------------------------------------------------------------------------
+// Native glTF draw: one call per primitive, culled as a whole
+//-----------------------------------------------------------------------------
+void Mesh::drawGltf(ShaderProgram &shader)
+{
+    mGltf->draw(shader, mModel, mHasView && mFrustumCulling ? &mFrustum : nullptr);
+
+    const GltfScene::Stats &stats = mGltf->getStats();
+    mStats = DrawStats();
+    mStats.triangles = stats.triangles;
+    mStats.totalTriangles = stats.totalTriangles;
+    mStats.drawRanges = stats.primitives;
+}
+
+//-----------------------------------------------------------------------------
+// Point cloud draw: the cloud picks its nodes for the current view under its
+// point budget, then draws the ones already resident
+//-----------------------------------------------------------------------------
+void Mesh::drawPointCloud(ShaderProgram &shader)
+{
+    mPointCloud->update(mFrustum, mCameraPosition, mHasView, mFovY, mViewportHeight);
+    mPointCloud->draw(shader);
+
+    const PointCloud::Stats &stats = mPointCloud->getStats();
+    mStats = DrawStats();
+    mStats.points = stats.points;
+    mStats.totalPoints = stats.totalPoints;
+    mStats.drawRanges = stats.drawnNodes;
+}
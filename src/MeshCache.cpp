@@ -0,0 +1,441 @@
+//-----------------------------------------------------------------------------
+// MeshCache.cpp
+//
+// On-disk binary cache (.mvmesh) of imported meshes
+//
+// File layout:
+//   CacheHeader
+//   packed vertex buffer       at vertexOffset (vertexBufferSize bytes)
+//   packed index buffer        at indexOffset (indexBufferSize bytes)
+//   SubMesh[subMeshCount]      at subMeshOffset
+//   Meshlet[meshletCount]      at meshletOffset
+// Every array starts on a 16 byte boundary.
+//
+// Each source path owns exactly one cache file, named after the hash of its
+// canonical path. The header records the source size, modification time and
+// content hash: a matching size and time is a hit straight away, a matching
+// size with a different time (e.g. the file was copied or touched) is still a
+// hit if the content hash agrees, and the entry takes the new time.
+//-----------------------------------------------------------------------------
+#include "MeshCache.h"
+#include "Hash.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char CACHE_MAGIC[8] = {'M', 'V', 'M', 'E', 'S', 'H', 0, 0};
+    const char *CACHE_EXTENSION = ".mvmesh";
+
+    // Files in the cache directory the disk budget covers: mesh entries and
+    // the files derived from sources next to them (TextureCache, MeshOctree)
+    const char *BUDGETED_EXTENSIONS[] = {CACHE_EXTENSION, ".mvtex", ".mvoct"};
+
+    // Bump whenever the file layout or the import pipeline output changes
+    constexpr uint32_t CACHE_VERSION = 8;
+
+    constexpr size_t HASH_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    std::string gCacheDirectory = "cache";
+    uint64_t gDiskBudget = 4ull * 1024 * 1024 * 1024;
+
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexStride;
+        uint64_t pathHash;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t contentHash;
+        uint64_t optionsHash;
+        VertexFormat vertexFormat;
+        VertexFormatReport vertexReport;
+        uint64_t vertexCount;
+        uint64_t vertexBufferSize;
+        uint64_t indexCount;
+        uint64_t indexBufferSize;
+        uint64_t subMeshCount;
+        uint64_t meshletCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t subMeshOffset;
+        uint64_t meshletOffset;
+    };
+
+    struct SourceInfo
+    {
+        std::string canonicalPath;
+        uint64_t pathHash = 0;
+        uint64_t size = 0;
+        int64_t time = 0;
+    };
+
+    inline uint64_t alignTo16(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    bool sourceInfo(const std::string &sourcePath, SourceInfo &info)
+    {
+        std::error_code ec;
+        fs::path canonical = fs::weakly_canonical(sourcePath, ec);
+        if (ec)
+            canonical = fs::absolute(sourcePath, ec);
+
+        info.size = fs::file_size(sourcePath, ec);
+        if (ec)
+            return false;
+        auto time = fs::last_write_time(sourcePath, ec);
+        if (ec)
+            return false;
+
+        info.canonicalPath = canonical.generic_string();
+        info.pathHash = hashBytes(info.canonicalPath.data(), info.canonicalPath.size());
+        info.time = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Every draw range of the entry inside its buffers: sub-mesh indices and
+    // vertices, and meshlets within their sub-mesh. A stale or corrupt entry
+    // would otherwise make the draws read past the buffer ends.
+    //-------------------------------------------------------------------------
+    bool rangesValid(const CacheHeader &header, const SubMesh *subMeshes, const Meshlet *meshlets)
+    {
+        for (uint64_t i = 0; i < header.subMeshCount; i++)
+        {
+            const SubMesh &subMesh = subMeshes[i];
+            if ((subMesh.indexSize != 2 && subMesh.indexSize != 4) ||
+                subMesh.indexBufferOffset % subMesh.indexSize != 0 ||
+                subMesh.indexBufferOffset + uint64_t(subMesh.indexCount) * subMesh.indexSize > header.indexBufferSize ||
+                uint64_t(subMesh.baseVertex) + subMesh.vertexCount > header.vertexCount ||
+                uint64_t(subMesh.meshletOffset) + subMesh.meshletCount > header.meshletCount)
+                return false;
+
+            for (unsigned int m = subMesh.meshletOffset; m < subMesh.meshletOffset + subMesh.meshletCount; m++)
+            {
+                if (uint64_t(meshlets[m].indexOffset) + meshlets[m].indexCount > subMesh.indexCount)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Records the source's new modification time in the mapped entry, so
+    // loads after a touch that left the content alone are hits without
+    // hashing. Like store(), it writes a new file and renames it over the
+    // entry, which readers that have the entry mapped never see. The mapping
+    // is closed for the rename (Windows cannot replace an open file); returns
+    // true if the new entry is in place, for the caller to map it. Otherwise
+    // the old entry is mapped again, or file is closed if it changed.
+    //-------------------------------------------------------------------------
+    bool rewriteSourceTime(const fs::path &cachePath, int64_t sourceTime, MappedFile &file)
+    {
+        CacheHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        const CacheHeader mappedHeader = header;
+        header.sourceTime = sourceTime;
+
+        std::error_code ec;
+        fs::path tempPath = cachePath;
+        tempPath += ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                std::cerr << "Mesh cache: unable to write '" << tempPath.string() << "'" << std::endl;
+                return false;
+            }
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(file.data() + sizeof(header)), static_cast<std::streamsize>(file.size() - sizeof(header)));
+            if (!out)
+            {
+                out.close();
+                fs::remove(tempPath, ec);
+                return false;
+            }
+        }
+
+        file.close();
+        fs::rename(tempPath, cachePath, ec);
+        if (!ec)
+            return true;
+        std::cerr << "Mesh cache: unable to update '" << cachePath.string() << "' (" << ec.message() << ")" << std::endl;
+        fs::remove(tempPath, ec);
+        if (file.open(cachePath.string()) &&
+            (file.size() < sizeof(CacheHeader) || std::memcmp(file.data(), &mappedHeader, sizeof(CacheHeader)) != 0))
+            file.close();
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // Pads the stream up to offset, then writes size bytes
+    //-------------------------------------------------------------------------
+    void writeAligned(std::ofstream &out, uint64_t offset, const void *data, uint64_t size)
+    {
+        const char padding[16] = {};
+        out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    }
+
+    fs::path cacheFilePath(uint64_t pathHash, const char *extension = CACHE_EXTENSION)
+    {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(pathHash));
+        return fs::path(gCacheDirectory) / (std::string(name) + extension);
+    }
+
+    //-------------------------------------------------------------------------
+    // Hashes the source file contents, one block per task on all cores
+    //-------------------------------------------------------------------------
+    bool contentHash(const std::string &sourcePath, uint64_t &hash)
+    {
+        MappedFile source;
+        if (!source.open(sourcePath))
+            return false;
+
+        size_t blockCount = (source.size() + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+        std::vector<uint64_t> blockHashes(blockCount);
+        parallelFor(blockCount, [&](size_t i)
+                    {
+                        size_t begin = i * HASH_BLOCK_SIZE;
+                        size_t size = std::min(HASH_BLOCK_SIZE, source.size() - begin);
+                        blockHashes[i] = hashBytes(source.data() + begin, size, i); });
+
+        hash = hashBytes(blockHashes.data(), blockHashes.size() * sizeof(uint64_t), source.size());
+        return true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Deletes least recently used cache files until the cache fits the budget.
+// A cache file's modification time is refreshed on every hit (touch()).
+// Mapped or open files that are deleted stay readable until closed.
+//-----------------------------------------------------------------------------
+void MeshCache::trim()
+{
+    struct CacheFile
+    {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type time;
+    };
+
+    std::error_code ec;
+    std::vector<CacheFile> files;
+    uint64_t totalSize = 0;
+    for (fs::directory_iterator it(gCacheDirectory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const std::string extension = it->path().extension().string();
+        if (!it->is_regular_file(ec) ||
+            std::find(std::begin(BUDGETED_EXTENSIONS), std::end(BUDGETED_EXTENSIONS), extension) == std::end(BUDGETED_EXTENSIONS))
+            continue;
+
+        CacheFile file;
+        file.path = it->path();
+        file.size = it->file_size(ec);
+        file.time = it->last_write_time(ec);
+        if (ec)
+            continue;
+
+        totalSize += file.size;
+        files.push_back(file);
+    }
+
+    if (totalSize <= gDiskBudget)
+        return;
+
+    std::sort(files.begin(), files.end(), [](const CacheFile &a, const CacheFile &b)
+              { return a.time < b.time; });
+
+    for (const CacheFile &file : files)
+    {
+        if (totalSize <= gDiskBudget)
+            break;
+        if (fs::remove(file.path, ec))
+        {
+            totalSize -= file.size;
+            std::cout << "Mesh cache: evicted " << file.path.filename().string() << std::endl;
+        }
+    }
+}
+
+void MeshCache::touch(const std::string &cachePath)
+{
+    std::error_code ec;
+    fs::last_write_time(cachePath, fs::file_time_type::clock::now(), ec);
+}
+
+void MeshCache::setDirectory(const std::string &directory)
+{
+    gCacheDirectory = directory;
+}
+
+void MeshCache::setDiskBudget(uint64_t bytes)
+{
+    gDiskBudget = bytes;
+}
+
+bool MeshCache::load(const std::string &sourcePath, uint64_t optionsHash, Entry &entry)
+{
+    SourceInfo source;
+    if (!sourceInfo(sourcePath, source))
+        return false;
+
+    fs::path cachePath = cacheFilePath(source.pathHash);
+    std::error_code ec;
+    if (!fs::exists(cachePath, ec))
+        return false;
+
+    MappedFile file;
+    if (!file.open(cachePath.string()) || file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.vertexStride != vertexLayout(header.vertexFormat).stride ||
+        header.pathHash != source.pathHash ||
+        header.optionsHash != optionsHash ||
+        header.sourceSize != source.size)
+        return false;
+
+    if (header.sourceTime != source.time)
+    {
+        uint64_t hash = 0;
+        if (!contentHash(sourcePath, hash) || hash != header.contentHash)
+            return false;
+
+        // The entry takes the new time, and the rewritten entry is checked
+        // like any other; if it could not be replaced, this one is used
+        if (rewriteSourceTime(cachePath, source.time, file))
+            return load(sourcePath, optionsHash, entry);
+        if (!file.isOpen())
+            return false;
+    }
+
+    if (header.vertexBufferSize != header.vertexCount * header.vertexStride ||
+        header.vertexOffset + header.vertexBufferSize > file.size() ||
+        header.indexOffset + header.indexBufferSize > file.size() ||
+        header.subMeshOffset + header.subMeshCount * sizeof(SubMesh) > file.size() ||
+        header.meshletOffset + header.meshletCount * sizeof(Meshlet) > file.size())
+    {
+        std::cerr << "Mesh cache: '" << cachePath.string() << "' is truncated" << std::endl;
+        return false;
+    }
+    if (!rangesValid(header, reinterpret_cast<const SubMesh *>(file.data() + header.subMeshOffset),
+                     reinterpret_cast<const Meshlet *>(file.data() + header.meshletOffset)))
+    {
+        std::cerr << "Mesh cache: '" << cachePath.string() << "' is corrupt" << std::endl;
+        return false;
+    }
+
+    // Refresh the entry for LRU eviction
+    touch(cachePath.string());
+
+    entry.vertexBuffer = file.data() + header.vertexOffset;
+    entry.indexBuffer = file.data() + header.indexOffset;
+    entry.subMeshes = reinterpret_cast<const SubMesh *>(file.data() + header.subMeshOffset);
+    entry.meshlets = reinterpret_cast<const Meshlet *>(file.data() + header.meshletOffset);
+    entry.vertexCount = static_cast<size_t>(header.vertexCount);
+    entry.vertexBufferSize = static_cast<size_t>(header.vertexBufferSize);
+    entry.vertexFormat = header.vertexFormat;
+    entry.vertexReport = header.vertexReport;
+    entry.indexCount = static_cast<size_t>(header.indexCount);
+    entry.indexBufferSize = static_cast<size_t>(header.indexBufferSize);
+    entry.subMeshCount = static_cast<size_t>(header.subMeshCount);
+    entry.meshletCount = static_cast<size_t>(header.meshletCount);
+    entry.file = std::move(file);
+    return true;
+}
+
+std::string MeshCache::derivedPath(const std::string &sourcePath, const char *extension)
+{
+    SourceInfo source;
+    if (!sourceInfo(sourcePath, source))
+        return std::string();
+    return cacheFilePath(source.pathHash, extension).string();
+}
+
+bool MeshCache::store(const std::string &sourcePath, uint64_t optionsHash, const MeshData &mesh, const VertexFormatReport &vertexReport)
+{
+    SourceInfo source;
+    if (!sourceInfo(sourcePath, source))
+        return false;
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.vertexStride = vertexLayout(mesh.vertexFormat).stride;
+    header.vertexFormat = mesh.vertexFormat;
+    header.vertexReport = vertexReport;
+    header.pathHash = source.pathHash;
+    header.sourceSize = source.size;
+    header.sourceTime = source.time;
+    header.optionsHash = optionsHash;
+    header.vertexCount = mesh.vertices.size();
+    header.vertexBufferSize = mesh.vertexBuffer.size();
+    header.indexCount = mesh.indices.size();
+    header.indexBufferSize = mesh.indexBuffer.size();
+    header.subMeshCount = mesh.subMeshes.size();
+    header.meshletCount = mesh.meshlets.size();
+    header.vertexOffset = alignTo16(sizeof(CacheHeader));
+    header.indexOffset = alignTo16(header.vertexOffset + header.vertexBufferSize);
+    header.subMeshOffset = alignTo16(header.indexOffset + header.indexBufferSize);
+    header.meshletOffset = alignTo16(header.subMeshOffset + header.subMeshCount * sizeof(SubMesh));
+    if (!contentHash(sourcePath, header.contentHash))
+        return false;
+
+    uint64_t fileSize = header.meshletOffset + header.meshletCount * sizeof(Meshlet);
+    if (fileSize > gDiskBudget)
+        return false;
+
+    std::error_code ec;
+    fs::create_directories(gCacheDirectory, ec);
+
+    // Write to a temporary file first so a crash never leaves a torn entry
+    fs::path cachePath = cacheFilePath(source.pathHash);
+    fs::path tempPath = cachePath;
+    tempPath += ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Mesh cache: unable to write '" << tempPath.string() << "'" << std::endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        writeAligned(out, header.vertexOffset, mesh.vertexBuffer.data(), header.vertexBufferSize);
+        writeAligned(out, header.indexOffset, mesh.indexBuffer.data(), header.indexBufferSize);
+        writeAligned(out, header.subMeshOffset, mesh.subMeshes.data(), header.subMeshCount * sizeof(SubMesh));
+        writeAligned(out, header.meshletOffset, mesh.meshlets.data(), header.meshletCount * sizeof(Meshlet));
+        if (!out)
+        {
+            out.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    trim();
+    return true;
+}
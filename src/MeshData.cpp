@@ -0,0 +1,393 @@
+//-----------------------------------------------------------------------------
+// MeshData.cpp
+//
+// CPU side result of a model import
+//-----------------------------------------------------------------------------
+#include "MeshData.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+    // Largest index span a 16-bit range can address
+    constexpr unsigned int MAX_SHORT_SPAN = 0xFFFF;
+
+    // Splitting a sub-mesh into 16-bit pieces is only worth it if the pieces
+    // stay big; otherwise the extra draw ranges cost more than the bytes saved
+    constexpr unsigned int MIN_PIECE_INDICES = 3 * 4096;
+
+    // Vertices per work item of packVertices
+    constexpr unsigned int VERTEX_CHUNK_SIZE = 64 * 1024;
+
+    constexpr float UNORM16_MAX = 65535.0f;
+
+    // A slice of one sub-mesh's vertex range
+    struct VertexChunk
+    {
+        size_t subMesh;
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    uint16_t encodeUnorm16(float value, float offset, float scale)
+    {
+        if (scale <= 0.0f)
+            return 0;
+        float normalized = std::min(std::max((value - offset) / scale, 0.0f), 1.0f);
+        return static_cast<uint16_t>(normalized * UNORM16_MAX + 0.5f);
+    }
+
+    float decodeUnorm16(uint16_t value, float offset, float scale)
+    {
+        return offset + scale * (value / UNORM16_MAX);
+    }
+
+    //-------------------------------------------------------------------------
+    // Greedily cuts a sub-mesh into triangle runs whose indices span at most
+    // MAX_SHORT_SPAN vertices, rebasing each run through its base vertex.
+    // Returns false if that would produce pieces below MIN_PIECE_INDICES.
+    //-------------------------------------------------------------------------
+    bool splitIntoShortRanges(const MeshData &mesh, const SubMesh &subMesh, std::vector<SubMesh> &pieces)
+    {
+        const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+
+        unsigned int pieceStart = 0;
+        unsigned int pieceMin = std::numeric_limits<unsigned int>::max();
+        unsigned int pieceMax = 0;
+
+        auto emitPiece = [&](unsigned int end)
+        {
+            SubMesh piece = subMesh;
+            piece.indexOffset = subMesh.indexOffset + pieceStart;
+            piece.indexCount = end - pieceStart;
+            piece.baseVertex = subMesh.baseVertex + pieceMin;
+            piece.vertexCount = pieceMax - pieceMin + 1;
+            piece.indexSize = 2;
+            pieces.push_back(piece);
+        };
+
+        for (unsigned int i = 0; i + 2 < subMesh.indexCount; i += 3)
+        {
+            unsigned int triangleMin = std::min({indices[i], indices[i + 1], indices[i + 2]});
+            unsigned int triangleMax = std::max({indices[i], indices[i + 1], indices[i + 2]});
+            unsigned int newMin = std::min(pieceMin, triangleMin);
+            unsigned int newMax = std::max(pieceMax, triangleMax);
+
+            if (i > pieceStart && newMax - newMin > MAX_SHORT_SPAN)
+            {
+                if (i - pieceStart < MIN_PIECE_INDICES)
+                    return false;
+
+                emitPiece(i);
+                pieceStart = i;
+                newMin = triangleMin;
+                newMax = triangleMax;
+            }
+
+            pieceMin = newMin;
+            pieceMax = newMax;
+        }
+
+        emitPiece(subMesh.indexCount);
+        return true;
+    }
+}
+
+void computeSubMeshBounds(MeshData &mesh)
+{
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                {
+                    SubMesh &subMesh = mesh.subMeshes[i];
+                    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+
+                    const Vertex *vertices = mesh.vertices.data() + subMesh.baseVertex;
+                    const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+                    for (unsigned int j = 0; j < subMesh.indexCount; j++)
+                    {
+                        const glm::vec3 &position = vertices[indices[j]].position;
+                        boundsMin = glm::min(boundsMin, position);
+                        boundsMax = glm::max(boundsMax, position);
+                    }
+
+                    // Point sets have no indices; every vertex counts
+                    if (subMesh.indexCount == 0)
+                    {
+                        for (unsigned int j = 0; j < subMesh.vertexCount; j++)
+                        {
+                            boundsMin = glm::min(boundsMin, vertices[j].position);
+                            boundsMax = glm::max(boundsMax, vertices[j].position);
+                        }
+                    }
+
+                    if (subMesh.indexCount == 0 && subMesh.vertexCount == 0)
+                        boundsMin = boundsMax = glm::vec3(0.0f);
+
+                    subMesh.boundsMin = boundsMin;
+                    subMesh.boundsMax = boundsMax; });
+}
+
+void packVertices(MeshData &mesh, const VertexFormat &format, VertexFormatReport &report)
+{
+    const VertexLayout layout = vertexLayout(format);
+
+    // LOD entries share the vertices of their LOD 0 entry
+    std::vector<VertexChunk> chunks;
+    for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+    {
+        const SubMesh &subMesh = mesh.subMeshes[i];
+        if (subMesh.lod != 0)
+            continue;
+        for (unsigned int begin = 0; begin < subMesh.vertexCount; begin += VERTEX_CHUNK_SIZE)
+            chunks.push_back({i, subMesh.baseVertex + begin, subMesh.baseVertex + std::min(subMesh.vertexCount, begin + VERTEX_CHUNK_SIZE)});
+    }
+
+    // 1. Range of every attribute over each sub-mesh's vertices. The index
+    //    based bounds are not enough: unreferenced vertices must encode too.
+    struct Range
+    {
+        glm::vec3 positionMin, positionMax;
+        glm::vec2 texCoordMin, texCoordMax;
+    };
+    std::vector<Range> chunkRanges(chunks.size());
+    parallelFor(chunks.size(), [&](size_t c)
+                {
+                    Range &range = chunkRanges[c];
+                    range.positionMin = glm::vec3(std::numeric_limits<float>::max());
+                    range.positionMax = glm::vec3(-std::numeric_limits<float>::max());
+                    range.texCoordMin = glm::vec2(std::numeric_limits<float>::max());
+                    range.texCoordMax = glm::vec2(-std::numeric_limits<float>::max());
+                    for (unsigned int v = chunks[c].begin; v < chunks[c].end; v++)
+                    {
+                        const Vertex &vertex = mesh.vertices[v];
+                        range.positionMin = glm::min(range.positionMin, vertex.position);
+                        range.positionMax = glm::max(range.positionMax, vertex.position);
+                        range.texCoordMin = glm::min(range.texCoordMin, vertex.texCoords);
+                        range.texCoordMax = glm::max(range.texCoordMax, vertex.texCoords);
+                    } });
+
+    for (SubMesh &subMesh : mesh.subMeshes)
+    {
+        subMesh.positionOffset = glm::vec3(0.0f);
+        subMesh.positionScale = glm::vec3(1.0f);
+        subMesh.texCoordOffset = glm::vec2(0.0f);
+        subMesh.texCoordScale = glm::vec2(1.0f);
+    }
+
+    std::vector<Range> subMeshRanges(mesh.subMeshes.size());
+    std::vector<unsigned char> seen(mesh.subMeshes.size(), 0);
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        Range &range = subMeshRanges[chunks[c].subMesh];
+        if (!seen[chunks[c].subMesh])
+        {
+            range = chunkRanges[c];
+            seen[chunks[c].subMesh] = 1;
+            continue;
+        }
+        range.positionMin = glm::min(range.positionMin, chunkRanges[c].positionMin);
+        range.positionMax = glm::max(range.positionMax, chunkRanges[c].positionMax);
+        range.texCoordMin = glm::min(range.texCoordMin, chunkRanges[c].texCoordMin);
+        range.texCoordMax = glm::max(range.texCoordMax, chunkRanges[c].texCoordMax);
+    }
+
+    glm::vec3 meshMin(std::numeric_limits<float>::max());
+    glm::vec3 meshMax(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+    {
+        if (!seen[i])
+            continue;
+
+        SubMesh &subMesh = mesh.subMeshes[i];
+        const Range &range = subMeshRanges[i];
+        meshMin = glm::min(meshMin, range.positionMin);
+        meshMax = glm::max(meshMax, range.positionMax);
+        if (format.position == PositionFormat::Unorm16)
+        {
+            subMesh.positionOffset = range.positionMin;
+            subMesh.positionScale = range.positionMax - range.positionMin;
+        }
+        if (format.texCoord == TexCoordFormat::Unorm16)
+        {
+            subMesh.texCoordOffset = range.texCoordMin;
+            subMesh.texCoordScale = range.texCoordMax - range.texCoordMin;
+        }
+    }
+
+    // 2. Encode, and decode again to measure the error. Vertices outside
+    //    every sub-mesh are never drawn and stay zero.
+    struct Error
+    {
+        double positionSquared = 0.0;
+        double texCoordSquared = 0.0;
+        float positionMax = 0.0f;
+        float texCoordMax = 0.0f;
+    };
+    std::vector<Error> chunkErrors(chunks.size());
+
+    mesh.vertexBuffer.assign(mesh.vertices.size() * layout.stride, 0);
+    parallelFor(chunks.size(), [&](size_t c)
+                {
+                    const SubMesh &subMesh = mesh.subMeshes[chunks[c].subMesh];
+                    Error &error = chunkErrors[c];
+                    for (unsigned int v = chunks[c].begin; v < chunks[c].end; v++)
+                    {
+                        const Vertex &vertex = mesh.vertices[v];
+                        unsigned char *out = mesh.vertexBuffer.data() + static_cast<size_t>(v) * layout.stride;
+                        glm::vec3 position = vertex.position;
+                        glm::vec2 texCoords = vertex.texCoords;
+
+                        if (format.position == PositionFormat::Unorm16)
+                        {
+                            uint16_t encoded[4] = {};
+                            for (int k = 0; k < 3; k++)
+                            {
+                                encoded[k] = encodeUnorm16(vertex.position[k], subMesh.positionOffset[k], subMesh.positionScale[k]);
+                                position[k] = decodeUnorm16(encoded[k], subMesh.positionOffset[k], subMesh.positionScale[k]);
+                            }
+                            std::memcpy(out, encoded, sizeof(encoded));
+                        }
+                        else
+                        {
+                            std::memcpy(out, &vertex.position, sizeof(vertex.position));
+                        }
+
+                        out += layout.attributes[1].offset;
+                        if (format.texCoord == TexCoordFormat::Unorm16)
+                        {
+                            uint16_t encoded[2];
+                            for (int k = 0; k < 2; k++)
+                            {
+                                encoded[k] = encodeUnorm16(vertex.texCoords[k], subMesh.texCoordOffset[k], subMesh.texCoordScale[k]);
+                                texCoords[k] = decodeUnorm16(encoded[k], subMesh.texCoordOffset[k], subMesh.texCoordScale[k]);
+                            }
+                            std::memcpy(out, encoded, sizeof(encoded));
+                        }
+                        else if (format.texCoord == TexCoordFormat::Half16)
+                        {
+                            uint16_t encoded[2];
+                            for (int k = 0; k < 2; k++)
+                            {
+                                encoded[k] = glm::packHalf1x16(vertex.texCoords[k]);
+                                texCoords[k] = glm::unpackHalf1x16(encoded[k]);
+                            }
+                            std::memcpy(out, encoded, sizeof(encoded));
+                        }
+                        else
+                        {
+                            std::memcpy(out, &vertex.texCoords, sizeof(vertex.texCoords));
+                        }
+
+                        float positionError = glm::length(position - vertex.position);
+                        float texCoordError = glm::length(texCoords - vertex.texCoords);
+                        error.positionSquared += static_cast<double>(positionError) * positionError;
+                        error.texCoordSquared += static_cast<double>(texCoordError) * texCoordError;
+                        error.positionMax = std::max(error.positionMax, positionError);
+                        error.texCoordMax = std::max(error.texCoordMax, texCoordError);
+                    } });
+
+    Error total;
+    size_t encodedCount = 0;
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        total.positionSquared += chunkErrors[c].positionSquared;
+        total.texCoordSquared += chunkErrors[c].texCoordSquared;
+        total.positionMax = std::max(total.positionMax, chunkErrors[c].positionMax);
+        total.texCoordMax = std::max(total.texCoordMax, chunkErrors[c].texCoordMax);
+        encodedCount += chunks[c].end - chunks[c].begin;
+    }
+
+    for (SubMesh &subMesh : mesh.subMeshes)
+    {
+        if (subMesh.lod == 0)
+            continue;
+        const SubMesh &lod0 = mesh.subMeshes[subMesh.group];
+        subMesh.positionOffset = lod0.positionOffset;
+        subMesh.positionScale = lod0.positionScale;
+        subMesh.texCoordOffset = lod0.texCoordOffset;
+        subMesh.texCoordScale = lod0.texCoordScale;
+    }
+
+    float diagonal = encodedCount > 0 ? glm::length(meshMax - meshMin) : 0.0f;
+    report.stride = layout.stride;
+    report.sourceStride = sizeof(Vertex);
+    report.maxPositionError = total.positionMax;
+    report.rmsPositionError = encodedCount > 0 ? static_cast<float>(std::sqrt(total.positionSquared / encodedCount)) : 0.0f;
+    report.relativePositionError = diagonal > 0.0f ? total.positionMax / diagonal : 0.0f;
+    report.maxTexCoordError = total.texCoordMax;
+    report.rmsTexCoordError = encodedCount > 0 ? static_cast<float>(std::sqrt(total.texCoordSquared / encodedCount)) : 0.0f;
+
+    mesh.vertexFormat = format;
+}
+
+void packIndices(MeshData &mesh)
+{
+    // Pick the index type of every sub-mesh, splitting where that pays off
+    std::vector<std::vector<SubMesh>> pieces(mesh.subMeshes.size());
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                {
+                    SubMesh subMesh = mesh.subMeshes[i];
+                    const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+                    auto range = std::minmax_element(indices, indices + subMesh.indexCount);
+
+                    if (subMesh.indexCount > 0 && *range.second - *range.first <= MAX_SHORT_SPAN)
+                    {
+                        subMesh.baseVertex += *range.first;
+                        subMesh.vertexCount = *range.second - *range.first + 1;
+                        subMesh.indexSize = 2;
+                        pieces[i].push_back(subMesh);
+                    }
+                    else if (!splitIntoShortRanges(mesh, subMesh, pieces[i]))
+                    {
+                        pieces[i].clear();
+                        if (subMesh.indexCount > 0)
+                            subMesh.vertexCount = *range.second + 1;
+                        subMesh.indexSize = 4;
+                        pieces[i].push_back(subMesh);
+                    } });
+
+    std::vector<SubMesh> subMeshes;
+    std::vector<unsigned int> rebase; // how far each piece's base vertex moved
+    uint64_t bufferSize = 0;
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        for (SubMesh &piece : pieces[i])
+        {
+            // 32-bit ranges must start on a 4 byte boundary
+            bufferSize = (bufferSize + piece.indexSize - 1) / piece.indexSize * piece.indexSize;
+            piece.indexBufferOffset = bufferSize;
+            bufferSize += static_cast<uint64_t>(piece.indexCount) * piece.indexSize;
+            subMeshes.push_back(piece);
+            rebase.push_back(piece.baseVertex - mesh.subMeshes[i].baseVertex);
+        }
+    }
+
+    // Write the packed indices, rebased to each piece's new base vertex. The
+    // 32-bit copy is rebased too so it keeps matching the sub-mesh table.
+    mesh.indexBuffer.assign(static_cast<size_t>(bufferSize), 0);
+    parallelFor(subMeshes.size(), [&](size_t i)
+                {
+                    const SubMesh &subMesh = subMeshes[i];
+                    unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+                    unsigned char *out = mesh.indexBuffer.data() + subMesh.indexBufferOffset;
+
+                    if (subMesh.indexSize == 4)
+                    {
+                        std::memcpy(out, indices, subMesh.indexCount * sizeof(unsigned int));
+                        return;
+                    }
+
+                    uint16_t *shorts = reinterpret_cast<uint16_t *>(out);
+                    for (unsigned int j = 0; j < subMesh.indexCount; j++)
+                    {
+                        indices[j] -= rebase[i];
+                        shorts[j] = static_cast<uint16_t>(indices[j]);
+                    } });
+
+    mesh.subMeshes.swap(subMeshes);
+}
@@ -0,0 +1,419 @@
+//-----------------------------------------------------------------------------
+// MeshOctree.cpp
+//
+// On-disk octree of mesh chunks for out-of-core rendering
+//
+// File layout: header, chunk data (each chunk's packed vertex buffer followed
+// by its 16-bit index buffer, 16 byte aligned), then the node and chunk
+// tables. The tables come last because the chunk offsets are only known once
+// the data has been written.
+//-----------------------------------------------------------------------------
+#include "MeshOctree.h"
+#include "Hash.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char OCTREE_MAGIC[8] = {'M', 'V', 'O', 'C', 'T', 'R', 'E', 'E'};
+    constexpr uint32_t OCTREE_VERSION = 1;
+
+    // Chunks encoded in parallel before they are written out, which bounds
+    // the memory the build step needs on top of the imported mesh
+    constexpr size_t CHUNK_BATCH_SIZE = 64;
+
+    struct OctreeHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexStride;
+        VertexFormat vertexFormat;
+        uint64_t sourceStamp;
+        uint64_t optionsHash;
+        uint64_t nodeCount;
+        uint64_t chunkCount;
+        uint64_t nodeOffset;
+        uint64_t chunkOffset;
+    };
+
+    inline uint64_t alignTo16(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    // A triangle of the source mesh
+    struct TriangleRef
+    {
+        unsigned int subMesh;
+        unsigned int triangle; // within the sub-mesh
+    };
+
+    // The triangles of one chunk, a range of the builder's triangle array
+    struct ChunkRange
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    //-------------------------------------------------------------------------
+    // Splits the triangles by the octant of their centroid until every leaf
+    // is small enough. Partitioning is stable, so every leaf keeps the
+    // source's optimized triangle order.
+    //-------------------------------------------------------------------------
+    class OctreeBuilder
+    {
+    public:
+        OctreeBuilder(const MeshData &mesh, std::vector<MeshOctree::Node> &nodes, std::vector<ChunkRange> &chunks)
+            : mMesh(mesh), mNodes(nodes), mChunks(chunks)
+        {
+            for (unsigned int s = 0; s < mesh.subMeshes.size(); s++)
+            {
+                const SubMesh &subMesh = mesh.subMeshes[s];
+                if (subMesh.lod != 0)
+                    continue;
+                for (unsigned int t = 0; t < subMesh.indexCount / 3; t++)
+                {
+                    mTriangles.push_back({s, t});
+                    mCentroids.push_back((position(s, t, 0) + position(s, t, 1) + position(s, t, 2)) / 3.0f);
+                }
+            }
+            mScratch.resize(mTriangles.size());
+            mScratchCentroids.resize(mCentroids.size());
+        }
+
+        const std::vector<TriangleRef> &triangles() const { return mTriangles; }
+
+        void build()
+        {
+            if (mTriangles.empty())
+                return;
+
+            glm::vec3 cubeMin(std::numeric_limits<float>::max());
+            glm::vec3 cubeMax(-std::numeric_limits<float>::max());
+            for (const glm::vec3 &centroid : mCentroids)
+            {
+                cubeMin = glm::min(cubeMin, centroid);
+                cubeMax = glm::max(cubeMax, centroid);
+            }
+            glm::vec3 size = cubeMax - cubeMin;
+            float extent = std::max(std::max(size.x, size.y), size.z);
+            buildNode(0, mTriangles.size(), cubeMin, extent, 0);
+        }
+
+    private:
+        glm::vec3 position(unsigned int subMesh, unsigned int triangle, unsigned int corner) const
+        {
+            const SubMesh &range = mMesh.subMeshes[subMesh];
+            unsigned int index = mMesh.indices[range.indexOffset + triangle * 3 + corner];
+            return mMesh.vertices[range.baseVertex + index].position;
+        }
+
+        uint32_t buildNode(size_t begin, size_t end, const glm::vec3 &cubeMin, float extent, unsigned int depth)
+        {
+            uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+            mNodes.push_back(MeshOctree::Node());
+            MeshOctree::Node node = {};
+            std::fill(node.children, node.children + 8, MeshOctree::INVALID_NODE);
+
+            if (end - begin <= MeshOctree::MAX_CHUNK_TRIANGLES || depth >= MeshOctree::MAX_DEPTH || extent <= 0.0f)
+            {
+                emitLeaf(begin, end, node);
+                mNodes[nodeIndex] = node;
+                return nodeIndex;
+            }
+
+            // Stable counting sort of the triangles into the eight octants
+            float half = 0.5f * extent;
+            glm::vec3 middle = cubeMin + glm::vec3(half);
+            size_t counts[8] = {};
+            for (size_t i = begin; i < end; i++)
+                counts[octant(mCentroids[i], middle)]++;
+
+            size_t starts[9] = {begin};
+            for (int o = 0; o < 8; o++)
+                starts[o + 1] = starts[o] + counts[o];
+            size_t cursor[8];
+            std::copy(starts, starts + 8, cursor);
+            for (size_t i = begin; i < end; i++)
+            {
+                size_t to = cursor[octant(mCentroids[i], middle)]++;
+                mScratch[to] = mTriangles[i];
+                mScratchCentroids[to] = mCentroids[i];
+            }
+            std::copy(mScratch.begin() + begin, mScratch.begin() + end, mTriangles.begin() + begin);
+            std::copy(mScratchCentroids.begin() + begin, mScratchCentroids.begin() + end, mCentroids.begin() + begin);
+
+            node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (int o = 0; o < 8; o++)
+            {
+                if (counts[o] == 0)
+                    continue;
+                glm::vec3 childMin = cubeMin + half * glm::vec3((o & 1) ? 1.0f : 0.0f, (o & 2) ? 1.0f : 0.0f, (o & 4) ? 1.0f : 0.0f);
+                uint32_t child = buildNode(starts[o], starts[o + 1], childMin, half, depth + 1);
+                node.children[o] = child;
+                node.boundsMin = glm::min(node.boundsMin, mNodes[child].boundsMin);
+                node.boundsMax = glm::max(node.boundsMax, mNodes[child].boundsMax);
+            }
+            mNodes[nodeIndex] = node;
+            return nodeIndex;
+        }
+
+        static int octant(const glm::vec3 &point, const glm::vec3 &middle)
+        {
+            return (point.x >= middle.x ? 1 : 0) | (point.y >= middle.y ? 2 : 0) | (point.z >= middle.z ? 4 : 0);
+        }
+
+        //---------------------------------------------------------------------
+        // One chunk per sub-mesh present in the leaf, split again if a leaf
+        // at the depth limit still holds too many triangles
+        //---------------------------------------------------------------------
+        void emitLeaf(size_t begin, size_t end, MeshOctree::Node &node)
+        {
+            std::stable_sort(mTriangles.begin() + begin, mTriangles.begin() + end, [](const TriangleRef &a, const TriangleRef &b)
+                             { return a.subMesh < b.subMesh; });
+
+            node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (size_t i = begin; i < end; i++)
+            {
+                for (unsigned int corner = 0; corner < 3; corner++)
+                {
+                    glm::vec3 p = position(mTriangles[i].subMesh, mTriangles[i].triangle, corner);
+                    node.boundsMin = glm::min(node.boundsMin, p);
+                    node.boundsMax = glm::max(node.boundsMax, p);
+                }
+            }
+
+            node.firstChunk = static_cast<uint32_t>(mChunks.size());
+            size_t chunkBegin = begin;
+            for (size_t i = begin; i <= end; i++)
+            {
+                if (i < end && mTriangles[i].subMesh == mTriangles[chunkBegin].subMesh &&
+                    i - chunkBegin < MeshOctree::MAX_CHUNK_TRIANGLES)
+                    continue;
+                if (i > chunkBegin)
+                    mChunks.push_back({chunkBegin, i});
+                chunkBegin = i;
+            }
+            node.chunkCount = static_cast<uint32_t>(mChunks.size()) - node.firstChunk;
+        }
+
+        const MeshData &mMesh;
+        std::vector<MeshOctree::Node> &mNodes;
+        std::vector<ChunkRange> &mChunks;
+        std::vector<TriangleRef> mTriangles;
+        std::vector<glm::vec3> mCentroids;
+        std::vector<TriangleRef> mScratch;
+        std::vector<glm::vec3> mScratchCentroids;
+    };
+
+    //-------------------------------------------------------------------------
+    // Copies the triangles of a chunk into a mesh of its own, vertices in
+    // first-use order, and packs it like a regular import
+    //-------------------------------------------------------------------------
+    void encodeChunk(const MeshData &mesh, const TriangleRef *triangles, size_t triangleCount, const VertexFormat &format,
+                     MeshData &chunk, MeshOctree::Chunk &record)
+    {
+        const SubMesh &source = mesh.subMeshes[triangles[0].subMesh];
+
+        std::unordered_map<unsigned int, unsigned int> remap;
+        remap.reserve(triangleCount * 3);
+        chunk.indices.reserve(triangleCount * 3);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int index = mesh.indices[source.indexOffset + triangles[t].triangle * 3 + corner];
+                auto inserted = remap.emplace(index, static_cast<unsigned int>(chunk.vertices.size()));
+                if (inserted.second)
+                    chunk.vertices.push_back(mesh.vertices[source.baseVertex + index]);
+                chunk.indices.push_back(inserted.first->second);
+            }
+        }
+
+        SubMesh subMesh = {};
+        subMesh.indexCount = static_cast<unsigned int>(chunk.indices.size());
+        subMesh.vertexCount = static_cast<unsigned int>(chunk.vertices.size());
+        subMesh.materialIndex = source.materialIndex;
+        subMesh.group = triangles[0].subMesh;
+        chunk.subMeshes.push_back(subMesh);
+
+        computeSubMeshBounds(chunk);
+        VertexFormatReport report;
+        packVertices(chunk, format, report);
+        packIndices(chunk);
+
+        record.vertexBufferSize = chunk.vertexBuffer.size();
+        record.indexBufferSize = chunk.indexBuffer.size();
+        record.subMesh = chunk.subMeshes[0];
+    }
+}
+
+uint64_t MeshOctree::sourceStamp(const std::string &sourcePath)
+{
+    std::error_code ec;
+    uint64_t size = fs::file_size(sourcePath, ec);
+    if (ec)
+        return 0;
+    auto time = fs::last_write_time(sourcePath, ec);
+    if (ec)
+        return 0;
+    return hashCombine(size, static_cast<uint64_t>(time.time_since_epoch().count()));
+}
+
+bool MeshOctree::build(const MeshData &mesh, const VertexFormat &format, uint64_t sourceStamp, uint64_t optionsHash, const std::string &path)
+{
+    std::vector<Node> nodes;
+    std::vector<ChunkRange> ranges;
+    OctreeBuilder builder(mesh, nodes, ranges);
+    builder.build();
+    if (ranges.empty())
+        return false;
+
+    OctreeHeader header = {};
+    std::memcpy(header.magic, OCTREE_MAGIC, sizeof(OCTREE_MAGIC));
+    header.version = OCTREE_VERSION;
+    header.vertexStride = vertexLayout(format).stride;
+    header.vertexFormat = format;
+    header.sourceStamp = sourceStamp;
+    header.optionsHash = optionsHash;
+    header.nodeCount = nodes.size();
+    header.chunkCount = ranges.size();
+
+    std::error_code ec;
+    fs::path finalPath(path);
+    if (finalPath.has_parent_path())
+        fs::create_directories(finalPath.parent_path(), ec);
+
+    // Write to a temporary file first so a crash never leaves a torn octree
+    fs::path tempPath = finalPath;
+    tempPath += ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Mesh octree: unable to write '" << tempPath.string() << "'" << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        const char padding[16] = {};
+        std::vector<Chunk> chunks(ranges.size());
+        std::vector<MeshData> batch;
+        for (size_t first = 0; first < ranges.size(); first += CHUNK_BATCH_SIZE)
+        {
+            size_t count = std::min(CHUNK_BATCH_SIZE, ranges.size() - first);
+            batch.assign(count, MeshData());
+            parallelFor(count, [&](size_t i)
+                        {
+                            const ChunkRange &range = ranges[first + i];
+                            encodeChunk(mesh, builder.triangles().data() + range.begin, range.end - range.begin, format,
+                                        batch[i], chunks[first + i]); });
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t offset = alignTo16(static_cast<uint64_t>(out.tellp()));
+                out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+                chunks[first + i].fileOffset = offset;
+                out.write(reinterpret_cast<const char *>(batch[i].vertexBuffer.data()), static_cast<std::streamsize>(batch[i].vertexBuffer.size()));
+                out.write(reinterpret_cast<const char *>(batch[i].indexBuffer.data()), static_cast<std::streamsize>(batch[i].indexBuffer.size()));
+            }
+        }
+
+        header.nodeOffset = alignTo16(static_cast<uint64_t>(out.tellp()));
+        out.write(padding, static_cast<std::streamsize>(header.nodeOffset - static_cast<uint64_t>(out.tellp())));
+        out.write(reinterpret_cast<const char *>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(Node)));
+        header.chunkOffset = alignTo16(static_cast<uint64_t>(out.tellp()));
+        out.write(padding, static_cast<std::streamsize>(header.chunkOffset - static_cast<uint64_t>(out.tellp())));
+        out.write(reinterpret_cast<const char *>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(Chunk)));
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!out)
+        {
+            out.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, finalPath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    std::cout << "Mesh octree: wrote " << nodes.size() << " nodes, " << ranges.size() << " chunks to '" << path << "'" << std::endl;
+    return true;
+}
+
+bool MeshOctree::Reader::open(const std::string &path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in)
+        return false;
+
+    OctreeHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, OCTREE_MAGIC, sizeof(OCTREE_MAGIC)) != 0 ||
+        header.version != OCTREE_VERSION ||
+        header.vertexStride != vertexLayout(header.vertexFormat).stride)
+        return false;
+
+    std::error_code ec;
+    uint64_t fileSize = fs::file_size(path, ec);
+    if (ec || header.nodeOffset + header.nodeCount * sizeof(Node) > fileSize ||
+        header.chunkOffset + header.chunkCount * sizeof(Chunk) > fileSize)
+    {
+        std::cerr << "Mesh octree: '" << path << "' is truncated" << std::endl;
+        return false;
+    }
+
+    mNodes.resize(static_cast<size_t>(header.nodeCount));
+    mChunks.resize(static_cast<size_t>(header.chunkCount));
+    in.seekg(static_cast<std::streamoff>(header.nodeOffset));
+    in.read(reinterpret_cast<char *>(mNodes.data()), static_cast<std::streamsize>(mNodes.size() * sizeof(Node)));
+    in.seekg(static_cast<std::streamoff>(header.chunkOffset));
+    in.read(reinterpret_cast<char *>(mChunks.data()), static_cast<std::streamsize>(mChunks.size() * sizeof(Chunk)));
+    if (!in)
+        return false;
+
+    for (const Chunk &chunk : mChunks)
+    {
+        if (chunk.fileOffset + chunk.vertexBufferSize + chunk.indexBufferSize > fileSize)
+        {
+            std::cerr << "Mesh octree: '" << path << "' is truncated" << std::endl;
+            return false;
+        }
+    }
+
+    mPath = path;
+    mVertexFormat = header.vertexFormat;
+    mSourceStamp = header.sourceStamp;
+    mOptionsHash = header.optionsHash;
+    return true;
+}
+
+bool MeshOctree::Reader::readChunk(size_t index, std::vector<unsigned char> &data) const
+{
+    const Chunk &chunk = mChunks[index];
+    std::ifstream in(mPath, std::ios::in | std::ios::binary);
+    if (!in)
+        return false;
+
+    data.resize(static_cast<size_t>(chunk.vertexBufferSize + chunk.indexBufferSize));
+    in.seekg(static_cast<std::streamoff>(chunk.fileOffset));
+    in.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(in);
+}
@@ -0,0 +1,320 @@
+//-----------------------------------------------------------------------------
+// MeshOptimizer.cpp
+//
+// Import-time reordering of triangles and vertices for GPU efficiency
+//-----------------------------------------------------------------------------
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    const unsigned int INVALID_INDEX = 0xFFFFFFFFu;
+
+    //-------------------------------------------------------------------------
+    // FIFO post-transform cache simulation, as used by most GPUs' vertex reuse
+    //-------------------------------------------------------------------------
+    class FifoCache
+    {
+    public:
+        explicit FifoCache(unsigned int vertexCount)
+            : mInsertedAt(vertexCount, 0), mMisses(0)
+        {
+        }
+
+        // Returns true on a cache miss (the vertex had to be transformed)
+        bool access(unsigned int vertex)
+        {
+            // Stamps are stored +1 so 0 means "never transformed"
+            if (mInsertedAt[vertex] != 0 && mMisses - mInsertedAt[vertex] < MeshOptimizer::CACHE_SIZE)
+                return false;
+
+            mMisses++;
+            mInsertedAt[vertex] = mMisses;
+            return true;
+        }
+
+        unsigned int misses() const { return mMisses; }
+
+    private:
+        std::vector<unsigned int> mInsertedAt;
+        unsigned int mMisses;
+    };
+
+    //-------------------------------------------------------------------------
+    // Vertex -> triangle adjacency in compressed row form
+    //-------------------------------------------------------------------------
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+    };
+
+    void buildAdjacency(const unsigned int *indices, unsigned int triangleCount, unsigned int vertexCount, Adjacency &adjacency)
+    {
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for (unsigned int i = 0; i < triangleCount * 3; i++)
+            adjacency.offsets[indices[i] + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+        std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(triangleCount * 3);
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+                adjacency.triangles[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Tipsify: fans around a vertex, then moves on to the neighbour most
+    // likely to still be in the cache. Returns the new triangle order.
+    //-------------------------------------------------------------------------
+    std::vector<unsigned int> tipsify(const unsigned int *indices, unsigned int triangleCount, unsigned int vertexCount)
+    {
+        const unsigned int cacheSize = MeshOptimizer::CACHE_SIZE;
+
+        Adjacency adjacency;
+        buildAdjacency(indices, triangleCount, vertexCount, adjacency);
+
+        std::vector<unsigned int> liveTriangles(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<unsigned char> emitted(triangleCount, 0);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> order;
+        order.reserve(triangleCount);
+
+        unsigned int time = cacheSize + 1;
+        unsigned int cursor = 0;
+
+        // Next vertex with live triangles: recently touched ones first, then scan
+        auto skipDeadEnd = [&]() -> unsigned int
+        {
+            while (!deadEnd.empty())
+            {
+                unsigned int vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[vertex] > 0)
+                    return vertex;
+            }
+            for (; cursor < vertexCount; cursor++)
+            {
+                if (liveTriangles[cursor] > 0)
+                    return cursor;
+            }
+            return INVALID_INDEX;
+        };
+
+        unsigned int fanning = skipDeadEnd();
+        while (fanning != INVALID_INDEX)
+        {
+            candidates.clear();
+            for (unsigned int a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++)
+            {
+                unsigned int triangle = adjacency.triangles[a];
+                if (emitted[triangle])
+                    continue;
+
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int vertex = indices[triangle * 3 + k];
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+                    if (time - cacheTime[vertex] > cacheSize)
+                        cacheTime[vertex] = time++;
+                }
+                emitted[triangle] = 1;
+                order.push_back(triangle);
+            }
+
+            // Prefer the candidate that is in the cache and stays there
+            // while its remaining triangles are emitted
+            unsigned int next = INVALID_INDEX;
+            unsigned int bestPriority = 0;
+            for (unsigned int vertex : candidates)
+            {
+                if (liveTriangles[vertex] == 0)
+                    continue;
+
+                unsigned int age = time - cacheTime[vertex];
+                unsigned int priority = age + 2 * liveTriangles[vertex] <= cacheSize ? age : 0;
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    next = vertex;
+                }
+            }
+
+            fanning = next != INVALID_INDEX ? next : skipDeadEnd();
+        }
+
+        return order;
+    }
+
+    //-------------------------------------------------------------------------
+    // Cuts the cache-optimized order into clusters at every triangle whose
+    // three vertices all miss the cache; reordering whole clusters there
+    // costs (almost) nothing in ACMR. Then sorts the clusters so the ones
+    // facing away from the sub-mesh centre are drawn first, which lets early
+    // depth testing reject more of what is drawn later.
+    //-------------------------------------------------------------------------
+    std::vector<unsigned int> sortClustersForOverdraw(const unsigned int *indices, const Vertex *vertices, unsigned int vertexCount,
+                                                      const std::vector<unsigned int> &order)
+    {
+        struct Cluster
+        {
+            unsigned int first;
+            unsigned int count;
+            float sortKey;
+        };
+
+        std::vector<Cluster> clusters;
+        FifoCache cache(vertexCount);
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            const unsigned int *triangle = indices + order[i] * 3;
+            unsigned int misses = 0;
+            for (unsigned int k = 0; k < 3; k++)
+                misses += cache.access(triangle[k]) ? 1 : 0;
+
+            if (clusters.empty() || misses == 3)
+                clusters.push_back({i, 0, 0.0f});
+            clusters.back().count++;
+        }
+
+        if (clusters.size() < 2)
+            return order;
+
+        glm::dvec3 meshCentre(0.0);
+        for (unsigned int triangle : order)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+                meshCentre += glm::dvec3(vertices[indices[triangle * 3 + k]].position);
+        }
+        meshCentre /= static_cast<double>(order.size() * 3);
+
+        for (Cluster &cluster : clusters)
+        {
+            glm::vec3 centre(0.0f);
+            glm::vec3 normal(0.0f);
+            for (unsigned int i = cluster.first; i < cluster.first + cluster.count; i++)
+            {
+                const unsigned int *triangle = indices + order[i] * 3;
+                const glm::vec3 &p0 = vertices[triangle[0]].position;
+                const glm::vec3 &p1 = vertices[triangle[1]].position;
+                const glm::vec3 &p2 = vertices[triangle[2]].position;
+                centre += p0 + p1 + p2;
+                normal += glm::cross(p1 - p0, p2 - p0); // area weighted
+            }
+            centre /= static_cast<float>(cluster.count * 3);
+
+            float length = glm::length(normal);
+            cluster.sortKey = length > 0.0f ? glm::dot(centre - glm::vec3(meshCentre), normal / length) : 0.0f;
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b)
+                         { return a.sortKey > b.sortKey; });
+
+        std::vector<unsigned int> sorted;
+        sorted.reserve(order.size());
+        for (const Cluster &cluster : clusters)
+            sorted.insert(sorted.end(), order.begin() + cluster.first, order.begin() + cluster.first + cluster.count);
+        return sorted;
+    }
+
+    //-------------------------------------------------------------------------
+    // Renumbers the vertices of one sub-mesh in the order the indices first
+    // use them. Unreferenced vertices keep their relative order at the end.
+    //-------------------------------------------------------------------------
+    void optimizeVertexFetch(unsigned int *indices, unsigned int indexCount, Vertex *vertices, unsigned int vertexCount)
+    {
+        std::vector<unsigned int> remap(vertexCount, INVALID_INDEX);
+        unsigned int next = 0;
+        for (unsigned int i = 0; i < indexCount; i++)
+        {
+            if (remap[indices[i]] == INVALID_INDEX)
+                remap[indices[i]] = next++;
+            indices[i] = remap[indices[i]];
+        }
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            if (remap[v] == INVALID_INDEX)
+                remap[v] = next++;
+        }
+
+        std::vector<Vertex> reordered(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            reordered[remap[v]] = vertices[v];
+        std::copy(reordered.begin(), reordered.end(), vertices);
+    }
+
+    void optimizeSubMesh(MeshData &mesh, const SubMesh &subMesh)
+    {
+        unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+        Vertex *vertices = mesh.vertices.data() + subMesh.baseVertex;
+        unsigned int triangleCount = subMesh.indexCount / 3;
+        if (triangleCount < 2)
+            return;
+
+        std::vector<unsigned int> order = tipsify(indices, triangleCount, subMesh.vertexCount);
+        order = sortClustersForOverdraw(indices, vertices, subMesh.vertexCount, order);
+
+        std::vector<unsigned int> reordered(triangleCount * 3);
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+                reordered[t * 3 + k] = indices[order[t] * 3 + k];
+        }
+        std::copy(reordered.begin(), reordered.end(), indices);
+
+        optimizeVertexFetch(indices, triangleCount * 3, vertices, subMesh.vertexCount);
+    }
+}
+
+float MeshOptimizer::computeACMR(const MeshData &mesh)
+{
+    std::vector<unsigned int> misses(mesh.subMeshes.size(), 0);
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                {
+                    const SubMesh &subMesh = mesh.subMeshes[i];
+                    const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+
+                    FifoCache cache(subMesh.vertexCount);
+                    for (unsigned int j = 0; j < subMesh.indexCount; j++)
+                        cache.access(indices[j]);
+                    misses[i] = cache.misses(); });
+
+    uint64_t totalMisses = std::accumulate(misses.begin(), misses.end(), uint64_t(0));
+    uint64_t triangleCount = mesh.indices.size() / 3;
+    return triangleCount > 0 ? static_cast<float>(static_cast<double>(totalMisses) / triangleCount) : 0.0f;
+}
+
+void MeshOptimizer::optimizeTriangleOrder(unsigned int *indices, unsigned int indexCount, unsigned int vertexCount)
+{
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    std::vector<unsigned int> order = tipsify(indices, triangleCount, vertexCount);
+    std::vector<unsigned int> reordered(triangleCount * 3);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+            reordered[t * 3 + k] = indices[order[t] * 3 + k];
+    }
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+void MeshOptimizer::optimize(MeshData &mesh)
+{
+    // Sub-meshes own disjoint index and vertex ranges until packIndices runs
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                { optimizeSubMesh(mesh, mesh.subMeshes[i]); });
+}
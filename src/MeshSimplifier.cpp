@@ -0,0 +1,430 @@
+//-----------------------------------------------------------------------------
+// MeshSimplifier.cpp
+//
+// Level of detail generation by quadric error metric edge collapse
+//-----------------------------------------------------------------------------
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const unsigned int INVALID_INDEX = 0xFFFFFFFFu;
+
+    // Cosine of the largest normal rotation a single collapse may cause
+    constexpr double MAX_NORMAL_CHANGE = 0.25;
+
+    //-------------------------------------------------------------------------
+    // Sum of squared distances to a set of planes, area weighted:
+    //   error(p) = p'Ap + 2b'p + c
+    //-------------------------------------------------------------------------
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    void addPlane(Quadric &q, const glm::dvec3 &n, double d, double weight)
+    {
+        q.a00 += weight * n.x * n.x;
+        q.a01 += weight * n.x * n.y;
+        q.a02 += weight * n.x * n.z;
+        q.a11 += weight * n.y * n.y;
+        q.a12 += weight * n.y * n.z;
+        q.a22 += weight * n.z * n.z;
+        q.b0 += weight * n.x * d;
+        q.b1 += weight * n.y * d;
+        q.b2 += weight * n.z * d;
+        q.c += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric &q, const Quadric &other)
+    {
+        q.a00 += other.a00;
+        q.a01 += other.a01;
+        q.a02 += other.a02;
+        q.a11 += other.a11;
+        q.a12 += other.a12;
+        q.a22 += other.a22;
+        q.b0 += other.b0;
+        q.b1 += other.b1;
+        q.b2 += other.b2;
+        q.c += other.c;
+        q.weight += other.weight;
+    }
+
+    double evaluate(const Quadric &q, const glm::dvec3 &p)
+    {
+        double result = q.a00 * p.x * p.x + 2.0 * q.a01 * p.x * p.y + 2.0 * q.a02 * p.x * p.z +
+                        q.a11 * p.y * p.y + 2.0 * q.a12 * p.y * p.z + q.a22 * p.z * p.z +
+                        2.0 * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+        return std::max(result, 0.0);
+    }
+
+    //-------------------------------------------------------------------------
+    // Half-edge collapse simplifier for one sub-mesh. Vertices never move, a
+    // collapse only redirects one vertex to a neighbour, so every result
+    // indexes the original vertex range. State carries over between calls,
+    // which makes each LOD a simplification of the previous one.
+    //-------------------------------------------------------------------------
+    class Simplifier
+    {
+    public:
+        Simplifier(const Vertex *vertices, unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount)
+            : mVertices(vertices), mVertexCount(vertexCount), mIndices(indices, indices + indexCount - indexCount % 3),
+              mRemap(vertexCount), mQuadrics(vertexCount), mLocked(vertexCount, 0), mError(0.0f)
+        {
+            for (unsigned int v = 0; v < vertexCount; v++)
+                mRemap[v] = v;
+            std::memset(mQuadrics.data(), 0, mQuadrics.size() * sizeof(Quadric));
+
+            for (size_t i = 0; i < mIndices.size(); i += 3)
+            {
+                glm::dvec3 p0 = position(mIndices[i]);
+                glm::dvec3 p1 = position(mIndices[i + 1]);
+                glm::dvec3 p2 = position(mIndices[i + 2]);
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                double length = glm::length(normal);
+                if (length <= 0.0)
+                    continue;
+
+                normal /= length;
+                double d = -glm::dot(normal, p0);
+                for (unsigned int k = 0; k < 3; k++)
+                    addPlane(mQuadrics[mIndices[i + k]], normal, d, 0.5 * length);
+            }
+
+            lockSeamsAndBorders();
+        }
+
+        // Collapses edges, cheapest first, until at most targetIndexCount
+        // indices remain or no collapse is allowed
+        void simplify(size_t targetIndexCount)
+        {
+            struct Collapse
+            {
+                unsigned int from;
+                unsigned int to;
+                double cost;
+            };
+            std::vector<Collapse> collapses;
+            std::vector<unsigned char> touched(mVertexCount);
+
+            while (mIndices.size() > targetIndexCount)
+            {
+                buildAdjacency();
+
+                // Every edge once (interior edges show up in two triangles)
+                collapses.clear();
+                for (size_t i = 0; i < mIndices.size(); i++)
+                {
+                    unsigned int a = mIndices[i];
+                    unsigned int b = mIndices[i % 3 == 2 ? i - 2 : i + 1];
+                    if (a > b)
+                        continue;
+
+                    Quadric merged = mQuadrics[a];
+                    addQuadric(merged, mQuadrics[b]);
+                    double costAB = mLocked[a] ? -1.0 : evaluate(merged, position(b));
+                    double costBA = mLocked[b] ? -1.0 : evaluate(merged, position(a));
+                    if (costAB >= 0.0 && (costBA < 0.0 || costAB <= costBA))
+                        collapses.push_back({a, b, costAB});
+                    else if (costBA >= 0.0)
+                        collapses.push_back({b, a, costBA});
+                }
+                if (collapses.empty())
+                    break;
+
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y)
+                          { return x.cost < y.cost; });
+
+                // A collapse removes about two triangles
+                size_t budget = (mIndices.size() - targetIndexCount) / 6 + 1;
+                size_t applied = 0;
+                std::fill(touched.begin(), touched.end(), 0);
+                for (const Collapse &collapse : collapses)
+                {
+                    if (applied >= budget)
+                        break;
+                    if (touched[collapse.from] || touched[collapse.to] || flipsTriangle(collapse.from, collapse.to))
+                        continue;
+
+                    mRemap[collapse.from] = collapse.to;
+                    double weight = mQuadrics[collapse.from].weight + mQuadrics[collapse.to].weight;
+                    addQuadric(mQuadrics[collapse.to], mQuadrics[collapse.from]);
+                    if (weight > 0.0)
+                        mError = std::max(mError, static_cast<float>(std::sqrt(collapse.cost / weight)));
+
+                    touched[collapse.from] = 1;
+                    touched[collapse.to] = 1;
+                    applied++;
+                }
+                if (applied == 0)
+                    break;
+
+                // Apply the collapses and drop the triangles they degenerated
+                size_t write = 0;
+                for (size_t i = 0; i < mIndices.size(); i += 3)
+                {
+                    unsigned int a = find(mIndices[i]);
+                    unsigned int b = find(mIndices[i + 1]);
+                    unsigned int c = find(mIndices[i + 2]);
+                    if (a == b || b == c || a == c)
+                        continue;
+                    mIndices[write++] = a;
+                    mIndices[write++] = b;
+                    mIndices[write++] = c;
+                }
+                mIndices.resize(write);
+            }
+        }
+
+        const std::vector<unsigned int> &indices() const { return mIndices; }
+
+        // Largest error any collapse so far introduced, in model units
+        float error() const { return mError; }
+
+    private:
+        glm::dvec3 position(unsigned int v) const
+        {
+            return glm::dvec3(mVertices[v].position);
+        }
+
+        unsigned int find(unsigned int v)
+        {
+            unsigned int root = v;
+            while (mRemap[root] != root)
+                root = mRemap[root];
+            while (mRemap[v] != root)
+            {
+                unsigned int next = mRemap[v];
+                mRemap[v] = root;
+                v = next;
+            }
+            return root;
+        }
+
+        //---------------------------------------------------------------------
+        // Moving a vertex on an open border would eat into the outline, and
+        // moving one copy of a UV seam vertex would tear the seam open
+        //---------------------------------------------------------------------
+        void lockSeamsAndBorders()
+        {
+            std::vector<unsigned int> byPosition(mVertexCount);
+            for (unsigned int v = 0; v < mVertexCount; v++)
+                byPosition[v] = v;
+            auto positionLess = [this](unsigned int a, unsigned int b)
+            {
+                const glm::vec3 &pa = mVertices[a].position;
+                const glm::vec3 &pb = mVertices[b].position;
+                if (pa.x != pb.x)
+                    return pa.x < pb.x;
+                if (pa.y != pb.y)
+                    return pa.y < pb.y;
+                return pa.z < pb.z;
+            };
+            std::sort(byPosition.begin(), byPosition.end(), positionLess);
+            for (size_t i = 1; i < byPosition.size(); i++)
+            {
+                if (!positionLess(byPosition[i - 1], byPosition[i]))
+                    mLocked[byPosition[i - 1]] = mLocked[byPosition[i]] = 1;
+            }
+
+            std::vector<uint64_t> edges;
+            edges.reserve(mIndices.size());
+            for (size_t i = 0; i < mIndices.size(); i++)
+            {
+                uint64_t a = mIndices[i];
+                uint64_t b = mIndices[i % 3 == 2 ? i - 2 : i + 1];
+                edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+            }
+            std::sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();)
+            {
+                size_t end = i + 1;
+                while (end < edges.size() && edges[end] == edges[i])
+                    end++;
+                if (end - i == 1)
+                {
+                    mLocked[static_cast<unsigned int>(edges[i] >> 32)] = 1;
+                    mLocked[static_cast<unsigned int>(edges[i] & 0xFFFFFFFFu)] = 1;
+                }
+                i = end;
+            }
+        }
+
+        void buildAdjacency()
+        {
+            mAdjacencyOffsets.assign(mVertexCount + 1, 0);
+            for (unsigned int index : mIndices)
+                mAdjacencyOffsets[index + 1]++;
+            for (unsigned int v = 0; v < mVertexCount; v++)
+                mAdjacencyOffsets[v + 1] += mAdjacencyOffsets[v];
+
+            std::vector<unsigned int> fill(mAdjacencyOffsets.begin(), mAdjacencyOffsets.end() - 1);
+            mAdjacency.resize(mIndices.size());
+            for (size_t i = 0; i < mIndices.size(); i++)
+                mAdjacency[fill[mIndices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        //---------------------------------------------------------------------
+        // True if moving from onto to would tilt any surviving triangle by
+        // more than MAX_NORMAL_CHANGE or flatten it to a line; small steps
+        // keep slivers from gradually turning upside down over many collapses
+        //---------------------------------------------------------------------
+        bool flipsTriangle(unsigned int from, unsigned int to)
+        {
+            glm::dvec3 target = position(to);
+            for (unsigned int a = mAdjacencyOffsets[from]; a < mAdjacencyOffsets[from + 1]; a++)
+            {
+                unsigned int triangle = mAdjacency[a];
+                unsigned int corners[3] = {find(mIndices[triangle * 3]), find(mIndices[triangle * 3 + 1]),
+                                           find(mIndices[triangle * 3 + 2])};
+                if (corners[0] == to || corners[1] == to || corners[2] == to)
+                    continue; // collapses away
+
+                glm::dvec3 before[3];
+                glm::dvec3 after[3];
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    before[k] = position(corners[k]);
+                    after[k] = corners[k] == from ? target : before[k];
+                }
+
+                glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                double lengthAfter = glm::length(normalAfter);
+                if (lengthAfter <= 0.0 ||
+                    glm::dot(normalBefore, normalAfter) < MAX_NORMAL_CHANGE * glm::length(normalBefore) * lengthAfter)
+                    return true;
+            }
+            return false;
+        }
+
+        const Vertex *mVertices;
+        unsigned int mVertexCount;
+        std::vector<unsigned int> mIndices;
+        std::vector<unsigned int> mRemap;
+        std::vector<Quadric> mQuadrics;
+        std::vector<unsigned char> mLocked;
+        std::vector<unsigned int> mAdjacencyOffsets;
+        std::vector<unsigned int> mAdjacency;
+        float mError;
+    };
+
+    struct Level
+    {
+        std::vector<unsigned int> indices;
+        float error;
+    };
+}
+
+void MeshSimplifier::buildLods(MeshData &mesh)
+{
+    std::vector<std::vector<Level>> levels(mesh.subMeshes.size());
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                {
+                    const SubMesh &subMesh = mesh.subMeshes[i];
+                    if (subMesh.lod != 0 || subMesh.indexCount / 3 < 2 * MIN_LOD_TRIANGLES)
+                        return;
+
+                    Simplifier simplifier(mesh.vertices.data() + subMesh.baseVertex, subMesh.vertexCount,
+                                          mesh.indices.data() + subMesh.indexOffset, subMesh.indexCount);
+                    for (unsigned int lod = 1; lod <= MAX_LOD; lod++)
+                    {
+                        size_t current = simplifier.indices().size();
+                        if (current / 3 < 2 * MIN_LOD_TRIANGLES)
+                            break;
+
+                        simplifier.simplify(current / 6 * 3);
+
+                        // Stalled on locked vertices: the level would not pay for itself
+                        if (simplifier.indices().size() * 10 > current * 9)
+                            break;
+
+                        Level level;
+                        level.indices = simplifier.indices();
+                        level.error = simplifier.error();
+                        MeshOptimizer::optimizeTriangleOrder(level.indices.data(), static_cast<unsigned int>(level.indices.size()),
+                                                             subMesh.vertexCount);
+                        levels[i].push_back(std::move(level));
+                    } });
+
+    // Level major, so ranges of the same level stay adjacent for batching
+    size_t lod0Count = mesh.subMeshes.size();
+    for (unsigned int lod = 1; lod <= MAX_LOD; lod++)
+    {
+        for (size_t i = 0; i < lod0Count; i++)
+        {
+            if (levels[i].size() < lod)
+                continue;
+
+            const Level &level = levels[i][lod - 1];
+            SubMesh subMesh = mesh.subMeshes[i];
+            subMesh.indexOffset = static_cast<unsigned int>(mesh.indices.size());
+            subMesh.indexCount = static_cast<unsigned int>(level.indices.size());
+            subMesh.lod = lod;
+            subMesh.lodError = level.error;
+            mesh.indices.insert(mesh.indices.end(), level.indices.begin(), level.indices.end());
+            mesh.subMeshes.push_back(subMesh);
+        }
+    }
+}
+
+void MeshSimplifier::orderVerticesByLod(MeshData &mesh)
+{
+    // Entries of each group, coarsest level first
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+    {
+        unsigned int group = mesh.subMeshes[i].group;
+        if (group >= groups.size())
+            groups.resize(group + 1);
+        groups[group].push_back(i);
+    }
+
+    parallelFor(groups.size(), [&](size_t g)
+                {
+                    std::vector<size_t> &entries = groups[g];
+                    if (entries.size() < 2)
+                        return;
+                    std::stable_sort(entries.begin(), entries.end(), [&](size_t a, size_t b)
+                                     { return mesh.subMeshes[a].lod > mesh.subMeshes[b].lod; });
+
+                    const SubMesh &lod0 = mesh.subMeshes[g];
+                    std::vector<unsigned int> remap(lod0.vertexCount, INVALID_INDEX);
+                    unsigned int next = 0;
+                    for (size_t entry : entries)
+                    {
+                        const SubMesh &subMesh = mesh.subMeshes[entry];
+                        for (unsigned int i = subMesh.indexOffset; i < subMesh.indexOffset + subMesh.indexCount; i++)
+                        {
+                            if (remap[mesh.indices[i]] == INVALID_INDEX)
+                                remap[mesh.indices[i]] = next++;
+                        }
+                    }
+                    for (unsigned int v = 0; v < lod0.vertexCount; v++)
+                    {
+                        if (remap[v] == INVALID_INDEX)
+                            remap[v] = next++;
+                    }
+
+                    for (size_t entry : entries)
+                    {
+                        const SubMesh &subMesh = mesh.subMeshes[entry];
+                        for (unsigned int i = subMesh.indexOffset; i < subMesh.indexOffset + subMesh.indexCount; i++)
+                            mesh.indices[i] = remap[mesh.indices[i]];
+                    }
+
+                    Vertex *vertices = mesh.vertices.data() + lod0.baseVertex;
+                    std::vector<Vertex> reordered(lod0.vertexCount);
+                    for (unsigned int v = 0; v < lod0.vertexCount; v++)
+                        reordered[remap[v]] = vertices[v];
+                    std::copy(reordered.begin(), reordered.end(), vertices); });
+}
@@ -0,0 +1,188 @@
+//-----------------------------------------------------------------------------
+// Meshlets.cpp
+//
+// Triangle clusters for CPU culling
+//-----------------------------------------------------------------------------
+#include "Meshlets.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const unsigned int NO_MESHLET = 0xFFFFFFFFu;
+
+    //-------------------------------------------------------------------------
+    // Bounding sphere and normal cone of the triangles [first, first + count)
+    // of a sub-mesh
+    //-------------------------------------------------------------------------
+    Meshlet makeMeshlet(const MeshData &mesh, const SubMesh &subMesh, unsigned int first, unsigned int count)
+    {
+        const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+        const Vertex *vertices = mesh.vertices.data() + subMesh.baseVertex;
+
+        Meshlet meshlet = {};
+        meshlet.indexOffset = first;
+        meshlet.indexCount = count;
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        glm::vec3 normalSum(0.0f);
+        for (unsigned int i = first; i < first + count; i += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[i]].position;
+            const glm::vec3 &p1 = vertices[indices[i + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[i + 2]].position;
+            boundsMin = glm::min(boundsMin, glm::min(p0, glm::min(p1, p2)));
+            boundsMax = glm::max(boundsMax, glm::max(p0, glm::max(p1, p2)));
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                normalSum += normal / length;
+        }
+
+        meshlet.center = 0.5f * (boundsMin + boundsMax);
+        float radiusSquared = 0.0f;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            glm::vec3 offset = vertices[indices[i]].position - meshlet.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // The cone must contain every triangle normal; degenerate triangles
+        // cannot face anywhere and are ignored
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 2.0f;
+        float axisLength = glm::length(normalSum);
+        if (axisLength <= 0.0f)
+            return meshlet;
+
+        glm::vec3 axis = normalSum / axisLength;
+        float minDot = 1.0f;
+        for (unsigned int i = first; i < first + count; i += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[i]].position;
+            const glm::vec3 &p1 = vertices[indices[i + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[i + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                minDot = std::min(minDot, glm::dot(axis, normal / length));
+        }
+
+        meshlet.coneAxis = axis;
+        if (minDot > 0.0f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        return meshlet;
+    }
+
+    //-------------------------------------------------------------------------
+    // Greedily grows meshlets along the (cache optimized) triangle order
+    //-------------------------------------------------------------------------
+    void buildSubMeshMeshlets(const MeshData &mesh, const SubMesh &subMesh, std::vector<Meshlet> &meshlets)
+    {
+        const unsigned int *indices = mesh.indices.data() + subMesh.indexOffset;
+
+        // Which meshlet last used each vertex, to count unique vertices
+        std::vector<unsigned int> usedBy(subMesh.vertexCount, NO_MESHLET);
+
+        unsigned int first = 0;
+        unsigned int vertexCount = 0;
+        for (unsigned int i = 0; i + 2 < subMesh.indexCount; i += 3)
+        {
+            unsigned int id = static_cast<unsigned int>(meshlets.size());
+            unsigned int newVertices = 0;
+            for (unsigned int k = 0; k < 3; k++)
+                newVertices += usedBy[indices[i + k]] != id ? 1 : 0;
+
+            if (i > first && (vertexCount + newVertices > Meshlets::MAX_VERTICES || (i - first) / 3 == Meshlets::MAX_TRIANGLES))
+            {
+                meshlets.push_back(makeMeshlet(mesh, subMesh, first, i - first));
+                first = i;
+                vertexCount = 0;
+                id++;
+            }
+
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                if (usedBy[indices[i + k]] != id)
+                {
+                    usedBy[indices[i + k]] = id;
+                    vertexCount++;
+                }
+            }
+        }
+
+        unsigned int end = subMesh.indexCount - subMesh.indexCount % 3;
+        if (end > first)
+            meshlets.push_back(makeMeshlet(mesh, subMesh, first, end - first));
+    }
+}
+
+void Meshlets::build(MeshData &mesh)
+{
+    std::vector<std::vector<Meshlet>> subMeshMeshlets(mesh.subMeshes.size());
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                { buildSubMeshMeshlets(mesh, mesh.subMeshes[i], subMeshMeshlets[i]); });
+
+    mesh.meshlets.clear();
+    for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+    {
+        mesh.subMeshes[i].meshletOffset = static_cast<unsigned int>(mesh.meshlets.size());
+        mesh.subMeshes[i].meshletCount = static_cast<unsigned int>(subMeshMeshlets[i].size());
+        mesh.meshlets.insert(mesh.meshlets.end(), subMeshMeshlets[i].begin(), subMeshMeshlets[i].end());
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Gribb/Hartmann plane extraction
+//-----------------------------------------------------------------------------
+Meshlets::Frustum Meshlets::extractFrustum(const glm::mat4 &m)
+{
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    for (glm::vec4 &plane : frustum.planes)
+    {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+    return frustum;
+}
+
+bool Meshlets::isSphereVisible(const Frustum &frustum, const glm::vec3 &center, float radius)
+{
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Conservative cone test against the bounding sphere: culls only if the
+// camera is behind every triangle plane as seen from anywhere in the sphere
+//-----------------------------------------------------------------------------
+bool Meshlets::isBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPosition)
+{
+    if (meshlet.coneCutoff > 1.0f)
+        return false;
+
+    glm::vec3 toCenter = meshlet.center - cameraPosition;
+    return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
@@ -0,0 +1,313 @@
+//-----------------------------------------------------------------------------
+// MipChain.cpp
+//
+// Separable mip filters on linear, alpha weighted float texels. A level is
+// computed in bands of rows, one band per task: the source rows a band
+// reads are decoded and filtered horizontally once, then combined
+// vertically, four channels per SIMD register.
+//-----------------------------------------------------------------------------
+#include "MipChain.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE2
+#endif
+
+namespace
+{
+    // Destination rows per task
+    const int ROWS_PER_TASK = 16;
+
+    // Half width of the Kaiser window in destination texels, and its shape
+    const float KAISER_RADIUS = 2.0f;
+    const float KAISER_ALPHA = 4.0f;
+
+    // Entries of the linear to sRGB table; fine enough that every 8-bit
+    // output is reachable
+    const int SRGB_TABLE_SIZE = 16384;
+
+    const float PI = 3.14159265358979f;
+
+    //-------------------------------------------------------------------------
+    // Four channels of one texel
+    //-------------------------------------------------------------------------
+#ifdef MIP_CHAIN_SSE2
+    struct Texel
+    {
+        __m128 v;
+    };
+
+    inline Texel zeroTexel() { return {_mm_setzero_ps()}; }
+    inline Texel loadTexel(const float *p) { return {_mm_loadu_ps(p)}; }
+    inline void storeTexel(float *p, Texel t) { _mm_storeu_ps(p, t.v); }
+    inline Texel multiplyAdd(Texel sum, Texel t, float weight) { return {_mm_add_ps(sum.v, _mm_mul_ps(t.v, _mm_set1_ps(weight)))}; }
+#else
+    struct Texel
+    {
+        float v[4];
+    };
+
+    inline Texel zeroTexel() { return {{0.0f, 0.0f, 0.0f, 0.0f}}; }
+    inline Texel loadTexel(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+    inline void storeTexel(float *p, Texel t) { std::copy(t.v, t.v + 4, p); }
+    inline Texel multiplyAdd(Texel sum, Texel t, float weight)
+    {
+        for (int c = 0; c < 4; c++)
+            sum.v[c] += t.v[c] * weight;
+        return sum;
+    }
+#endif
+
+    struct ColourTables
+    {
+        float srgbToLinear[256];
+        float unormToFloat[256];
+        unsigned char linearToSrgb[SRGB_TABLE_SIZE];
+
+        ColourTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                unormToFloat[i] = c;
+            }
+            for (int i = 0; i < SRGB_TABLE_SIZE; i++)
+            {
+                float c = static_cast<float>(i) / (SRGB_TABLE_SIZE - 1);
+                float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                linearToSrgb[i] = static_cast<unsigned char>(std::min(255.0f, s * 255.0f + 0.5f));
+            }
+        }
+    };
+
+    const ColourTables &colourTables()
+    {
+        static const ColourTables tables;
+        return tables;
+    }
+
+    //-------------------------------------------------------------------------
+    // The source texels and weights of every destination texel along one
+    // axis, tapCount per texel (unused taps have weight 0)
+    //-------------------------------------------------------------------------
+    struct Taps
+    {
+        int tapCount = 0;
+        std::vector<int> indices;
+        std::vector<float> weights;
+    };
+
+    float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 32 && term > 1e-8f * sum; k++)
+        {
+            term *= (x * x) / (4.0f * k * k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    float kaiserSinc(float t)
+    {
+        float x = t / KAISER_RADIUS;
+        if (x <= -1.0f || x >= 1.0f)
+            return 0.0f;
+        float sinc = t == 0.0f ? 1.0f : std::sin(PI * t) / (PI * t);
+        return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0f - x * x)) / besselI0(KAISER_ALPHA);
+    }
+
+    //-------------------------------------------------------------------------
+    // Destination texel i covers source [i * scale, (i + 1) * scale). The box
+    // filter weights source texels by their overlap with that span; Kaiser
+    // samples its kernel, stretched by scale, at the source texel centres.
+    //-------------------------------------------------------------------------
+    Taps buildTaps(MipFilter filter, int sourceSize, int size)
+    {
+        const float scale = static_cast<float>(sourceSize) / size;
+        const float support = filter == MipFilter::Box ? 0.5f * scale : KAISER_RADIUS * scale;
+
+        Taps taps;
+        taps.tapCount = static_cast<int>(std::ceil(2.0f * support)) + 1;
+        taps.indices.assign(static_cast<size_t>(size) * taps.tapCount, 0);
+        taps.weights.assign(static_cast<size_t>(size) * taps.tapCount, 0.0f);
+
+        for (int i = 0; i < size; i++)
+        {
+            const float center = (i + 0.5f) * scale;
+            const int first = static_cast<int>(std::floor(center - support));
+            int *indices = &taps.indices[static_cast<size_t>(i) * taps.tapCount];
+            float *weights = &taps.weights[static_cast<size_t>(i) * taps.tapCount];
+
+            float total = 0.0f;
+            for (int k = 0; k < taps.tapCount; k++)
+            {
+                int j = first + k;
+                float weight;
+                if (filter == MipFilter::Box)
+                {
+                    weight = std::max(0.0f, std::min(j + 1.0f, center + support) - std::max(static_cast<float>(j), center - support));
+                    j = std::min(std::max(j, 0), sourceSize - 1);
+                }
+                else
+                {
+                    weight = kaiserSinc((j + 0.5f - center) / scale);
+                    j = ((j % sourceSize) + sourceSize) % sourceSize;
+                }
+                indices[k] = j;
+                weights[k] = weight;
+                total += weight;
+            }
+            for (int k = 0; k < taps.tapCount; k++)
+                weights[k] /= total;
+        }
+        return taps;
+    }
+
+    //-------------------------------------------------------------------------
+    // Decodes a row of RGBA8 texels to linear floats with colour multiplied
+    // by alpha
+    //-------------------------------------------------------------------------
+    void decodeRow(const unsigned char *row, int width, const float *colourTable, float *out)
+    {
+        const float *alphaTable = colourTables().unormToFloat;
+        for (int x = 0; x < width; x++)
+        {
+            const unsigned char *texel = row + 4 * x;
+            float alpha = alphaTable[texel[3]];
+            out[4 * x + 0] = colourTable[texel[0]] * alpha;
+            out[4 * x + 1] = colourTable[texel[1]] * alpha;
+            out[4 * x + 2] = colourTable[texel[2]] * alpha;
+            out[4 * x + 3] = alpha;
+        }
+    }
+
+    void encodeRow(const float *row, int width, bool gammaCorrect, unsigned char *out)
+    {
+        const unsigned char *srgbTable = colourTables().linearToSrgb;
+        for (int x = 0; x < width; x++)
+        {
+            const float *texel = row + 4 * x;
+            float alpha = std::min(std::max(texel[3], 0.0f), 1.0f);
+            float unpremultiply = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            for (int c = 0; c < 3; c++)
+            {
+                float value = std::min(std::max(texel[c] * unpremultiply, 0.0f), 1.0f);
+                out[4 * x + c] = gammaCorrect ? srgbTable[static_cast<int>(value * (SRGB_TABLE_SIZE - 1) + 0.5f)]
+                                              : static_cast<unsigned char>(value * 255.0f + 0.5f);
+            }
+            out[4 * x + 3] = static_cast<unsigned char>(alpha * 255.0f + 0.5f);
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Filters destination rows [rowBegin, rowEnd) of level from source
+    //-------------------------------------------------------------------------
+    void filterBand(const MipLevel &source, const Taps &columns, const Taps &rows, bool gammaCorrect, int rowBegin, int rowEnd,
+                    unsigned char *destination, int width)
+    {
+        const float *colourTable = gammaCorrect ? colourTables().srgbToLinear : colourTables().unormToFloat;
+
+        // Source rows the band reads, each filtered horizontally once
+        std::vector<int> sourceRows;
+        for (int y = rowBegin; y < rowEnd; y++)
+        {
+            for (int k = 0; k < rows.tapCount; k++)
+            {
+                size_t tap = static_cast<size_t>(y) * rows.tapCount + k;
+                if (rows.weights[tap] != 0.0f)
+                    sourceRows.push_back(rows.indices[tap]);
+            }
+        }
+        std::sort(sourceRows.begin(), sourceRows.end());
+        sourceRows.erase(std::unique(sourceRows.begin(), sourceRows.end()), sourceRows.end());
+
+        std::vector<float> decoded(static_cast<size_t>(source.width) * 4);
+        std::vector<float> filtered(sourceRows.size() * width * 4);
+        for (size_t r = 0; r < sourceRows.size(); r++)
+        {
+            decodeRow(source.pixels + static_cast<size_t>(sourceRows[r]) * source.width * 4, source.width, colourTable, decoded.data());
+            float *out = &filtered[r * width * 4];
+            for (int x = 0; x < width; x++)
+            {
+                const int *indices = &columns.indices[static_cast<size_t>(x) * columns.tapCount];
+                const float *weights = &columns.weights[static_cast<size_t>(x) * columns.tapCount];
+                Texel sum = zeroTexel();
+                for (int k = 0; k < columns.tapCount; k++)
+                    sum = multiplyAdd(sum, loadTexel(&decoded[static_cast<size_t>(indices[k]) * 4]), weights[k]);
+                storeTexel(out + 4 * x, sum);
+            }
+        }
+
+        std::vector<float> row(static_cast<size_t>(width) * 4);
+        for (int y = rowBegin; y < rowEnd; y++)
+        {
+            const int *indices = &rows.indices[static_cast<size_t>(y) * rows.tapCount];
+            const float *weights = &rows.weights[static_cast<size_t>(y) * rows.tapCount];
+            std::fill(row.begin(), row.end(), 0.0f);
+            for (int k = 0; k < rows.tapCount; k++)
+            {
+                if (weights[k] == 0.0f)
+                    continue;
+                size_t r = std::lower_bound(sourceRows.begin(), sourceRows.end(), indices[k]) - sourceRows.begin();
+                const float *in = &filtered[r * width * 4];
+                for (int x = 0; x < width; x++)
+                    storeTexel(&row[4 * x], multiplyAdd(loadTexel(&row[4 * x]), loadTexel(in + 4 * x), weights[k]));
+            }
+            encodeRow(row.data(), width, gammaCorrect, destination + static_cast<size_t>(y) * width * 4);
+        }
+    }
+}
+
+unsigned int MipChain::levelCount(int width, int height)
+{
+    unsigned int count = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        count++;
+    }
+    return count;
+}
+
+void MipChain::build(MipFilter filter, bool gammaCorrect, std::vector<unsigned char> &storage, std::vector<MipLevel> &levels)
+{
+    const MipLevel base = levels[0];
+
+    // Lay out every level first so the pointers stay valid
+    std::vector<MipLevel> sizes;
+    size_t bytes = 0;
+    for (int width = base.width, height = base.height; width > 1 || height > 1;)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        sizes.push_back({width, height, nullptr});
+        bytes += static_cast<size_t>(width) * height * 4;
+    }
+    storage.resize(bytes);
+
+    unsigned char *out = storage.data();
+    for (MipLevel level : sizes)
+    {
+        const MipLevel source = levels.back();
+        Taps columns = buildTaps(filter, source.width, level.width);
+        Taps rows = buildTaps(filter, source.height, level.height);
+
+        unsigned char *destination = out;
+        size_t taskCount = static_cast<size_t>((level.height + ROWS_PER_TASK - 1) / ROWS_PER_TASK);
+        parallelFor(taskCount, [&](size_t task)
+                    {
+                        int rowBegin = static_cast<int>(task) * ROWS_PER_TASK;
+                        int rowEnd = std::min(level.height, rowBegin + ROWS_PER_TASK);
+                        filterBand(source, columns, rows, gammaCorrect, rowBegin, rowEnd, destination, level.width); });
+
+        level.pixels = destination;
+        levels.push_back(level);
+        out += static_cast<size_t>(level.width) * level.height * 4;
+    }
+}
@@ -0,0 +1,656 @@
+//-----------------------------------------------------------------------------
+// ObjLoader.cpp
+//
+// Native Wavefront OBJ reader used instead of Assimp for .obj files
+//
+// The file is read into memory once and split into line-aligned chunks.
+// Every chunk is processed independently in three passes:
+//   1. count positions, texture coordinates and face corners, and note
+//      where o/g/usemtl statements start a new group
+//   2. parse positions and texture coordinates into shared arrays
+//   3. resolve faces and write the final vertices and indices
+// Prefix sums over the per-chunk counts give each chunk its own slice of the
+// output arrays, so no pass needs any locking. Between passes 1 and 3 the
+// group starts of all chunks are stitched together into the sub-mesh table.
+//-----------------------------------------------------------------------------
+#include "ObjLoader.h"
+#include "Parallel.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    // Chunks smaller than this are not worth handing to another thread
+    constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+    constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    enum LineType
+    {
+        LINE_OTHER,
+        LINE_POSITION,
+        LINE_TEXCOORD,
+        LINE_FACE,
+        LINE_GROUP,
+        LINE_MATERIAL
+    };
+
+    // An o/g/usemtl statement, positioned by the chunk-local counts before it
+    struct GroupStart
+    {
+        size_t cornerCount;
+        size_t indexCount;
+        bool setsMaterial;
+        std::string material;
+    };
+
+    // A run of faces between two group starts, in global positions
+    struct GroupRange
+    {
+        size_t cornerStart;
+        size_t indexStart;
+        unsigned int materialIndex;
+    };
+
+    struct Chunk
+    {
+        const char *begin = nullptr;
+        const char *end = nullptr;
+
+        size_t positionCount = 0;
+        size_t texCoordCount = 0;
+        size_t cornerCount = 0;
+        size_t indexCount = 0;
+
+        size_t positionOffset = 0;
+        size_t texCoordOffset = 0;
+        size_t cornerOffset = 0;
+        size_t indexOffset = 0;
+
+        std::vector<GroupStart> groups;
+        size_t groupOffset = 0; // index of the chunk's first group in the range table
+    };
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline const char *skipBlanks(const char *p, const char *end)
+    {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    inline const char *lineEnd(const char *p, const char *end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        return newline ? newline : end;
+    }
+
+    //-------------------------------------------------------------------------
+    // Classifies a line and returns a pointer past its keyword
+    //-------------------------------------------------------------------------
+    LineType lineType(const char *&p, const char *end)
+    {
+        p = skipBlanks(p, end);
+        if (end - p < 2)
+            return LINE_OTHER;
+
+        if (p[0] == 'v')
+        {
+            if (isBlank(p[1]))
+            {
+                p += 2;
+                return LINE_POSITION;
+            }
+            if (p[1] == 't' && end - p > 2 && isBlank(p[2]))
+            {
+                p += 3;
+                return LINE_TEXCOORD;
+            }
+        }
+        else if (p[0] == 'f' && isBlank(p[1]))
+        {
+            p += 2;
+            return LINE_FACE;
+        }
+        else if ((p[0] == 'o' || p[0] == 'g') && isBlank(p[1]))
+        {
+            p += 2;
+            return LINE_GROUP;
+        }
+        else if (end - p > 6 && std::memcmp(p, "usemtl", 6) == 0 && isBlank(p[6]))
+        {
+            p += 7;
+            return LINE_MATERIAL;
+        }
+        return LINE_OTHER;
+    }
+
+    //-------------------------------------------------------------------------
+    // Locale independent float parser. Returns nullptr if no number was found.
+    //-------------------------------------------------------------------------
+    const char *parseFloat(const char *p, const char *end, float &value)
+    {
+        p = skipBlanks(p, end);
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = *p == '-';
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int significantDigits = 0;
+        bool anyDigits = false;
+
+        for (; p < end && isDigit(*p); p++)
+        {
+            anyDigits = true;
+            if (significantDigits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    significantDigits++;
+            }
+            else
+            {
+                exponent++;
+            }
+        }
+
+        if (p < end && *p == '.')
+        {
+            for (p++; p < end && isDigit(*p); p++)
+            {
+                anyDigits = true;
+                if (significantDigits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                    if (mantissa != 0)
+                        significantDigits++;
+                }
+            }
+        }
+
+        if (!anyDigits)
+            return nullptr;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+            {
+                negativeExponent = *q == '-';
+                q++;
+            }
+            if (q < end && isDigit(*q))
+            {
+                int e = 0;
+                for (; q < end && isDigit(*q); q++)
+                {
+                    if (e < 10000)
+                        e = e * 10 + (*q - '0');
+                }
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (mantissa != 0)
+        {
+            while (exponent > 22)
+            {
+                result *= POWERS_OF_TEN[22];
+                exponent -= 22;
+            }
+            while (exponent < -22)
+            {
+                result /= POWERS_OF_TEN[22];
+                exponent += 22;
+            }
+            result = exponent >= 0 ? result * POWERS_OF_TEN[exponent] : result / POWERS_OF_TEN[-exponent];
+        }
+
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    //-------------------------------------------------------------------------
+    // Parses a signed integer. Returns nullptr if no digits were found.
+    //-------------------------------------------------------------------------
+    const char *parseInt(const char *p, const char *end, long long &value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = *p == '-';
+            p++;
+        }
+
+        if (p >= end || !isDigit(*p))
+            return nullptr;
+
+        long long result = 0;
+        for (; p < end && isDigit(*p); p++)
+            result = result * 10 + (*p - '0');
+
+        value = negative ? -result : result;
+        return p;
+    }
+
+    //-------------------------------------------------------------------------
+    // Counts the whitespace separated corners of a face line
+    //-------------------------------------------------------------------------
+    size_t countCorners(const char *p, const char *end)
+    {
+        size_t corners = 0;
+        while (true)
+        {
+            p = skipBlanks(p, end);
+            if (p >= end || *p == '#')
+                break;
+            corners++;
+            while (p < end && !isBlank(*p))
+                p++;
+        }
+        return corners;
+    }
+
+    //-------------------------------------------------------------------------
+    // Resolves a 1-based (or negative, relative) OBJ index to a 0-based one
+    //-------------------------------------------------------------------------
+    inline long long resolveIndex(long long index, size_t countSoFar)
+    {
+        return index > 0 ? index - 1 : static_cast<long long>(countSoFar) + index;
+    }
+
+    //-------------------------------------------------------------------------
+    // Pass 1: count everything that will be written by the later passes
+    //-------------------------------------------------------------------------
+    void countChunk(Chunk &chunk)
+    {
+        for (const char *line = chunk.begin; line < chunk.end;)
+        {
+            const char *end = lineEnd(line, chunk.end);
+            const char *p = line;
+
+            switch (lineType(p, end))
+            {
+            case LINE_POSITION:
+                chunk.positionCount++;
+                break;
+            case LINE_TEXCOORD:
+                chunk.texCoordCount++;
+                break;
+            case LINE_FACE:
+            {
+                size_t corners = countCorners(p, end);
+                if (corners >= 3)
+                {
+                    chunk.cornerCount += corners;
+                    chunk.indexCount += 3 * (corners - 2);
+                }
+                break;
+            }
+            case LINE_GROUP:
+                chunk.groups.push_back({chunk.cornerCount, chunk.indexCount, false, std::string()});
+                break;
+            case LINE_MATERIAL:
+            {
+                p = skipBlanks(p, end);
+                const char *nameEnd = end;
+                while (nameEnd > p && isBlank(nameEnd[-1]))
+                    nameEnd--;
+                chunk.groups.push_back({chunk.cornerCount, chunk.indexCount, true, std::string(p, nameEnd)});
+                break;
+            }
+            default:
+                break;
+            }
+
+            line = end + 1;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Pass 2: parse positions and texture coordinates into the shared arrays
+    //-------------------------------------------------------------------------
+    void parseAttributes(const Chunk &chunk, std::vector<glm::vec3> &positions, std::vector<glm::vec2> &texCoords)
+    {
+        glm::vec3 *position = positions.data() + chunk.positionOffset;
+        glm::vec2 *texCoord = texCoords.data() + chunk.texCoordOffset;
+
+        for (const char *line = chunk.begin; line < chunk.end;)
+        {
+            const char *end = lineEnd(line, chunk.end);
+            const char *p = line;
+
+            LineType type = lineType(p, end);
+            if (type == LINE_POSITION)
+            {
+                glm::vec3 v(0.0f);
+                for (int i = 0; i < 3 && p; i++)
+                    p = parseFloat(p, end, v[i]);
+                *position++ = v;
+            }
+            else if (type == LINE_TEXCOORD)
+            {
+                glm::vec2 vt(0.0f);
+                for (int i = 0; i < 2 && p; i++)
+                    p = parseFloat(p, end, vt[i]);
+                *texCoord++ = vt;
+            }
+
+            line = end + 1;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Pass 3: resolve face corners and write the final vertices and indices.
+    // Indices are written relative to the base vertex of their group.
+    // Returns false if a face references a vertex that does not exist.
+    //-------------------------------------------------------------------------
+    bool parseFaces(const Chunk &chunk, const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                    const std::vector<GroupRange> &ranges, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        size_t positionsSeen = chunk.positionOffset;
+        size_t texCoordsSeen = chunk.texCoordOffset;
+        size_t corner = chunk.cornerOffset;
+        unsigned int *index = indices.data() + chunk.indexOffset;
+
+        // The group that was open when the chunk started
+        size_t range = chunk.groupOffset - 1;
+        size_t baseVertex = ranges[range].cornerStart;
+
+        for (const char *line = chunk.begin; line < chunk.end;)
+        {
+            const char *end = lineEnd(line, chunk.end);
+            const char *p = line;
+
+            LineType type = lineType(p, end);
+            if (type == LINE_POSITION)
+            {
+                positionsSeen++;
+            }
+            else if (type == LINE_TEXCOORD)
+            {
+                texCoordsSeen++;
+            }
+            else if (type == LINE_GROUP || type == LINE_MATERIAL)
+            {
+                baseVertex = ranges[++range].cornerStart;
+            }
+            else if (type == LINE_FACE)
+            {
+                size_t corners = countCorners(p, end);
+                if (corners >= 3)
+                {
+                    size_t firstCorner = corner;
+                    for (size_t k = 0; k < corners; k++)
+                    {
+                        p = skipBlanks(p, end);
+
+                        long long v = 0;
+                        long long vt = 0;
+                        p = parseInt(p, end, v);
+                        if (!p)
+                            return false;
+
+                        if (p < end && *p == '/')
+                        {
+                            p++;
+                            if (p < end && *p != '/' && !isBlank(*p))
+                            {
+                                p = parseInt(p, end, vt);
+                                if (!p)
+                                    return false;
+                            }
+                        }
+                        // Skip the normal index, it is not part of Vertex
+                        while (p < end && !isBlank(*p))
+                            p++;
+
+                        long long positionIndex = resolveIndex(v, positionsSeen);
+                        if (positionIndex < 0 || positionIndex >= static_cast<long long>(positions.size()))
+                            return false;
+
+                        Vertex &vertex = vertices[corner++];
+                        vertex.position = positions[positionIndex];
+                        vertex.texCoords = glm::vec2(0.0f);
+
+                        if (vt != 0)
+                        {
+                            long long texCoordIndex = resolveIndex(vt, texCoordsSeen);
+                            if (texCoordIndex < 0 || texCoordIndex >= static_cast<long long>(texCoords.size()))
+                                return false;
+
+                            const glm::vec2 &uv = texCoords[texCoordIndex];
+                            vertex.texCoords = glm::vec2(uv.x, 1.0f - uv.y);
+                        }
+                    }
+
+                    // Fan triangulation, same winding as aiProcess_Triangulate
+                    for (size_t k = 1; k + 1 < corners; k++)
+                    {
+                        *index++ = static_cast<unsigned int>(firstCorner - baseVertex);
+                        *index++ = static_cast<unsigned int>(firstCorner + k - baseVertex);
+                        *index++ = static_cast<unsigned int>(firstCorner + k + 1 - baseVertex);
+                    }
+                }
+            }
+
+            line = end + 1;
+        }
+
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Splits the buffer into chunks that start and end on line boundaries
+    //-------------------------------------------------------------------------
+    std::vector<Chunk> splitIntoChunks(const char *data, size_t size)
+    {
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(workerThreadCount() * CHUNKS_PER_THREAD, size / MIN_CHUNK_SIZE));
+        size_t chunkSize = size / chunkCount;
+
+        std::vector<Chunk> chunks;
+        const char *end = data + size;
+        const char *begin = data;
+        while (begin < end)
+        {
+            const char *split = begin + std::min<size_t>(chunkSize, end - begin);
+            if (split < end)
+                split = std::min(lineEnd(split, end) + 1, end);
+
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = split;
+            chunks.push_back(chunk);
+            begin = split;
+        }
+        return chunks;
+    }
+
+    //-------------------------------------------------------------------------
+    // Runs one pass over all chunks, reporting progress and stopping early
+    // once the load is cancelled. Returns false if it was cancelled.
+    //-------------------------------------------------------------------------
+    template <typename Fn>
+    bool runPass(std::vector<Chunk> &chunks, int pass, LoadProgress *progress, Fn fn)
+    {
+        const int PASS_COUNT = 3;
+        std::atomic<size_t> done(0);
+
+        parallelFor(chunks.size(), [&](size_t i)
+                    {
+                        if (progress && progress->isCancelled())
+                            return;
+
+                        fn(chunks[i]);
+
+                        if (progress)
+                        {
+                            float passFraction = static_cast<float>(++done) / chunks.size();
+                            progress->report("Parsing OBJ", (pass + passFraction) / PASS_COUNT);
+                        } });
+
+        return !(progress && progress->isCancelled());
+    }
+
+    //-------------------------------------------------------------------------
+    // Stitches the group starts of all chunks into one global range table.
+    // Range 0 holds any faces before the first o/g/usemtl statement. Material
+    // indices follow the order in which usemtl names first appear.
+    //-------------------------------------------------------------------------
+    std::vector<GroupRange> buildGroupRanges(std::vector<Chunk> &chunks)
+    {
+        std::vector<GroupRange> ranges;
+        ranges.push_back({0, 0, 0});
+
+        std::unordered_map<std::string, unsigned int> materials;
+        unsigned int material = 0;
+        for (Chunk &chunk : chunks)
+        {
+            chunk.groupOffset = ranges.size();
+            for (const GroupStart &group : chunk.groups)
+            {
+                if (group.setsMaterial)
+                {
+                    auto inserted = materials.emplace(group.material, static_cast<unsigned int>(materials.size()));
+                    material = inserted.first->second;
+                }
+                ranges.push_back({chunk.cornerOffset + group.cornerCount, chunk.indexOffset + group.indexCount, material});
+            }
+        }
+        return ranges;
+    }
+
+    //-------------------------------------------------------------------------
+    // Turns the non-empty group ranges into sub-meshes
+    //-------------------------------------------------------------------------
+    void buildSubMeshes(const std::vector<GroupRange> &ranges, size_t cornerCount, size_t indexCount, std::vector<SubMesh> &subMeshes)
+    {
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            size_t cornerEnd = i + 1 < ranges.size() ? ranges[i + 1].cornerStart : cornerCount;
+            size_t indexEnd = i + 1 < ranges.size() ? ranges[i + 1].indexStart : indexCount;
+            if (indexEnd == ranges[i].indexStart)
+                continue;
+
+            SubMesh subMesh = {};
+            subMesh.indexOffset = static_cast<unsigned int>(ranges[i].indexStart);
+            subMesh.indexCount = static_cast<unsigned int>(indexEnd - ranges[i].indexStart);
+            subMesh.baseVertex = static_cast<unsigned int>(ranges[i].cornerStart);
+            subMesh.vertexCount = static_cast<unsigned int>(cornerEnd - ranges[i].cornerStart);
+            subMesh.materialIndex = ranges[i].materialIndex;
+            subMeshes.push_back(subMesh);
+        }
+    }
+}
+
+bool ObjLoader::load(const std::string &filename, MeshData &mesh, LoadProgress *progress)
+{
+    if (progress)
+        progress->report("Reading file", 0.0f);
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        std::cerr << "ERROR::OBJ::Unable to open '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(buffer.data(), buffer.size()))
+    {
+        std::cerr << "ERROR::OBJ::Unable to read '" << filename << "'" << std::endl;
+        return false;
+    }
+    file.close();
+
+    std::vector<Chunk> chunks = splitIntoChunks(buffer.data(), buffer.size());
+
+    if (!runPass(chunks, 0, progress, countChunk))
+        return false;
+
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t cornerCount = 0;
+    size_t indexCount = 0;
+    for (Chunk &chunk : chunks)
+    {
+        chunk.positionOffset = positionCount;
+        chunk.texCoordOffset = texCoordCount;
+        chunk.cornerOffset = cornerCount;
+        chunk.indexOffset = indexCount;
+        positionCount += chunk.positionCount;
+        texCoordCount += chunk.texCoordCount;
+        cornerCount += chunk.cornerCount;
+        indexCount += chunk.indexCount;
+    }
+
+    if (cornerCount > 0xFFFFFFFFull)
+    {
+        std::cerr << "ERROR::OBJ::'" << filename << "' has too many vertices for 32-bit indices" << std::endl;
+        return false;
+    }
+
+    std::vector<GroupRange> ranges = buildGroupRanges(chunks);
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    if (!runPass(chunks, 1, progress, [&](const Chunk &chunk)
+                 { parseAttributes(chunk, positions, texCoords); }))
+        return false;
+
+    mesh.clear();
+    mesh.vertices.resize(cornerCount);
+    mesh.indices.resize(indexCount);
+    std::atomic<bool> valid(true);
+    bool completed = runPass(chunks, 2, progress, [&](const Chunk &chunk)
+                             {
+                                 if (!parseFaces(chunk, positions, texCoords, ranges, mesh.vertices, mesh.indices))
+                                     valid = false; });
+
+    if (!completed)
+    {
+        mesh.clear();
+        return false;
+    }
+
+    if (!valid)
+    {
+        std::cerr << "ERROR::OBJ::'" << filename << "' has a malformed face or an out of range index" << std::endl;
+        mesh.clear();
+        return false;
+    }
+
+    buildSubMeshes(ranges, cornerCount, indexCount, mesh.subMeshes);
+    computeSubMeshBounds(mesh);
+
+    std::cout << "OBJ: " << positionCount << " positions, " << texCoordCount << " texture coordinates, "
+              << indexCount / 3 << " triangles in " << mesh.subMeshes.size() << " sub-meshes parsed in "
+              << chunks.size() << " chunks" << std::endl;
+    return true;
+}
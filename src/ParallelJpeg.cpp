@@ -0,0 +1,686 @@
+//-----------------------------------------------------------------------------
+// ParallelJpeg.cpp
+//
+// Striped multi-core decoding of baseline JPEGs with restart markers
+//-----------------------------------------------------------------------------
+#include "ParallelJpeg.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "stb_image/stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Smaller images decode in well under 100 ms on one core
+    constexpr uint64_t MIN_PIXELS = 2048ull * 2048;
+
+    // Stripes per worker, so stripes of uneven cost still balance out
+    constexpr size_t STRIPES_PER_WORKER = 2;
+
+    struct Frame
+    {
+        size_t heightOffset = 0; // of the height field in the SOF segment
+        size_t scanOffset = 0;   // where the entropy coded data starts
+        int width = 0;
+        int height = 0;
+        int mcuWidth = 8;
+        int mcuHeight = 8;
+        int components = 0;
+        size_t restartInterval = 0; // MCUs per entropy coded segment
+    };
+
+    uint16_t read16(const unsigned char *p)
+    {
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    //-------------------------------------------------------------------------
+    // Reads the markers up to the first scan. Only a baseline or extended
+    // sequential Huffman frame coded in one interleaved scan qualifies.
+    //-------------------------------------------------------------------------
+    bool parseHeader(const unsigned char *data, size_t size, Frame &frame)
+    {
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+            return false;
+
+        int components = 0;
+        size_t p = 2;
+        while (p + 4 <= size)
+        {
+            if (data[p] != 0xFF)
+                return false;
+            const unsigned char marker = data[p + 1];
+            if (marker == 0xFF)
+            {
+                p++; // fill byte
+                continue;
+            }
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            {
+                p += 2; // markers without a segment
+                continue;
+            }
+
+            const size_t length = read16(data + p + 2);
+            if (length < 2 || p + 2 + length > size)
+                return false;
+            const unsigned char *segment = data + p + 4;
+            if (marker == 0xC0 || marker == 0xC1)
+            {
+                if (length < 8)
+                    return false;
+                frame.heightOffset = p + 5;
+                frame.height = read16(segment + 1);
+                frame.width = read16(segment + 3);
+                components = segment[5];
+                if (length < 8 + 3 * static_cast<size_t>(components))
+                    return false;
+
+                // A single component scan codes its blocks one at a time,
+                // whatever its sampling factors
+                int hMax = 1, vMax = 1;
+                for (int c = 0; c < components && components > 1; c++)
+                {
+                    hMax = std::max(hMax, segment[7 + 3 * c] >> 4);
+                    vMax = std::max(vMax, segment[7 + 3 * c] & 15);
+                }
+                frame.mcuWidth = 8 * hMax;
+                frame.mcuHeight = 8 * vMax;
+            }
+            else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+                return false; // progressive, lossless or arithmetic coded
+            else if (marker == 0xDD)
+            {
+                if (length < 4)
+                    return false;
+                frame.restartInterval = read16(segment);
+            }
+            else if (marker == 0xDA)
+            {
+                // A scan of fewer components means more scans follow
+                frame.scanOffset = p + 2 + length;
+                frame.components = components;
+                return components > 0 && segment[0] == components;
+            }
+            else if (marker == 0xD9)
+                return false;
+            p += 2 + length;
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // Start and end offsets of the entropy coded segments of the scan, which
+    // restart markers separate. False if the data ends before the scan does.
+    //-------------------------------------------------------------------------
+    bool findSegments(const unsigned char *data, size_t size, size_t p, std::vector<size_t> &starts, std::vector<size_t> &ends)
+    {
+        starts.push_back(p);
+        while (p < size)
+        {
+            const void *found = std::memchr(data + p, 0xFF, size - p);
+            if (found == nullptr)
+                return false;
+            p = static_cast<size_t>(static_cast<const unsigned char *>(found) - data);
+            if (p + 1 >= size)
+                return false;
+
+            const unsigned char next = data[p + 1];
+            if (next == 0x00)
+            {
+                p += 2; // a stuffed 0xFF data byte
+                continue;
+            }
+            if (next == 0xFF)
+            {
+                p++;
+                continue;
+            }
+            ends.push_back(p);
+            if (next < 0xD0 || next > 0xD7)
+                return true; // EOI or another marker ends the scan
+            p += 2;
+            starts.push_back(p);
+        }
+        return false;
+    }
+
+    // Below this many pixels the full decode is about as quick as a preview
+    constexpr uint64_t PREVIEW_MIN_PIXELS = 1024ull * 1024;
+
+    // Code lengths the Huffman lookup tables resolve in one step
+    constexpr int FAST_BITS = 9;
+
+    struct Huffman
+    {
+        bool defined = false;
+        uint8_t values[256];
+        int maxCode[17];                // largest code of each length, -1 for none
+        int valueOffset[17];            // values index minus the first code of each length
+        uint16_t fast[1 << FAST_BITS]; // length << 8 | value for short codes, 0 for longer ones
+    };
+
+    //-------------------------------------------------------------------------
+    // Canonical codes from a DHT table: counts of codes of 1 to 16 bits,
+    // then the values in code order. Tables with more values than a byte
+    // has, or more codes of a length than its bits can hold, are rejected
+    // before anything is written.
+    //-------------------------------------------------------------------------
+    bool buildHuffman(const unsigned char *counts, const unsigned char *values, int valueCount, Huffman &table)
+    {
+        if (valueCount > 256)
+            return false;
+        std::fill(std::begin(table.fast), std::end(table.fast), uint16_t(0));
+        int code = 0, k = 0;
+        for (int length = 1; length <= 16; length++)
+        {
+            table.valueOffset[length] = k - code;
+            for (int i = 0; i < counts[length - 1]; i++, k++, code++)
+            {
+                if (k >= valueCount || code >= (1 << length))
+                    return false;
+                if (length <= FAST_BITS)
+                {
+                    const int shift = FAST_BITS - length;
+                    for (int j = 0; j < (1 << shift); j++)
+                        table.fast[(code << shift) | j] = static_cast<uint16_t>(length << 8 | values[k]);
+                }
+            }
+            table.maxCode[length] = counts[length - 1] > 0 ? code - 1 : -1;
+            code <<= 1;
+        }
+        std::memcpy(table.values, values, static_cast<size_t>(valueCount));
+        table.defined = true;
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Reads entropy coded bits, most significant first, removing stuffed
+    // zero bytes. At a marker it stops and reads zeros.
+    //-------------------------------------------------------------------------
+    class BitReader
+    {
+    public:
+        BitReader(const unsigned char *data, size_t size, size_t position)
+            : mData(data), mSize(size), mPosition(position), mBits(0), mCount(0), mAtMarker(false)
+        {
+        }
+
+        // Next Huffman coded value, or -1 for a code the table lacks
+        int decode(const Huffman &table)
+        {
+            fill();
+            const uint16_t entry = table.fast[mBits >> (32 - FAST_BITS)];
+            if (entry != 0)
+            {
+                consume(entry >> 8);
+                return entry & 0xFF;
+            }
+            for (int length = FAST_BITS + 1; length <= 16; length++)
+            {
+                const int code = static_cast<int>(mBits >> (32 - length));
+                if (code <= table.maxCode[length])
+                {
+                    consume(length);
+                    return table.values[table.valueOffset[length] + code];
+                }
+            }
+            return -1;
+        }
+
+        // The signed value of the next size bits (size 0 to 16)
+        int receive(int size)
+        {
+            if (size == 0)
+                return 0;
+            fill();
+            const int value = static_cast<int>(mBits >> (32 - size));
+            consume(size);
+            return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+        }
+
+        void skip(int size)
+        {
+            fill();
+            consume(size);
+        }
+
+        // Drops the padding bits of the interval and steps over the restart
+        // marker after it; false if there is none
+        bool restart()
+        {
+            mBits = 0;
+            mCount = 0;
+            mAtMarker = false;
+            while (mPosition + 1 < mSize && mData[mPosition] == 0xFF && mData[mPosition + 1] == 0xFF)
+                mPosition++;
+            if (mPosition + 1 >= mSize || mData[mPosition] != 0xFF || mData[mPosition + 1] < 0xD0 || mData[mPosition + 1] > 0xD7)
+                return false;
+            mPosition += 2;
+            return true;
+        }
+
+    private:
+        // Tops the buffer up to at least 25 bits
+        void fill()
+        {
+            while (mCount <= 24)
+            {
+                uint32_t byte = 0;
+                if (!mAtMarker && mPosition < mSize)
+                {
+                    byte = mData[mPosition];
+                    if (byte != 0xFF)
+                        mPosition++;
+                    else if (mPosition + 1 < mSize && mData[mPosition + 1] == 0x00)
+                        mPosition += 2;
+                    else
+                    {
+                        mAtMarker = true;
+                        byte = 0;
+                    }
+                }
+                mBits |= byte << (24 - mCount);
+                mCount += 8;
+            }
+        }
+
+        void consume(int size)
+        {
+            mBits <<= size;
+            mCount -= size;
+        }
+
+        const unsigned char *mData;
+        size_t mSize;
+        size_t mPosition;
+        uint32_t mBits; // next bits, left aligned
+        int mCount;
+        bool mAtMarker;
+    };
+
+    struct Component
+    {
+        int id = 0;
+        int h = 1;
+        int v = 1;
+        int quantTable = 0;
+        int dcTable = 0;
+        int acTable = 0;
+        int predictor = 0;
+        int blocksWide = 0;
+        std::vector<int> dc; // dequantised DC of every block
+    };
+
+    uint8_t clampByte(int value)
+    {
+        return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// A stripe may start at any segment that starts a row of MCUs. Stripes keep
+// every header segment, so each is a valid JPEG of its own; only the height
+// in the frame header changes, and the restart markers are numbered again
+// from 0.
+//-----------------------------------------------------------------------------
+unsigned char *ParallelJpeg::decode(const std::string &fileName, int &width, int &height, int &components, const DecodedRows *rows)
+{
+    MappedFile file;
+    if (workerThreadCount() < 2 || !file.open(fileName))
+        return nullptr;
+    const unsigned char *data = file.data();
+    const size_t size = file.size();
+
+    Frame frame;
+    if (!parseHeader(data, size, frame) || frame.restartInterval == 0 || frame.height == 0 ||
+        static_cast<uint64_t>(frame.width) * frame.height < MIN_PIXELS)
+        return nullptr;
+
+    std::vector<size_t> starts, ends;
+    if (!findSegments(data, size, frame.scanOffset, starts, ends))
+        return nullptr;
+    const size_t mcusPerRow = (frame.width + frame.mcuWidth - 1) / frame.mcuWidth;
+    const size_t mcuRows = (frame.height + frame.mcuHeight - 1) / frame.mcuHeight;
+    if (starts.size() != (mcusPerRow * mcuRows + frame.restartInterval - 1) / frame.restartInterval)
+        return nullptr;
+
+    // Segments that start a row of MCUs, then the first segment of every
+    // stripe, both ending with the segment count
+    auto segmentRow = [&](size_t segment)
+    { return static_cast<int>(segment * frame.restartInterval / mcusPerRow); };
+    auto firstRowOf = [&](size_t segment)
+    { return segment == starts.size() ? frame.height : segmentRow(segment) * frame.mcuHeight; };
+    std::vector<size_t> rowStarts;
+    for (size_t s = 0; s < starts.size(); s++)
+    {
+        if (s * frame.restartInterval % mcusPerRow == 0)
+            rowStarts.push_back(s);
+    }
+    rowStarts.push_back(starts.size());
+
+    const size_t rowsPerStripe = std::max<size_t>(1, mcuRows / (workerThreadCount() * STRIPES_PER_WORKER));
+    std::vector<size_t> stripes = {0};
+    for (size_t i = 1; i + 1 < rowStarts.size(); i++)
+    {
+        if (static_cast<size_t>(segmentRow(rowStarts[i]) - segmentRow(stripes.back())) >= rowsPerStripe)
+            stripes.push_back(rowStarts[i]);
+    }
+    if (stripes.size() < 2)
+        return nullptr;
+    stripes.push_back(starts.size());
+
+    // Upsampling vertically subsampled chroma reads the neighbouring rows, so
+    // those stripes decode a row start further on both sides and drop the
+    // extra rows; the seams then match a decode of the whole image
+    const bool overlap = frame.mcuHeight > 8;
+
+    const size_t rowBytes = static_cast<size_t>(frame.width) * 4;
+    unsigned char *pixels = static_cast<unsigned char *>(std::malloc(rowBytes * frame.height));
+    if (pixels == nullptr)
+        return nullptr;
+    if (rows != nullptr)
+        rows->started(pixels, frame.width, frame.height, frame.components >= 3 ? 3 : 1);
+
+    std::atomic<bool> failed(false);
+    int fileComponents = 0;
+    parallelFor(stripes.size() - 1, [&](size_t stripe)
+                {
+        size_t first = stripes[stripe];
+        size_t last = stripes[stripe + 1];
+        const int firstRow = firstRowOf(first);
+        const int rowCount = firstRowOf(last) - firstRow;
+        if (overlap)
+        {
+            auto at = std::lower_bound(rowStarts.begin(), rowStarts.end(), first);
+            if (at != rowStarts.begin())
+                first = *(at - 1);
+            at = std::upper_bound(rowStarts.begin(), rowStarts.end(), last);
+            if (at != rowStarts.end())
+                last = *at;
+        }
+        const int decodeFirstRow = firstRowOf(first);
+        const int decodeRows = firstRowOf(last) - decodeFirstRow;
+
+        std::vector<unsigned char> stream(data, data + frame.scanOffset);
+        stream[frame.heightOffset] = static_cast<unsigned char>(decodeRows >> 8);
+        stream[frame.heightOffset + 1] = static_cast<unsigned char>(decodeRows & 0xFF);
+        for (size_t s = first; s < last; s++)
+        {
+            stream.insert(stream.end(), data + starts[s], data + ends[s]);
+            if (s + 1 < last)
+            {
+                stream.push_back(0xFF);
+                stream.push_back(static_cast<unsigned char>(0xD0 + (s - first) % 8));
+            }
+        }
+        stream.push_back(0xFF);
+        stream.push_back(0xD9);
+
+        int stripeWidth = 0, stripeHeight = 0, stripeComponents = 0;
+        unsigned char *stripePixels = stbi_load_from_memory(stream.data(), static_cast<int>(stream.size()), &stripeWidth, &stripeHeight,
+                                                            &stripeComponents, STBI_rgb_alpha);
+        if (stripePixels == nullptr || stripeWidth != frame.width || stripeHeight != decodeRows)
+            failed = true;
+        else
+        {
+            std::memcpy(pixels + rowBytes * firstRow, stripePixels + rowBytes * (firstRow - decodeFirstRow), rowBytes * rowCount);
+            if (rows != nullptr)
+                rows->decoded(firstRow, rowCount);
+        }
+        if (stripe == 0)
+            fileComponents = stripeComponents;
+        stbi_image_free(stripePixels); });
+
+    if (failed)
+    {
+        if (rows != nullptr)
+            rows->abandoned();
+        std::free(pixels);
+        return nullptr;
+    }
+    width = frame.width;
+    height = frame.height;
+    components = fileComponents;
+    return pixels;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the tables and the frame, then the DC coefficients of the first
+// scan, which must hold every component. Baseline scans still decode the
+// Huffman codes of the AC coefficients to skip them; a progressive file's
+// first scan has no others.
+//-----------------------------------------------------------------------------
+unsigned char *ParallelJpeg::decodePreview(const std::string &fileName, int &width, int &height, int &components)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+        return nullptr;
+    const unsigned char *data = file.data();
+    const size_t size = file.size();
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return nullptr;
+
+    int dcQuant[4] = {1, 1, 1, 1};
+    std::vector<Huffman> dcTables(4), acTables(4);
+    std::vector<Component> frame;
+    int imageWidth = 0, imageHeight = 0;
+    bool progressive = false;
+    size_t restartInterval = 0;
+
+    size_t p = 2;
+    while (p + 4 <= size)
+    {
+        if (data[p] != 0xFF)
+            return nullptr;
+        const unsigned char marker = data[p + 1];
+        if (marker == 0xFF)
+        {
+            p++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            p += 2;
+            continue;
+        }
+
+        const size_t length = read16(data + p + 2);
+        if (length < 2 || p + 2 + length > size)
+            return nullptr;
+        const unsigned char *segment = data + p + 4;
+        const unsigned char *end = data + p + 2 + length;
+        if (marker == 0xDB)
+        {
+            while (segment < end)
+            {
+                const int precision = segment[0] >> 4, table = segment[0] & 15;
+                if (table > 3 || end - segment < (precision ? 129 : 65))
+                    return nullptr;
+                dcQuant[table] = precision ? read16(segment + 1) : segment[1];
+                segment += precision ? 129 : 65;
+            }
+        }
+        else if (marker == 0xC4)
+        {
+            while (segment < end)
+            {
+                const int tableClass = segment[0] >> 4, table = segment[0] & 15;
+                if (tableClass > 1 || table > 3 || end - segment < 17)
+                    return nullptr;
+                int count = 0;
+                for (int i = 1; i <= 16; i++)
+                    count += segment[i];
+                if (count > 256 || end - segment < 17 + count ||
+                    !buildHuffman(segment + 1, segment + 17, count, tableClass == 0 ? dcTables[table] : acTables[table]))
+                    return nullptr;
+                segment += 17 + count;
+            }
+        }
+        else if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2)
+        {
+            if (length < 8 || segment[0] != 8)
+                return nullptr;
+            progressive = marker == 0xC2;
+            imageHeight = read16(segment + 1);
+            imageWidth = read16(segment + 3);
+            frame.resize(segment[5]);
+            if ((frame.size() != 1 && frame.size() != 3) || length < 8 + 3 * frame.size())
+                return nullptr;
+            for (size_t c = 0; c < frame.size(); c++)
+            {
+                frame[c].id = segment[6 + 3 * c];
+                frame[c].h = std::max(1, segment[7 + 3 * c] >> 4);
+                frame[c].v = std::max(1, segment[7 + 3 * c] & 15);
+                frame[c].quantTable = segment[8 + 3 * c] & 3;
+            }
+        }
+        else if (marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            return nullptr; // lossless or arithmetic coded
+        else if (marker == 0xDD)
+        {
+            if (length < 4)
+                return nullptr;
+            restartInterval = read16(segment);
+        }
+        else if (marker == 0xDA)
+            break;
+        else if (marker == 0xD9)
+            return nullptr;
+        p += 2 + length;
+    }
+
+    // The first scan: every component, DC only or (baseline) all of them
+    if (p + 4 > size || data[p + 1] != 0xDA || frame.empty() || imageWidth == 0 || imageHeight == 0 ||
+        static_cast<uint64_t>(imageWidth) * imageHeight < PREVIEW_MIN_PIXELS)
+        return nullptr;
+    const unsigned char *scan = data + p + 4;
+    const size_t scanCount = scan[0];
+    if (scanCount != frame.size() || read16(data + p + 2) < 6 + 2 * scanCount)
+        return nullptr;
+    for (size_t i = 0; i < scanCount; i++)
+    {
+        // Scans list components in frame order
+        Component &component = frame[i];
+        if (component.id != scan[1 + 2 * i])
+            return nullptr;
+        component.dcTable = scan[2 + 2 * i] >> 4 & 3;
+        component.acTable = scan[2 + 2 * i] & 3;
+        if (!dcTables[component.dcTable].defined || (!progressive && !acTables[component.acTable].defined))
+            return nullptr;
+    }
+    const int spectralStart = scan[1 + 2 * scanCount];
+    const int spectralEnd = scan[2 + 2 * scanCount];
+    const int approximationHigh = scan[3 + 2 * scanCount] >> 4;
+    const int approximationLow = scan[3 + 2 * scanCount] & 15;
+    if (spectralStart != 0 || approximationHigh != 0 || spectralEnd != (progressive ? 0 : 63))
+        return nullptr;
+
+    // A single component scan codes its blocks one at a time, whatever its
+    // sampling factors
+    if (frame.size() == 1)
+        frame[0].h = frame[0].v = 1;
+    int hMax = 1, vMax = 1;
+    for (const Component &component : frame)
+    {
+        hMax = std::max(hMax, component.h);
+        vMax = std::max(vMax, component.v);
+    }
+    const int mcusWide = (imageWidth + 8 * hMax - 1) / (8 * hMax);
+    const int mcusHigh = (imageHeight + 8 * vMax - 1) / (8 * vMax);
+    for (Component &component : frame)
+    {
+        component.blocksWide = mcusWide * component.h;
+        component.dc.assign(static_cast<size_t>(component.blocksWide) * mcusHigh * component.v, 0);
+    }
+
+    BitReader reader(data, size, p + 2 + read16(data + p + 2));
+    size_t untilRestart = restartInterval;
+    for (int mcuY = 0; mcuY < mcusHigh; mcuY++)
+    {
+        for (int mcuX = 0; mcuX < mcusWide; mcuX++)
+        {
+            if (restartInterval > 0 && untilRestart-- == 0)
+            {
+                if (!reader.restart())
+                    return nullptr;
+                untilRestart = restartInterval - 1;
+                for (Component &component : frame)
+                    component.predictor = 0;
+            }
+            for (Component &component : frame)
+            {
+                for (int y = 0; y < component.v; y++)
+                {
+                    for (int x = 0; x < component.h; x++)
+                    {
+                        const int dcSize = reader.decode(dcTables[component.dcTable]);
+                        if (dcSize < 0 || dcSize > 11)
+                            return nullptr;
+                        component.predictor += reader.receive(dcSize);
+                        const size_t block = static_cast<size_t>(mcuY * component.v + y) * component.blocksWide + mcuX * component.h + x;
+                        component.dc[block] = (component.predictor << approximationLow) * dcQuant[component.quantTable];
+                        if (progressive)
+                            continue;
+
+                        for (int k = 1; k < 64;)
+                        {
+                            const int runSize = reader.decode(acTables[component.acTable]);
+                            if (runSize < 0)
+                                return nullptr;
+                            const int run = runSize >> 4, acSize = runSize & 15;
+                            if (acSize != 0)
+                            {
+                                reader.skip(acSize);
+                                k += run + 1;
+                            }
+                            else if (run == 15)
+                                k += 16;
+                            else
+                                break; // end of block
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The DC of a block is eight times its mean, centred on 0
+    width = (imageWidth + 7) / 8;
+    height = (imageHeight + 7) / 8;
+    unsigned char *pixels = static_cast<unsigned char *>(std::malloc(static_cast<size_t>(width) * height * 4));
+    if (pixels == nullptr)
+        return nullptr;
+    auto sample = [&](const Component &component, int x, int y)
+    {
+        const size_t block = static_cast<size_t>(y * component.v / vMax) * component.blocksWide + x * component.h / hMax;
+        return component.dc[block] / 8 + 128;
+    };
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char *row = pixels + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++)
+        {
+            const int luma = sample(frame[0], x, y);
+            if (frame.size() == 1)
+                row[4 * x] = row[4 * x + 1] = row[4 * x + 2] = clampByte(luma);
+            else
+            {
+                // JFIF YCbCr to RGB, in 16.16 fixed point
+                const int cb = sample(frame[1], x, y) - 128;
+                const int cr = sample(frame[2], x, y) - 128;
+                row[4 * x] = clampByte(luma + ((91881 * cr + 32768) >> 16));
+                row[4 * x + 1] = clampByte(luma - ((22554 * cb + 46802 * cr - 32768) >> 16));
+                row[4 * x + 2] = clampByte(luma + ((116130 * cb + 32768) >> 16));
+            }
+            row[4 * x + 3] = 255;
+        }
+    }
+    components = static_cast<int>(frame.size());
+    return pixels;
+}
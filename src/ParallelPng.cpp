@@ -0,0 +1,729 @@
+//-----------------------------------------------------------------------------
+// ParallelPng.cpp
+//
+// Two stage inflate and unfilter pipeline for large PNGs
+//-----------------------------------------------------------------------------
+#include "ParallelPng.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    // Smaller images decode in well under 100 ms on one core
+    constexpr uint64_t MIN_PIXELS = 2048ull * 2048;
+
+    // Inflated bytes between progress reports to the unfilter stage
+    constexpr size_t PUBLISH_BYTES = 256 * 1024;
+
+    // RGBA8 bytes of scanlines handed to DecodedRows::decoded at a time
+    constexpr size_t BAND_BYTES = 4 * 1024 * 1024;
+
+    const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    enum ColorType
+    {
+        COLOR_GRAY = 0,
+        COLOR_RGB = 2,
+        COLOR_PALETTE = 3,
+        COLOR_GRAY_ALPHA = 4,
+        COLOR_RGBA = 6
+    };
+
+    struct Image
+    {
+        int width = 0;
+        int height = 0;
+        int colorType = 0;
+        int channels = 0;                 // bytes per pixel of a scanline
+        std::vector<const unsigned char *> idat; // data of the IDAT chunks, in order
+        std::vector<size_t> idatSizes;
+        unsigned char palette[256 * 4];   // RGBA
+        bool transparent = false;         // tRNS: palette alpha or a transparent colour
+        unsigned char transparentColor[3] = {};
+    };
+
+    uint32_t read32(const unsigned char *p)
+    {
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3];
+    }
+
+    constexpr uint32_t chunkType(char a, char b, char c, char d)
+    {
+        return static_cast<uint32_t>(static_cast<unsigned char>(a)) << 24 | static_cast<uint32_t>(static_cast<unsigned char>(b)) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(c)) << 8 | static_cast<uint32_t>(static_cast<unsigned char>(d));
+    }
+
+    //-------------------------------------------------------------------------
+    // Reads the chunks up to IEND. Only 8 bit, non-interlaced images of the
+    // standard colour types qualify; Apple's CgBI variant and unknown
+    // critical chunks do not.
+    //-------------------------------------------------------------------------
+    bool parseChunks(const unsigned char *data, size_t size, Image &image)
+    {
+        if (size < 8 + 25 || std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0)
+            return false;
+
+        for (int i = 0; i < 256; i++)
+        {
+            unsigned char *entry = image.palette + i * 4;
+            entry[0] = entry[1] = entry[2] = 0;
+            entry[3] = 255;
+        }
+
+        size_t p = 8;
+        bool first = true;
+        int paletteSize = 0;
+        while (p + 12 <= size)
+        {
+            const size_t length = read32(data + p);
+            const uint32_t type = read32(data + p + 4);
+            const unsigned char *chunk = data + p + 8;
+            if (length > size - p - 12)
+                return false;
+            if (first != (type == chunkType('I', 'H', 'D', 'R')))
+                return false;
+            first = false;
+
+            switch (type)
+            {
+            case chunkType('I', 'H', 'D', 'R'):
+            {
+                if (length != 13)
+                    return false;
+                const uint32_t width = read32(chunk), height = read32(chunk + 4);
+                const int depth = chunk[8];
+                image.colorType = chunk[9];
+                if (width == 0 || height == 0 || width > (1u << 24) || height > (1u << 24) || depth != 8 || chunk[10] != 0 || chunk[11] != 0 ||
+                    chunk[12] != 0)
+                    return false;
+                image.width = static_cast<int>(width);
+                image.height = static_cast<int>(height);
+                switch (image.colorType)
+                {
+                case COLOR_GRAY:
+                case COLOR_PALETTE:
+                    image.channels = 1;
+                    break;
+                case COLOR_GRAY_ALPHA:
+                    image.channels = 2;
+                    break;
+                case COLOR_RGB:
+                    image.channels = 3;
+                    break;
+                case COLOR_RGBA:
+                    image.channels = 4;
+                    break;
+                default:
+                    return false;
+                }
+                break;
+            }
+            case chunkType('P', 'L', 'T', 'E'):
+                if (length % 3 != 0 || length > 256 * 3)
+                    return false;
+                paletteSize = static_cast<int>(length / 3);
+                for (int i = 0; i < paletteSize; i++)
+                    std::memcpy(image.palette + i * 4, chunk + i * 3, 3);
+                break;
+            case chunkType('t', 'R', 'N', 'S'):
+                if (image.colorType == COLOR_PALETTE)
+                {
+                    if (length > static_cast<size_t>(paletteSize))
+                        return false;
+                    for (size_t i = 0; i < length; i++)
+                        image.palette[i * 4 + 3] = chunk[i];
+                }
+                else if (image.colorType == COLOR_GRAY || image.colorType == COLOR_RGB)
+                {
+                    // 16 bit samples; an 8 bit image only uses their low byte
+                    const int samples = image.colorType == COLOR_RGB ? 3 : 1;
+                    if (length != static_cast<size_t>(samples) * 2)
+                        return false;
+                    for (int c = 0; c < samples; c++)
+                        image.transparentColor[c] = chunk[c * 2 + 1];
+                }
+                else
+                    return false;
+                image.transparent = true;
+                break;
+            case chunkType('I', 'D', 'A', 'T'):
+                image.idat.push_back(chunk);
+                image.idatSizes.push_back(length);
+                break;
+            case chunkType('I', 'E', 'N', 'D'):
+                return !image.idat.empty() && (image.colorType != COLOR_PALETTE || paletteSize > 0);
+            default:
+                if (!(type & (1u << 29)) || type == chunkType('C', 'g', 'B', 'I'))
+                    return false; // critical, or Apple's premultiplied BGRA
+                break;
+            }
+            p += 12 + length;
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // Inflate
+    //-------------------------------------------------------------------------
+
+    // Code lengths the lookup tables resolve in one step
+    constexpr int FAST_BITS = 10;
+
+    const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    struct Huffman
+    {
+        uint16_t fast[1 << FAST_BITS]; // symbol << 4 | length for short codes, 0 for longer ones
+        int limit[17];                 // one past the last code of each length, left aligned to 16 bits
+        int firstCode[17];
+        int firstSymbol[17];
+        uint16_t symbols[288];
+    };
+
+    int reverseBits(int code, int length)
+    {
+        int reversed = 0;
+        for (int i = 0; i < length; i++, code >>= 1)
+            reversed = reversed << 1 | (code & 1);
+        return reversed;
+    }
+
+    //-------------------------------------------------------------------------
+    // Canonical codes from count code lengths. Deflate sends codes first bit
+    // first, so the lookup table is indexed by the reversed code.
+    // Over-subscribed lengths are rejected; incomplete codes are allowed
+    // (e.g. a single distance code) and fail when a missing code shows up.
+    //-------------------------------------------------------------------------
+    bool buildHuffman(const uint8_t *lengths, int count, Huffman &table)
+    {
+        int lengthCounts[17] = {};
+        for (int i = 0; i < count; i++)
+            lengthCounts[lengths[i]]++;
+        lengthCounts[0] = 0;
+        std::fill(std::begin(table.fast), std::end(table.fast), uint16_t(0));
+
+        int nextCode[17];
+        int code = 0, symbol = 0;
+        for (int length = 1; length <= 16; length++)
+        {
+            nextCode[length] = code;
+            table.firstCode[length] = code;
+            table.firstSymbol[length] = symbol;
+            code += length <= 15 ? lengthCounts[length] : 0;
+            if (length <= 15 && code > (1 << length))
+                return false;
+            table.limit[length] = code << (16 - length);
+            symbol += length <= 15 ? lengthCounts[length] : 0;
+            code <<= 1;
+        }
+        table.limit[16] = 0x10000; // ends the search
+
+        for (int i = 0; i < count; i++)
+        {
+            const int length = lengths[i];
+            if (length == 0)
+                continue;
+            const int slot = table.firstSymbol[length] + nextCode[length] - table.firstCode[length];
+            table.symbols[slot] = static_cast<uint16_t>(i);
+            if (length <= FAST_BITS)
+            {
+                const uint16_t entry = static_cast<uint16_t>(i << 4 | length);
+                for (int j = reverseBits(nextCode[length], length); j < (1 << FAST_BITS); j += 1 << length)
+                    table.fast[j] = entry;
+            }
+            nextCode[length]++;
+        }
+        return true;
+    }
+
+    struct Progress
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        size_t inflated = 0; // bytes of filtered scanlines ready
+        bool finished = false;
+        bool failed = false;
+        bool cancelled = false; // the unfilter stage gave up
+    };
+
+    //-------------------------------------------------------------------------
+    // Inflates a zlib stream split over the IDAT chunks into out, reporting
+    // the bytes ready every PUBLISH_BYTES
+    //-------------------------------------------------------------------------
+    class Inflater
+    {
+    public:
+        Inflater(const unsigned char *data, size_t size, unsigned char *out, size_t outSize, Progress &progress)
+            : mData(data), mSize(size), mPosition(0), mBits(0), mCount(0), mBegin(out), mOut(out), mEnd(out + outSize),
+              mPublished(out), mProgress(progress)
+        {
+        }
+
+        bool run()
+        {
+            if (mSize < 2)
+                return false;
+            const int cmf = mData[0], flg = mData[1];
+            if ((cmf * 256 + flg) % 31 != 0 || (cmf & 15) != 8 || (flg & 32) != 0)
+                return false;
+            mPosition = 2;
+
+            bool last = false;
+            while (!last)
+            {
+                refill();
+                last = take(1) != 0;
+                const uint64_t type = take(2);
+                bool ok = false;
+                if (type == 0)
+                    ok = storedBlock();
+                else if (type == 1)
+                    ok = fixedBlock();
+                else if (type == 2)
+                    ok = dynamicBlock();
+                if (!ok || !publish(false))
+                    return false;
+            }
+            return mOut == mEnd && mPosition - mCount / 8 <= mSize;
+        }
+
+    private:
+        // Tops the buffer up to at least 57 bits; reads past the end give zeros
+        void refill()
+        {
+            while (mCount <= 56)
+            {
+                const uint64_t byte = mPosition < mSize ? mData[mPosition] : 0;
+                mBits |= byte << mCount;
+                mPosition++;
+                mCount += 8;
+            }
+        }
+
+        uint64_t take(int count)
+        {
+            const uint64_t value = mBits & ((uint64_t(1) << count) - 1);
+            mBits >>= count;
+            mCount -= count;
+            return value;
+        }
+
+        // Next symbol; the buffer must hold 15 bits. -1 for a missing code.
+        int decode(const Huffman &table)
+        {
+            const uint16_t entry = table.fast[mBits & ((1 << FAST_BITS) - 1)];
+            if (entry != 0)
+            {
+                take(entry & 15);
+                return entry >> 4;
+            }
+            const int code = reverseBits(static_cast<int>(mBits & 0xFFFF), 16);
+            int length = FAST_BITS + 1;
+            while (code >= table.limit[length])
+                length++;
+            if (length > 15)
+                return -1;
+            take(length);
+            const int slot = table.firstSymbol[length] + (code >> (16 - length)) - table.firstCode[length];
+            return slot < 288 ? table.symbols[slot] : -1;
+        }
+
+        // Every PUBLISH_BYTES, or always when force is set. False once the
+        // unfilter stage has given up.
+        bool publish(bool force)
+        {
+            if (!force && mOut - mPublished < static_cast<ptrdiff_t>(PUBLISH_BYTES))
+                return true;
+            mPublished = mOut;
+            std::lock_guard<std::mutex> lock(mProgress.mutex);
+            mProgress.inflated = static_cast<size_t>(mOut - mBegin);
+            mProgress.changed.notify_one();
+            return !mProgress.cancelled;
+        }
+
+        bool storedBlock()
+        {
+            // Back to whole bytes; the buffered ones are read again directly
+            take(mCount % 8);
+            mPosition -= mCount / 8;
+            mBits = 0;
+            mCount = 0;
+            if (mPosition + 4 > mSize)
+                return false;
+            const size_t length = mData[mPosition] | mData[mPosition + 1] << 8;
+            const size_t check = mData[mPosition + 2] | mData[mPosition + 3] << 8;
+            mPosition += 4;
+            if ((length ^ 0xFFFF) != check || length > mSize - mPosition || length > static_cast<size_t>(mEnd - mOut))
+                return false;
+            std::memcpy(mOut, mData + mPosition, length);
+            mOut += length;
+            mPosition += length;
+            return true;
+        }
+
+        bool fixedBlock()
+        {
+            static const struct FixedTables
+            {
+                Huffman literals, distances;
+                FixedTables()
+                {
+                    uint8_t lengths[288];
+                    std::fill(lengths, lengths + 144, uint8_t(8));
+                    std::fill(lengths + 144, lengths + 256, uint8_t(9));
+                    std::fill(lengths + 256, lengths + 280, uint8_t(7));
+                    std::fill(lengths + 280, lengths + 288, uint8_t(8));
+                    buildHuffman(lengths, 288, literals);
+                    std::fill(lengths, lengths + 30, uint8_t(5));
+                    buildHuffman(lengths, 30, distances);
+                }
+            } tables;
+            return codedBlock(tables.literals, tables.distances);
+        }
+
+        bool dynamicBlock()
+        {
+            refill();
+            const int literalCount = static_cast<int>(take(5)) + 257;
+            const int distanceCount = static_cast<int>(take(5)) + 1;
+            const int codeLengthCount = static_cast<int>(take(4)) + 4;
+            if (literalCount > 286 || distanceCount > 30)
+                return false;
+
+            uint8_t codeLengths[19] = {};
+            for (int i = 0; i < codeLengthCount; i++)
+            {
+                refill();
+                codeLengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(take(3));
+            }
+            Huffman codeLengthTable;
+            if (!buildHuffman(codeLengths, 19, codeLengthTable))
+                return false;
+
+            uint8_t lengths[286 + 30];
+            const int total = literalCount + distanceCount;
+            for (int n = 0; n < total;)
+            {
+                refill();
+                const int symbol = decode(codeLengthTable);
+                if (symbol < 0)
+                    return false;
+                if (symbol < 16)
+                {
+                    lengths[n++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint8_t value = 0;
+                int repeat;
+                if (symbol == 16)
+                {
+                    if (n == 0)
+                        return false;
+                    value = lengths[n - 1];
+                    repeat = 3 + static_cast<int>(take(2));
+                }
+                else if (symbol == 17)
+                    repeat = 3 + static_cast<int>(take(3));
+                else
+                    repeat = 11 + static_cast<int>(take(7));
+                if (repeat > total - n)
+                    return false;
+                std::fill(lengths + n, lengths + n + repeat, value);
+                n += repeat;
+            }
+            if (lengths[256] == 0)
+                return false; // no end of block code
+
+            Huffman literals, distances;
+            return buildHuffman(lengths, literalCount, literals) && buildHuffman(lengths + literalCount, distanceCount, distances) &&
+                   codedBlock(literals, distances);
+        }
+
+        //---------------------------------------------------------------------
+        // One refill covers a whole length and distance pair: at most 15 + 5
+        // + 15 + 13 bits
+        //---------------------------------------------------------------------
+        bool codedBlock(const Huffman &literals, const Huffman &distances)
+        {
+            for (;;)
+            {
+                refill();
+                int symbol = decode(literals);
+                if (symbol < 256)
+                {
+                    if (symbol < 0 || mOut == mEnd)
+                        return false;
+                    *mOut++ = static_cast<unsigned char>(symbol);
+                    continue;
+                }
+                if (symbol == 256)
+                    return true;
+
+                symbol -= 257;
+                if (symbol >= 29)
+                    return false;
+                const size_t length = LENGTH_BASE[symbol] + take(LENGTH_EXTRA[symbol]);
+                symbol = decode(distances);
+                if (symbol < 0 || symbol >= 30)
+                    return false;
+                const size_t distance = DISTANCE_BASE[symbol] + take(DISTANCE_EXTRA[symbol]);
+                if (distance > static_cast<size_t>(mOut - mBegin) || length > static_cast<size_t>(mEnd - mOut))
+                    return false;
+
+                const unsigned char *from = mOut - distance;
+                if (distance >= length)
+                    std::memcpy(mOut, from, length);
+                else if (distance == 1)
+                    std::memset(mOut, *from, length);
+                else
+                {
+                    for (size_t i = 0; i < length; i++)
+                        mOut[i] = from[i];
+                }
+                mOut += length;
+                if (!publish(false))
+                    return false;
+            }
+        }
+
+        const unsigned char *mData;
+        size_t mSize;
+        size_t mPosition; // next byte to buffer, possibly past the end
+        uint64_t mBits;   // next bits, first in the lowest
+        int mCount;
+        unsigned char *mBegin;
+        unsigned char *mOut;
+        unsigned char *mEnd;
+        unsigned char *mPublished;
+        Progress &mProgress;
+
+    public:
+        // The last publish also covers the tail of the stream
+        void finish(bool ok)
+        {
+            publish(true);
+            std::lock_guard<std::mutex> lock(mProgress.mutex);
+            mProgress.finished = true;
+            mProgress.failed = !ok;
+            mProgress.changed.notify_one();
+        }
+    };
+
+    //-------------------------------------------------------------------------
+    // Unfilter and conversion
+    //-------------------------------------------------------------------------
+    int paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    //-------------------------------------------------------------------------
+    // Undoes the filter of a scanline of size bytes against the previous
+    // unfiltered one (zeros for the first). False for an unknown filter.
+    //-------------------------------------------------------------------------
+    bool unfilterRow(int filter, const unsigned char *source, const unsigned char *previous, unsigned char *row, size_t size, int channels)
+    {
+        const size_t bpp = static_cast<size_t>(channels);
+        switch (filter)
+        {
+        case 0:
+            std::memcpy(row, source, size);
+            return true;
+        case 1:
+            std::memcpy(row, source, bpp);
+            for (size_t i = bpp; i < size; i++)
+                row[i] = static_cast<unsigned char>(source[i] + row[i - bpp]);
+            return true;
+        case 2:
+            for (size_t i = 0; i < size; i++)
+                row[i] = static_cast<unsigned char>(source[i] + previous[i]);
+            return true;
+        case 3:
+            for (size_t i = 0; i < bpp; i++)
+                row[i] = static_cast<unsigned char>(source[i] + (previous[i] >> 1));
+            for (size_t i = bpp; i < size; i++)
+                row[i] = static_cast<unsigned char>(source[i] + ((row[i - bpp] + previous[i]) >> 1));
+            return true;
+        case 4:
+            for (size_t i = 0; i < bpp; i++)
+                row[i] = static_cast<unsigned char>(source[i] + previous[i]);
+            for (size_t i = bpp; i < size; i++)
+                row[i] = static_cast<unsigned char>(source[i] + paeth(row[i - bpp], previous[i], previous[i - bpp]));
+            return true;
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // One unfiltered scanline to RGBA8, as stbi_load expands it
+    //-------------------------------------------------------------------------
+    void convertRow(const Image &image, const unsigned char *row, unsigned char *out)
+    {
+        const int width = image.width;
+        const unsigned char *key = image.transparentColor;
+        switch (image.colorType)
+        {
+        case COLOR_GRAY:
+            for (int x = 0; x < width; x++, out += 4)
+            {
+                out[0] = out[1] = out[2] = row[x];
+                out[3] = image.transparent && row[x] == key[0] ? 0 : 255;
+            }
+            break;
+        case COLOR_GRAY_ALPHA:
+            for (int x = 0; x < width; x++, out += 4)
+            {
+                out[0] = out[1] = out[2] = row[x * 2];
+                out[3] = row[x * 2 + 1];
+            }
+            break;
+        case COLOR_RGB:
+            for (int x = 0; x < width; x++, out += 4, row += 3)
+            {
+                out[0] = row[0];
+                out[1] = row[1];
+                out[2] = row[2];
+                out[3] = image.transparent && row[0] == key[0] && row[1] == key[1] && row[2] == key[2] ? 0 : 255;
+            }
+            break;
+        case COLOR_PALETTE:
+            for (int x = 0; x < width; x++, out += 4)
+                std::memcpy(out, image.palette + row[x] * 4, 4);
+            break;
+        default:
+            std::memcpy(out, row, static_cast<size_t>(width) * 4);
+            break;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The inflate stage fills the filtered image and reports how far it got;
+// the unfilter stage waits for each scanline, undoes its filter against
+// the previous one and converts it into the result
+//-----------------------------------------------------------------------------
+unsigned char *ParallelPng::decode(const std::string &fileName, int &width, int &height, int &components, const DecodedRows *rows)
+{
+    MappedFile file;
+    if (workerThreadCount() < 2 || !file.open(fileName))
+        return nullptr;
+
+    Image image;
+    if (!parseChunks(file.data(), file.size(), image) || static_cast<uint64_t>(image.width) * image.height < MIN_PIXELS)
+        return nullptr;
+
+    // The zlib stream continues across IDAT chunks; usually there are many
+    // small ones, which are joined so the inflater reads one buffer
+    std::vector<unsigned char> joined;
+    const unsigned char *stream = image.idat[0];
+    size_t streamSize = image.idatSizes[0];
+    if (image.idat.size() > 1)
+    {
+        for (size_t i = 0; i < image.idat.size(); i++)
+            joined.insert(joined.end(), image.idat[i], image.idat[i] + image.idatSizes[i]);
+        stream = joined.data();
+        streamSize = joined.size();
+    }
+
+    const size_t rowSize = static_cast<size_t>(image.width) * image.channels;
+    const size_t filteredRowSize = rowSize + 1; // with the filter type byte
+    std::vector<unsigned char> filtered;
+    unsigned char *pixels = nullptr;
+    try
+    {
+        filtered.resize(filteredRowSize * image.height);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+    const size_t outRowSize = static_cast<size_t>(image.width) * 4;
+    pixels = static_cast<unsigned char *>(std::malloc(outRowSize * image.height));
+    if (pixels == nullptr)
+        return nullptr;
+
+    int fileComponents;
+    switch (image.colorType)
+    {
+    case COLOR_GRAY:
+        fileComponents = image.transparent ? 2 : 1;
+        break;
+    case COLOR_GRAY_ALPHA:
+        fileComponents = 2;
+        break;
+    case COLOR_RGB:
+    case COLOR_PALETTE:
+        fileComponents = image.transparent ? 4 : 3;
+        break;
+    default:
+        fileComponents = 4;
+        break;
+    }
+    if (rows != nullptr)
+        rows->started(pixels, image.width, image.height, fileComponents);
+
+    Progress progress;
+    bool unfiltered = false;
+    parallelFor(2, [&](size_t stage)
+                {
+        if (stage == 0)
+        {
+            Inflater inflater(stream, streamSize, filtered.data(), filtered.size(), progress);
+            inflater.finish(inflater.run());
+            return;
+        }
+
+        const int bandRows = static_cast<int>(std::max<size_t>(BAND_BYTES / outRowSize, 1));
+        std::vector<unsigned char> previous(rowSize, 0), row(rowSize);
+        for (int y = 0; y < image.height; y++)
+        {
+            const size_t needed = filteredRowSize * (y + 1);
+            {
+                std::unique_lock<std::mutex> lock(progress.mutex);
+                progress.changed.wait(lock, [&]
+                                      { return progress.inflated >= needed || progress.finished; });
+                if (progress.inflated < needed || progress.failed)
+                    return;
+            }
+            const unsigned char *source = filtered.data() + filteredRowSize * y;
+            if (!unfilterRow(source[0], source + 1, previous.data(), row.data(), rowSize, image.channels))
+            {
+                std::lock_guard<std::mutex> lock(progress.mutex);
+                progress.cancelled = true;
+                return;
+            }
+            convertRow(image, row.data(), pixels + outRowSize * y);
+            row.swap(previous);
+            if (rows != nullptr && ((y + 1) % bandRows == 0 || y + 1 == image.height))
+                rows->decoded(y / bandRows * bandRows, y % bandRows + 1);
+        }
+        unfiltered = true; });
+
+    if (!unfiltered || progress.failed)
+    {
+        if (rows != nullptr)
+            rows->abandoned();
+        std::free(pixels);
+        return nullptr;
+    }
+
+    width = image.width;
+    height = image.height;
+    components = fileComponents;
+    return pixels;
+}
@@ -0,0 +1,593 @@
+//-----------------------------------------------------------------------------
+// PlyLoader.cpp
+//
+// Native binary PLY reader used instead of Assimp for .ply files
+//
+// The file is mapped and only its text header is parsed up front. Vertex
+// records have a fixed size, so they are decoded in parallel chunks straight
+// from the mapping. Face records are lists and in general have to be walked
+// one by one; scanners almost always write triangles only, so the face
+// element is first assumed to have a fixed triangle stride and decoded in
+// parallel, checking every record's corner count. If any record is not a
+// triangle the faces are walked serially instead.
+//-----------------------------------------------------------------------------
+#include "PlyLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // Records per work item of the parallel passes
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    enum class ScalarType
+    {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64,
+        Invalid
+    };
+
+    struct Property
+    {
+        std::string name;
+        ScalarType type = ScalarType::Invalid; // of the values of a list
+        bool isList = false;
+        ScalarType countType = ScalarType::Invalid;
+    };
+
+    struct Element
+    {
+        std::string name;
+        uint64_t count = 0;
+        std::vector<Property> properties;
+    };
+
+    struct Header
+    {
+        bool bigEndian = false;
+        size_t size = 0; // bytes up to and including end_header
+        std::vector<Element> elements;
+    };
+
+    ScalarType parseType(const std::string &name)
+    {
+        if (name == "char" || name == "int8")
+            return ScalarType::Int8;
+        if (name == "uchar" || name == "uint8")
+            return ScalarType::UInt8;
+        if (name == "short" || name == "int16")
+            return ScalarType::Int16;
+        if (name == "ushort" || name == "uint16")
+            return ScalarType::UInt16;
+        if (name == "int" || name == "int32")
+            return ScalarType::Int32;
+        if (name == "uint" || name == "uint32")
+            return ScalarType::UInt32;
+        if (name == "float" || name == "float32")
+            return ScalarType::Float32;
+        if (name == "double" || name == "float64")
+            return ScalarType::Float64;
+        return ScalarType::Invalid;
+    }
+
+    size_t typeSize(ScalarType type)
+    {
+        switch (type)
+        {
+        case ScalarType::Int8:
+        case ScalarType::UInt8:
+            return 1;
+        case ScalarType::Int16:
+        case ScalarType::UInt16:
+            return 2;
+        case ScalarType::Int32:
+        case ScalarType::UInt32:
+        case ScalarType::Float32:
+            return 4;
+        case ScalarType::Float64:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Reads one value of the given type, swapping its bytes for big endian
+    // files
+    //-------------------------------------------------------------------------
+    template <typename T>
+    inline T readRaw(const unsigned char *p, bool swap)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, p, sizeof(T));
+        if (swap)
+            std::reverse(bytes, bytes + sizeof(T));
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    double readScalar(const unsigned char *p, ScalarType type, bool swap)
+    {
+        switch (type)
+        {
+        case ScalarType::Int8:
+            return static_cast<int8_t>(*p);
+        case ScalarType::UInt8:
+            return *p;
+        case ScalarType::Int16:
+            return readRaw<int16_t>(p, swap);
+        case ScalarType::UInt16:
+            return readRaw<uint16_t>(p, swap);
+        case ScalarType::Int32:
+            return readRaw<int32_t>(p, swap);
+        case ScalarType::UInt32:
+            return readRaw<uint32_t>(p, swap);
+        case ScalarType::Float32:
+            return readRaw<float>(p, swap);
+        case ScalarType::Float64:
+            return readRaw<double>(p, swap);
+        default:
+            return 0.0;
+        }
+    }
+
+    // Negative indices read as huge values and fail the range check
+    inline uint64_t readIndex(const unsigned char *p, ScalarType type, bool swap)
+    {
+        double value = readScalar(p, type, swap);
+        return value < 0.0 ? ~0ull : static_cast<uint64_t>(value);
+    }
+
+    //-------------------------------------------------------------------------
+    // Parses the text header. Returns false for ASCII and malformed files.
+    //-------------------------------------------------------------------------
+    bool parseHeader(const unsigned char *data, size_t size, Header &header)
+    {
+        const char *text = reinterpret_cast<const char *>(data);
+        const char *end = text + size;
+        const char *line = text;
+        bool sawFormat = false;
+
+        if (size < 4 || std::memcmp(text, "ply", 3) != 0 || (text[3] != '\n' && text[3] != '\r'))
+            return false;
+
+        while (line < end)
+        {
+            const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+            if (!lineEnd)
+                return false;
+
+            std::istringstream stream(std::string(line, lineEnd));
+            std::string keyword;
+            stream >> keyword;
+            line = lineEnd + 1;
+
+            if (keyword == "format")
+            {
+                std::string format;
+                stream >> format;
+                if (format == "binary_big_endian")
+                    header.bigEndian = true;
+                else if (format != "binary_little_endian")
+                    return false;
+                sawFormat = true;
+            }
+            else if (keyword == "element")
+            {
+                Element element;
+                if (!(stream >> element.name >> element.count))
+                    return false;
+                header.elements.push_back(element);
+            }
+            else if (keyword == "property")
+            {
+                if (header.elements.empty())
+                    return false;
+
+                Property property;
+                std::string type;
+                stream >> type;
+                if (type == "list")
+                {
+                    std::string countType;
+                    stream >> countType >> type;
+                    property.isList = true;
+                    property.countType = parseType(countType);
+                    if (property.countType == ScalarType::Invalid)
+                        return false;
+                }
+                property.type = parseType(type);
+                if (property.type == ScalarType::Invalid || !(stream >> property.name))
+                    return false;
+                header.elements.back().properties.push_back(property);
+            }
+            else if (keyword == "end_header")
+            {
+                header.size = line - text;
+                return sawFormat;
+            }
+        }
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    // Record size of an element without list properties, 0 otherwise
+    //-------------------------------------------------------------------------
+    size_t fixedStride(const Element &element)
+    {
+        size_t stride = 0;
+        for (const Property &property : element.properties)
+        {
+            if (property.isList)
+                return 0;
+            stride += typeSize(property.type);
+        }
+        return stride;
+    }
+
+    //-------------------------------------------------------------------------
+    // Size of the record at p, or 0 if it runs past end
+    //-------------------------------------------------------------------------
+    size_t recordSize(const Element &element, const unsigned char *p, const unsigned char *end, bool swap)
+    {
+        size_t size = 0;
+        for (const Property &property : element.properties)
+        {
+            if (!property.isList)
+            {
+                size += typeSize(property.type);
+                continue;
+            }
+
+            size_t countSize = typeSize(property.countType);
+            if (static_cast<size_t>(end - p) < size + countSize)
+                return 0;
+            uint64_t count = readIndex(p + size, property.countType, swap);
+            if (count > (static_cast<size_t>(end - p) - size - countSize) / typeSize(property.type))
+                return 0;
+            size += countSize + count * typeSize(property.type);
+        }
+        return size <= static_cast<size_t>(end - p) ? size : 0;
+    }
+
+    //-------------------------------------------------------------------------
+    // Byte size of a whole element starting at p, or 0 if it runs past end
+    //-------------------------------------------------------------------------
+    size_t elementSize(const Element &element, const unsigned char *p, const unsigned char *end, bool swap)
+    {
+        size_t stride = fixedStride(element);
+        if (stride > 0 || element.properties.empty())
+        {
+            if (element.count > static_cast<size_t>(end - p) / std::max<size_t>(stride, 1))
+                return 0;
+            return static_cast<size_t>(element.count) * stride;
+        }
+
+        const unsigned char *record = p;
+        for (uint64_t i = 0; i < element.count; i++)
+        {
+            size_t size = recordSize(element, record, end, swap);
+            if (size == 0)
+                return 0;
+            record += size;
+        }
+        return record - p;
+    }
+
+    int findProperty(const Element &element, std::initializer_list<const char *> names)
+    {
+        for (const char *name : names)
+        {
+            for (size_t i = 0; i < element.properties.size(); i++)
+            {
+                if (!element.properties[i].isList && element.properties[i].name == name)
+                    return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    size_t propertyOffset(const Element &element, int index)
+    {
+        size_t offset = 0;
+        for (int i = 0; i < index; i++)
+            offset += typeSize(element.properties[i].type);
+        return offset;
+    }
+
+    //-------------------------------------------------------------------------
+    // Decodes the vertex element. Returns false if it lacks a position.
+    //-------------------------------------------------------------------------
+    bool readVertices(const Element &element, const unsigned char *data, bool swap, std::vector<Vertex> &vertices,
+                      LoadProgress *progress)
+    {
+        const int position[3] = {findProperty(element, {"x"}), findProperty(element, {"y"}), findProperty(element, {"z"})};
+        const int texCoord[2] = {findProperty(element, {"u", "s", "texture_u", "texture_s"}),
+                                 findProperty(element, {"v", "t", "texture_v", "texture_t"})};
+        if (position[0] < 0 || position[1] < 0 || position[2] < 0)
+            return false;
+
+        const size_t stride = fixedStride(element);
+        size_t positionOffsets[3];
+        ScalarType positionTypes[3];
+        for (int i = 0; i < 3; i++)
+        {
+            positionOffsets[i] = propertyOffset(element, position[i]);
+            positionTypes[i] = element.properties[position[i]].type;
+        }
+        const bool hasTexCoords = texCoord[0] >= 0 && texCoord[1] >= 0;
+        size_t texCoordOffsets[2] = {0, 0};
+        ScalarType texCoordTypes[2] = {ScalarType::Float32, ScalarType::Float32};
+        for (int i = 0; i < 2 && hasTexCoords; i++)
+        {
+            texCoordOffsets[i] = propertyOffset(element, texCoord[i]);
+            texCoordTypes[i] = element.properties[texCoord[i]].type;
+        }
+
+        vertices.resize(static_cast<size_t>(element.count));
+        const size_t chunks = (vertices.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::atomic<size_t> done(0);
+        parallelFor(chunks, [&](size_t c)
+                    {
+                        if (progress && progress->isCancelled())
+                            return;
+
+                        size_t end = std::min(vertices.size(), (c + 1) * CHUNK_SIZE);
+                        for (size_t i = c * CHUNK_SIZE; i < end; i++)
+                        {
+                            const unsigned char *record = data + i * stride;
+                            Vertex &vertex = vertices[i];
+                            for (int k = 0; k < 3; k++)
+                                vertex.position[k] = static_cast<float>(readScalar(record + positionOffsets[k], positionTypes[k], swap));
+                            vertex.texCoords = glm::vec2(0.0f);
+                            if (hasTexCoords)
+                            {
+                                vertex.texCoords.x = static_cast<float>(readScalar(record + texCoordOffsets[0], texCoordTypes[0], swap));
+                                vertex.texCoords.y = 1.0f - static_cast<float>(readScalar(record + texCoordOffsets[1], texCoordTypes[1], swap));
+                            }
+                        }
+
+                        if (progress)
+                            progress->report("Parsing PLY", 0.5f * ++done / chunks); });
+
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Decodes a face element whose records are all triangles of one fixed
+    // stride. Returns false if any record is not, leaving indices undefined.
+    //-------------------------------------------------------------------------
+    bool readTriangles(const Element &element, int list, const unsigned char *data, const unsigned char *end, bool swap,
+                       uint64_t vertexCount, std::vector<unsigned int> &indices, bool &valid, LoadProgress *progress)
+    {
+        const Property &indexList = element.properties[list];
+        const size_t countSize = typeSize(indexList.countType);
+        const size_t indexSize = typeSize(indexList.type);
+        const size_t listOffset = propertyOffset(element, list);
+
+        size_t stride = countSize + 3 * indexSize;
+        for (const Property &property : element.properties)
+        {
+            if (&property == &indexList)
+                continue;
+            if (property.isList)
+                return false;
+            stride += typeSize(property.type);
+        }
+        if (element.count > static_cast<size_t>(end - data) / stride)
+            return false;
+
+        indices.resize(3 * static_cast<size_t>(element.count));
+        const size_t chunks = (static_cast<size_t>(element.count) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::atomic<bool> triangles(true);
+        std::atomic<bool> inRange(true);
+        std::atomic<size_t> done(0);
+        parallelFor(chunks, [&](size_t c)
+                    {
+                        if (!triangles || (progress && progress->isCancelled()))
+                            return;
+
+                        size_t last = std::min<size_t>(element.count, (c + 1) * CHUNK_SIZE);
+                        for (size_t i = c * CHUNK_SIZE; i < last; i++)
+                        {
+                            const unsigned char *record = data + i * stride + listOffset;
+                            if (readIndex(record, indexList.countType, swap) != 3)
+                            {
+                                triangles = false;
+                                return;
+                            }
+                            for (int k = 0; k < 3; k++)
+                            {
+                                uint64_t index = readIndex(record + countSize + k * indexSize, indexList.type, swap);
+                                if (index >= vertexCount)
+                                    inRange = false;
+                                indices[3 * i + k] = static_cast<unsigned int>(index);
+                            }
+                        }
+
+                        if (progress)
+                            progress->report("Parsing PLY", 0.5f + 0.5f * ++done / chunks); });
+
+        valid = inRange;
+        return triangles;
+    }
+
+    //-------------------------------------------------------------------------
+    // Walks the face records one by one, fan-triangulating polygons the same
+    // way aiProcess_Triangulate does
+    //-------------------------------------------------------------------------
+    bool readPolygons(const Element &element, int list, const unsigned char *data, const unsigned char *end, bool swap,
+                      uint64_t vertexCount, std::vector<unsigned int> &indices)
+    {
+        const Property &indexList = element.properties[list];
+        const size_t countSize = typeSize(indexList.countType);
+        const size_t indexSize = typeSize(indexList.type);
+
+        indices.clear();
+        const unsigned char *record = data;
+        for (uint64_t f = 0; f < element.count; f++)
+        {
+            size_t size = recordSize(element, record, end, swap);
+            if (size == 0)
+                return false;
+
+            // The list's offset depends on any lists before it
+            const unsigned char *p = record;
+            for (int i = 0; i < list; i++)
+            {
+                const Property &property = element.properties[i];
+                if (property.isList)
+                    p += countSize + readIndex(p, property.countType, swap) * typeSize(property.type);
+                else
+                    p += typeSize(property.type);
+            }
+
+            uint64_t corners = readIndex(p, indexList.countType, swap);
+            p += countSize;
+            for (uint64_t k = 1; k + 1 < corners; k++)
+            {
+                const uint64_t fan[3] = {0, k, k + 1};
+                for (uint64_t corner : fan)
+                {
+                    uint64_t index = readIndex(p + corner * indexSize, indexList.type, swap);
+                    if (index >= vertexCount)
+                        return false;
+                    indices.push_back(static_cast<unsigned int>(index));
+                }
+            }
+            record += size;
+        }
+        return true;
+    }
+}
+
+bool PlyLoader::load(const std::string &filename, MeshData &mesh, LoadProgress *progress)
+{
+    if (progress)
+        progress->report("Reading file", 0.0f);
+
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        std::cerr << "ERROR::PLY::Unable to open '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    Header header;
+    if (!parseHeader(file.data(), file.size(), header))
+    {
+        std::cout << "PLY: '" << filename << "' is not a binary PLY file" << std::endl;
+        return false;
+    }
+    const bool swap = header.bigEndian;
+
+    // Find the vertex and face elements, skipping over any others
+    const unsigned char *end = file.data() + file.size();
+    const unsigned char *p = file.data() + header.size;
+    const Element *vertexElement = nullptr;
+    const Element *faceElement = nullptr;
+    const unsigned char *vertexData = nullptr;
+    const unsigned char *faceData = nullptr;
+    for (const Element &element : header.elements)
+    {
+        if (element.name == "vertex" && !vertexElement)
+        {
+            vertexElement = &element;
+            vertexData = p;
+        }
+        else if (element.name == "face" && !faceElement)
+        {
+            faceElement = &element;
+            faceData = p;
+            break; // nothing after the faces is needed
+        }
+
+        size_t size = elementSize(element, p, end, swap);
+        if (size == 0 && element.count > 0 && !element.properties.empty())
+        {
+            std::cerr << "ERROR::PLY::'" << filename << "' is truncated in element '" << element.name << "'" << std::endl;
+            return false;
+        }
+        p += size;
+    }
+
+    if (!vertexElement || vertexElement->count == 0 || fixedStride(*vertexElement) == 0 ||
+        vertexElement->count > 0xFFFFFFFFull)
+    {
+        std::cerr << "ERROR::PLY::'" << filename << "' has no usable vertex element" << std::endl;
+        return false;
+    }
+
+    mesh.clear();
+    if (!readVertices(*vertexElement, vertexData, swap, mesh.vertices, progress))
+    {
+        std::cerr << "ERROR::PLY::'" << filename << "' has vertices without x, y and z" << std::endl;
+        mesh.clear();
+        return false;
+    }
+    if (progress && progress->isCancelled())
+    {
+        mesh.clear();
+        return false;
+    }
+
+    int indexList = -1;
+    if (faceElement)
+    {
+        for (size_t i = 0; i < faceElement->properties.size(); i++)
+        {
+            const std::string &name = faceElement->properties[i].name;
+            if (faceElement->properties[i].isList && (name == "vertex_indices" || name == "vertex_index"))
+                indexList = static_cast<int>(i);
+        }
+    }
+
+    bool polygons = false;
+    if (indexList >= 0 && faceElement->count > 0)
+    {
+        bool valid = true;
+        if (!readTriangles(*faceElement, indexList, faceData, end, swap, vertexElement->count, mesh.indices, valid, progress))
+        {
+            polygons = true;
+            valid = readPolygons(*faceElement, indexList, faceData, end, swap, vertexElement->count, mesh.indices);
+        }
+        if (progress && progress->isCancelled())
+        {
+            mesh.clear();
+            return false;
+        }
+        if (!valid || mesh.indices.size() > 0xFFFFFFFFull)
+        {
+            std::cerr << "ERROR::PLY::'" << filename << "' has a malformed face or an out of range index" << std::endl;
+            mesh.clear();
+            return false;
+        }
+    }
+
+    SubMesh subMesh = {};
+    subMesh.indexCount = static_cast<unsigned int>(mesh.indices.size());
+    subMesh.vertexCount = static_cast<unsigned int>(mesh.vertices.size());
+    mesh.subMeshes.push_back(subMesh);
+    computeSubMeshBounds(mesh);
+
+    if (mesh.indices.empty())
+        std::cout << "PLY: " << mesh.vertices.size() << " points, no faces" << std::endl;
+    else
+        std::cout << "PLY: " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles"
+                  << (polygons ? " (polygons walked serially)" : "") << std::endl;
+    return true;
+}
@@ -0,0 +1,406 @@
+//-----------------------------------------------------------------------------
+// PointCloud.cpp
+//
+// Level of detail rendering of large point sets
+//
+// The octree is built top down one level at a time, the nodes of a level in
+// parallel. Splitting a node keeps the first point that falls into every
+// cell of its sampling grid and sorts the rest by octant, all within the
+// node's own range of the point array, so when the build is done every
+// node's points are one contiguous range and are packed like the sub-meshes
+// of a triangle mesh.
+//-----------------------------------------------------------------------------
+#include "PointCloud.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace
+{
+    // Default budgets
+    constexpr size_t DEFAULT_POINT_BUDGET = 5 * 1000 * 1000;
+    constexpr uint64_t DEFAULT_GPU_BUDGET = 1024ull * 1024 * 1024;
+
+    // Render thread time per frame for node uploads
+    constexpr double UPLOAD_BUDGET_MS = 2.0;
+
+    // A node is refined while its points are further apart than this on screen
+    constexpr float REFINE_SPACING_PIXELS = 1.5f;
+
+    // Where the points of a node go: slot 0 keeps them in the node, slots
+    // 1 to 8 send them to a child octant
+    using SplitCounts = std::array<size_t, 9>;
+
+    struct BuildTask
+    {
+        uint32_t node;
+        size_t begin;
+        size_t end;
+    };
+
+    inline unsigned int octantOf(const glm::vec3 &position, const glm::vec3 &center)
+    {
+        return (position.x >= center.x ? 1u : 0u) | (position.y >= center.y ? 2u : 0u) | (position.z >= center.z ? 4u : 0u);
+    }
+
+    //-------------------------------------------------------------------------
+    // Reorders points[begin, end) into the points the node keeps followed by
+    // those of each octant, using the same range of scratch. Nodes that are
+    // small or deep enough keep everything.
+    //-------------------------------------------------------------------------
+    SplitCounts splitNode(const glm::vec3 &boundsMin, float size, unsigned int depth, std::vector<Vertex> &points,
+                          std::vector<Vertex> &scratch, size_t begin, size_t end)
+    {
+        SplitCounts counts = {};
+        if (end - begin <= PointCloud::MAX_LEAF_POINTS || depth >= PointCloud::MAX_DEPTH)
+        {
+            counts[0] = end - begin;
+            return counts;
+        }
+
+        const unsigned int GRID = PointCloud::SAMPLE_GRID;
+        const float cellsPerUnit = GRID / size;
+        const glm::vec3 center = boundsMin + glm::vec3(0.5f * size);
+        std::vector<uint64_t> occupied(GRID * GRID * GRID / 64, 0);
+        std::vector<unsigned char> slots(end - begin);
+
+        for (size_t i = begin; i < end; i++)
+        {
+            const glm::vec3 &position = points[i].position;
+            glm::ivec3 cell = glm::clamp(glm::ivec3((position - boundsMin) * cellsPerUnit), glm::ivec3(0), glm::ivec3(GRID - 1));
+            size_t bit = static_cast<size_t>(cell.x) + GRID * (static_cast<size_t>(cell.y) + GRID * static_cast<size_t>(cell.z));
+
+            unsigned char slot = 0;
+            if (occupied[bit / 64] & (1ull << (bit % 64)))
+                slot = static_cast<unsigned char>(1 + octantOf(position, center));
+            else
+                occupied[bit / 64] |= 1ull << (bit % 64);
+
+            slots[i - begin] = slot;
+            counts[slot]++;
+        }
+
+        size_t cursor[9];
+        cursor[0] = begin;
+        for (int s = 1; s < 9; s++)
+            cursor[s] = cursor[s - 1] + counts[s - 1];
+        for (size_t i = begin; i < end; i++)
+            scratch[cursor[slots[i - begin]]++] = points[i];
+        std::copy(scratch.begin() + begin, scratch.begin() + end, points.begin() + begin);
+        return counts;
+    }
+}
+
+PointCloud::PointCloud()
+    : mPointCount(0), mPointBudget(DEFAULT_POINT_BUDGET), mGpuBudget(DEFAULT_GPU_BUDGET), mGpuBytes(0), mPointSize(1.0f),
+      mPointScale(0.0f), mFrame(0), mStats()
+{
+}
+
+PointCloud::~PointCloud()
+{
+    for (Node &node : mNodes)
+        releaseGpu(node);
+}
+
+//-----------------------------------------------------------------------------
+// Builds the octree over the cube around the points' bounds
+//-----------------------------------------------------------------------------
+void PointCloud::build(MeshData &mesh, const VertexFormat &format, VertexFormatReport &report)
+{
+    std::vector<Vertex> &points = mesh.vertices;
+    mPointCount = points.size();
+    mNodes.clear();
+    if (points.empty())
+        return;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (const SubMesh &subMesh : mesh.subMeshes)
+    {
+        boundsMin = glm::min(boundsMin, subMesh.boundsMin);
+        boundsMax = glm::max(boundsMax, subMesh.boundsMax);
+    }
+    glm::vec3 extent = boundsMax - boundsMin;
+    float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+
+    Node root;
+    root.boundsMin = 0.5f * (boundsMin + boundsMax) - glm::vec3(0.5f * size);
+    root.size = size;
+    root.depth = 0;
+    mNodes.push_back(root);
+
+    std::vector<Vertex> scratch(points.size());
+    std::vector<BuildTask> level(1, {0, 0, points.size()});
+    while (!level.empty())
+    {
+        std::vector<SplitCounts> counts(level.size());
+        parallelFor(level.size(), [&](size_t i)
+                    {
+                        const Node &node = mNodes[level[i].node];
+                        counts[i] = splitNode(node.boundsMin, node.size, node.depth, points, scratch, level[i].begin, level[i].end); });
+
+        std::vector<BuildTask> next;
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            const BuildTask &task = level[i];
+            Node &node = mNodes[task.node];
+            node.spacing = node.size / SAMPLE_GRID;
+            node.points = SubMesh();
+            node.points.baseVertex = static_cast<unsigned int>(task.begin);
+            node.points.vertexCount = static_cast<unsigned int>(counts[i][0]);
+            node.points.group = task.node;
+            std::fill(std::begin(node.children), std::end(node.children), INVALID_NODE);
+
+            size_t begin = task.begin + counts[i][0];
+            for (unsigned int octant = 0; octant < 8; octant++)
+            {
+                size_t count = counts[i][octant + 1];
+                if (count == 0)
+                    continue;
+
+                Node child;
+                child.size = 0.5f * mNodes[task.node].size;
+                child.boundsMin = mNodes[task.node].boundsMin +
+                                  child.size * glm::vec3(octant & 1 ? 1.0f : 0.0f, octant & 2 ? 1.0f : 0.0f, octant & 4 ? 1.0f : 0.0f);
+                child.depth = mNodes[task.node].depth + 1;
+                mNodes[task.node].children[octant] = static_cast<uint32_t>(mNodes.size());
+                next.push_back({static_cast<uint32_t>(mNodes.size()), begin, begin + count});
+                mNodes.push_back(child);
+                begin += count;
+            }
+        }
+        level.swap(next);
+    }
+    scratch = std::vector<Vertex>();
+
+    // Every node is packed as a sub-mesh of its own, so quantized formats
+    // use the node's own range
+    mesh.subMeshes.clear();
+    for (const Node &node : mNodes)
+        mesh.subMeshes.push_back(node.points);
+    computeSubMeshBounds(mesh);
+    packVertices(mesh, format, report);
+    for (size_t i = 0; i < mNodes.size(); i++)
+        mNodes[i].points = mesh.subMeshes[i];
+
+    mVertexBuffer.swap(mesh.vertexBuffer);
+    mVertexFormat = format;
+    mesh.clear();
+}
+
+void PointCloud::setBudget(size_t points, uint64_t gpuBytes)
+{
+    mPointBudget = points;
+    mGpuBudget = gpuBytes;
+}
+
+void PointCloud::setPointSize(float scale)
+{
+    mPointSize = scale;
+}
+
+//-----------------------------------------------------------------------------
+// Walks the tree largest on screen first, which for nodes of one size is
+// nearest first. A visible node is drawn if the budget still has room for
+// it, and its children are considered while its points are spread further
+// than REFINE_SPACING_PIXELS. Once a node does not fit the walk stops, so
+// the budget always goes to the nodes nearest the camera.
+//-----------------------------------------------------------------------------
+void PointCloud::update(const Meshlets::Frustum &frustum, const glm::vec3 &cameraPosition, bool hasView, float fovY,
+                        int viewportHeight)
+{
+    mFrame++;
+    mSelected.clear();
+    mStats = Stats();
+    mStats.totalPoints = mPointCount;
+    mStats.pointBudget = mPointBudget;
+    mStats.nodes = mNodes.size();
+    if (mNodes.empty())
+        return;
+
+    const float pixelsPerUnit = viewportHeight > 0 ? viewportHeight / (2.0f * std::tan(0.5f * fovY)) : 0.0f;
+    mPointScale = pixelsPerUnit * mPointSize;
+    const bool refineByView = hasView && pixelsPerUnit > 0.0f;
+
+    struct Candidate
+    {
+        float priority;
+        uint32_t node;
+        bool operator<(const Candidate &rhs) const { return priority < rhs.priority; }
+    };
+    auto priorityOf = [&](const Node &node)
+    {
+        glm::vec3 center = node.boundsMin + glm::vec3(0.5f * node.size);
+        float radius = 0.8660254f * node.size;
+        if (!hasView)
+            return radius;
+        return radius / std::max(glm::length(center - cameraPosition), 1e-4f);
+    };
+
+    std::priority_queue<Candidate> queue;
+    queue.push({priorityOf(mNodes[0]), 0});
+    size_t points = 0;
+    while (!queue.empty())
+    {
+        const uint32_t index = queue.top().node;
+        queue.pop();
+        const Node &node = mNodes[index];
+
+        glm::vec3 center = node.boundsMin + glm::vec3(0.5f * node.size);
+        float radius = 0.8660254f * node.size;
+        if (hasView && !Meshlets::isSphereVisible(frustum, center, radius))
+            continue;
+        if (points + node.points.vertexCount > mPointBudget && !mSelected.empty())
+            break;
+
+        mSelected.push_back(index);
+        points += node.points.vertexCount;
+
+        float distance = std::max(glm::length(center - cameraPosition) - radius, 1e-4f);
+        if (refineByView && node.spacing * pixelsPerUnit / distance <= REFINE_SPACING_PIXELS)
+            continue;
+        for (uint32_t child : node.children)
+        {
+            if (child != INVALID_NODE)
+                queue.push({priorityOf(mNodes[child]), child});
+        }
+    }
+
+    for (uint32_t index : mSelected)
+        mNodes[index].lastUsed = mFrame;
+    mStats.selectedNodes = mSelected.size();
+
+    uploadNodes();
+
+    for (uint32_t index : mSelected)
+    {
+        if (mNodes[index].vao != 0)
+        {
+            mStats.points += mNodes[index].points.vertexCount;
+            mStats.drawnNodes++;
+        }
+    }
+    for (const Node &node : mNodes)
+    {
+        if (node.vao != 0)
+            mStats.gpuNodes++;
+    }
+    mStats.gpuBytes = mGpuBytes;
+    mStats.gpuBudget = mGpuBudget;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads missing selected nodes in priority order until the frame's upload
+// time is spent. At least one node goes per frame.
+//-----------------------------------------------------------------------------
+void PointCloud::uploadNodes()
+{
+    auto start = std::chrono::steady_clock::now();
+    const size_t stride = vertexLayout(mVertexFormat).stride;
+
+    bool uploaded = false;
+    for (uint32_t index : mSelected)
+    {
+        Node &node = mNodes[index];
+        if (node.vao != 0)
+            continue;
+        if (uploaded && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= UPLOAD_BUDGET_MS)
+            break;
+
+        uint64_t bytes = nodeBytes(node);
+        if (!makeGpuRoom(bytes))
+            break;
+
+        glGenVertexArrays(1, &node.vao);
+        glGenBuffers(1, &node.vbo);
+        glBindVertexArray(node.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, node.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes),
+                     mVertexBuffer.data() + static_cast<size_t>(node.points.baseVertex) * stride, GL_STATIC_DRAW);
+        setVertexAttributes(mVertexFormat);
+        glBindVertexArray(0);
+
+        mGpuBytes += bytes;
+        uploaded = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Evicts nodes not selected this frame, least recently used first, until
+// bytes more fit the GPU budget. Returns false if they cannot.
+//-----------------------------------------------------------------------------
+bool PointCloud::makeGpuRoom(uint64_t bytes)
+{
+    if (mGpuBytes + bytes <= mGpuBudget)
+        return true;
+
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        if (mNodes[i].vao != 0 && mNodes[i].lastUsed < mFrame)
+            candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+              { return mNodes[a].lastUsed < mNodes[b].lastUsed; });
+
+    for (size_t i : candidates)
+    {
+        if (mGpuBytes + bytes <= mGpuBudget)
+            break;
+        mGpuBytes -= nodeBytes(mNodes[i]);
+        releaseGpu(mNodes[i]);
+    }
+    return mGpuBytes + bytes <= mGpuBudget;
+}
+
+void PointCloud::releaseGpu(Node &node)
+{
+    if (node.vao == 0)
+        return;
+    glDeleteVertexArrays(1, &node.vao);
+    glDeleteBuffers(1, &node.vbo);
+    node.vao = node.vbo = 0;
+}
+
+uint64_t PointCloud::nodeBytes(const Node &node) const
+{
+    return static_cast<uint64_t>(node.points.vertexCount) * vertexLayout(mVertexFormat).stride;
+}
+
+//-----------------------------------------------------------------------------
+// One draw per node. The vertex shader sizes every point from the node's
+// spacing and its depth, so sparse coarse levels close their gaps and
+// dense fine ones stay small.
+//-----------------------------------------------------------------------------
+void PointCloud::draw(ShaderProgram &shader)
+{
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    shader.setUniform("pointScale", mPointScale);
+
+    for (uint32_t index : mSelected)
+    {
+        const Node &node = mNodes[index];
+        if (node.vao == 0)
+            continue;
+
+        shader.setUniform("positionOffset", node.points.positionOffset);
+        shader.setUniform("positionScale", node.points.positionScale);
+        shader.setUniform("texCoordOffset", node.points.texCoordOffset);
+        shader.setUniform("texCoordScale", node.points.texCoordScale);
+        shader.setUniform("pointSpacing", node.spacing);
+
+        glBindVertexArray(node.vao);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(node.points.vertexCount));
+    }
+    glBindVertexArray(0);
+
+    shader.setUniform("pointScale", 0.0f);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+}
@@ -154,6 +154,15 @@ GLuint ShaderProgram::getProgram() const
 	return mHandle;
 }
 
+//-----------------------------------------------------------------------------
+// Sets a float shader uniform
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(const GLchar *name, GLfloat f)
+{
+	GLint loc = getUniformLocation(name);
+	glUniform1f(loc, f);
+}
+
 //-----------------------------------------------------------------------------
 // Sets a glm::vec2 shader uniform
 //-----------------------------------------------------------------------------
@@ -195,6 +204,15 @@ void ShaderProgram::setUniform(const GLchar *name, const glm::mat4 &m)
 	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(m));
 }
 
+//-----------------------------------------------------------------------------
+// Points a sampler uniform at a texture unit
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniformSampler(const GLchar *name, GLint texUnit)
+{
+	GLint loc = getUniformLocation(name);
+	glUniform1i(loc, texUnit);
+}
+
 //-----------------------------------------------------------------------------
 // Returns the uniform identifier given it's string name.
 // NOTE: Shader must be currently active first.
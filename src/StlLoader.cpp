@@ -0,0 +1,327 @@
+//-----------------------------------------------------------------------------
+// StlLoader.cpp
+//
+// Native binary STL reader used instead of Assimp for .stl files
+//
+// Binary STL stores every triangle with its own three corners, so a scan
+// with N triangles carries 3N positions for roughly N/2 distinct vertices.
+// The file is mapped and its triangles split into chunks, and the corners
+// are merged without ever materialising the unindexed vertex array:
+//   1. every chunk merges its own corners through a private hash table and
+//      writes chunk-local indices straight into the final index array
+//   2. the distinct positions of all chunks are merged across chunks, hash
+//      partitioned so every partition is one thread's private table
+//   3. vertices get their final numbers, chunk by chunk in first-use order,
+//      and the indices are rewritten to them
+//-----------------------------------------------------------------------------
+#include "StlLoader.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    constexpr size_t HEADER_SIZE = 84; // 80 byte comment, 32-bit triangle count
+    constexpr size_t TRIANGLE_SIZE = 50;
+    constexpr size_t NORMAL_SIZE = 12;
+
+    // Triangles per chunk of the per-chunk merge
+    constexpr size_t CHUNK_TRIANGLES = 256 * 1024;
+
+    // Distinct chunk positions are bucketed by the top hash bits so every
+    // partition can be merged by one thread
+    constexpr unsigned int PARTITION_BITS = 6;
+    constexpr unsigned int PARTITION_COUNT = 1u << PARTITION_BITS;
+
+    const uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+    const uint64_t EMPTY_REFERENCE = ~0ull;
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+
+        bool operator==(const PositionKey &rhs) const
+        {
+            return bits[0] == rhs.bits[0] && bits[1] == rhs.bits[1] && bits[2] == rhs.bits[2];
+        }
+    };
+
+    struct Chunk
+    {
+        size_t firstTriangle = 0;
+        size_t triangleCount = 0;
+
+        // Distinct positions of the chunk in first-use order, and their hashes
+        std::vector<PositionKey> keys;
+        std::vector<uint64_t> hashes;
+
+        // Local ids grouped by partition; partition p is
+        // [partitionStart[p], partitionStart[p + 1]) of partitionOrder
+        std::vector<uint32_t> partitionStart;
+        std::vector<uint32_t> partitionOrder;
+
+        // (chunk << 32) | local id of the first occurrence of every position
+        // across all chunks; equal to the position's own reference if this
+        // chunk owns it
+        std::vector<uint64_t> owner;
+        size_t ownedCount = 0;
+        size_t vertexOffset = 0;
+        std::vector<uint32_t> vertexIds; // final vertex of every local id
+    };
+
+    //-------------------------------------------------------------------------
+    // Reads a corner position. -0 is folded into +0 so they merge.
+    //-------------------------------------------------------------------------
+    inline PositionKey readKey(const unsigned char *p)
+    {
+        PositionKey key;
+        for (int i = 0; i < 3; i++)
+        {
+            float value;
+            std::memcpy(&value, p + 4 * i, sizeof(value));
+            value += 0.0f;
+            std::memcpy(&key.bits[i], &value, sizeof(value));
+        }
+        return key;
+    }
+
+    inline uint64_t hashKey(const PositionKey &key)
+    {
+        uint64_t xy = (static_cast<uint64_t>(key.bits[0]) << 32) | key.bits[1];
+        return hashCombine(hashMix(xy), key.bits[2]);
+    }
+
+    inline unsigned int partitionOf(uint64_t hash)
+    {
+        return static_cast<unsigned int>(hash >> (64 - PARTITION_BITS));
+    }
+
+    inline uint64_t makeReference(size_t chunk, uint32_t local)
+    {
+        return (static_cast<uint64_t>(chunk) << 32) | local;
+    }
+
+    size_t tableCapacity(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity < 2 * count)
+            capacity *= 2;
+        return capacity;
+    }
+
+    //-------------------------------------------------------------------------
+    // Pass 1: merges the corners of one chunk. Indices are written as local
+    // ids and replaced with final vertex numbers in pass 3.
+    //-------------------------------------------------------------------------
+    void mergeChunk(Chunk &chunk, const unsigned char *triangles, unsigned int *indices)
+    {
+        const size_t cornerCount = 3 * chunk.triangleCount;
+        std::vector<uint32_t> slots(tableCapacity(cornerCount), EMPTY_SLOT);
+        const size_t mask = slots.size() - 1;
+
+        chunk.keys.reserve(cornerCount / 2);
+        chunk.hashes.reserve(cornerCount / 2);
+
+        const unsigned char *triangle = triangles + chunk.firstTriangle * TRIANGLE_SIZE;
+        unsigned int *index = indices + 3 * chunk.firstTriangle;
+        for (size_t t = 0; t < chunk.triangleCount; t++, triangle += TRIANGLE_SIZE)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                PositionKey key = readKey(triangle + NORMAL_SIZE + 12 * corner);
+                uint64_t hash = hashKey(key);
+
+                size_t slot = static_cast<size_t>(hash) & mask;
+                while (slots[slot] != EMPTY_SLOT && !(chunk.keys[slots[slot]] == key))
+                    slot = (slot + 1) & mask;
+
+                if (slots[slot] == EMPTY_SLOT)
+                {
+                    slots[slot] = static_cast<uint32_t>(chunk.keys.size());
+                    chunk.keys.push_back(key);
+                    chunk.hashes.push_back(hash);
+                }
+                *index++ = slots[slot];
+            }
+        }
+
+        // Counting sort of the local ids by partition
+        chunk.partitionStart.assign(PARTITION_COUNT + 1, 0);
+        for (uint64_t hash : chunk.hashes)
+            chunk.partitionStart[partitionOf(hash) + 1]++;
+        for (unsigned int p = 0; p < PARTITION_COUNT; p++)
+            chunk.partitionStart[p + 1] += chunk.partitionStart[p];
+
+        std::vector<uint32_t> cursor(chunk.partitionStart.begin(), chunk.partitionStart.end() - 1);
+        chunk.partitionOrder.resize(chunk.keys.size());
+        for (size_t local = 0; local < chunk.keys.size(); local++)
+            chunk.partitionOrder[cursor[partitionOf(chunk.hashes[local])]++] = static_cast<uint32_t>(local);
+
+        chunk.owner.resize(chunk.keys.size());
+    }
+
+    //-------------------------------------------------------------------------
+    // Pass 2: merges one partition across all chunks. Chunks are visited in
+    // file order, so the owner of a position is its first chunk.
+    //-------------------------------------------------------------------------
+    void mergePartition(std::vector<Chunk> &chunks, unsigned int partition)
+    {
+        size_t count = 0;
+        for (const Chunk &chunk : chunks)
+            count += chunk.partitionStart[partition + 1] - chunk.partitionStart[partition];
+
+        std::vector<uint64_t> slots(tableCapacity(count), EMPTY_REFERENCE);
+        const size_t mask = slots.size() - 1;
+
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            Chunk &chunk = chunks[c];
+            for (uint32_t i = chunk.partitionStart[partition]; i < chunk.partitionStart[partition + 1]; i++)
+            {
+                uint32_t local = chunk.partitionOrder[i];
+                const PositionKey &key = chunk.keys[local];
+                const uint64_t hash = chunk.hashes[local];
+
+                size_t slot = static_cast<size_t>(hash) & mask;
+                while (slots[slot] != EMPTY_REFERENCE)
+                {
+                    const Chunk &other = chunks[slots[slot] >> 32];
+                    uint32_t otherLocal = static_cast<uint32_t>(slots[slot]);
+                    if (other.hashes[otherLocal] == hash && other.keys[otherLocal] == key)
+                        break;
+                    slot = (slot + 1) & mask;
+                }
+
+                if (slots[slot] == EMPTY_REFERENCE)
+                    slots[slot] = makeReference(c, local);
+                chunk.owner[local] = slots[slot];
+            }
+        }
+    }
+}
+
+bool StlLoader::load(const std::string &filename, MeshData &mesh, LoadProgress *progress)
+{
+    if (progress)
+        progress->report("Reading file", 0.0f);
+
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        std::cerr << "ERROR::STL::Unable to open '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    // ASCII files (and truncated binary ones) fail the size check
+    uint32_t triangleCount = 0;
+    if (file.size() >= HEADER_SIZE)
+        std::memcpy(&triangleCount, file.data() + 80, sizeof(triangleCount));
+    if (file.size() < HEADER_SIZE || file.size() != HEADER_SIZE + static_cast<uint64_t>(triangleCount) * TRIANGLE_SIZE)
+    {
+        std::cout << "STL: '" << filename << "' is not a binary STL file" << std::endl;
+        return false;
+    }
+    if (triangleCount == 0 || 3ull * triangleCount > 0xFFFFFFFFull)
+    {
+        std::cerr << "ERROR::STL::'" << filename << "' has no triangles or too many for 32-bit indices" << std::endl;
+        return false;
+    }
+
+    const unsigned char *triangles = file.data() + HEADER_SIZE;
+
+    std::vector<Chunk> chunks((triangleCount + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES);
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        chunks[c].firstTriangle = c * CHUNK_TRIANGLES;
+        chunks[c].triangleCount = std::min<size_t>(CHUNK_TRIANGLES, triangleCount - chunks[c].firstTriangle);
+    }
+
+    mesh.clear();
+    mesh.indices.resize(3 * static_cast<size_t>(triangleCount));
+
+    std::atomic<size_t> done(0);
+    parallelFor(chunks.size(), [&](size_t c)
+                {
+                    if (progress && progress->isCancelled())
+                        return;
+
+                    mergeChunk(chunks[c], triangles, mesh.indices.data());
+
+                    if (progress)
+                        progress->report("Parsing STL", 0.8f * ++done / chunks.size()); });
+    if (progress && progress->isCancelled())
+    {
+        mesh.clear();
+        return false;
+    }
+
+    if (progress)
+        progress->report("Merging STL vertices", 0.8f);
+    parallelFor(PARTITION_COUNT, [&](size_t p)
+                { mergePartition(chunks, static_cast<unsigned int>(p)); });
+
+    // Pass 3: number the owned positions of every chunk, then everything else
+    size_t vertexCount = 0;
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        Chunk &chunk = chunks[c];
+        for (size_t local = 0; local < chunk.owner.size(); local++)
+        {
+            if (chunk.owner[local] == makeReference(c, static_cast<uint32_t>(local)))
+                chunk.ownedCount++;
+        }
+        chunk.vertexOffset = vertexCount;
+        vertexCount += chunk.ownedCount;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    parallelFor(chunks.size(), [&](size_t c)
+                {
+                    Chunk &chunk = chunks[c];
+                    chunk.vertexIds.resize(chunk.owner.size());
+                    uint32_t next = static_cast<uint32_t>(chunk.vertexOffset);
+                    for (size_t local = 0; local < chunk.owner.size(); local++)
+                    {
+                        if (chunk.owner[local] != makeReference(c, static_cast<uint32_t>(local)))
+                            continue;
+
+                        Vertex &vertex = mesh.vertices[next];
+                        std::memcpy(&vertex.position, chunk.keys[local].bits, sizeof(vertex.position));
+                        vertex.texCoords = glm::vec2(0.0f);
+                        chunk.vertexIds[local] = next++;
+                    } });
+
+    parallelFor(chunks.size(), [&](size_t c)
+                {
+                    Chunk &chunk = chunks[c];
+                    for (size_t local = 0; local < chunk.owner.size(); local++)
+                    {
+                        // Owned ids are final and only ever read here
+                        uint64_t owner = chunk.owner[local];
+                        if (owner != makeReference(c, static_cast<uint32_t>(local)))
+                            chunk.vertexIds[local] = chunks[owner >> 32].vertexIds[static_cast<uint32_t>(owner)];
+                    }
+
+                    unsigned int *index = mesh.indices.data() + 3 * chunk.firstTriangle;
+                    for (size_t i = 0; i < 3 * chunk.triangleCount; i++)
+                        index[i] = chunk.vertexIds[index[i]];
+
+                    // The chunk's tables are no longer needed
+                    chunk.keys = std::vector<PositionKey>();
+                    chunk.hashes = std::vector<uint64_t>(); });
+
+    SubMesh subMesh = {};
+    subMesh.indexCount = static_cast<unsigned int>(mesh.indices.size());
+    subMesh.vertexCount = static_cast<unsigned int>(vertexCount);
+    mesh.subMeshes.push_back(subMesh);
+    computeSubMeshBounds(mesh);
+
+    std::cout << "STL: " << triangleCount << " triangles, " << 3ull * triangleCount << " corners merged into "
+              << vertexCount << " vertices in " << chunks.size() << " chunks" << std::endl;
+    return true;
+}
@@ -5,16 +5,169 @@
 // Simple 2D texture class
 //-----------------------------------------------------------------------------
 #include "Texture2D.h"
+#include "Parallel.h"
+#include "ParallelJpeg.h"
+#include "ParallelPng.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <cassert>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image/stb_image.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_SSE2
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+	// Bytes copied into one staging buffer at a time
+	const size_t STAGING_BUFFER_SIZE = 4 * 1024 * 1024;
+
+	// Texels one task repacks to fewer channels
+	const size_t PACK_TEXELS_PER_TASK = 64 * 1024;
+
+	// How long a synchronous upload waits for a staging buffer per try
+	const GLuint64 FENCE_WAIT_NS = 1000000000ull;
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+	const GLenum GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+	const GLenum GL_COMPRESSED_RGBA_S3TC_DXT3_EXT = 0x83F2;
+	const GLenum GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+	const GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT = 0x8C4D;
+	const GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT = 0x8C4E;
+	const GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT = 0x8C4F;
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+	const GLenum GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+	const GLenum GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+#endif
+
+	//-------------------------------------------------------------------------
+	// GL format of a block format, or 0 if the driver cannot sample it. The
+	// colour formats are sRGB when the file marks them so. BC4 and BC5 hold
+	// data and have no sRGB variant.
+	//-------------------------------------------------------------------------
+	GLenum compressedFormat(BlockFormat format, bool srgb)
+	{
+#ifdef __APPLE__
+		const bool s3tc = true; // every macOS driver exposes EXT_texture_compression_s3tc
+		const bool bptc = false;
+#else
+		const bool s3tc = GLEW_EXT_texture_compression_s3tc;
+		const bool bptc = GLEW_ARB_texture_compression_bptc || GLEW_VERSION_4_2;
+#endif
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			return !s3tc ? 0 : srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case BlockFormat::BC2:
+			return !s3tc ? 0 : srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		case BlockFormat::BC3:
+			return !s3tc ? 0 : srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC4:
+			return GL_COMPRESSED_RED_RGTC1; // core since GL 3.0
+		case BlockFormat::BC5:
+			return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7:
+			return !bptc ? 0 : srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		return 0;
+	}
+
+	//-------------------------------------------------------------------------
+	// Bytes per texel to keep of an image stb_image reported components for:
+	// gray as R8 or RG8, unless sRGB, which has no one or two channel formats
+	//-------------------------------------------------------------------------
+	int storedChannels(int components, const TextureOptions &options)
+	{
+		if (!options.compactChannels)
+			return 4;
+		switch (components)
+		{
+		case 1:
+			return options.srgb ? 3 : 1;
+		case 2:
+			return options.srgb ? 4 : 2;
+		case 3:
+			return 3;
+		}
+		return 4;
+	}
+
+	//-------------------------------------------------------------------------
+	// Keeps the first channels (1 to 3) of count RGBA8 texels. Gray images
+	// have R = G = B, so their first channel is the luminance.
+	//-------------------------------------------------------------------------
+	void packTexels(const unsigned char *rgba, size_t count, int channels, unsigned char *out)
+	{
+		size_t i = 0;
+#ifdef TEXTURE_SSE2
+		if (channels == 1)
+		{
+			// Each 32 bit lane keeps its red byte; the packs cannot saturate
+			const __m128i mask = _mm_set1_epi32(0xFF);
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i *source = reinterpret_cast<const __m128i *>(rgba + i * 4);
+				__m128i a = _mm_and_si128(_mm_loadu_si128(source), mask);
+				__m128i b = _mm_and_si128(_mm_loadu_si128(source + 1), mask);
+				__m128i c = _mm_and_si128(_mm_loadu_si128(source + 2), mask);
+				__m128i d = _mm_and_si128(_mm_loadu_si128(source + 3), mask);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+			}
+		}
+		else if (channels == 2)
+		{
+			// Sign extending the red-green half of each lane lets the signed
+			// saturating pack return it unchanged
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m128i *source = reinterpret_cast<const __m128i *>(rgba + i * 4);
+				__m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(source), 16), 16);
+				__m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(source + 1), 16), 16);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_packs_epi32(a, b));
+			}
+		}
+#endif
+#ifdef __SSSE3__
+		if (channels == 3)
+		{
+			// Each store writes 4 bytes past its 12; the loop stops early
+			// enough that they land inside this range and are overwritten
+			const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+			for (; i + 8 <= count; i += 4)
+			{
+				__m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 3), _mm_shuffle_epi8(texels, shuffle));
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			for (int c = 0; c < channels; c++)
+				out[i * channels + c] = rgba[i * 4 + c];
+		}
+	}
+}
+
+uint64_t Texture2D::sBindCount = 0;
+bool Texture2D::sSrgbOutput = true;
+
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
 Texture2D::Texture2D()
-	: mTexture(0)
+	: mTexture(0), mPixels(nullptr), mWidth(0), mHeight(0), mOptions(), mIsCompressed(false), mBlockFormat(BlockFormat::BC1), mChannels(4),
+	  mInternalFormat(GL_RGBA8), mFormat(GL_RGBA), mSrgb(false), mLevelCount(0), mStreamable(false), mTargetLevel(0), mResidentLevel(0), mAllocatedLevel(0), mGpuBytes(0), mRgbaBytes(0), mLastBind(0), mStaging(), mStagingFences(), mStagingSize(0), mNextStaging(0),
+	  mUploadLevel(-1), mUploadRow(0), mUploadedBytes(0), mUploadTotalBytes(0)
 {
 }
 
@@ -23,53 +176,924 @@ Texture2D::Texture2D()
 //-----------------------------------------------------------------------------
 Texture2D::~Texture2D()
 {
+	releasePixels();
+
+	// Only decoded (e.g. a cancelled background load): no GL objects
+	if (mTexture == 0)
+		return;
+	releaseUpload();
 	glDeleteTextures(1, &mTexture);
 }
 
 //-----------------------------------------------------------------------------
 // Load a texture with a given filename using stb image loader
 // http://nothings.org/stb_image.h
-// Creates mip maps if generateMipMaps is true.
 //-----------------------------------------------------------------------------
-bool Texture2D::loadTexture(const string &fileName, bool generateMipMaps)
+bool Texture2D::loadTexture(const string &fileName, const TextureOptions &options)
+{
+	return decode(fileName, options) && upload();
+}
+
+//-----------------------------------------------------------------------------
+// Maps the texture cache entry of the file or decodes the image to RGBA8
+// pixels, builds the mip chain from them and keeps the channels the image
+// has, all until the upload finishes. Mapped levels are kept after it, so
+// the texture can stream.
+//-----------------------------------------------------------------------------
+bool Texture2D::decode(const string &fileName, const TextureOptions &options)
 {
-	int width, height, components;
+	auto startTime = std::chrono::steady_clock::now();
+
+	releasePixels();
+	mOptions = options;
+	mChannels = 4;
+	mTargetLevel = 0;
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		mRowStream.pixels = nullptr;
+		mRowStream.bands.clear();
+		mRowStream.closed = false;
+		mRowStream.complete = false;
+	}
 
-	// Use stbi image library to load our image
-	unsigned char *imageData = stbi_load(fileName.c_str(), &width, &height, &components, STBI_rgb_alpha);
+	mIsCompressed = CompressedTexture::isCompressedFile(fileName);
+	if (mIsCompressed)
+	{
+		if (!CompressedTexture::load(fileName, mCompressed))
+			return false;
+		mBlockFormat = mCompressed.format;
+		mLevels = mCompressed.levels;
+		mWidth = mLevels[0].width;
+		mHeight = mLevels[0].height;
+		mStreamable = true;
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << "Texture has been loaded correctly (" << blockFormatName(mCompressed.format) << (mCompressed.srgb ? " sRGB" : "") << ", " << mWidth << "x" << mHeight
+				  << ", " << mLevels.size() << " levels, " << elapsedMs << " ms)" << std::endl;
+		return true;
+	}
 
-	if (imageData == NULL)
+	const uint64_t optionsHash = options.hash();
+	if (options.cache && TextureCache::load(fileName, optionsHash, mCached))
+	{
+		mLevels = mCached.levels;
+		mChannels = mCached.channels;
+		mWidth = mLevels[0].width;
+		mHeight = mLevels[0].height;
+		mStreamable = true;
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << "Texture has been loaded correctly (texture cache, " << mWidth << "x" << mHeight << ", " << mLevels.size()
+				  << " levels of " << mChannels << " channels, " << elapsedMs << " ms)" << std::endl;
+		return true;
+	}
+
+	int components;
+
+	// Large JPEGs with restart markers decode in stripes on all cores, large
+	// PNGs inflate and unfilter on two; everything else through the stbi
+	// image library. The parallel decoders report their finished rows for
+	// uploadDecodedRows().
+	DecodedRows rows;
+	rows.started = [this](const unsigned char *pixels, int width, int height, int components)
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		if (mRowStream.closed)
+			return;
+		mRowStream.pixels = pixels;
+		mRowStream.width = width;
+		mRowStream.height = height;
+		mRowStream.channels = storedChannels(components, mOptions);
+	};
+	rows.decoded = [this](int firstRow, int rowCount)
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		if (mRowStream.pixels != nullptr)
+			mRowStream.bands.push_back({firstRow, rowCount});
+	};
+	rows.abandoned = [this]()
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		mRowStream.pixels = nullptr;
+		mRowStream.bands.clear();
+		mRowStream.closed = true;
+	};
+	const char *parallelDecode = "striped decode, ";
+	mPixels = ParallelJpeg::decode(fileName, mWidth, mHeight, components, &rows);
+	if (mPixels == NULL)
+	{
+		parallelDecode = "pipelined decode, ";
+		mPixels = ParallelPng::decode(fileName, mWidth, mHeight, components, &rows);
+	}
+	if (mPixels == NULL)
+	{
+		parallelDecode = "";
+		mPixels = stbi_load(fileName.c_str(), &mWidth, &mHeight, &components, STBI_rgb_alpha);
+	}
+
+	// From here on the pixels are repacked or freed; the rows streamed so
+	// far count if they came from the image that is kept
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		mRowStream.closed = true;
+		mRowStream.complete = mRowStream.pixels != nullptr && mRowStream.pixels == mPixels;
+	}
+
+	if (mPixels == NULL)
 	{
 		std::cerr << "Error loading texture '" << fileName << "'" << std::endl;
 		return false;
 	}
 
+	double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	buildLevels(components);
+	std::cout << "Texture has been loaded correctly (" << mWidth << "x" << mHeight << ", " << components << " components stored in "
+			  << mChannels << ", " << parallelDecode << decodeMs << " ms)" << std::endl;
+
+	// The new cache entry maps back in place of the decoded levels, which
+	// lets the texture stream like a cache hit
+	if (options.cache && TextureCache::store(fileName, optionsHash, mLevels, mChannels) &&
+		TextureCache::load(fileName, optionsHash, mCached))
+	{
+		releaseDecoded();
+		mLevels = mCached.levels;
+		mStreamable = true;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// A 1/8 scale decode of large JPEGs; other files either map in no time
+// (block compressed, texture cache) or have no quick preview
+//-----------------------------------------------------------------------------
+bool Texture2D::decodePreview(const string &fileName, const TextureOptions &options)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	releasePixels();
+	mOptions = options;
+	mChannels = 4;
+	mIsCompressed = false;
+	if (CompressedTexture::isCompressedFile(fileName) || (options.cache && TextureCache::load(fileName, options.hash(), mCached)))
+	{
+		releasePixels();
+		return false;
+	}
+
+	int components;
+	mPixels = ParallelJpeg::decodePreview(fileName, mWidth, mHeight, components);
+	if (mPixels == NULL)
+		return false;
+	buildLevels(components);
+
+	double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << "Texture preview decoded (" << mWidth << "x" << mHeight << ", " << elapsedMs << " ms)" << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Turns the decoded RGBA8 image in mPixels into the levels to upload: its
+// mip chain, then the channels the image has
+//-----------------------------------------------------------------------------
+void Texture2D::buildLevels(int components)
+{
+	mLevels.push_back({mWidth, mHeight, mPixels});
+	if (mOptions.generateMipMaps)
+	{
+		auto mipStart = std::chrono::steady_clock::now();
+		MipChain::build(mOptions.mipFilter, mOptions.gammaCorrectMips, mMipPixels, mLevels);
+		double mipMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mipStart).count();
+		std::cout << "Mip chain: " << mLevels.size() << " levels, " << (mOptions.mipFilter == MipFilter::Box ? "box" : "Kaiser")
+				  << (mOptions.gammaCorrectMips ? " filter in linear light (" : " filter (") << mipMs << " ms)" << std::endl;
+	}
+	mChannels = storedChannels(components, mOptions);
+	if (mChannels < 4)
+		packChannels();
+}
+
+//-----------------------------------------------------------------------------
+// Repacks every RGBA8 level to mChannels bytes per texel in mPackedPixels,
+// in parallel, and frees the RGBA8 copies
+//-----------------------------------------------------------------------------
+void Texture2D::packChannels()
+{
+	std::vector<size_t> offsets;
+	size_t totalTexels = 0;
+	for (const MipLevel &level : mLevels)
+	{
+		offsets.push_back(totalTexels);
+		totalTexels += static_cast<size_t>(level.width) * level.height;
+	}
+	mPackedPixels.resize(totalTexels * mChannels);
+
+	// Tasks never straddle two levels
+	struct Task
+	{
+		size_t level;
+		size_t first;
+		size_t count;
+	};
+	std::vector<Task> tasks;
+	for (size_t i = 0; i < mLevels.size(); i++)
+	{
+		const size_t texels = static_cast<size_t>(mLevels[i].width) * mLevels[i].height;
+		for (size_t first = 0; first < texels; first += PACK_TEXELS_PER_TASK)
+			tasks.push_back({i, first, std::min(PACK_TEXELS_PER_TASK, texels - first)});
+	}
+	parallelFor(tasks.size(), [&](size_t t)
+				{
+		const Task &task = tasks[t];
+		packTexels(mLevels[task.level].pixels + task.first * 4, task.count, mChannels,
+				   mPackedPixels.data() + (offsets[task.level] + task.first) * mChannels); });
+
+	for (size_t i = 0; i < mLevels.size(); i++)
+		mLevels[i].pixels = mPackedPixels.data() + offsets[i] * mChannels;
+	stbi_image_free(mPixels);
+	mPixels = NULL;
+	mMipPixels.clear();
+	mMipPixels.shrink_to_fit();
+}
+
+//-----------------------------------------------------------------------------
+// GL formats of an uncompressed texture of channels bytes per texel
+//-----------------------------------------------------------------------------
+void Texture2D::selectFormat(int channels)
+{
+	const bool srgb = mOptions.srgb && sSrgbOutput;
+	switch (channels)
+	{
+	case 1:
+		mInternalFormat = GL_R8;
+		mFormat = GL_RED;
+		break;
+	case 2:
+		mInternalFormat = GL_RG8;
+		mFormat = GL_RG;
+		break;
+	case 3:
+		mInternalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+		mFormat = GL_RGB;
+		break;
+	default:
+		mInternalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		mFormat = GL_RGBA;
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Allocates levelCount levels from width x height on the bound texture:
+// immutable storage where the driver has it, one level at a time otherwise
+//-----------------------------------------------------------------------------
+void Texture2D::allocateStorage(int levelCount, int width, int height)
+{
+#ifndef __APPLE__ // the macOS loader is generated for GL 3.3 without ARB_texture_storage
+	if (GLEW_ARB_texture_storage || GLEW_VERSION_4_2)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, levelCount, mInternalFormat, width, height);
+		return;
+	}
+#endif
+	for (int i = 0; i < levelCount; i++)
+	{
+		const int levelWidth = std::max(1, width >> i);
+		const int levelHeight = std::max(1, height >> i);
+		if (mIsCompressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, mInternalFormat, levelWidth, levelHeight, 0,
+								   static_cast<GLsizei>(levelSize(levelWidth, levelHeight)), nullptr);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, mInternalFormat, levelWidth, levelHeight, 0, mFormat, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+}
+
+//-----------------------------------------------------------------------------
+// Gives a level of the bound, mutable texture its storage, or frees it: a
+// zero size image holds no memory
+//-----------------------------------------------------------------------------
+void Texture2D::allocateLevel(int level, bool allocate)
+{
+	const int width = allocate ? mLevels[level].width : 0;
+	const int height = allocate ? mLevels[level].height : 0;
+	if (mIsCompressed)
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, mInternalFormat, width, height, 0,
+							   static_cast<GLsizei>(allocate ? levelSize(width, height) : 0), nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, mInternalFormat, width, height, 0, mFormat, GL_UNSIGNED_BYTE, nullptr);
+}
+
+//-----------------------------------------------------------------------------
+// GL storage of the allocated levels, in the texture's format and as RGBA8
+//-----------------------------------------------------------------------------
+void Texture2D::updateGpuBytes()
+{
+	mGpuBytes = 0;
+	mRgbaBytes = 0;
+	for (int i = mAllocatedLevel; i < mLevelCount; i++)
+	{
+		const int width = std::max(1, mWidth >> i);
+		const int height = std::max(1, mHeight >> i);
+		mGpuBytes += levelSize(width, height);
+		mRgbaBytes += static_cast<uint64_t>(width) * height * 4;
+	}
+}
+
+uint64_t Texture2D::getGpuBytesFrom(int level) const
+{
+	if (!mStreamable)
+		return mGpuBytes;
+	uint64_t bytes = 0;
+	for (int i = std::max(level, 0); i < mLevelCount; i++)
+		bytes += levelSize(std::max(1, mWidth >> i), std::max(1, mHeight >> i));
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// Create the GL texture with storage for every level, then start streaming
+// the decoded levels into it
+//-----------------------------------------------------------------------------
+bool Texture2D::upload(double budgetMs)
+{
+	// The texture uploadDecodedRows() started is kept if decode() finished
+	// with the image its rows came from
+	if (!mStreamedRows.empty() && mUploadLevel < 0)
+	{
+		std::lock_guard<std::mutex> lock(mRowStream.mutex);
+		if (!mRowStream.complete || mChannels != mRowStream.channels || mLevelCount != static_cast<int>(mLevels.size()))
+			deleteRowTexture();
+	}
+	const bool streamedRows = !mStreamedRows.empty() && mUploadLevel < 0;
+	if (mLevels.empty() || (mTexture != 0 && !streamedRows))
+		return false;
+
+	if (mWidth <= 0 || mHeight <= 0 || mWidth > maxTextureSize() || mHeight > maxTextureSize())
+	{
+		std::cerr << "Texture: " << mWidth << "x" << mHeight << " is outside the driver's limit of " << maxTextureSize() << std::endl;
+		releasePixels();
+		return false;
+	}
+
+	if (mIsCompressed)
+	{
+		// The file, not the srgb option, says how its colours are encoded
+		mSrgb = sSrgbOutput && mCompressed.srgb && mBlockFormat != BlockFormat::BC4 && mBlockFormat != BlockFormat::BC5;
+		mInternalFormat = compressedFormat(mBlockFormat, mSrgb);
+		if (mInternalFormat == 0)
+		{
+			std::cerr << "Texture: " << blockFormatName(mBlockFormat) << " is not supported by the driver" << std::endl;
+			releasePixels();
+			return false;
+		}
+	}
+	else
+	{
+		selectFormat(mChannels);
+		mSrgb = mInternalFormat == GL_SRGB8 || mInternalFormat == GL_SRGB8_ALPHA8;
+	}
+
+	if (streamedRows)
+		glBindTexture(GL_TEXTURE_2D, mTexture);
+	else
+	{
+		glGenTextures(1, &mTexture);
+		glBindTexture(GL_TEXTURE_2D, mTexture); // all upcoming GL_TEXTURE_2D operations will affect our texture object (mTexture)
+		mLevelCount = static_cast<int>(mLevels.size());
+		initSampling(mLevelCount, mChannels);
+	}
+
+	// A streaming texture is on mutable storage: each level is allocated as
+	// its upload starts and freed again when the target moves past it. The
+	// texture of uploadDecodedRows() came with every level.
+	mTargetLevel = std::min(mTargetLevel, mLevelCount - 1);
+	if (streamedRows)
+		mAllocatedLevel = 0;
+	else if (mStreamable)
+		mAllocatedLevel = mLevelCount;
+	else
+	{
+		allocateStorage(mLevelCount, mWidth, mHeight);
+		mAllocatedLevel = 0;
+	}
+	updateGpuBytes();
+
+	mUploadTotalBytes = 0;
+	for (int i = mTargetLevel; i < mLevelCount; i++)
+		mUploadTotalBytes += levelSize(mLevels[i].width, mLevels[i].height);
+
+	// Sampling is limited to the levels already uploaded; each finished level
+	// lowers the base level until it reaches the target
+	const GLint lastLevel = mLevelCount - 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, lastLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+	glBindTexture(GL_TEXTURE_2D, 0); // unbind texture when done so we don't accidentally mess up our mTexture
+
+	mResidentLevel = mLevelCount;
+	mUploadLevel = lastLevel;
+	mUploadRow = 0;
+	mUploadedBytes = 0;
+
+	streamUpload(budgetMs);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// The staging buffers, each holding at least one row (of blocks) of level 0
+// of rowSize bytes
+//-----------------------------------------------------------------------------
+void Texture2D::createStaging(size_t rowSize)
+{
+	mStagingSize = std::max(STAGING_BUFFER_SIZE, rowSize);
+	glGenBuffers(STAGING_BUFFERS, mStaging);
+	for (GLuint buffer : mStaging)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(mStagingSize), nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	mNextStaging = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Sends the bands of rows decoded since the last call through the staging
+// buffers, creating the texture with the first. The stream stays locked
+// meanwhile, so decode() cannot close it and free the pixels being copied.
+//-----------------------------------------------------------------------------
+void Texture2D::uploadDecodedRows(double budgetMs)
+{
+	std::lock_guard<std::mutex> lock(mRowStream.mutex);
+	if (mRowStream.closed || mRowStream.bands.empty())
+		return;
+	if (mTexture == 0 && !createRowTexture())
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	const size_t rowSize = static_cast<size_t>(mRowStream.width) * 4;
+	const int maxRows = std::max(static_cast<int>(mStagingSize / rowSize), 1);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	do
+	{
+		GLsync &fence = mStagingFences[mNextStaging];
+		if (fence)
+		{
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		// GL drops the channels the texture does not store
+		std::pair<int, int> &band = mRowStream.bands.back();
+		const int rows = std::min(band.second, maxRows);
+		stageRows(0, mRowStream.width, band.first, rows, GL_RGBA, mRowStream.pixels + rowSize * band.first, rowSize * rows);
+		std::fill(mStreamedRows.begin() + band.first, mStreamedRows.begin() + band.first + rows, true);
+		band.first += rows;
+		band.second -= rows;
+		if (band.second == 0)
+			mRowStream.bands.pop_back();
+	} while (!mRowStream.bands.empty() &&
+			 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+//-----------------------------------------------------------------------------
+// The texture uploadDecodedRows() streams into: mutable storage for every
+// level the image will have, in the format upload() picks for it. Images
+// over the driver's limit wait for upload() to reject them.
+//-----------------------------------------------------------------------------
+bool Texture2D::createRowTexture()
+{
+	const RowStream &stream = mRowStream;
+	if (stream.width > maxTextureSize() || stream.height > maxTextureSize())
+		return false;
+
+	selectFormat(stream.channels);
+	const int levelCount = mOptions.generateMipMaps ? static_cast<int>(MipChain::levelCount(stream.width, stream.height)) : 1;
 	glGenTextures(1, &mTexture);
-	glBindTexture(GL_TEXTURE_2D, mTexture); // all upcoming GL_TEXTURE_2D operations will affect our texture object (mTexture)
-
-	// Set the texture wrapping/filtering options (on the currently bound texture object)
-	// GL_CLAMP_TO_EDGE
-	// GL_REPEAT
-	// GL_MIRRORED_REPEAT
-	// GL_CLAMP_TO_BORDER
-	// GL_LINEAR
-	// GL_NEAREST
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	initSampling(levelCount, stream.channels);
+	for (int i = 0; i < levelCount; i++)
+		glTexImage2D(GL_TEXTURE_2D, i, mInternalFormat, std::max(1, stream.width >> i), std::max(1, stream.height >> i), 0, mFormat,
+					 GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	mLevelCount = levelCount;
+	createStaging(static_cast<size_t>(stream.width) * 4);
+	mStreamedRows.assign(stream.height, false);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Drops the texture of uploadDecodedRows() when its rows did not come from
+// the image decode() kept; upload() then starts over
+//-----------------------------------------------------------------------------
+void Texture2D::deleteRowTexture()
+{
+	releaseUpload();
+	glDeleteTextures(1, &mTexture);
+	mTexture = 0;
+	mStreamedRows.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Set the texture wrapping/filtering options (on the currently bound texture object)
+// GL_CLAMP_TO_EDGE
+// GL_REPEAT
+// GL_MIRRORED_REPEAT
+// GL_CLAMP_TO_BORDER
+// GL_LINEAR
+// GL_NEAREST
+//-----------------------------------------------------------------------------
+void Texture2D::initSampling(int levelCount, int channels)
+{
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (maxAnisotropy() > 1.0f)
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(std::max(mOptions.anisotropy, 1.0f), maxAnisotropy()));
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+	// One and two channel textures show as gray and gray with alpha, BC4
+	// and BC5 blocks like R8 and RG8
+	if (mIsCompressed)
+		channels = mBlockFormat == BlockFormat::BC4 ? 1 : mBlockFormat == BlockFormat::BC5 ? 2 : 4;
+	if (channels < 3)
+	{
+		const GLint gray[] = {GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE};
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, gray);
+	}
+}
 
-	if (generateMipMaps)
-		glGenerateMipmap(GL_TEXTURE_2D);
+//-----------------------------------------------------------------------------
+// Copies level rows through the staging buffers, coarsest level first, until
+// the budget is spent or the next staging buffer is still in use by the GPU.
+// An unbounded budget waits for the buffers instead. The buffers only exist
+// while levels are on their way.
+//-----------------------------------------------------------------------------
+bool Texture2D::streamUpload(double budgetMs)
+{
+	if (mTexture == 0)
+		return false;
+	if (mUploadLevel < 0)
+		return true;
+	if (mStaging[0] == 0)
+		createStaging(levelSize(mWidth, 1));
 
-	stbi_image_free(imageData);
-	glBindTexture(GL_TEXTURE_2D, 0); // unbind texture when done so we don't accidentally mess up our mTexture
+	const bool blocking = budgetMs == std::numeric_limits<double>::infinity();
+	auto start = std::chrono::steady_clock::now();
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // R8 and RGB8 rows are not padded to 4 bytes
+	do
+	{
+		GLsync &fence = mStagingFences[mNextStaging];
+		if (fence)
+		{
+			GLenum status = glClientWaitSync(fence, blocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, blocking ? FENCE_WAIT_NS : 0);
+			if (status == GL_TIMEOUT_EXPIRED && blocking)
+				continue;
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break; // still being read; try again next frame
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		// Compressed levels go up in whole rows of blocks
+		const MipLevel &level = mLevels[mUploadLevel];
+		if (mUploadLevel < mAllocatedLevel)
+		{
+			allocateLevel(mUploadLevel, true);
+			mAllocatedLevel = mUploadLevel;
+			updateGpuBytes();
+		}
+		const int rowStep = mIsCompressed ? 4 : 1;
+		const size_t rowSize = std::max(levelSize(level.width, 1), static_cast<size_t>(1));
+		int rows = std::min(level.height - mUploadRow, std::max(static_cast<int>(mStagingSize / rowSize), 1) * rowStep);
+		if (mUploadLevel == 0 && !mStreamedRows.empty())
+		{
+			// Rows uploadDecodedRows() sent are skipped; the others go up in
+			// the runs between them
+			const int firstRow = mUploadRow;
+			while (mUploadRow < level.height && mStreamedRows[mUploadRow])
+				mUploadRow++;
+			mUploadedBytes += levelSize(level.width, mUploadRow - firstRow);
+			rows = std::min(rows, level.height - mUploadRow);
+			int run = 0;
+			while (run < rows && !mStreamedRows[mUploadRow + run])
+				run++;
+			rows = run;
+		}
+		if (rows > 0)
+		{
+			stageRows(mUploadLevel, level.width, mUploadRow, rows, mFormat, level.pixels + levelSize(level.width, mUploadRow),
+					  levelSize(level.width, rows));
+			mUploadRow += rows;
+			mUploadedBytes += levelSize(level.width, rows);
+		}
+
+		if (mUploadRow == level.height)
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mUploadLevel);
+			mResidentLevel = mUploadLevel;
+			if (mUploadLevel == 0)
+				mStreamedRows.clear();
+			mUploadLevel = mUploadLevel > mTargetLevel ? mUploadLevel - 1 : -1;
+			mUploadRow = 0;
+		}
+	} while (mUploadLevel >= 0 &&
+			 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (mUploadLevel >= 0)
+		return false;
+
+	releaseUpload();
+	if (!mStreamable)
+		releasePixels();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// A coarser target raises the base level first, so the texture stays
+// complete, then frees the levels below it along with any upload into them.
+// A finer target queues the missing levels for streamUpload().
+//-----------------------------------------------------------------------------
+void Texture2D::setTargetLevel(int level)
+{
+	if (!mStreamable || mLevels.empty())
+		return;
+	level = std::min(std::max(level, 0), static_cast<int>(mLevels.size()) - 1);
+	if (level == mTargetLevel)
+		return;
+	const int previousTarget = mTargetLevel;
+	mTargetLevel = level;
+	if (mTexture == 0)
+		return; // upload() starts at the target
+
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	if (mUploadLevel >= 0 && mUploadLevel < level)
+	{
+		mUploadLevel = -1;
+		mUploadRow = 0;
+		releaseUpload();
+	}
+	if (mResidentLevel < level)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		mResidentLevel = level;
+	}
+	for (; mAllocatedLevel < level; mAllocatedLevel++)
+		allocateLevel(mAllocatedLevel, false);
+	if (level > 0)
+		mStreamedRows.clear(); // they went with level 0
+	glBindTexture(GL_TEXTURE_2D, 0);
+	updateGpuBytes();
+
+	if (mUploadLevel < 0 && mResidentLevel > level)
+	{
+		mUploadLevel = mResidentLevel - 1;
+		mUploadRow = 0;
+		mUploadedBytes = 0;
+		mUploadTotalBytes = 0;
+		for (int i = level; i < mResidentLevel; i++)
+			mUploadTotalBytes += levelSize(mLevels[i].width, mLevels[i].height);
+	}
+	else if (mUploadLevel >= 0)
+	{
+		for (int i = level; i < previousTarget; i++)
+			mUploadTotalBytes += levelSize(mLevels[i].width, mLevels[i].height);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Copies size bytes of rows from firstRow of a level width texels wide into
+// the next staging buffer and queues their upload into the bound texture,
+// fenced so the buffer is not written again while the GPU still reads it.
+// format is the pixel format of uncompressed rows.
+//-----------------------------------------------------------------------------
+void Texture2D::stageRows(GLint mipLevel, int width, int firstRow, int rows, GLenum format, const unsigned char *source, size_t size)
+{
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mStaging[mNextStaging]);
+	void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+									 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	bool staged = false;
+	if (staging != nullptr)
+	{
+		std::memcpy(staging, source, size);
+		staged = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+	}
+	// The buffer could not be mapped or lost its contents (e.g. a mode
+	// switch): send these rows straight from client memory instead
+	if (!staged)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	const void *data = staged ? nullptr : source;
+	if (mIsCompressed)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, mipLevel, 0, firstRow, width, rows, mInternalFormat, static_cast<GLsizei>(size), data);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, mipLevel, 0, firstRow, width, rows, format, GL_UNSIGNED_BYTE, data);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	mStagingFences[mNextStaging] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mNextStaging = (mNextStaging + 1) % STAGING_BUFFERS;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes the staging buffers and their fences. GL keeps a buffer alive
+// until the uploads reading it have finished.
+//-----------------------------------------------------------------------------
+void Texture2D::releaseUpload()
+{
+	for (unsigned int i = 0; i < STAGING_BUFFERS; i++)
+	{
+		if (mStagingFences[i])
+			glDeleteSync(mStagingFences[i]);
+		mStagingFences[i] = nullptr;
+	}
+	if (mStaging[0] != 0)
+		glDeleteBuffers(STAGING_BUFFERS, mStaging);
+	std::fill(mStaging, mStaging + STAGING_BUFFERS, 0u);
+}
+
+//-----------------------------------------------------------------------------
+// Frees the decoded copy of the levels; mapped levels stay
+//-----------------------------------------------------------------------------
+void Texture2D::releaseDecoded()
+{
+	stbi_image_free(mPixels);
+	mPixels = NULL;
+	mMipPixels.clear();
+	mMipPixels.shrink_to_fit();
+	mPackedPixels.clear();
+	mPackedPixels.shrink_to_fit();
+}
+
+//-----------------------------------------------------------------------------
+// Frees the CPU copy of the levels, decoded or mapped
+//-----------------------------------------------------------------------------
+void Texture2D::releasePixels()
+{
+	releaseDecoded();
+	mCached = TextureCache::Entry();
+	mCompressed = CompressedTexture::Image();
+	mLevels.clear();
+	mStreamable = false;
+}
+
+//-----------------------------------------------------------------------------
+// Bytes of a level of this texture's format; partial blocks round up
+//-----------------------------------------------------------------------------
+size_t Texture2D::levelSize(int width, int height) const
+{
+	if (mIsCompressed)
+		return compressedSize(mBlockFormat, width, height);
+	return static_cast<size_t>(width) * height * mChannels;
+}
 
+//-----------------------------------------------------------------------------
+// Name of the GL format the texture is stored in
+//-----------------------------------------------------------------------------
+string Texture2D::getFormatName() const
+{
+	if (mIsCompressed)
+		return string(blockFormatName(mBlockFormat)) + (mSrgb ? " sRGB" : "");
+	switch (mChannels)
+	{
+	case 1:
+		return "R8";
+	case 2:
+		return "RG8";
+	case 3:
+		return mSrgb ? "SRGB8" : "RGB8";
+	}
+	return mSrgb ? "SRGB8_ALPHA8" : "RGBA8";
+}
+
+//-----------------------------------------------------------------------------
+// GL 3.3 cannot copy between textures, so levels 1 and up are read back and
+// uploaded again into a new texture. Stalls for the read back; meant for
+// the rare case that the texture budget is exceeded by textures in use.
+//-----------------------------------------------------------------------------
+bool Texture2D::dropTopLevel()
+{
+	if (mTexture == 0 || mStreamable || mUploadLevel >= 0 || mLevelCount < 2)
+		return false;
+
+	std::vector<size_t> offsets;
+	size_t totalSize = 0;
+	for (int i = 1; i < mLevelCount; i++)
+	{
+		offsets.push_back(totalSize);
+		totalSize += levelSize(std::max(1, mWidth >> i), std::max(1, mHeight >> i));
+	}
+	std::vector<unsigned char> pixels(totalSize);
+
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (int i = 1; i < mLevelCount; i++)
+	{
+		if (mIsCompressed)
+			glGetCompressedTexImage(GL_TEXTURE_2D, i, pixels.data() + offsets[i - 1]);
+		else
+			glGetTexImage(GL_TEXTURE_2D, i, mFormat, GL_UNSIGNED_BYTE, pixels.data() + offsets[i - 1]);
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glDeleteTextures(1, &mTexture);
+
+	mWidth = std::max(1, mWidth >> 1);
+	mHeight = std::max(1, mHeight >> 1);
+	mLevelCount--;
+	mGpuBytes = totalSize;
+	mRgbaBytes = 0;
+
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	initSampling(mLevelCount, mChannels);
+	allocateStorage(mLevelCount, mWidth, mHeight);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < mLevelCount; i++)
+	{
+		const int width = std::max(1, mWidth >> i);
+		const int height = std::max(1, mHeight >> i);
+		const unsigned char *data = pixels.data() + offsets[i];
+		if (mIsCompressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, mInternalFormat, static_cast<GLsizei>(levelSize(width, height)), data);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, mFormat, GL_UNSIGNED_BYTE, data);
+		mRgbaBytes += static_cast<uint64_t>(width) * height * 4;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Anisotropic filtering: the driver's limit (1 if unsupported), queried on
+// first use from the GL thread
+//-----------------------------------------------------------------------------
+float Texture2D::maxAnisotropy()
+{
+	static float limit = 0.0f;
+	if (limit == 0.0f)
+	{
+		limit = 1.0f;
+#ifdef __APPLE__
+		const bool supported = true; // every macOS driver exposes EXT_texture_filter_anisotropic
+#else
+		const bool supported = GLEW_EXT_texture_filter_anisotropic;
+#endif
+		if (supported)
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &limit);
+	}
+	return limit;
+}
+
+//-----------------------------------------------------------------------------
+// Largest side of a texture the driver takes, queried on first use from the
+// GL thread
+//-----------------------------------------------------------------------------
+int Texture2D::maxTextureSize()
+{
+	static GLint limit = 0;
+	if (limit == 0)
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+	return limit;
+}
+
+void Texture2D::setAnisotropy(float anisotropy)
+{
+	mOptions.anisotropy = anisotropy;
+	if (mTexture == 0 || maxAnisotropy() <= 1.0f)
+		return;
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(std::max(anisotropy, 1.0f), maxAnisotropy()));
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Fraction of the texture's bytes uploaded so far
+//-----------------------------------------------------------------------------
+float Texture2D::getUploadProgress() const
+{
+	if (mTexture == 0)
+		return 0.0f;
+	if (mUploadTotalBytes == 0 || mUploadLevel < 0)
+		return 1.0f;
+	return static_cast<float>(static_cast<double>(mUploadedBytes) / mUploadTotalBytes);
+}
+
+//-----------------------------------------------------------------------------
+// Size of the decoded image in pixels
+//-----------------------------------------------------------------------------
+int Texture2D::getWidth() const
+{
+	return mWidth;
+}
+
+int Texture2D::getHeight() const
+{
+	return mHeight;
+}
+
 //-----------------------------------------------------------------------------
 // Bind the texture unit passed in as the active texture in the shader
 //-----------------------------------------------------------------------------
@@ -79,6 +1103,7 @@ void Texture2D::bind(GLuint texUnit)
 
 	glActiveTexture(GL_TEXTURE0 + texUnit);
 	glBindTexture(GL_TEXTURE_2D, mTexture);
+	mLastBind = ++sBindCount;
 }
 
 //-----------------------------------------------------------------------------
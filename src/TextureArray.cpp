@@ -0,0 +1,279 @@
+//-----------------------------------------------------------------------------
+// TextureArray.cpp
+//
+// Material textures packed into array layers and atlas pages
+//-----------------------------------------------------------------------------
+#include "TextureArray.h"
+#include "ShaderProgram.h"
+#include "Texture2D.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // Texels around every atlas tile, copied from the opposite edge of the
+    // image so repeating and filtering see the right neighbours down to the
+    // fourth mip level
+    constexpr int ATLAS_GUTTER = 8;
+
+    double megabytes(uint64_t bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+TextureArray::TextureArray()
+    : mAtlasedCount(0), mGpuBytes(0), mBoundArray(0)
+{
+}
+
+TextureArray::~TextureArray()
+{
+    for (Array &array : mArrays)
+    {
+        if (array.texture != 0)
+            glDeleteTextures(1, &array.texture);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The largest image sets the layer size. Images of that size are layers,
+// smaller ones that fit with their gutter go into atlas pages of the same
+// size, and the rest get an array per size.
+//-----------------------------------------------------------------------------
+bool TextureArray::decode(const std::vector<std::string> &files, const TextureOptions &options)
+{
+    // Layers share one RGBA8 format whatever channels each image has
+    mOptions = options;
+    mOptions.compactChannels = false;
+    mSources.clear();
+    mPages.clear();
+    mArrays.clear();
+    mLayers.assign(files.size(), Layer());
+    mAtlasedCount = 0;
+    if (files.empty())
+        return false;
+
+    size_t largest = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::unique_ptr<Texture2D> source(new Texture2D());
+        if (!source->decode(files[i], mOptions))
+            return false;
+        if (source->isCompressed())
+        {
+            std::cerr << "Texture array: '" << files[i] << "' is block compressed and cannot share layers with RGBA8 images" << std::endl;
+            return false;
+        }
+        const MipLevel &base = source->getDecodedLevels()[0];
+        const MipLevel &largestBase = i > 0 ? mSources[largest]->getDecodedLevels()[0] : base;
+        if (static_cast<int64_t>(base.width) * base.height > static_cast<int64_t>(largestBase.width) * largestBase.height)
+            largest = i;
+        mSources.push_back(std::move(source));
+    }
+
+    mArrays.emplace_back();
+    mArrays[0].width = mSources[largest]->getWidth();
+    mArrays[0].height = mSources[largest]->getHeight();
+
+    std::vector<size_t> atlased;
+    for (size_t i = 0; i < mSources.size(); i++)
+    {
+        const int width = mSources[i]->getWidth();
+        const int height = mSources[i]->getHeight();
+        if (width + 2 * ATLAS_GUTTER <= mArrays[0].width && height + 2 * ATLAS_GUTTER <= mArrays[0].height)
+        {
+            atlased.push_back(i);
+            continue;
+        }
+
+        // A layer of the array of its size, made on first use
+        size_t a = 0;
+        while (a < mArrays.size() && (mArrays[a].width != width || mArrays[a].height != height))
+            a++;
+        if (a == mArrays.size())
+        {
+            mArrays.emplace_back();
+            mArrays[a].width = width;
+            mArrays[a].height = height;
+        }
+        mLayers[i].array = static_cast<unsigned int>(a);
+        mLayers[i].layer = static_cast<float>(mArrays[a].layers.size());
+        mLayers[i].atlasRect = glm::vec4(0.0f);
+        mArrays[a].layers.push_back(mSources[i]->getDecodedLevels());
+    }
+    packAtlas(atlased, mArrays[0]);
+
+    size_t layerCount = 0;
+    for (const Array &array : mArrays)
+        layerCount += array.layers.size();
+    std::cout << "Texture array: " << files.size() << " materials in " << layerCount << " layers of " << mArrays.size()
+              << (mArrays.size() == 1 ? " array" : " arrays") << ", " << mAtlasedCount << " atlased" << std::endl;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Shelf packs the images, tallest first, into as many pages of the array's
+// size as they need. Each page gets its own mip chain, so tiles blend into
+// their gutters rather than their neighbours.
+//-----------------------------------------------------------------------------
+void TextureArray::packAtlas(const std::vector<size_t> &images, Array &array)
+{
+    if (images.empty())
+        return;
+
+    std::vector<size_t> order = images;
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+              { return mSources[a]->getHeight() > mSources[b]->getHeight(); });
+
+    const size_t pageBytes = static_cast<size_t>(array.width) * array.height * 4;
+    const size_t firstPage = mPages.size();
+    int x = 0, y = 0, shelfHeight = 0;
+    for (size_t image : order)
+    {
+        const MipLevel &source = mSources[image]->getDecodedLevels()[0];
+        const int tileWidth = source.width + 2 * ATLAS_GUTTER;
+        const int tileHeight = source.height + 2 * ATLAS_GUTTER;
+        if (x + tileWidth > array.width)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (mPages.size() == firstPage || y + tileHeight > array.height)
+        {
+            mPages.emplace_back(pageBytes, 0);
+            x = y = shelfHeight = 0;
+        }
+
+        // The tile wraps into its gutter the way the texture repeats
+        unsigned char *page = mPages.back().data();
+        for (int ty = -ATLAS_GUTTER; ty < source.height + ATLAS_GUTTER; ty++)
+        {
+            const int sy = (ty % source.height + source.height) % source.height;
+            unsigned char *row = page + (static_cast<size_t>(y + ATLAS_GUTTER + ty) * array.width + x) * 4;
+            for (int tx = -ATLAS_GUTTER; tx < source.width + ATLAS_GUTTER; tx++)
+            {
+                const int sx = (tx % source.width + source.width) % source.width;
+                std::memcpy(row + (tx + ATLAS_GUTTER) * 4, source.pixels + (static_cast<size_t>(sy) * source.width + sx) * 4, 4);
+            }
+        }
+
+        Layer &layer = mLayers[image];
+        layer.array = static_cast<unsigned int>(&array - mArrays.data());
+        layer.layer = static_cast<float>(array.layers.size() + (mPages.size() - 1 - firstPage));
+        layer.atlasRect = glm::vec4(static_cast<float>(x + ATLAS_GUTTER) / array.width, static_cast<float>(y + ATLAS_GUTTER) / array.height,
+                                    static_cast<float>(source.width) / array.width, static_cast<float>(source.height) / array.height);
+        mAtlasedCount++;
+
+        x += tileWidth;
+        shelfHeight = std::max(shelfHeight, tileHeight);
+    }
+
+    // The mip storage of every page is a further entry of mPages; the inner
+    // buffers do not move when the outer vector grows
+    const size_t lastPage = mPages.size();
+    for (size_t p = firstPage; p < lastPage; p++)
+    {
+        std::vector<MipLevel> levels = {{array.width, array.height, mPages[p].data()}};
+        if (mOptions.generateMipMaps)
+        {
+            std::vector<unsigned char> storage;
+            MipChain::build(mOptions.mipFilter, mOptions.gammaCorrectMips, storage, levels);
+            mPages.push_back(std::move(storage));
+        }
+        array.layers.push_back(std::move(levels));
+    }
+}
+
+bool TextureArray::upload()
+{
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    mGpuBytes = 0;
+    for (Array &array : mArrays)
+    {
+        if (array.layers.empty() || array.texture != 0)
+            continue;
+        if (static_cast<GLint>(array.layers.size()) > maxLayers)
+        {
+            std::cerr << "Texture array: " << array.layers.size() << " layers, the driver allows " << maxLayers << std::endl;
+            return false;
+        }
+
+        size_t levelCount = array.layers[0].size();
+        for (const std::vector<MipLevel> &levels : array.layers)
+            levelCount = std::min(levelCount, levels.size());
+
+        glGenTextures(1, &array.texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levelCount) - 1);
+        if (Texture2D::maxAnisotropy() > 1.0f)
+            glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(std::max(mOptions.anisotropy, 1.0f), Texture2D::maxAnisotropy()));
+
+        const GLsizei layerCount = static_cast<GLsizei>(array.layers.size());
+        for (size_t level = 0; level < levelCount; level++)
+        {
+            const int width = array.layers[0][level].width;
+            const int height = array.layers[0][level].height;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), mOptions.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            for (GLsizei layer = 0; layer < layerCount; layer++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                array.layers[layer][level].pixels);
+            mGpuBytes += static_cast<uint64_t>(width) * height * 4 * layerCount;
+        }
+        array.layers.clear();
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    mBoundArray = 0;
+
+    mSources.clear();
+    mPages.clear();
+    std::cout << "Texture array: uploaded " << megabytes(mGpuBytes) << " MB" << std::endl;
+    return true;
+}
+
+void TextureArray::apply(ShaderProgram &shader, unsigned int material, GLuint texUnit)
+{
+    if (mLayers.empty())
+        return;
+
+    const Layer &layer = mLayers[material % mLayers.size()];
+    if (mBoundArray != layer.array + 1)
+    {
+        glActiveTexture(GL_TEXTURE0 + texUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mArrays[layer.array].texture);
+        mBoundArray = layer.array + 1;
+    }
+    shader.setUniform("materialLayer", layer.layer);
+    shader.setUniform("materialAtlasRect", layer.atlasRect);
+}
+
+void TextureArray::unbind(GLuint texUnit)
+{
+    glActiveTexture(GL_TEXTURE0 + texUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    mBoundArray = 0;
+}
+
+void TextureArray::setAnisotropy(float anisotropy)
+{
+    mOptions.anisotropy = anisotropy;
+    if (Texture2D::maxAnisotropy() <= 1.0f)
+        return;
+    for (const Array &array : mArrays)
+    {
+        if (array.texture == 0)
+            continue;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(std::max(anisotropy, 1.0f), Texture2D::maxAnisotropy()));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    mBoundArray = 0;
+}
@@ -0,0 +1,169 @@
+//-----------------------------------------------------------------------------
+// TextureCache.cpp
+//
+// On-disk cache (.mvtex) of decoded textures
+//
+// File layout:
+//   TextureHeader
+//   LevelRecord[levelCount]
+//   pixels of every level (channels bytes per texel), level 0 first, at
+//   pixelOffset
+//-----------------------------------------------------------------------------
+#include "TextureCache.h"
+#include "MeshCache.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char TEXTURE_MAGIC[8] = {'M', 'V', 'T', 'E', 'X', 0, 0, 0};
+    const char *TEXTURE_EXTENSION = ".mvtex";
+
+    // Bump whenever the file layout or the mip filters change
+    constexpr uint32_t TEXTURE_VERSION = 2;
+
+    struct TextureHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t levelCount;
+        uint32_t channels;
+        uint32_t reserved;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t optionsHash;
+        uint64_t pixelOffset;
+        uint64_t pixelBytes;
+    };
+
+    struct LevelRecord
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset; // from pixelOffset
+    };
+
+    bool sourceStamp(const std::string &sourcePath, uint64_t &size, int64_t &time)
+    {
+        std::error_code ec;
+        size = fs::file_size(sourcePath, ec);
+        if (ec)
+            return false;
+        auto writeTime = fs::last_write_time(sourcePath, ec);
+        if (ec)
+            return false;
+        time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+        return true;
+    }
+}
+
+bool TextureCache::load(const std::string &sourcePath, uint64_t optionsHash, Entry &entry)
+{
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    std::string cachePath = MeshCache::derivedPath(sourcePath, TEXTURE_EXTENSION);
+    std::error_code ec;
+    if (cachePath.empty() || !sourceStamp(sourcePath, sourceSize, sourceTime) || !fs::exists(cachePath, ec))
+        return false;
+
+    MappedFile file;
+    if (!file.open(cachePath) || file.size() < sizeof(TextureHeader))
+        return false;
+
+    TextureHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC)) != 0 ||
+        header.version != TEXTURE_VERSION ||
+        header.sourceSize != sourceSize ||
+        header.sourceTime != sourceTime ||
+        header.optionsHash != optionsHash)
+        return false;
+
+    if (header.levelCount == 0 || header.channels < 1 || header.channels > 4 ||
+        sizeof(TextureHeader) + header.levelCount * sizeof(LevelRecord) > file.size() ||
+        header.pixelOffset + header.pixelBytes > file.size())
+    {
+        std::cerr << "Texture cache: '" << cachePath << "' is truncated" << std::endl;
+        return false;
+    }
+
+    entry.levels.clear();
+    const unsigned char *records = file.data() + sizeof(TextureHeader);
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+        LevelRecord record;
+        std::memcpy(&record, records + i * sizeof(LevelRecord), sizeof(record));
+        if (record.offset + uint64_t(record.width) * record.height * header.channels > header.pixelBytes)
+        {
+            std::cerr << "Texture cache: '" << cachePath << "' is corrupt" << std::endl;
+            return false;
+        }
+        entry.levels.push_back({static_cast<int>(record.width), static_cast<int>(record.height),
+                                file.data() + header.pixelOffset + record.offset});
+    }
+    entry.channels = static_cast<int>(header.channels);
+    entry.file = std::move(file);
+    MeshCache::touch(cachePath);
+    return true;
+}
+
+bool TextureCache::store(const std::string &sourcePath, uint64_t optionsHash, const std::vector<MipLevel> &levels, int channels)
+{
+    TextureHeader header = {};
+    std::memcpy(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC));
+    header.version = TEXTURE_VERSION;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.channels = static_cast<uint32_t>(channels);
+    header.optionsHash = optionsHash;
+    header.pixelOffset = sizeof(TextureHeader) + levels.size() * sizeof(LevelRecord);
+
+    std::string cachePath = MeshCache::derivedPath(sourcePath, TEXTURE_EXTENSION);
+    if (levels.empty() || cachePath.empty() || !sourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+
+    std::vector<LevelRecord> records;
+    for (const MipLevel &level : levels)
+    {
+        records.push_back({static_cast<uint32_t>(level.width), static_cast<uint32_t>(level.height), header.pixelBytes});
+        header.pixelBytes += uint64_t(level.width) * level.height * channels;
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path(cachePath).parent_path(), ec);
+
+    // Write to a temporary file first so a crash never leaves a torn entry
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Texture cache: unable to write '" << tempPath << "'" << std::endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(LevelRecord)));
+        for (const MipLevel &level : levels)
+            out.write(reinterpret_cast<const char *>(level.pixels), static_cast<std::streamsize>(uint64_t(level.width) * level.height * channels));
+        if (!out)
+        {
+            out.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    MeshCache::trim();
+    return true;
+}
@@ -0,0 +1,180 @@
+//-----------------------------------------------------------------------------
+// TextureFeedback.cpp
+//
+// Screen-space mip level feedback for texture streaming
+//-----------------------------------------------------------------------------
+#include "TextureFeedback.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // The feedback target is this many times smaller than the viewport on
+    // each side; the shader's level bias makes up for it
+    constexpr int FEEDBACK_SCALE = 8;
+
+    // Frames between feedback draws
+    constexpr unsigned int FEEDBACK_INTERVAL = 8;
+
+    // Levels the R8 target spans below that of a 1x1 texture
+    constexpr float LEVEL_RANGE = 16.0f;
+}
+
+TextureFeedback::TextureFeedback()
+    : mFramebuffer(0), mColor(0), mDepth(0), mWidth(0), mHeight(0), mReadbacks(), mReadbackFences(), mReadbackSizes(),
+      mNextReadback(0), mFrame(0), mFinestLevel(-LEVEL_RANGE)
+{
+}
+
+TextureFeedback::~TextureFeedback()
+{
+    release();
+}
+
+bool TextureFeedback::init(const char *vsFilename, const char *fsFilename)
+{
+    if (!mShader.loadShaders(vsFilename, fsFilename))
+        return false;
+    mShader.use();
+    mShader.setUniform("levelBias", -std::log2(static_cast<float>(FEEDBACK_SCALE)));
+    mShader.setUniform("pointScale", 0.0f);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// A read back is only queued when its buffer is free, so a slow GPU skips
+// feedback draws rather than stalling the frame
+//-----------------------------------------------------------------------------
+void TextureFeedback::update(Mesh &mesh, const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+                             int viewportWidth, int viewportHeight, float anisotropy)
+{
+    collect();
+    if (mFrame++ % FEEDBACK_INTERVAL != 0 || mReadbackFences[mNextReadback] || viewportWidth <= 0 || viewportHeight <= 0)
+        return;
+
+    resize(std::max(1, viewportWidth / FEEDBACK_SCALE), std::max(1, viewportHeight / FEEDBACK_SCALE));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glViewport(0, 0, mWidth, mHeight);
+    glClearColor(1.0f, 0.0f, 0.0f, 1.0f); // nothing drawn: the coarsest level
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    mShader.use();
+    mShader.setUniform("model", model);
+    mShader.setUniform("view", view);
+    mShader.setUniform("projection", projection);
+    mShader.setUniform("maxAnisotropy", std::max(anisotropy, 1.0f));
+    mesh.redraw(mShader);
+
+    GLuint &buffer = mReadbacks[mNextReadback];
+    const int size = mWidth * mHeight;
+    if (buffer == 0)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    if (mReadbackSizes[mNextReadback] != size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        mReadbackSizes[mNextReadback] = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, mWidth, mHeight, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mReadbackFences[mNextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mNextReadback = (mNextReadback + 1) % READBACKS;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+//-----------------------------------------------------------------------------
+// The finest level for a 1x1 texture plus log2 of the larger side; level
+// selection uses the larger derivative, so that is the side that counts
+//-----------------------------------------------------------------------------
+int TextureFeedback::getNeededLevel(int textureWidth, int textureHeight) const
+{
+    const float size = static_cast<float>(std::max(std::max(textureWidth, textureHeight), 1));
+    return static_cast<int>(std::floor(std::max(mFinestLevel + std::log2(size), 0.0f)));
+}
+
+//-----------------------------------------------------------------------------
+// Color and depth renderbuffers of the feedback target, reallocated when the
+// viewport changes size
+//-----------------------------------------------------------------------------
+void TextureFeedback::resize(int width, int height)
+{
+    if (mFramebuffer != 0 && width == mWidth && height == mHeight)
+        return;
+
+    if (mFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &mFramebuffer);
+        glGenRenderbuffers(1, &mColor);
+        glGenRenderbuffers(1, &mDepth);
+    }
+    mWidth = width;
+    mHeight = height;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, mColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_R8, mWidth, mHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mWidth, mHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Takes the finest level from every read back the GPU has finished, oldest
+// first so the latest wins. Values round to the nearest 1/16th of a level;
+// half of that is taken off so the level errs finer.
+//-----------------------------------------------------------------------------
+void TextureFeedback::collect()
+{
+    for (unsigned int n = 0; n < READBACKS; n++)
+    {
+        const unsigned int i = (mNextReadback + n) % READBACKS;
+        GLsync &fence = mReadbackFences[i];
+        if (!fence)
+            continue;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, mReadbacks[i]);
+        const unsigned char *pixels = static_cast<const unsigned char *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, mReadbackSizes[i], GL_MAP_READ_BIT));
+        if (pixels != nullptr)
+        {
+            const unsigned char finest = *std::min_element(pixels, pixels + mReadbackSizes[i]);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            mFinestLevel = (std::max(finest - 0.5f, 0.0f) / 255.0f - 1.0f) * LEVEL_RANGE;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void TextureFeedback::release()
+{
+    for (unsigned int i = 0; i < READBACKS; i++)
+    {
+        if (mReadbackFences[i])
+            glDeleteSync(mReadbackFences[i]);
+        mReadbackFences[i] = nullptr;
+    }
+    // Read backs only exist once the target does; unused names of 0 are ignored
+    if (mFramebuffer != 0)
+    {
+        glDeleteBuffers(READBACKS, mReadbacks);
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteRenderbuffers(1, &mColor);
+        glDeleteRenderbuffers(1, &mDepth);
+    }
+    std::fill(mReadbacks, mReadbacks + READBACKS, 0u);
+    mFramebuffer = mColor = mDepth = 0;
+}
@@ -0,0 +1,282 @@
+//-----------------------------------------------------------------------------
+// TextureManager.cpp
+//
+// Shared, budgeted ownership of the viewer's textures
+//-----------------------------------------------------------------------------
+#include "TextureManager.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Texture2D.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    constexpr uint64_t DEFAULT_BUDGET = 512ull * 1024 * 1024;
+
+    // Frames a streaming texture must be wanted at a coarser level before
+    // its finer levels are freed, about two seconds
+    constexpr int COARSEN_FRAMES = 120;
+
+    double megabytes(uint64_t bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+TextureManager::TextureManager()
+    : mBudget(DEFAULT_BUDGET), mEvictions(0), mDroppedLevels(0), mReuses(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Textures still held here at shutdown are not deleted: by the time this runs
+// the GL context is gone (clear() while it is alive)
+//-----------------------------------------------------------------------------
+TextureManager::~TextureManager()
+{
+    for (Entry &entry : mEntries)
+        entry.texture.release();
+}
+
+uint64_t TextureManager::contentKey(const std::string &path, const TextureOptions &options)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return 0;
+    return hashCombine(hashBytes(file.data(), file.size()), options.hash());
+}
+
+Texture2D *TextureManager::acquire(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (Entry &entry : mEntries)
+    {
+        if (entry.key == key)
+        {
+            entry.references++;
+            mReuses++;
+            return entry.texture.get();
+        }
+    }
+    return nullptr;
+}
+
+Texture2D *TextureManager::add(uint64_t key, Texture2D *texture)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (Entry &entry : mEntries)
+    {
+        if (entry.key == key)
+        {
+            delete texture;
+            entry.references++;
+            mReuses++;
+            return entry.texture.get();
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.texture.reset(texture);
+    entry.references = 1;
+    // Everything the upload brings stays until feedback has wanted it
+    // coarser for COARSEN_FRAMES
+    entry.wantedLevel = 0;
+    entry.level = 0;
+    entry.coarserFrames = 0;
+    entry.heldBack = 0;
+    mEntries.push_back(std::move(entry));
+    return texture;
+}
+
+void TextureManager::release(Texture2D *texture)
+{
+    if (texture == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (Entry &entry : mEntries)
+    {
+        if (entry.texture.get() == texture)
+        {
+            entry.references = std::max(0, entry.references - 1);
+            return;
+        }
+    }
+}
+
+void TextureManager::setBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudget = bytes;
+}
+
+void TextureManager::setWantedLevel(Texture2D *texture, int level)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (Entry &entry : mEntries)
+    {
+        if (entry.texture.get() == texture)
+        {
+            entry.wantedLevel = std::max(0, std::min(level, texture->getLevelCount() - 1));
+            return;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// A streaming texture in use refines to its wanted level at once but only
+// coarsens after being wanted coarser for COARSEN_FRAMES, so levels are not
+// freed and uploaded again as the camera wobbles. Measured by those
+// targets, unreferenced textures are evicted least recently bound first. If
+// the budget still does not hold, the least recently bound streaming
+// texture in use with levels to spare is held a level coarser, and so on
+// round the textures. Uploads continue whether or not the texture is still
+// referenced, so a released texture does not keep its CPU copy. Textures
+// that cannot stream drop their top level the same way, last.
+//-----------------------------------------------------------------------------
+void TextureManager::update(double uploadBudgetMs)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::sort(mEntries.begin(), mEntries.end(), [](const Entry &a, const Entry &b)
+              { return a.texture->getLastBind() < b.texture->getLastBind(); });
+
+    uint64_t bytes = 0;
+    for (Entry &entry : mEntries)
+    {
+        entry.heldBack = 0;
+        if (entry.references > 0 && entry.texture->isStreamable())
+        {
+            if (entry.wantedLevel < entry.level)
+                entry.level = entry.wantedLevel;
+            if (entry.wantedLevel <= entry.level)
+                entry.coarserFrames = 0;
+            else if (++entry.coarserFrames >= COARSEN_FRAMES)
+            {
+                entry.level = entry.wantedLevel;
+                entry.coarserFrames = 0;
+            }
+        }
+        bytes += targetBytes(entry);
+    }
+
+    for (auto it = mEntries.begin(); it != mEntries.end() && bytes > mBudget;)
+    {
+        if (it->references > 0)
+        {
+            ++it;
+            continue;
+        }
+        std::cout << "Texture budget: evicting a " << it->texture->getWidth() << "x" << it->texture->getHeight() << " texture ("
+                  << megabytes(it->texture->getGpuBytes()) << " MB)" << std::endl;
+        bytes -= it->texture->getGpuBytes();
+        it = mEntries.erase(it);
+        mEvictions++;
+    }
+
+    bool coarsened = true;
+    while (bytes > mBudget && coarsened)
+    {
+        coarsened = false;
+        for (Entry &entry : mEntries)
+        {
+            if (bytes <= mBudget)
+                break;
+            if (entry.references == 0 || !entry.texture->isStreamable() ||
+                entry.level + entry.heldBack >= entry.texture->getLevelCount() - 1)
+                continue;
+            uint64_t before = targetBytes(entry);
+            entry.heldBack++;
+            bytes -= before - targetBytes(entry);
+            coarsened = true;
+        }
+    }
+
+    for (Entry &entry : mEntries)
+    {
+        if (entry.references > 0)
+            entry.texture->setTargetLevel(entry.level + entry.heldBack);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (Entry &entry : mEntries)
+    {
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (elapsedMs >= uploadBudgetMs)
+            break;
+        entry.texture->streamUpload(uploadBudgetMs - elapsedMs);
+    }
+
+    bytes = gpuBytes();
+    bool dropped = true;
+    while (bytes > mBudget && dropped)
+    {
+        dropped = false;
+        for (Entry &entry : mEntries)
+        {
+            if (bytes <= mBudget)
+                break;
+            uint64_t before = entry.texture->getGpuBytes();
+            if (!entry.texture->dropTopLevel())
+                continue;
+            std::cout << "Texture budget: textures in use exceed it, dropping to " << entry.texture->getWidth() << "x"
+                      << entry.texture->getHeight() << std::endl;
+            bytes -= before - entry.texture->getGpuBytes();
+            mDroppedLevels++;
+            dropped = true;
+        }
+    }
+}
+
+void TextureManager::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
+TextureManager::Residency TextureManager::getResidency() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Residency residency = Residency();
+    residency.textures = mEntries.size();
+    for (const Entry &entry : mEntries)
+    {
+        if (entry.references > 0)
+            residency.referenced++;
+        residency.rgbaBytes += entry.texture->getRgbaBytes();
+        if (entry.texture->isStreamable())
+        {
+            residency.streaming++;
+            residency.streamedOut += entry.texture->getGpuBytesFrom(0) - entry.texture->getGpuBytes();
+            residency.heldBackLevels += entry.heldBack;
+        }
+    }
+    residency.gpuBytes = gpuBytes();
+    residency.budget = mBudget;
+    residency.evictions = mEvictions;
+    residency.droppedLevels = mDroppedLevels;
+    residency.reuses = mReuses;
+    return residency;
+}
+
+//-----------------------------------------------------------------------------
+// GL storage of a texture once a streaming texture in use reaches its target
+//-----------------------------------------------------------------------------
+uint64_t TextureManager::targetBytes(const Entry &entry) const
+{
+    if (entry.references > 0 && entry.texture->isStreamable())
+        return entry.texture->getGpuBytesFrom(entry.level + entry.heldBack);
+    return entry.texture->getGpuBytes();
+}
+
+uint64_t TextureManager::gpuBytes() const
+{
+    uint64_t bytes = 0;
+    for (const Entry &entry : mEntries)
+        bytes += entry.texture->getGpuBytes();
+    return bytes;
+}
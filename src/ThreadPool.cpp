@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// ThreadPool.cpp
+//
+// Fixed size pool of worker threads for background loading
+//-----------------------------------------------------------------------------
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : mStopping(false)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+
+    mThreads.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+        mThreads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+//-----------------------------------------------------------------------------
+// Finishes the jobs already queued, then joins all workers
+//-----------------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWakeUp.notify_all();
+
+    for (std::thread &thread : mThreads)
+        thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mWakeUp.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeUp.wait(lock, [this]()
+                         { return mStopping || !mJobs.empty(); });
+
+            if (mJobs.empty())
+                return;
+
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,69 @@
+//-----------------------------------------------------------------------------
+// VertexFormat.cpp
+//
+// Compact GPU vertex layouts
+//-----------------------------------------------------------------------------
+#include "VertexFormat.h"
+
+VertexLayout vertexLayout(const VertexFormat &format)
+{
+    VertexLayout layout = {};
+    VertexAttributeLayout &position = layout.attributes[0];
+    VertexAttributeLayout &texCoord = layout.attributes[1];
+
+    position.components = 3;
+    position.offset = 0;
+    if (format.position == PositionFormat::Unorm16)
+    {
+        position.type = AttributeType::UnsignedShort;
+        position.normalized = true;
+        layout.stride = 4 * sizeof(uint16_t); // padded to keep texCoord 4 byte aligned
+    }
+    else
+    {
+        position.type = AttributeType::Float;
+        position.normalized = false;
+        layout.stride = 3 * sizeof(float);
+    }
+
+    texCoord.components = 2;
+    texCoord.offset = layout.stride;
+    switch (format.texCoord)
+    {
+    case TexCoordFormat::Half16:
+        texCoord.type = AttributeType::HalfFloat;
+        texCoord.normalized = false;
+        layout.stride += 2 * sizeof(uint16_t);
+        break;
+    case TexCoordFormat::Unorm16:
+        texCoord.type = AttributeType::UnsignedShort;
+        texCoord.normalized = true;
+        layout.stride += 2 * sizeof(uint16_t);
+        break;
+    default:
+        texCoord.type = AttributeType::Float;
+        texCoord.normalized = false;
+        layout.stride += 2 * sizeof(float);
+        break;
+    }
+
+    return layout;
+}
+
+const char *positionFormatName(PositionFormat format)
+{
+    return format == PositionFormat::Unorm16 ? "unorm16" : "float32";
+}
+
+const char *texCoordFormatName(TexCoordFormat format)
+{
+    switch (format)
+    {
+    case TexCoordFormat::Half16:
+        return "half";
+    case TexCoordFormat::Unorm16:
+        return "unorm16";
+    default:
+        return "float32";
+    }
+}
@@ -0,0 +1,237 @@
+//-----------------------------------------------------------------------------
+// VertexWelder.cpp
+//
+// Parallel vertex deduplication for imported meshes
+//-----------------------------------------------------------------------------
+#include "VertexWelder.h"
+#include "Hash.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const unsigned int INVALID_INDEX = 0xFFFFFFFFu;
+
+    // Vertices per work item of the per-vertex passes
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Vertices are bucketed by the top hash bits so every partition can be
+    // deduplicated by one thread with a private table
+    constexpr unsigned int PARTITION_BITS = 8;
+    constexpr unsigned int PARTITION_COUNT = 1u << PARTITION_BITS;
+
+    constexpr int ATTRIBUTE_COUNT = 5; // position xyz, texture uv
+
+    struct WeldKey
+    {
+        int64_t values[ATTRIBUTE_COUNT];
+    };
+
+    //-------------------------------------------------------------------------
+    // The values two vertices must share to be merged: the float bits in
+    // exact mode, the grid cell otherwise
+    //-------------------------------------------------------------------------
+    WeldKey makeKey(const Vertex &vertex, double inverseEpsilon)
+    {
+        const float attributes[ATTRIBUTE_COUNT] = {vertex.position.x, vertex.position.y, vertex.position.z,
+                                                   vertex.texCoords.x, vertex.texCoords.y};
+        WeldKey key;
+        for (int i = 0; i < ATTRIBUTE_COUNT; i++)
+        {
+            if (inverseEpsilon > 0.0)
+            {
+                double cell = std::floor(attributes[i] * inverseEpsilon + 0.5);
+                key.values[i] = static_cast<int64_t>(std::max(-9.0e18, std::min(9.0e18, cell)));
+            }
+            else
+            {
+                float value = attributes[i] + 0.0f; // folds -0 into +0
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                key.values[i] = bits;
+            }
+        }
+        return key;
+    }
+
+    size_t chunkCount(size_t count)
+    {
+        return (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+}
+
+size_t VertexWelder::weld(MeshData &mesh, float epsilon)
+{
+    const size_t vertexCount = mesh.vertices.size();
+    if (vertexCount == 0)
+        return 0;
+
+    const double inverseEpsilon = epsilon > 0.0f ? 1.0 / epsilon : 0.0;
+    const size_t chunks = chunkCount(vertexCount);
+
+    // Which sub-mesh every vertex belongs to; vertices never merge across them
+    std::vector<unsigned int> owner(vertexCount, INVALID_INDEX);
+    parallelFor(mesh.subMeshes.size(), [&](size_t i)
+                {
+                    const SubMesh &subMesh = mesh.subMeshes[i];
+                    std::fill_n(owner.begin() + subMesh.baseVertex, subMesh.vertexCount, static_cast<unsigned int>(i)); });
+
+    // 1. Hash every vertex and count the vertices of each partition per chunk
+    std::vector<uint64_t> hashes(vertexCount);
+    std::vector<unsigned int> partitionCounts(chunks * PARTITION_COUNT, 0);
+    parallelFor(chunks, [&](size_t chunk)
+                {
+                    unsigned int *counts = partitionCounts.data() + chunk * PARTITION_COUNT;
+                    size_t end = std::min(vertexCount, (chunk + 1) * CHUNK_SIZE);
+                    for (size_t v = chunk * CHUNK_SIZE; v < end; v++)
+                    {
+                        if (owner[v] == INVALID_INDEX)
+                            continue;
+                        WeldKey key = makeKey(mesh.vertices[v], inverseEpsilon);
+                        hashes[v] = hashCombine(hashBytes(&key, sizeof(key)), owner[v]);
+                        counts[hashes[v] >> (64 - PARTITION_BITS)]++;
+                    }
+                });
+
+    // 2. Scatter vertex ids by partition. Chunks are laid out in order, so
+    //    every partition lists its vertices in ascending order.
+    std::vector<size_t> partitionStart(PARTITION_COUNT + 1, 0);
+    std::vector<size_t> scatterOffset(chunks * PARTITION_COUNT);
+    size_t ownedCount = 0;
+    for (unsigned int p = 0; p < PARTITION_COUNT; p++)
+    {
+        partitionStart[p] = ownedCount;
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            scatterOffset[chunk * PARTITION_COUNT + p] = ownedCount;
+            ownedCount += partitionCounts[chunk * PARTITION_COUNT + p];
+        }
+    }
+    partitionStart[PARTITION_COUNT] = ownedCount;
+
+    std::vector<unsigned int> partitioned(ownedCount);
+    parallelFor(chunks, [&](size_t chunk)
+                {
+                    size_t *offsets = scatterOffset.data() + chunk * PARTITION_COUNT;
+                    size_t end = std::min(vertexCount, (chunk + 1) * CHUNK_SIZE);
+                    for (size_t v = chunk * CHUNK_SIZE; v < end; v++)
+                    {
+                        if (owner[v] != INVALID_INDEX)
+                            partitioned[offsets[hashes[v] >> (64 - PARTITION_BITS)]++] = static_cast<unsigned int>(v);
+                    } });
+
+    // 3. Deduplicate each partition with an open addressing table. The first
+    //    vertex of every group becomes its representative.
+    std::vector<unsigned int> representative(vertexCount, INVALID_INDEX);
+    parallelFor(PARTITION_COUNT, [&](size_t p)
+                {
+                    size_t count = partitionStart[p + 1] - partitionStart[p];
+                    if (count == 0)
+                        return;
+
+                    size_t tableSize = 1;
+                    while (tableSize < count * 2)
+                        tableSize <<= 1;
+                    std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+
+                    for (size_t i = partitionStart[p]; i < partitionStart[p + 1]; i++)
+                    {
+                        unsigned int v = partitioned[i];
+                        WeldKey key = makeKey(mesh.vertices[v], inverseEpsilon);
+                        for (size_t slot = hashes[v] & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1))
+                        {
+                            unsigned int existing = table[slot];
+                            if (existing == INVALID_INDEX)
+                            {
+                                table[slot] = v;
+                                representative[v] = v;
+                                break;
+                            }
+                            if (hashes[existing] == hashes[v] && owner[existing] == owner[v])
+                            {
+                                WeldKey existingKey = makeKey(mesh.vertices[existing], inverseEpsilon);
+                                if (std::memcmp(&existingKey, &key, sizeof(key)) == 0)
+                                {
+                                    representative[v] = existing;
+                                    break;
+                                }
+                            }
+                        }
+                    } });
+
+    // 4. New position of every kept vertex: an exclusive prefix count of the
+    //    representatives, stored for all vertices so sub-mesh ranges map too
+    std::vector<unsigned int> keptPerChunk(chunks + 1, 0);
+    parallelFor(chunks, [&](size_t chunk)
+                {
+                    size_t end = std::min(vertexCount, (chunk + 1) * CHUNK_SIZE);
+                    for (size_t v = chunk * CHUNK_SIZE; v < end; v++)
+                        keptPerChunk[chunk] += representative[v] == v ? 1 : 0; });
+
+    unsigned int keptCount = 0;
+    for (size_t chunk = 0; chunk <= chunks; chunk++)
+    {
+        unsigned int kept = keptPerChunk[chunk];
+        keptPerChunk[chunk] = keptCount;
+        keptCount += kept;
+    }
+    if (keptCount == vertexCount)
+        return 0;
+
+    std::vector<unsigned int> remap(vertexCount + 1);
+    std::vector<Vertex> welded(keptCount);
+    parallelFor(chunks, [&](size_t chunk)
+                {
+                    unsigned int next = keptPerChunk[chunk];
+                    size_t end = std::min(vertexCount, (chunk + 1) * CHUNK_SIZE);
+                    for (size_t v = chunk * CHUNK_SIZE; v < end; v++)
+                    {
+                        remap[v] = next;
+                        if (representative[v] == v)
+                            welded[next++] = mesh.vertices[v];
+                    } });
+    remap[vertexCount] = keptCount;
+
+    // 5. Rewrite the indices in chunks so a single huge sub-mesh still
+    //    spreads over all threads
+    struct IndexRange
+    {
+        unsigned int oldBase;
+        unsigned int newBase;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<IndexRange> ranges;
+    for (SubMesh &subMesh : mesh.subMeshes)
+    {
+        unsigned int oldBase = subMesh.baseVertex;
+        unsigned int newBase = remap[oldBase];
+        for (size_t begin = 0; begin < subMesh.indexCount; begin += CHUNK_SIZE)
+        {
+            size_t end = std::min<size_t>(subMesh.indexCount, begin + CHUNK_SIZE);
+            ranges.push_back({oldBase, newBase, subMesh.indexOffset + begin, subMesh.indexOffset + end});
+        }
+
+        subMesh.baseVertex = newBase;
+        subMesh.vertexCount = remap[oldBase + subMesh.vertexCount] - newBase;
+    }
+
+    parallelFor(ranges.size(), [&](size_t r)
+                {
+                    const IndexRange &range = ranges[r];
+                    for (size_t i = range.begin; i < range.end; i++)
+                    {
+                        unsigned int oldVertex = range.oldBase + mesh.indices[i];
+                        mesh.indices[i] = remap[representative[oldVertex]] - range.newBase;
+                    } });
+
+    mesh.vertices.swap(welded);
+
+    // Snapping moves vertices by up to half a cell
+    if (epsilon > 0.0f)
+        computeSubMeshBounds(mesh);
+
+    return vertexCount - keptCount;
+}
@@ -5,9 +5,12 @@
 // - Creates Mesh class
 // - Loads and renders (3) OBJ models
 //-----------------------------------------------------------------------------
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #ifdef __APPLE__
 #include <glad/glad.h>
 #else
@@ -22,6 +25,13 @@
 #include "Texture2D.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "AssetLoader.h"
+#include "TextureManager.h"
+#include "TextureArray.h"
+#include "TextureFeedback.h"
+#include "MeshCache.h"
+#include "ChunkPager.h"
+#include "PointCloud.h"
 
 #include "imgui/imgui.h"
 #include "imgui/backends/imgui_impl_glfw.h"
@@ -39,7 +49,11 @@ namespace
     constexpr float Z_FAR = 200.0f;
     constexpr float ZOOM_SENSITIVITY = -3.0;
     constexpr float MOVE_SPEED = 5.0f; // units per second
+    constexpr double STREAM_UPLOAD_BUDGET_MS = 2.0; // mesh and texture upload time per frame
     constexpr float DRAG_THRESHOLD = 5.0f;
+    constexpr uint64_t MESH_CACHE_BUDGET = 4ull * 1024 * 1024 * 1024; // bytes of disk for .mvmesh files
+    const char *MESH_CACHE_DIRECTORY = "cache";
+    const char *CAMERA_PATH_FILE = "camera_path.txt";
 
     const char *APP_TITLE = "MiraViewer v0.1";
     int gWindowWidth = 1024;
@@ -63,10 +77,40 @@ namespace
 
     Mesh *gSelectedMesh = nullptr;
     Texture2D *gSelectedTexture = nullptr;
+    TextureArray *gSelectedMaterials = nullptr; // instead of gSelectedTexture for several textures
+    TextureManager gTextureManager; // before the loader, which hands it textures
+    AssetLoader gAssetLoader(gTextureManager);
+    ImportOptions gImportOptions;
+    TextureOptions gTextureOptions;
+    bool gFrustumCulling = true;
+    bool gBackfaceCulling = false;
+    float gLodPixelError = 1.0f;
+    int gPagerCpuBudgetMB = 1024;
+    int gPagerGpuBudgetMB = 512;
+    float gPointBudgetMillions = 5.0f;
+    int gPointGpuBudgetMB = 1024;
+    int gTextureGpuBudgetMB = 512;
+    bool gTextureStreaming = true; // mip levels from screen-space feedback
+    bool gSrgbFramebuffer = false; // GL_FRAMEBUFFER_SRGB encodes the output
+    float gPointSize = 1.0f;
     bool gShowModelLoaderTool = false;
 
+    // Camera path recorded for the pager benchmark, one key per frame
+    struct CameraKey
+    {
+        glm::vec3 position;
+        float fov;
+        float rotationX;
+        float rotationY;
+    };
+    std::vector<CameraKey> gCameraPath;
+    bool gRecordingPath = false;
+    bool gReplayingPath = false;
+    size_t gReplayFrame = 0;
+    std::string gBenchmarkReport;
+
     std::string gModelPath;
-    std::string gTexturePath;
+    std::vector<std::string> gTexturePaths; // in name order, one per material
 }
 
 // Function prototypes
@@ -78,6 +122,10 @@ void showFPS(GLFWwindow *window);
 bool initOpenGL();
 void initImGUI();
 void renderMenuBar();
+void renderVertexFormatReport();
+void renderPagerControls();
+void renderPointCloudControls();
+void stepCameraPath();
 
 void renderMenuBar()
 {
@@ -87,11 +135,13 @@ void renderMenuBar()
         {
             auto selectedFiles = ImGuiFileDialog::Instance()->GetSelection();
 
+            if (gSelectingTexture)
+                gTexturePaths.clear();
             for (const auto &file : selectedFiles)
             {
                 if (gSelectingTexture)
                 {
-                    gTexturePath = file.second;
+                    gTexturePaths.push_back(file.second);
                 }
                 else
                 {
@@ -129,13 +179,28 @@ void renderMenuBar()
     {
         ImGui::Begin("Model loader", &gShowModelLoaderTool);
 
+        if (gAssetLoader.isLoading())
+        {
+            // The current model keeps rendering until the new one is ready
+            ImGui::Text("Loading: %s", gAssetLoader.stage());
+            ImGui::ProgressBar(gAssetLoader.progress(), ImVec2(-1.0f, 0.0f));
+
+            if (ImGui::Button("Cancel"))
+            {
+                gAssetLoader.cancel();
+            }
+
+            ImGui::End();
+            return;
+        }
+
         ImGui::Text("3D Model");
         ImGui::SameLine();
         if (ImGui::Button("...##3D"))
         {
             IGFD::FileDialogConfig config;
             config.path = ".";
-            const char *filters = "Model files (*.obj *.md2 *.md3 *.md5 *.fbx *.dae *.stl *.ply){.obj,.md2,.md3,.md5,.fbx,.dae,.stl,.ply}";
+            const char *filters = "Model files (*.obj *.gltf *.glb *.md2 *.md3 *.md5 *.fbx *.dae *.stl *.ply *.mvoct){.obj,.gltf,.glb,.md2,.md3,.md5,.fbx,.dae,.stl,.ply,.mvoct}";
 
             ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose files", filters, config);
         }
@@ -147,23 +212,59 @@ void renderMenuBar()
             gSelectingTexture = true;
             IGFD::FileDialogConfig config;
             config.path = ".";
-            const char *filters = "Image files (*.png *.gif *.jpg *.jpeg *.tga *.bmp){.png,.gif,.jpg,.jpeg,.tga,.bmp}";
+            config.countSelectionMax = 0; // several textures map to the model's materials in name order
+            const char *filters = "Image files (*.png *.gif *.jpg *.jpeg *.tga *.bmp *.dds *.ktx2){.png,.gif,.jpg,.jpeg,.tga,.bmp,.dds,.ktx2}";
             ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose files", filters, config);
         }
 
+        ImGui::Checkbox("Weld duplicate vertices", &gImportOptions.weldVertices);
+        if (gImportOptions.weldVertices)
+        {
+            ImGui::InputFloat("Weld tolerance", &gImportOptions.weldEpsilon, 0.0f, 0.0f, "%g");
+            gImportOptions.weldEpsilon = std::max(0.0f, gImportOptions.weldEpsilon);
+        }
+        ImGui::Checkbox("Optimize mesh for the GPU", &gImportOptions.optimizeVertexCache);
+        ImGui::Checkbox("Generate levels of detail", &gImportOptions.generateLods);
+        ImGui::Checkbox("Out-of-core (page chunks from a disk octree)", &gImportOptions.outOfCore);
+
+        const char *positionFormats[] = {"float32", "unorm16"};
+        int positionFormat = static_cast<int>(gImportOptions.vertexFormat.position);
+        if (ImGui::Combo("Positions", &positionFormat, positionFormats, IM_ARRAYSIZE(positionFormats)))
+            gImportOptions.vertexFormat.position = static_cast<PositionFormat>(positionFormat);
+
+        const char *texCoordFormats[] = {"float32", "half", "unorm16"};
+        int texCoordFormat = static_cast<int>(gImportOptions.vertexFormat.texCoord);
+        if (ImGui::Combo("Texture coords", &texCoordFormat, texCoordFormats, IM_ARRAYSIZE(texCoordFormats)))
+            gImportOptions.vertexFormat.texCoord = static_cast<TexCoordFormat>(texCoordFormat);
+
+        ImGui::Checkbox("Generate texture mip maps", &gTextureOptions.generateMipMaps);
+        if (gTextureOptions.generateMipMaps)
+        {
+            const char *mipFilters[] = {"box", "Kaiser"};
+            int mipFilter = static_cast<int>(gTextureOptions.mipFilter);
+            if (ImGui::Combo("Mip filter", &mipFilter, mipFilters, IM_ARRAYSIZE(mipFilters)))
+                gTextureOptions.mipFilter = static_cast<MipFilter>(mipFilter);
+            ImGui::Checkbox("Gamma-correct mip maps", &gTextureOptions.gammaCorrectMips);
+        }
+        ImGui::Checkbox("Store only the image's channels (R8, RG8, RGB8)", &gTextureOptions.compactChannels);
+        ImGui::BeginDisabled(!gSrgbFramebuffer);
+        ImGui::Checkbox("sRGB colour textures (shade in linear light)", &gTextureOptions.srgb);
+        ImGui::EndDisabled();
+        if (!gSrgbFramebuffer)
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(no sRGB framebuffer)");
+        }
+        ImGui::Checkbox("Preview large JPEGs while they decode", &gTextureOptions.preview);
+
         if (ImGui::Button("Load"))
         {
-            if (!gModelPath.empty() && !gTexturePath.empty())
+            if (!gModelPath.empty() && !gTexturePaths.empty())
             {
-                gSelectedMesh = new Mesh();
-                gSelectedMesh->loadModel(gModelPath);
-
-                gSelectedTexture = new Texture2D();
-                gSelectedTexture->loadTexture(gTexturePath);
+                gAssetLoader.load(gModelPath, gTexturePaths, gImportOptions, gTextureOptions);
 
                 gModelPath.clear();
-                gTexturePath.clear();
-                gShowModelLoaderTool = false;
+                gTexturePaths.clear();
             }
             else
             {
@@ -174,7 +275,7 @@ void renderMenuBar()
         if (ImGui::Button("Cancel"))
         {
             gModelPath.clear();
-            gTexturePath.clear();
+            gTexturePaths.clear();
             gShowModelLoaderTool = false;
         }
 
@@ -194,6 +295,175 @@ void renderMenuBar()
     }
 }
 
+//-----------------------------------------------------------------------------
+// Shows what the current mesh's vertex format saves and what it costs in
+// precision, so the format can be judged per asset. The errors are colored
+// by how visible they are likely to be.
+//-----------------------------------------------------------------------------
+void renderVertexFormatReport()
+{
+    const VertexFormat &format = gSelectedMesh->getVertexFormat();
+    const VertexFormatReport &report = gSelectedMesh->getVertexFormatReport();
+    if (report.stride == 0)
+        return;
+
+    const ImVec4 good(0.1f, 0.6f, 0.1f, 1.0f);
+    const ImVec4 visible(0.8f, 0.5f, 0.0f, 1.0f);
+    const ImVec4 bad(0.8f, 0.1f, 0.1f, 1.0f);
+
+    ImGui::Separator();
+    ImGui::Text("Vertex format: positions %s, texture coords %s", positionFormatName(format.position), texCoordFormatName(format.texCoord));
+    ImGui::Text("%u bytes per vertex instead of %u (%.0f%%)", report.stride, report.sourceStride,
+                100.0f * report.stride / report.sourceStride);
+
+    float relativeError = report.relativePositionError;
+    ImGui::TextColored(relativeError < 1e-5f ? good : relativeError < 1e-4f ? visible : bad,
+                       "Position error: max %g, rms %g (%.5f%% of the bounds)",
+                       report.maxPositionError, report.rmsPositionError, relativeError * 100.0f);
+
+    // Texture coordinate error in texels of the current texture
+    int textureSize = gSelectedTexture != nullptr ? std::max(gSelectedTexture->getWidth(), gSelectedTexture->getHeight()) : 0;
+    float texelError = report.maxTexCoordError * textureSize;
+    ImGui::TextColored(texelError < 0.05f ? good : texelError < 0.5f ? visible : bad,
+                       "Texture coord error: max %g, rms %g (%.3f texels)",
+                       report.maxTexCoordError, report.rmsTexCoordError, texelError);
+}
+
+//-----------------------------------------------------------------------------
+// Point budget, GPU budget and point size of a point cloud, and what the
+// last frame drew
+//-----------------------------------------------------------------------------
+void renderPointCloudControls()
+{
+    PointCloud *pointCloud = gSelectedMesh->getPointCloud();
+    if (pointCloud == nullptr)
+        return;
+
+    ImGui::Separator();
+    ImGui::SliderFloat("Point budget (millions)", &gPointBudgetMillions, 0.5f, 50.0f);
+    ImGui::SliderInt("Point GPU budget (MB)", &gPointGpuBudgetMB, 64, 8192);
+    ImGui::SliderFloat("Point size", &gPointSize, 0.0f, 4.0f);
+    pointCloud->setBudget(static_cast<size_t>(gPointBudgetMillions * 1e6f), static_cast<uint64_t>(gPointGpuBudgetMB) << 20);
+    pointCloud->setPointSize(gPointSize);
+
+    const PointCloud::Stats &stats = pointCloud->getStats();
+    ImGui::Text("Nodes: %zu of %zu selected, %zu drawn, %zu on the GPU (%llu of %llu MB)", stats.selectedNodes, stats.nodes,
+                stats.drawnNodes, stats.gpuNodes, static_cast<unsigned long long>(stats.gpuBytes >> 20),
+                static_cast<unsigned long long>(stats.gpuBudget >> 20));
+}
+
+//-----------------------------------------------------------------------------
+// Budgets and residency of an out-of-core model, and the pager benchmark:
+// record a camera path once, then replay it from a cold cache to measure
+// the hit rate and how long visible chunks were missing
+//-----------------------------------------------------------------------------
+void renderPagerControls()
+{
+    ChunkPager *pager = gSelectedMesh->getPager();
+    if (pager == nullptr)
+        return;
+
+    ImGui::Separator();
+    ImGui::SliderInt("Pager memory budget (MB)", &gPagerCpuBudgetMB, 64, 16384);
+    ImGui::SliderInt("Pager GPU budget (MB)", &gPagerGpuBudgetMB, 64, 8192);
+    pager->setBudget(static_cast<uint64_t>(gPagerCpuBudgetMB) << 20, static_cast<uint64_t>(gPagerGpuBudgetMB) << 20);
+
+    const ChunkPager::Residency &residency = pager->getResidency();
+    ImGui::Text("Chunks: %zu of %zu visible, %zu drawn, %zu on the GPU, %zu in memory", residency.visibleChunks, residency.chunks,
+                residency.drawnChunks, residency.gpuChunks, residency.cpuChunks);
+    ImGui::Text("Memory %llu of %llu MB, GPU %llu of %llu MB", static_cast<unsigned long long>(residency.cpuBytes >> 20),
+                static_cast<unsigned long long>(residency.cpuBudget >> 20), static_cast<unsigned long long>(residency.gpuBytes >> 20),
+                static_cast<unsigned long long>(residency.gpuBudget >> 20));
+
+    if (gReplayingPath)
+    {
+        ImGui::Text("Benchmark: frame %zu of %zu", gReplayFrame, gCameraPath.size());
+    }
+    else
+    {
+        if (ImGui::Button(gRecordingPath ? "Stop recording" : "Record camera path"))
+        {
+            if (!gRecordingPath)
+                gCameraPath.clear();
+            else
+            {
+                std::ofstream out(CAMERA_PATH_FILE);
+                for (const CameraKey &key : gCameraPath)
+                    out << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' ' << key.fov << ' '
+                        << key.rotationX << ' ' << key.rotationY << '\n';
+            }
+            gRecordingPath = !gRecordingPath;
+        }
+
+        ImGui::SameLine();
+        if (!gRecordingPath && ImGui::Button("Run pager benchmark"))
+        {
+            if (gCameraPath.empty())
+            {
+                std::ifstream in(CAMERA_PATH_FILE);
+                CameraKey key;
+                while (in >> key.position.x >> key.position.y >> key.position.z >> key.fov >> key.rotationX >> key.rotationY)
+                    gCameraPath.push_back(key);
+            }
+
+            if (gCameraPath.empty())
+                gBenchmarkReport = std::string("No camera path recorded (") + CAMERA_PATH_FILE + ")";
+            else
+            {
+                pager->flush();
+                pager->resetStats();
+                gReplayFrame = 0;
+                gReplayingPath = true;
+            }
+        }
+    }
+
+    if (!gBenchmarkReport.empty())
+        ImGui::TextWrapped("%s", gBenchmarkReport.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// Records the camera into the path, or moves it along the path and reports
+// the pager statistics when the replay ends
+//-----------------------------------------------------------------------------
+void stepCameraPath()
+{
+    if (gRecordingPath)
+    {
+        gCameraPath.push_back({gFpsCamera.getPosition(), gFpsCamera.getFOV(), gModelRotationAngleX, gModelRotationAngleY});
+        return;
+    }
+    if (!gReplayingPath)
+        return;
+
+    ChunkPager *pager = gSelectedMesh != nullptr ? gSelectedMesh->getPager() : nullptr;
+    if (pager != nullptr && gReplayFrame < gCameraPath.size())
+    {
+        const CameraKey &key = gCameraPath[gReplayFrame++];
+        gFpsCamera.setPosition(key.position);
+        gFpsCamera.setFOV(key.fov);
+        gModelRotationAngleX = key.rotationX;
+        gModelRotationAngleY = key.rotationY;
+        gPerspectiveUpdated = true;
+        return;
+    }
+
+    gReplayingPath = false;
+    if (pager == nullptr)
+        return;
+
+    const ChunkPager::Stats &stats = pager->getStats();
+    std::ostringstream report;
+    report << "Pager benchmark (" << stats.frames << " frames): hit rate "
+           << (stats.lookups > 0 ? 100.0 * stats.hits / stats.lookups : 100.0) << "%, stalled "
+           << stats.stalledFrames << " frames (" << stats.stallMs << " ms), mean wait "
+           << (stats.arrivals > 0 ? stats.latencyMs / stats.arrivals : 0.0) << " ms per chunk, "
+           << stats.reads << " reads, " << stats.evictions << " evictions, paging "
+           << (stats.frames > 0 ? stats.pagingMs / stats.frames : 0.0) << " ms per frame";
+    gBenchmarkReport = report.str();
+    std::cout << gBenchmarkReport << std::endl;
+}
+
 //-----------------------------------------------------------------------------
 // Main Application Entry Point
 //-----------------------------------------------------------------------------
@@ -207,8 +477,17 @@ int main()
 
     initImGUI();
 
+    MeshCache::setDirectory(MESH_CACHE_DIRECTORY);
+    MeshCache::setDiskBudget(MESH_CACHE_BUDGET);
+
     ShaderProgram shaderProgram;
     shaderProgram.loadShaders("shaders/basic.vert", "shaders/basic.frag");
+    shaderProgram.use();
+    shaderProgram.setUniformSampler("texSampler1", 0);
+    shaderProgram.setUniformSampler("materialTextures", 1);
+
+    TextureFeedback textureFeedback;
+    textureFeedback.init("shaders/basic.vert", "shaders/feedback.frag");
 
     double lastTime = glfwGetTime();
 
@@ -228,6 +507,20 @@ int main()
         glfwPollEvents();
         update(deltaTime);
 
+        stepCameraPath();
+
+        // Upload anything the background loader has finished
+        if (gAssetLoader.update(gSelectedMesh, gSelectedTexture, gSelectedMaterials))
+        {
+            gShowModelLoaderTool = false;
+        }
+
+        // Stream the rest of a model and texture that arrived coarse first,
+        // then hold textures to their GPU budget
+        if (gSelectedMesh)
+            gSelectedMesh->streamUpload(STREAM_UPLOAD_BUDGET_MS);
+        gTextureManager.update(STREAM_UPLOAD_BUDGET_MS);
+
         // Clear the screen
         glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -247,20 +540,49 @@ int main()
 
         shaderProgram.setUniform("model", model);
 
+        // One texture for the whole model, or a layer per material that
+        // Mesh::draw selects (material 0 for the paths that do not)
         if (gSelectedTexture != nullptr)
         {
             gSelectedTexture->bind();
         }
+        if (gSelectedMaterials != nullptr)
+            gSelectedMaterials->apply(shaderProgram, 0);
+        else
+            shaderProgram.setUniform("materialLayer", -1.0f);
+
+        // sRGB textures sample as linear values; the framebuffer encodes the
+        // result again. Not for ImGui, whose colours are already encoded.
+        const bool linearShading = gSelectedMaterials != nullptr ? gSelectedMaterials->isSrgb()
+                                                                  : gSelectedTexture != nullptr && gSelectedTexture->isSrgb();
+        if (linearShading)
+            glEnable(GL_FRAMEBUFFER_SRGB);
 
         if (gSelectedMesh != nullptr)
         {
-            gSelectedMesh->draw();
+            gSelectedMesh->setClusterCulling(gFrustumCulling, gBackfaceCulling);
+            gSelectedMesh->setView(model, view, projection);
+            gSelectedMesh->setLodSelection(glm::radians(gFpsCamera.getFOV()), gWindowHeight, gLodPixelError);
+            gSelectedMesh->draw(shaderProgram);
+
+            // The mip levels the texture needs resident, a frame or two late
+            if (gTextureStreaming && gSelectedTexture != nullptr && gSelectedTexture->isStreamable())
+            {
+                textureFeedback.update(*gSelectedMesh, model, view, projection, gWindowWidth, gWindowHeight, gTextureOptions.anisotropy);
+                shaderProgram.use();
+            }
+            if (gSelectedTexture != nullptr)
+                gTextureManager.setWantedLevel(gSelectedTexture, gTextureStreaming ? textureFeedback.getNeededLevel(gSelectedTexture->getWidth(), gSelectedTexture->getHeight()) : 0);
         }
 
         if (gSelectedTexture != nullptr)
         {
             gSelectedTexture->unbind(0);
         }
+        if (gSelectedMaterials != nullptr)
+            gSelectedMaterials->unbind();
+        if (linearShading)
+            glDisable(GL_FRAMEBUFFER_SRGB);
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -295,6 +617,64 @@ int main()
 
             ImGui::ColorEdit3("Background color", (float *)&clearColor);
 
+            ImGui::Checkbox("Frustum cull meshlets", &gFrustumCulling);
+            ImGui::Checkbox("Back-face cull meshlets (closed models only)", &gBackfaceCulling);
+
+            ImGui::SliderFloat("LOD pixel error (0 = full detail)", &gLodPixelError, 0.0f, 8.0f);
+
+            if (Texture2D::maxAnisotropy() > 1.0f &&
+                ImGui::SliderFloat("Texture anisotropy", &gTextureOptions.anisotropy, 1.0f, Texture2D::maxAnisotropy(), "%.0fx"))
+            {
+                if (gSelectedTexture != nullptr)
+                    gSelectedTexture->setAnisotropy(gTextureOptions.anisotropy);
+                if (gSelectedMaterials != nullptr)
+                    gSelectedMaterials->setAnisotropy(gTextureOptions.anisotropy);
+            }
+
+            ImGui::SliderInt("Texture GPU budget (MB)", &gTextureGpuBudgetMB, 16, 8192);
+            gTextureManager.setBudget(static_cast<uint64_t>(gTextureGpuBudgetMB) << 20);
+            TextureManager::Residency textures = gTextureManager.getResidency();
+            ImGui::Text("Textures: %zu resident (%zu in use), %.1f of %.0f MB, %llu reused, %llu evicted, %llu levels dropped",
+                        textures.textures, textures.referenced, static_cast<double>(textures.gpuBytes) / (1024.0 * 1024.0),
+                        static_cast<double>(textures.budget) / (1024.0 * 1024.0), static_cast<unsigned long long>(textures.reuses),
+                        static_cast<unsigned long long>(textures.evictions), static_cast<unsigned long long>(textures.droppedLevels));
+            ImGui::Checkbox("Stream texture mips from screen-space feedback", &gTextureStreaming);
+            if (textures.streaming > 0)
+                ImGui::Text("Texture streaming: %zu streamed, %.1f MB of mips not resident, %d levels held back by the budget", textures.streaming,
+                            static_cast<double>(textures.streamedOut) / (1024.0 * 1024.0), textures.heldBackLevels);
+            if (gSelectedTexture != nullptr && gSelectedTexture->isStreamable())
+                ImGui::Text("Texture mips: level %d resident, level %d targeted, %d levels", gSelectedTexture->getResidentLevel(),
+                            gSelectedTexture->getTargetLevel(), gSelectedTexture->getLevelCount());
+            if (textures.rgbaBytes > textures.gpuBytes)
+                ImGui::Text("Texture formats save %.1f MB over RGBA8", static_cast<double>(textures.rgbaBytes - textures.gpuBytes) / (1024.0 * 1024.0));
+            if (gSelectedTexture != nullptr && gSelectedTexture->getGpuBytes() > 0)
+                ImGui::Text("Texture: %s, %.1f MB, %.1f MB less than RGBA8", gSelectedTexture->getFormatName().c_str(),
+                            static_cast<double>(gSelectedTexture->getGpuBytes()) / (1024.0 * 1024.0),
+                            static_cast<double>(gSelectedTexture->getRgbaBytes() - std::min(gSelectedTexture->getRgbaBytes(), gSelectedTexture->getGpuBytes())) / (1024.0 * 1024.0));
+            if (gSelectedMaterials != nullptr)
+                ImGui::Text("Material textures: %zu in %zu array%s (%zu atlased), %.1f MB", gSelectedMaterials->getMaterialCount(),
+                            gSelectedMaterials->getArrayCount(), gSelectedMaterials->getArrayCount() == 1 ? "" : "s",
+                            gSelectedMaterials->getAtlasedCount(), static_cast<double>(gSelectedMaterials->getGpuBytes()) / (1024.0 * 1024.0));
+
+            const Mesh::DrawStats &stats = gSelectedMesh->getDrawStats();
+            if (stats.totalPoints > 0)
+                ImGui::Text("Drawn: %zu of %zu points in %zu ranges", stats.points, stats.totalPoints, stats.drawRanges);
+            else
+                ImGui::Text("Drawn: %zu of %zu triangles, %zu of %zu meshlets in %zu ranges", stats.triangles, stats.totalTriangles,
+                            stats.meshlets, stats.totalMeshlets, stats.drawRanges);
+            ImGui::Text("Coarsest LOD in use: %u", stats.coarsestLod);
+            if (gSelectedMesh->getUploadProgress() < 1.0f)
+                ImGui::Text("Streaming: %.0f%%", 100.0f * gSelectedMesh->getUploadProgress());
+            if (gSelectedTexture != nullptr && gSelectedTexture->getUploadProgress() < 1.0f)
+                ImGui::Text("Streaming texture: %.0f%%", 100.0f * gSelectedTexture->getUploadProgress());
+            if (gAssetLoader.isRefiningTexture())
+                ImGui::Text("Texture preview: decoding full resolution");
+            ImGui::Text("Frame time: %.2f ms", 1000.0f * ImGui::GetIO().DeltaTime);
+
+            renderVertexFormatReport();
+            renderPagerControls();
+            renderPointCloudControls();
+
             ImGui::End();
         }
 
@@ -307,6 +687,13 @@ int main()
         lastTime = currentTime;
     }
 
+    // Textures go while the GL context is still alive
+    gAssetLoader.cancel();
+    gSelectedTexture = nullptr;
+    gTextureManager.clear();
+    delete gSelectedMaterials;
+    gSelectedMaterials = nullptr;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -331,6 +718,7 @@ bool initOpenGL()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // forward compatible with newer versions of OpenGL as they become available but not backward compatible (it will not run on devices that do not support OpenGL 3.3
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);        // lets GL_FRAMEBUFFER_SRGB encode the output of sRGB textures
 
     // Create an OpenGL 3.3 core, forward compatible context window
     gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, nullptr, nullptr);
@@ -381,6 +769,19 @@ bool initOpenGL()
     glViewport(0, 0, gWindowWidth, gWindowHeight);
     glEnable(GL_DEPTH_TEST);
 
+    // The hint is only a request. Without an sRGB capable framebuffer,
+    // sRGB textures would sample as linear values that are never encoded
+    // again, and render too dark, so textures keep their encoded values.
+    GLint encoding = GL_LINEAR;
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    gSrgbFramebuffer = encoding == GL_SRGB;
+    Texture2D::setSrgbOutput(gSrgbFramebuffer);
+    if (!gSrgbFramebuffer)
+    {
+        std::cout << "The framebuffer is not sRGB capable; textures are shaded in sRGB space" << std::endl;
+        gTextureOptions.srgb = false;
+    }
+
     return true;
 }
 
@@ -0,0 +1,591 @@
+//-----------------------------------------------------------------------------
+// miraconvert.cpp
+//
+// Headless batch converter. Runs the viewer's import pipeline (Mesh::import,
+// no GL context needed) over files and directories of models and writes the
+// results to a mesh cache directory: .mvmesh entries, or .mvoct octrees with
+// --out-of-core. Pointing the viewer at that directory (it uses "cache" next
+// to the executable) makes every converted model load by mapping its entry.
+//
+// Entries are keyed by the canonical source path, so convert the models
+// where the viewer will open them from.
+//
+// With --textures it also encodes images into block compressed DDS files
+// (BC1/BC3/BC4/BC5 with a full mip chain) next to their sources; the viewer
+// uploads those without decoding or filtering anything.
+//
+// Several files are converted at once and every import stage of a file is
+// itself spread over all cores, so --jobs only needs to cover the serial
+// parts of a load (mostly Assimp and file I/O).
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "CompressedTexture.h"
+#include "ImportOptions.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshOctree.h"
+#include "MipChain.h"
+#include "Parallel.h"
+#include "stb_image/stb_image.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char *DEFAULT_OUTPUT_DIRECTORY = "cache";
+
+    // Same list as the viewer's open dialog, minus .mvoct
+    const char *MODEL_EXTENSIONS[] = {".obj", ".gltf", ".glb", ".md2", ".md3", ".md5", ".fbx", ".dae", ".stl", ".ply"};
+
+    // Images stb_image decodes, for --textures
+    const char *TEXTURE_EXTENSIONS[] = {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".gif"};
+
+    enum class Result
+    {
+        Converted,
+        UpToDate,
+        Skipped,
+        Failed
+    };
+
+    struct Job
+    {
+        std::string path;
+        bool texture = false;
+        uint64_t sourceSize = 0;
+        Result result = Result::Failed;
+        std::string note;
+        uint64_t outputSize = 0;
+        double ms = 0.0;
+    };
+
+    struct Settings
+    {
+        std::vector<std::string> inputs;
+        std::string outputDirectory = DEFAULT_OUTPUT_DIRECTORY;
+        unsigned int jobs = 0; // 0 = pick from the core count
+        bool force = false;
+        bool verbose = false;
+        ImportOptions options;
+        bool textures = false;
+        bool autoTextureFormat = true; // BC3 for images with alpha, else BC1
+        BlockFormat textureFormat = BlockFormat::BC1;
+    };
+
+    std::mutex gPrintMutex;
+
+    std::string lowerExtension(const fs::path &path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    bool isModelFile(const fs::path &path)
+    {
+        std::string extension = lowerExtension(path);
+        for (const char *modelExtension : MODEL_EXTENSIONS)
+        {
+            if (extension == modelExtension)
+                return true;
+        }
+        return false;
+    }
+
+    bool isTextureFile(const fs::path &path)
+    {
+        std::string extension = lowerExtension(path);
+        for (const char *textureExtension : TEXTURE_EXTENSIONS)
+        {
+            if (extension == textureExtension)
+                return true;
+        }
+        return false;
+    }
+
+    uint64_t fileSize(const std::string &path)
+    {
+        std::error_code ec;
+        uint64_t size = fs::file_size(path, ec);
+        return ec ? 0 : size;
+    }
+
+    bool isGltf(const std::string &path)
+    {
+        std::string extension = lowerExtension(path);
+        return extension == ".gltf" || extension == ".glb";
+    }
+
+    void printUsage()
+    {
+        std::printf(
+            "Usage: miraconvert [options] <file or directory>...\n"
+            "\n"
+            "Converts models (recursively for directories) into the viewer's mesh cache.\n"
+            "\n"
+            "  -o, --output <dir>        cache directory to write (default: %s)\n"
+            "  -j, --jobs <n>            files converted at once (default: cores / 4)\n"
+            "  -f, --force               reconvert files whose entry is up to date\n"
+            "  -v, --verbose             print the import pipeline's log (one file at a time)\n"
+            "      --out-of-core         build paged octrees (.mvoct) instead of .mvmesh\n"
+            "      --no-weld             keep duplicate vertices\n"
+            "      --weld-epsilon <e>    also weld vertices closer than e\n"
+            "      --no-optimize         skip the vertex cache optimization\n"
+            "      --no-lods             skip level of detail generation\n"
+            "      --no-progressive      keep the optimized vertex order for LODs\n"
+            "      --position <fmt>      float32 | unorm16\n"
+            "      --texcoord <fmt>      float32 | half16 | unorm16\n"
+            "      --textures            also encode images into .dds files next to them\n"
+            "      --texture-format <f>  auto | bc1 | bc3 | bc4 | bc5 (default: auto, BC3\n"
+            "                            for images with alpha, else BC1)\n"
+            "\n"
+            "The import options are part of the cache key: convert with the options\n"
+            "the viewer will load with.\n",
+            DEFAULT_OUTPUT_DIRECTORY);
+    }
+
+    //-------------------------------------------------------------------------
+    // Returns false (after printing why) on a malformed command line
+    //-------------------------------------------------------------------------
+    bool parseArguments(int argc, char **argv, Settings &settings)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char *&out)
+            {
+                if (i + 1 >= argc)
+                {
+                    std::fprintf(stderr, "miraconvert: %s needs a value\n", arg.c_str());
+                    return false;
+                }
+                out = argv[++i];
+                return true;
+            };
+
+            const char *text = nullptr;
+            if (arg == "-h" || arg == "--help")
+            {
+                printUsage();
+                std::exit(0);
+            }
+            else if (arg == "-o" || arg == "--output")
+            {
+                if (!value(text))
+                    return false;
+                settings.outputDirectory = text;
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                if (!value(text))
+                    return false;
+                int jobs = std::atoi(text);
+                if (jobs < 1)
+                {
+                    std::fprintf(stderr, "miraconvert: --jobs must be at least 1\n");
+                    return false;
+                }
+                settings.jobs = static_cast<unsigned int>(jobs);
+            }
+            else if (arg == "-f" || arg == "--force")
+                settings.force = true;
+            else if (arg == "-v" || arg == "--verbose")
+                settings.verbose = true;
+            else if (arg == "--out-of-core")
+                settings.options.outOfCore = true;
+            else if (arg == "--no-weld")
+                settings.options.weldVertices = false;
+            else if (arg == "--weld-epsilon")
+            {
+                if (!value(text))
+                    return false;
+                settings.options.weldEpsilon = std::max(0.0f, static_cast<float>(std::atof(text)));
+            }
+            else if (arg == "--no-optimize")
+                settings.options.optimizeVertexCache = false;
+            else if (arg == "--no-lods")
+                settings.options.generateLods = false;
+            else if (arg == "--no-progressive")
+                settings.options.progressive = false;
+            else if (arg == "--position")
+            {
+                if (!value(text))
+                    return false;
+                if (std::strcmp(text, "float32") == 0)
+                    settings.options.vertexFormat.position = PositionFormat::Float32;
+                else if (std::strcmp(text, "unorm16") == 0)
+                    settings.options.vertexFormat.position = PositionFormat::Unorm16;
+                else
+                {
+                    std::fprintf(stderr, "miraconvert: unknown position format '%s'\n", text);
+                    return false;
+                }
+            }
+            else if (arg == "--texcoord")
+            {
+                if (!value(text))
+                    return false;
+                if (std::strcmp(text, "float32") == 0)
+                    settings.options.vertexFormat.texCoord = TexCoordFormat::Float32;
+                else if (std::strcmp(text, "half16") == 0)
+                    settings.options.vertexFormat.texCoord = TexCoordFormat::Half16;
+                else if (std::strcmp(text, "unorm16") == 0)
+                    settings.options.vertexFormat.texCoord = TexCoordFormat::Unorm16;
+                else
+                {
+                    std::fprintf(stderr, "miraconvert: unknown texture coordinate format '%s'\n", text);
+                    return false;
+                }
+            }
+            else if (arg == "--textures")
+                settings.textures = true;
+            else if (arg == "--texture-format")
+            {
+                if (!value(text))
+                    return false;
+                settings.autoTextureFormat = std::strcmp(text, "auto") == 0;
+                if (std::strcmp(text, "bc1") == 0)
+                    settings.textureFormat = BlockFormat::BC1;
+                else if (std::strcmp(text, "bc3") == 0)
+                    settings.textureFormat = BlockFormat::BC3;
+                else if (std::strcmp(text, "bc4") == 0)
+                    settings.textureFormat = BlockFormat::BC4;
+                else if (std::strcmp(text, "bc5") == 0)
+                    settings.textureFormat = BlockFormat::BC5;
+                else if (!settings.autoTextureFormat)
+                {
+                    std::fprintf(stderr, "miraconvert: unknown texture format '%s'\n", text);
+                    return false;
+                }
+            }
+            else if (!arg.empty() && arg[0] == '-')
+            {
+                std::fprintf(stderr, "miraconvert: unknown option '%s'\n", arg.c_str());
+                return false;
+            }
+            else
+                settings.inputs.push_back(arg);
+        }
+
+        if (settings.inputs.empty())
+        {
+            printUsage();
+            return false;
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Expands the inputs into model files (and images with --textures),
+    // directories recursively and in a stable order
+    //-------------------------------------------------------------------------
+    std::vector<Job> collectJobs(const std::vector<std::string> &inputs, bool textures)
+    {
+        std::vector<Job> jobs;
+        for (const std::string &input : inputs)
+        {
+            std::error_code ec;
+            if (fs::is_directory(input, ec))
+            {
+                std::vector<std::string> found;
+                for (fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, ec), end;
+                     !ec && it != end; it.increment(ec))
+                {
+                    if (it->is_regular_file(ec) && (isModelFile(it->path()) || (textures && isTextureFile(it->path()))))
+                        found.push_back(it->path().generic_string());
+                }
+                if (ec)
+                    std::fprintf(stderr, "miraconvert: error reading '%s': %s\n", input.c_str(), ec.message().c_str());
+                std::sort(found.begin(), found.end());
+                for (std::string &path : found)
+                {
+                    Job job;
+                    job.path = std::move(path);
+                    jobs.push_back(std::move(job));
+                }
+            }
+            else if (fs::is_regular_file(input, ec))
+            {
+                Job job;
+                job.path = input;
+                jobs.push_back(std::move(job));
+            }
+            else
+                std::fprintf(stderr, "miraconvert: '%s' not found\n", input.c_str());
+        }
+
+        for (Job &job : jobs)
+        {
+            job.texture = textures && isTextureFile(job.path);
+            job.sourceSize = fileSize(job.path);
+        }
+        return jobs;
+    }
+
+    //-------------------------------------------------------------------------
+    // True if the output for job is already there and matches options
+    //-------------------------------------------------------------------------
+    bool isUpToDate(Job &job, const ImportOptions &options)
+    {
+        if (options.outOfCore)
+        {
+            std::string octreePath = MeshCache::derivedPath(job.path, ".mvoct");
+            MeshOctree::Reader octree;
+            if (octreePath.empty() || !octree.open(octreePath) ||
+                octree.getSourceStamp() != MeshOctree::sourceStamp(job.path) ||
+                octree.getOptionsHash() != options.hash())
+                return false;
+            job.outputSize = fileSize(octreePath);
+            return true;
+        }
+
+        MeshCache::Entry entry;
+        if (!MeshCache::load(job.path, options.hash(), entry))
+            return false;
+        job.outputSize = fileSize(MeshCache::derivedPath(job.path, ".mvmesh"));
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Encodes an image into <name>.dds next to it: mip chain in linear light
+    // (as the viewer builds it), then every level block compressed. Up to date
+    // while the DDS file is newer than the image.
+    //-------------------------------------------------------------------------
+    void convertTexture(Job &job, const Settings &settings)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string ddsPath = fs::path(job.path).replace_extension(".dds").string();
+
+        std::error_code ec;
+        fs::file_time_type ddsTime = fs::last_write_time(ddsPath, ec);
+        if (!settings.force && !ec && ddsTime >= fs::last_write_time(job.path, ec) && !ec)
+        {
+            job.result = Result::UpToDate;
+            job.outputSize = fileSize(ddsPath);
+            return;
+        }
+
+        int width = 0, height = 0, components = 0;
+        unsigned char *pixels = stbi_load(job.path.c_str(), &width, &height, &components, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            job.result = Result::Failed;
+            job.note = stbi_failure_reason();
+            return;
+        }
+
+        std::vector<unsigned char> mipStorage;
+        std::vector<MipLevel> levels = {{width, height, pixels}};
+        MipChain::build(MipFilter::Kaiser, true, mipStorage, levels);
+
+        BlockFormat format = settings.textureFormat;
+        if (settings.autoTextureFormat)
+            format = BlockCompression::hasAlpha(levels[0]) ? BlockFormat::BC3 : BlockFormat::BC1;
+
+        size_t totalSize = 0;
+        for (const MipLevel &level : levels)
+            totalSize += compressedSize(format, level.width, level.height);
+        std::vector<unsigned char> blocks(totalSize);
+        std::vector<MipLevel> blockLevels;
+        size_t offset = 0;
+        for (const MipLevel &level : levels)
+        {
+            BlockCompression::encode(level, format, blocks.data() + offset);
+            blockLevels.push_back({level.width, level.height, blocks.data() + offset});
+            offset += compressedSize(format, level.width, level.height);
+        }
+        stbi_image_free(pixels);
+
+        // The mips were filtered in linear light from sRGB colours; the file
+        // says so, which the viewer samples them as
+        if (!CompressedTexture::writeDds(ddsPath, format, blockLevels, true))
+        {
+            job.result = Result::Failed;
+            job.note = "could not write " + ddsPath;
+            return;
+        }
+        job.result = Result::Converted;
+        job.note = blockFormatName(format);
+        job.outputSize = fileSize(ddsPath);
+        job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void convert(Job &job, const Settings &settings)
+    {
+        if (job.texture)
+        {
+            convertTexture(job, settings);
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        const ImportOptions &options = settings.options;
+
+        // The viewer maps glTF buffers directly and never looks at the cache
+        // for them, so there is nothing to bake unless they are paged
+        if (isGltf(job.path) && !options.outOfCore)
+        {
+            job.result = Result::Skipped;
+            job.note = "glTF loads natively";
+            return;
+        }
+
+        if (!settings.force && isUpToDate(job, options))
+        {
+            job.result = Result::UpToDate;
+            return;
+        }
+
+        // Mesh::import reuses a valid entry, so a forced conversion drops it
+        std::error_code ec;
+        fs::remove(MeshCache::derivedPath(job.path, options.outOfCore ? ".mvoct" : ".mvmesh"), ec);
+
+        Mesh mesh;
+        if (!mesh.import(job.path, nullptr, options))
+        {
+            job.result = Result::Failed;
+            job.note = "import failed";
+        }
+        else if (mesh.getPointCloud())
+        {
+            job.result = Result::Skipped;
+            job.note = "point set, built at load time";
+        }
+        else if (!isUpToDate(job, options))
+        {
+            job.result = Result::Failed;
+            job.note = "output not written (over the disk budget?)";
+        }
+        else
+            job.result = Result::Converted;
+
+        job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const char *resultName(Result result)
+    {
+        switch (result)
+        {
+        case Result::Converted:
+            return "converted";
+        case Result::UpToDate:
+            return "up to date";
+        case Result::Skipped:
+            return "skipped";
+        case Result::Failed:
+            return "FAILED";
+        }
+        return "";
+    }
+
+    double megabytes(uint64_t bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Entry point. Exits with 1 if any file failed to convert.
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    Settings settings;
+    if (!parseArguments(argc, argv, settings))
+        return 2;
+
+    std::vector<Job> jobs = collectJobs(settings.inputs, settings.textures);
+    if (jobs.empty())
+    {
+        std::fprintf(stderr, settings.textures ? "miraconvert: no model or image files found\n" : "miraconvert: no model files found\n");
+        return 1;
+    }
+
+    // Every file's stages already use all cores; a few files at once keep
+    // them busy through the serial parts without multiplying peak memory
+    unsigned int threadCount = settings.jobs ? settings.jobs : std::max(1u, workerThreadCount() / 4);
+    if (settings.verbose)
+        threadCount = 1;
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, jobs.size()));
+
+    // Nothing may be evicted halfway through a batch
+    MeshCache::setDirectory(settings.outputDirectory);
+    MeshCache::setDiskBudget(UINT64_MAX);
+
+    // The pipeline logs every stage of every file to std::cout; with several
+    // files in flight that is only readable one file at a time
+    std::streambuf *coutBuffer = std::cout.rdbuf();
+    if (!settings.verbose)
+        std::cout.rdbuf(nullptr);
+
+    std::printf("Converting %zu file%s into '%s' (%u at a time, %u cores)\n", jobs.size(), jobs.size() == 1 ? "" : "s",
+                settings.outputDirectory.c_str(), threadCount, workerThreadCount());
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    size_t done = 0;
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < jobs.size(); i = next++)
+        {
+            Job &job = jobs[i];
+            convert(job, settings);
+
+            std::lock_guard<std::mutex> lock(gPrintMutex);
+            done++;
+            std::printf("[%zu/%zu] %-10s %s", done, jobs.size(), resultName(job.result), job.path.c_str());
+            if (job.result == Result::Converted)
+                std::printf(" (%.1f -> %.1f MB, %.0f ms)", megabytes(job.sourceSize), megabytes(job.outputSize), job.ms);
+            if (!job.note.empty())
+                std::printf(" (%s)", job.note.c_str());
+            std::printf("\n");
+            std::fflush(stdout);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    std::cout.rdbuf(coutBuffer);
+
+    size_t counts[4] = {};
+    uint64_t sourceBytes = 0, outputBytes = 0;
+    for (const Job &job : jobs)
+    {
+        counts[static_cast<int>(job.result)]++;
+        if (job.result == Result::Converted)
+        {
+            sourceBytes += job.sourceSize;
+            outputBytes += job.outputSize;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu converted (%.1f -> %.1f MB), %zu up to date, %zu skipped, %zu failed in %.2f s\n",
+                counts[static_cast<int>(Result::Converted)], megabytes(sourceBytes), megabytes(outputBytes),
+                counts[static_cast<int>(Result::UpToDate)], counts[static_cast<int>(Result::Skipped)],
+                counts[static_cast<int>(Result::Failed)], seconds);
+
+    return counts[static_cast<int>(Result::Failed)] > 0 ? 1 : 0;
+}